@@ -3,21 +3,24 @@
 ////////////////////////////////////////////////////////////////////////////////
 QwtPlotGappedCurve::QwtPlotGappedCurve(double gapValue) 
 :	QwtPlotCurve(), 
-	gapValue_(gapValue) 
+	gapValue_(gapValue), 
+	gapScale_(1)
 {
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 QwtPlotGappedCurve::QwtPlotGappedCurve(const QwtText &title, double gapValue)
 :	QwtPlotCurve(title), 
-	gapValue_(gapValue)  
+	gapValue_(gapValue), 
+	gapScale_(1)
 {
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 QwtPlotGappedCurve::QwtPlotGappedCurve(const QString &title, double gapValue)
 :	QwtPlotCurve(title), 
-	gapValue_(gapValue) 
+	gapValue_(gapValue), 
+	gapScale_(1)
 {
 }
 
@@ -31,6 +34,10 @@ void QwtPlotGappedCurve::drawSeries(QPainter *painter, const QwtScaleMap &xMap,
     if (to < 0)
         to = dataSize() - 1;
 
+    // points that each stand for several samples
+    // can be that much further apart
+    double gap = gapValue_ * gapScale_;
+
     int i = from;
     double last = 0;
     while (i < to)
@@ -38,7 +45,7 @@ void QwtPlotGappedCurve::drawSeries(QPainter *painter, const QwtScaleMap &xMap,
         // First non-missed point will be the start of curve section.
         double x = sample(i).x();
         double y = sample(i).y();
-        if ((y < -0.001 || y > 0.001) && x - last <= gapValue_) {
+        if ((y < -0.001 || y > 0.001) && x - last <= gap) {
 
             int start = i-1;
             int end = i;
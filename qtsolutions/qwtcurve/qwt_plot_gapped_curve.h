@@ -29,9 +29,15 @@ public:
     virtual void drawSeries(QPainter *painter, const QwtScaleMap &xMap,
                                                 const QwtScaleMap &yMap, const QRectF &canvRect, int from, int to) const;
 
+	/// When the points drawn each stand for several samples (e.g. the
+	/// data is decimated) the gap is scaled by how many, 1 by default
+	void setGapScale(double scale) { gapScale_ = scale; }
+	double gapScale() const { return gapScale_; }
+
 private:
 	/// Value that denotes missed Y data at point
 	double gapValue_;
+	double gapScale_;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -50,6 +50,7 @@
 #include <qendian.h>
 #include <qdebug.h>
 #include <qdir.h>
+#include <qhash.h>
 
 #include <zlib.h>
 
@@ -438,6 +439,7 @@ public:
     void scanFiles();
 
     ZipReader::Status status;
+    QHash<QString, int> index; // file name -> header, for rawFileData
 };
 
 class ZipWriterPrivate : public QZipPrivate
@@ -458,6 +460,8 @@ public:
     enum EntryType { Directory, File, Symlink };
 
     void addEntry(EntryType type, const QString &fileName, const QByteArray &contents);
+    void addPrepared(EntryType type, const ZipWriter::PreparedFile &file);
+    static ZipWriter::PreparedFile prepare(const QString &fileName, const QByteArray &contents, ZipWriter::CompressionPolicy policy);
 };
 
 LocalFileHeader CentralFileHeader::toLocalHeader() const
@@ -565,21 +569,10 @@ void ZipReaderPrivate::scanFiles()
     }
 }
 
-void ZipWriterPrivate::addEntry(EntryType type, const QString &fileName, const QByteArray &contents/*, QFile::Permissions permissions, QZip::Method m*/)
+ZipWriter::PreparedFile ZipWriterPrivate::prepare(const QString &fileName, const QByteArray &contents, ZipWriter::CompressionPolicy compressionPolicy)
 {
-#ifndef NDEBUG
-    static const char *entryTypes[] = {
-        "directory",
-        "file     ",
-        "symlink  " };
-    ZDEBUG() << "adding" << entryTypes[type] <<":" << fileName.toUtf8().data() << (type == 2 ? QByteArray(" -> " + contents).constData() : "");
-#endif
-
-    if (! (device->isOpen() || device->open(QIODevice::WriteOnly))) {
-        status = ZipWriter::FileOpenError;
-        return;
-    }
-    device->seek(start_of_directory);
+    ZipWriter::PreparedFile file;
+    file.fileName = fileName;
 
     // don't compress small files
     ZipWriter::CompressionPolicy compression = compressionPolicy;
@@ -590,16 +583,11 @@ void ZipWriterPrivate::addEntry(EntryType type, const QString &fileName, const Q
             compression = ZipWriter::AlwaysCompress;
     }
 
-    FileHeader header;
-    memset(&header.h, 0, sizeof(CentralFileHeader));
-    writeUInt(header.h.signature, 0x02014b50);
-
-    writeUShort(header.h.version_needed, 0x14);
-    writeUInt(header.h.uncompressed_size, contents.length());
-    writeMSDosDate(header.h.last_mod_file, QDateTime::currentDateTime());
+    file.size = contents.length();
+    file.deflated = false;
     QByteArray data = contents;
     if (compression == ZipWriter::AlwaysCompress) {
-        writeUShort(header.h.compression_method, 8);
+        file.deflated = true;
 
        ulong len = contents.length();
         // shamelessly copied form zlib
@@ -624,12 +612,47 @@ void ZipWriterPrivate::addEntry(EntryType type, const QString &fileName, const Q
         } while (res == Z_BUF_ERROR);
     }
 // TODO add a check if data.length() > contents.length().  Then try to store the original and revert the compression method to be uncompressed
-    writeUInt(header.h.compressed_size, data.length());
+    file.data = data;
     uint crc_32 = ::crc32(0, 0, 0);
     crc_32 = ::crc32(crc_32, (const uchar *)contents.constData(), contents.length());
-    writeUInt(header.h.crc_32, crc_32);
+    file.crc32 = crc_32;
+
+    return file;
+}
+
+void ZipWriterPrivate::addEntry(EntryType type, const QString &fileName, const QByteArray &contents/*, QFile::Permissions permissions, QZip::Method m*/)
+{
+#ifndef NDEBUG
+    static const char *entryTypes[] = {
+        "directory",
+        "file     ",
+        "symlink  " };
+    ZDEBUG() << "adding" << entryTypes[type] <<":" << fileName.toUtf8().data() << (type == 2 ? QByteArray(" -> " + contents).constData() : "");
+#endif
+
+    addPrepared(type, prepare(fileName, contents, compressionPolicy));
+}
+
+void ZipWriterPrivate::addPrepared(EntryType type, const ZipWriter::PreparedFile &file)
+{
+    if (! (device->isOpen() || device->open(QIODevice::WriteOnly))) {
+        status = ZipWriter::FileOpenError;
+        return;
+    }
+    device->seek(start_of_directory);
+
+    FileHeader header;
+    memset(&header.h, 0, sizeof(CentralFileHeader));
+    writeUInt(header.h.signature, 0x02014b50);
 
-    header.file_name = fileName.toLocal8Bit();
+    writeUShort(header.h.version_needed, 0x14);
+    writeUInt(header.h.uncompressed_size, file.size);
+    writeMSDosDate(header.h.last_mod_file, file.lastModified.isValid() ? file.lastModified : QDateTime::currentDateTime());
+    if (file.deflated) writeUShort(header.h.compression_method, 8);
+    writeUInt(header.h.compressed_size, file.data.length());
+    writeUInt(header.h.crc_32, file.crc32);
+
+    header.file_name = file.fileName.toLocal8Bit();
     if (header.file_name.size() > 0xffff) {
         qWarning("QZip: Filename too long, chopping it to 65535 characters");
         header.file_name = header.file_name.left(0xffff);
@@ -655,7 +678,7 @@ void ZipWriterPrivate::addEntry(EntryType type, const QString &fileName, const Q
     LocalFileHeader h = header.h.toLocalHeader();
     device->write((const char *)&h, sizeof(LocalFileHeader));
     device->write(header.file_name);
-    device->write(data);
+    device->write(file.data);
     start_of_directory = device->pos();
     dirtyFileTree = true;
 }
@@ -909,6 +932,67 @@ QByteArray ZipReader::fileData(const QString &fileName) const
     return QByteArray();
 }
 
+/*!
+    Returns the data for \a fileName as it is stored in the archive, and
+    whether it is deflated. Returns false if there is no such file, or
+    it doesn't match its checksum.
+*/
+bool ZipReader::rawFileData(const QString &fileName, QByteArray &data, bool &deflated) const
+{
+    d->scanFiles();
+
+    // copying a whole archive looks up every file, so index them
+    if (d->index.count() != d->fileHeaders.size()) {
+        d->index.clear();
+        for (int i = 0; i < d->fileHeaders.size(); ++i)
+            d->index.insert(QString::fromLocal8Bit(d->fileHeaders.at(i).file_name), i);
+    }
+    int i = d->index.value(fileName, -1);
+    if (i < 0)
+        return false;
+
+    FileHeader header = d->fileHeaders.at(i);
+
+    int compressed_size = readUInt(header.h.compressed_size);
+    int start = readUInt(header.h.offset_local_header);
+
+    d->device->seek(start);
+    LocalFileHeader lh;
+    d->device->read((char *)&lh, sizeof(LocalFileHeader));
+    uint skip = readUShort(lh.file_name_length) + readUShort(lh.extra_field_length);
+    d->device->seek(d->device->pos() + skip);
+
+    int compression_method = readUShort(lh.compression_method);
+    if (compression_method != 0 && compression_method != 8)
+        return false;
+
+    deflated = (compression_method == 8);
+    data = d->device->read(compressed_size);
+    if (data.size() != compressed_size)
+        return false;
+
+    // the data is copied into another archive without being looked at,
+    // so check it against its crc first or a damaged entry would be
+    // carried from one backup to the next. inflating is still much
+    // cheaper than deflating it again
+    int uncompressed_size = readUInt(header.h.uncompressed_size);
+    QByteArray contents;
+    if (deflated) {
+        ulong len = uncompressed_size;
+        contents.resize(uncompressed_size);
+        if (inflate((uchar*)contents.data(), &len, (const uchar*)data.constData(), compressed_size) != Z_OK ||
+            (int)len != uncompressed_size)
+            return false;
+    } else {
+        if (compressed_size != uncompressed_size)
+            return false;
+        contents = data;
+    }
+    uint crc_32 = ::crc32(0, 0, 0);
+    crc_32 = ::crc32(crc_32, (const uchar *)contents.constData(), contents.length());
+    return crc_32 == readUInt(header.h.crc_32);
+}
+
 /*!
     Extracts the full contents of the zip file into \a destinationDir on
     the local filesystem.
@@ -1173,6 +1257,24 @@ void ZipWriter::addFile(const QString &fileName, const QByteArray &data)
     d->addEntry(ZipWriterPrivate::File, QDir::fromNativeSeparators(fileName), data);
 }
 
+/*!
+    Compress \a contents ready to add to an archive as \a fileName. This
+    doesn't use the archive so is safe to call from any thread.
+*/
+ZipWriter::PreparedFile ZipWriter::prepareFile(const QString &fileName, const QByteArray &contents, CompressionPolicy policy)
+{
+    return ZipWriterPrivate::prepare(QDir::fromNativeSeparators(fileName), contents, policy);
+}
+
+/*!
+    Add a file prepared with prepareFile(), or copied as stored from
+    another archive.
+*/
+void ZipWriter::addFile(const PreparedFile &file)
+{
+    d->addPrepared(ZipWriterPrivate::File, file);
+}
+
 /*!
     Add a file to the archive with \a device as the source of the contents.
     The contents returned from QIODevice::readAll() will be used as the
@@ -99,6 +99,9 @@ public:
 
     FileInfo entryInfoAt(int index) const;
     QByteArray fileData(const QString &fileName) const;
+
+    // the file as stored, checked against its crc but not uncompressed
+    bool rawFileData(const QString &fileName, QByteArray &data, bool &deflated) const;
     bool extractAll(const QString &destinationDir) const;
 
     enum Status {
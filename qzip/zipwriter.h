@@ -55,6 +55,7 @@
 
 #include <QtCore/qstring.h>
 #include <QtCore/qfile.h>
+#include <QtCore/qdatetime.h>
 
 QT_BEGIN_NAMESPACE
 
@@ -100,6 +101,23 @@ public:
 
     void addFile(const QString &fileName, QIODevice *device);
 
+    // a file compressed ahead of adding it, prepareFile() doesn't touch
+    // the archive so many can be prepared at once on other threads. the
+    // data is as stored in the archive, so entries can also be copied
+    // from another archive (see ZipReader::rawFileData)
+    struct PreparedFile
+    {
+        QString fileName;
+        QByteArray data;
+        bool deflated;
+        uint crc32;
+        uint size;              // uncompressed
+        QDateTime lastModified; // now if not set
+    };
+    static PreparedFile prepareFile(const QString &fileName, const QByteArray &contents,
+                                    CompressionPolicy policy = AlwaysCompress);
+    void addFile(const PreparedFile &file);
+
     void addDirectory(const QString &dirName);
 
     void addSymLink(const QString &fileName, const QString &destination);
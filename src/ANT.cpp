@@ -38,6 +38,11 @@
 #include <unistd.h>
 #endif
 
+#ifndef WIN32
+#include <poll.h> // waiting on the serial port
+#endif
+#include <string.h>
+
 /* Control status */
 #define ANT_RUNNING  0x01
 #define ANT_PAUSED   0x02
@@ -242,10 +247,12 @@ void ANT::run()
 
     while(1)
     {
-        // read more bytes from the device
-        uint8_t byte;
-        if (rawRead(&byte, 1) > 0) receiveByte((unsigned char)byte);
-        else msleep(5);
+        // read whatever the device has for us, usually several
+        // messages at a time when there are a few sensors about
+        uint8_t buf[64];
+        int n = rawRead(buf, sizeof(buf));
+        if (n > 0) receiveBytes(buf, n);
+        else waitForData(5);
 
         //----------------------------------------------------------------------
         // LISTEN TO CONTROLLER FOR COMMANDS
@@ -881,6 +888,37 @@ ANT::handleChannelEvent(void) {
     }
 }
 
+// take a buffer full of bytes; whole messages are framed and checked in
+// one go, anything else (split across reads, or garbage) goes through the
+// byte at a time state machine above
+void
+ANT::receiveBytes(const unsigned char *buf, int n) {
+
+    int i = 0;
+    while (i < n) {
+
+        if (state == ST_WAIT_FOR_SYNC && buf[i] == ANT_SYNC_BYTE && i+1 < n) {
+
+            int len = buf[i+ANT_OFFSET_LENGTH];
+            int size = ANT_OFFSET_DATA + len + 1; // header, data and checksum
+
+            if (len > 0 && len <= ANT_MAX_LENGTH && i+size <= n) {
+
+                unsigned char sum = 0;
+                for (int k=0; k<size-1; k++) sum ^= buf[i+k];
+
+                if (sum == buf[i+size-1]) {
+                    memcpy(rxMessage, buf+i, size-1);
+                    processMessage();
+                    i += size;
+                    continue;
+                }
+            }
+        }
+        receiveByte(buf[i++]);
+    }
+}
+
 void
 ANT::processMessage(void) {
 
@@ -1144,22 +1182,38 @@ int ANT::rawRead(uint8_t bytes[], int size)
         return usb2->read((char *)bytes, size);
     }
 #endif
-    int i=0;
-    uint8_t byte;
-
-    // read one byte at a time sleeping when no data ready
-    // until we timeout waiting then return error
-    for (i=0; i<size; i++) {
-        int rc = read(devicePort, &byte, 1);
-        if (rc == -1 || rc == 0) return -1; // error!
-        else bytes[i] = byte;
-    }
-    return i;
+    // the port is non-blocking so just take whatever is there
+    int rc = read(devicePort, bytes, size);
+    if (rc == -1 || rc == 0) return -1; // error or nothing to read
+    return rc;
 
 #endif
     return -1; // keep compiler happy.
 }
 
+// nothing to read, wait for some more (or ms) so we still get to
+// service the controller. serial ports wake us as soon as data arrives
+// rather than sleeping on it, usb sticks just sleep as they always have
+void ANT::waitForData(int ms)
+{
+#ifndef WIN32
+#ifdef GC_HAVE_LIBUSB
+    if (usbMode != USB2) {
+#endif
+        struct pollfd fds;
+        fds.fd = devicePort;
+        fds.events = POLLIN;
+        fds.revents = 0;
+        // hung up or in error we sleep, so we don't spin
+        int rc = poll(&fds, 1, ms);
+        if (rc == 0 || (rc > 0 && (fds.revents & POLLIN))) return;
+#ifdef GC_HAVE_LIBUSB
+    }
+#endif
+#endif
+    msleep(ms);
+}
+
 // convert 'p' 'c' etc into ANT values for device type
 int ANT::interpretSuffix(char c)
 {
@@ -415,6 +415,7 @@ public:
     // transmission
     void sendMessage(ANTMessage);
     void receiveByte(unsigned char byte);
+    void receiveBytes(const unsigned char *buf, int n);
     void handleChannelEvent(void);
     void processMessage(void);
 
@@ -426,6 +427,7 @@ public:
     int closePort();
     int rawRead(uint8_t bytes[], int size);
     int rawWrite(uint8_t *bytes, int size);
+    void waitForData(int ms);
 
     bool modeERGO(void) const;
     bool modeSLOPE(void) const;
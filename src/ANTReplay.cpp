@@ -0,0 +1,231 @@
+/*
+ * Copyright (c) 2015 Mark Liversedge (liversedge@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "ANTReplay.h"
+#include "ANT.h"
+
+#include <QFile>
+#include <QMutexLocker>
+#include <QElapsedTimer>
+#include <QtAlgorithms>
+#include <stdio.h>
+
+#ifndef WIN32
+#include <stdlib.h> // posix_openpt et al
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h> // strerror
+#endif
+
+// same clock as the timestamps the ANT puts on its messages
+static qint64
+now()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return qint64(tv.tv_sec) * 1000000L + tv.tv_usec;
+}
+
+// print a distribution of values in usecs as msecs
+static void
+distribution(const char *name, QVector<double> values)
+{
+    if (values.isEmpty()) {
+        printf("%-28s n/a\n", name);
+        return;
+    }
+    qSort(values);
+
+    int n = values.count();
+    printf("%-28s n=%-6d p50 %8.3f  p90 %8.3f  p99 %8.3f  max %8.3f ms\n", name, n,
+           values[(n-1) * 50 / 100] / 1000.0,
+           values[(n-1) * 90 / 100] / 1000.0,
+           values[(n-1) * 99 / 100] / 1000.0,
+           values[n-1] / 1000.0);
+}
+
+ANTReplay::ANTReplay(QString log) : log(log), chunk(40), gap(5)
+{
+}
+
+void
+ANTReplay::received(const ANTMessage message, const struct timeval timestamp)
+{
+    QMutexLocker locker(&lock);
+    got << QByteArray((const char*)message.data, ANT_OFFSET_DATA + message.data[ANT_OFFSET_LENGTH]);
+    gotAt << qint64(timestamp.tv_sec) * 1000000L + timestamp.tv_usec;
+}
+
+int
+ANTReplay::run()
+{
+#ifdef WIN32
+    fprintf(stderr, "antreplay: needs a pseudo terminal, not available on windows\n");
+    return 1;
+#else
+    QFile file(log);
+    if (!file.open(QIODevice::ReadOnly)) {
+        fprintf(stderr, "antreplay: can't read %s\n", log.toLocal8Bit().constData());
+        return 1;
+    }
+    QByteArray logged = file.readAll();
+    file.close();
+
+    // the logger writes each message padded out to the same size
+    // without its checksum, so put back what the stick actually sent
+    QByteArray stream;
+    QVector<QByteArray> sent;
+    QVector<int> ends; // where each message finishes in the stream
+    for (int i=0; i + ANT_MAX_MESSAGE_SIZE <= logged.size(); i += ANT_MAX_MESSAGE_SIZE) {
+
+        const unsigned char *m = (const unsigned char *)logged.constData() + i;
+        int len = m[ANT_OFFSET_LENGTH];
+        if (m[ANT_OFFSET_SYNC] != ANT_SYNC_BYTE || len == 0 || len > ANT_MAX_LENGTH) continue;
+
+        QByteArray message((const char *)m, ANT_OFFSET_DATA + len);
+        unsigned char sum = 0;
+        for (int k=0; k<message.size(); k++) sum ^= (unsigned char)message.at(k);
+
+        sent << message;
+        stream.append(message);
+        stream.append((char)sum);
+        ends << stream.size();
+    }
+    if (sent.isEmpty()) {
+        fprintf(stderr, "antreplay: no ANT messages in %s\n", log.toLocal8Bit().constData());
+        return 1;
+    }
+
+    // the ANT reads the slave side like a serial port and we write
+    // to the master. we hold the slave open too, raw from the start,
+    // so the pty isn't hung up when the ANT closes it
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master == -1 || grantpt(master) == -1 || unlockpt(master) == -1) {
+        fprintf(stderr, "antreplay: can't create a pseudo terminal\n");
+        return 1;
+    }
+    QString slave(ptsname(master));
+    int hold = open(slave.toLatin1().constData(), O_RDWR | O_NOCTTY);
+    if (hold == -1) {
+        fprintf(stderr, "antreplay: can't open %s\n", slave.toLatin1().constData());
+        close(master);
+        return 1;
+    }
+    struct termios raw;
+    tcgetattr(hold, &raw);
+    cfmakeraw(&raw);
+    tcsetattr(hold, TCSANOW, &raw);
+    fcntl(master, F_SETFL, fcntl(master, F_GETFL) | O_NONBLOCK);
+
+    ANT ant(NULL, NULL, "");
+    ant.setDevice(slave);
+    connect(&ant, SIGNAL(receivedAntMessage(const ANTMessage ,const timeval )),
+            this, SLOT(received(const ANTMessage ,const timeval)), Qt::DirectConnection);
+    ant.start();
+
+    // wait for it to open the port, if it found a USB2 stick
+    // first it is reading from that instead, so give up
+    QElapsedTimer opening;
+    opening.start();
+    while (ant.channelCount() == 0 && !ant.isFinished() && opening.elapsed() < 5000) usleep(1000);
+    usleep(200000);
+    if (ant.channelCount() != 4 || ant.isFinished()) {
+        fprintf(stderr, "antreplay: the ANT didn't open %s%s\n", slave.toLatin1().constData(),
+                ant.channelCount() == 8 ? ", it found a USB2 stick" : "");
+        ant.stop();
+        ant.wait();
+        close(hold);
+        close(master);
+        return 1;
+    }
+
+    printf("antreplay: %d messages from %s, in chunks of 1 to %d bytes every %d msecs\n",
+           sent.count(), log.toLocal8Bit().constData(), chunk, gap);
+
+    // when each chunk went in and where it finished
+    QVector<qint64> chunkAt;
+    QVector<int> chunkEnd;
+
+    int offset = 0, size = 1;
+    while (offset < stream.size()) {
+
+        int n = qMin(size, stream.size() - offset);
+        int rc = write(master, stream.constData() + offset, n);
+        if (rc > 0) {
+            offset += rc;
+            chunkAt << now();
+            chunkEnd << offset;
+            size = size % chunk + 1;
+        } else if (rc == -1 && errno != EAGAIN) {
+            fprintf(stderr, "antreplay: write failed, %s\n", strerror(errno));
+            break;
+        }
+
+        // throw away anything the ANT sends back, so it never blocks
+        char discard[256];
+        while (read(master, discard, sizeof(discard)) > 0) ;
+
+        // the pty is full, or in between chunks
+        if (rc <= 0) usleep(1000);
+        else if (gap > 0) usleep(gap * 1000);
+    }
+
+    // give it a moment to catch up
+    QElapsedTimer draining;
+    draining.start();
+    forever {
+        {
+            QMutexLocker locker(&lock);
+            if (got.count() >= sent.count()) break;
+        }
+        if (draining.elapsed() > 2000) break;
+        usleep(1000);
+    }
+
+    ant.stop();
+    ant.wait();
+    close(hold);
+    close(master);
+
+    // messages match one for one, and how long after the chunk that
+    // completed each one was written the ANT had it framed
+    int mismatched = 0;
+    QVector<double> latency;
+    for (int i=0; i<sent.count() && i<got.count(); i++) {
+
+        if (got.at(i) != sent.at(i)) {
+            mismatched++;
+            continue;
+        }
+
+        int c = qLowerBound(chunkEnd.constBegin(), chunkEnd.constEnd(), ends.at(i)) - chunkEnd.constBegin();
+        if (c < chunkAt.count()) latency << double(gotAt.at(i) - chunkAt.at(c));
+    }
+
+    printf("\n");
+    distribution("write to framed latency", latency);
+    printf("\n");
+    printf("%-28s %d\n", "messages sent", sent.count());
+    printf("%-28s %d\n", "messages received", got.count());
+    printf("%-28s %d\n", "messages mismatched", mismatched);
+
+    return (got.count() == sent.count() && mismatched == 0) ? 0 : 1;
+#endif
+}
@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2015 Mark Liversedge (liversedge@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _GC_ANTReplay_h
+#define _GC_ANTReplay_h 1
+#include "GoldenCheetah.h"
+
+#include <QObject>
+#include <QString>
+#include <QVector>
+#include <QByteArray>
+#include <QMutex>
+#include <sys/time.h>
+
+#include "ANTMessage.h"
+
+// Replays an ANT log (antlog.bin, as written by the ANTLogger whilst
+// training) down a pseudo terminal to the ANT reader, as if it were a
+// USB1 stick on a serial port, then checks every message came out the
+// other end intact and reports how long each took to get through.
+//
+// The bytes are written in chunks that grow from 1 byte up to the chunk
+// size and start again, so messages get split across reads at every
+// offset and the framing in ANT::receiveBytes is exercised along with
+// the byte at a time state machine. With a gap between the chunks the
+// reader is idle in ANT::waitForData when each one arrives, so the
+// latency is how quickly the poll() wakes it up.
+//
+// Not on Windows, there are no ptys. It runs from the command line:
+//   GoldenCheetah --antreplay=antlog.bin [--chunk=bytes] [--gap=msecs]
+class ANTReplay : public QObject
+{
+    Q_OBJECT
+    G_OBJECT
+
+    public:
+        ANTReplay(QString log);
+
+        void setChunk(int bytes) { chunk = bytes > 0 ? bytes : 1; }
+        void setGap(int msecs) { gap = msecs; }
+
+        // runs it and prints the report, 0 if everything got through
+        int run();
+
+    public slots:
+        // called on the ANT thread as each message is framed
+        void received(const ANTMessage message, const struct timeval timestamp);
+
+    private:
+        QString log;
+        int chunk, gap;
+
+        QMutex lock; // guards what we got
+        QVector<QByteArray> got;
+        QVector<qint64> gotAt;
+};
+
+#endif // _GC_ANTReplay_h
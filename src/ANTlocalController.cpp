@@ -115,7 +115,7 @@ ANTlocalController::setMode(int mode) {
 }
 
 /*
- * gets called from the GUI to get updated telemetry.
+ * gets called from the train engine thread to get updated telemetry.
  * so whilst we are at it we check button status too and
  * act accordingly.
  *
@@ -125,11 +125,9 @@ ANTlocalController::getRealtimeData(RealtimeData &rtData)
 {
     if(!myANTlocal->isRunning())
     {
-        QMessageBox msgBox;
-        msgBox.setText(tr("Cannot open ANT+ device"));
-        msgBox.setIcon(QMessageBox::Critical);
-        msgBox.exec();
-        parent->Stop(1);
+        // not on the gui thread, so let it tell them
+        QMetaObject::invokeMethod(parent, "deviceError", Qt::QueuedConnection,
+                                  Q_ARG(QString, tr("Cannot open ANT+ device")));
         logger.close();
         return;
     }
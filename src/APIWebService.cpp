@@ -72,7 +72,8 @@ APIWebService::athleteData(QStringList &paths, HttpRequest &request, HttpRespons
         return;
     } else {
         QFile ridedb(home.absolutePath() + "/" + paths[0] + "/cache/rideDB.json");
-        if (!ridedb.exists()) {
+        QFile ridestore(home.absolutePath() + "/" + paths[0] + "/cache/rideDB.bin");
+        if (!ridedb.exists() && !ridestore.exists()) {
             response.setStatus(404); // malformed URL
             response.setHeader("Content-Type", "text; charset=ISO-8859-1");
             response.write("unknown athlete " + paths[0].toLocal8Bit());
@@ -155,7 +156,8 @@ APIWebService::listAthletes(HttpRequest &, HttpResponse &response)
         // sure fire sign the athlete has been upgraded to post 3.2 and not some
         // random directory full of other things & check something basic is set
         QString ridedb = home.absolutePath() + "/" + name + "/cache/rideDB.json";
-        if (QFile(ridedb).exists() && appsettings->cvalue(name, GC_SEX, "") != "") {
+        QString ridestore = home.absolutePath() + "/" + name + "/cache/rideDB.bin";
+        if ((QFile(ridedb).exists() || QFile(ridestore).exists()) && appsettings->cvalue(name, GC_SEX, "") != "") {
             // we got one
             QString line = name;
             line += ", " + appsettings->cvalue(name, GC_DOB).toDate().toString("yyyy/MM/dd");
@@ -23,6 +23,12 @@
 #include "RideItem.h"
 #include "RideMetadata.h"
 #include <QDir>
+#include <QMap>
+#include <QStringList>
+#include <QSharedPointer>
+#include <QMutex>
+#include <QReadWriteLock>
+#include <QDateTime>
 
 struct listRideSettings {
     bool intervals;
@@ -31,6 +37,26 @@ struct listRideSettings {
     QList<QString> metawanted; // metadata to list
 };
 
+// the rides for an athlete as they were in cache/rideDB.bin when it
+// was last read, shared by all the connection handler threads
+class APIAthleteIndex
+{
+    public:
+        APIAthleteIndex() : size(-1) {}
+        ~APIAthleteIndex() { clear(); }
+
+        // delete the rides and their intervals
+        void clear();
+
+        QReadWriteLock lock;
+        QList<RideItem*> rides;
+
+        // generation stamp of the store when it was read
+        QDateTime modified;
+        qint64 size;
+};
+typedef QSharedPointer<APIAthleteIndex> APIAthleteIndexPtr;
+
 class APIWebService : public HttpRequestHandler
 {
 
@@ -53,8 +79,19 @@ class APIWebService : public HttpRequestHandler
         // utility
         void writeRideLine(RideItem &item, HttpRequest *request, HttpResponse *response);
 
+        // rides for the athlete, reread when the store changes
+        // NULL if there is no store (yet) or it can't be read
+        APIAthleteIndexPtr athleteIndex(QString athlete);
+
     private:
         QDir home;
+
+        // only the most recently asked for athletes are kept, an index
+        // that is dropped lives on until the requests using it are done
+        static const int maxIndexes = 4;
+        QMutex indexLock;
+        QMap<QString, APIAthleteIndexPtr> indexes;
+        QStringList recent; // most recent first
 };
 
 #endif
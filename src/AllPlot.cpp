@@ -33,6 +33,7 @@
 #include "Colors.h"
 #include "WPrime.h"
 #include "IndendPlotMarker.h"
+#include "DecimatedSeriesData.h"
 
 #include <qwt_plot_curve.h>
 #include <qwt_plot_canvas.h>
@@ -2310,112 +2311,112 @@ AllPlot::recalc(AllPlotObject *objects)
     // set curve.
     for(int k=0; k<objects->U.count(); k++) {
         if (!objects->U[k].array.empty()) {
-            objects->U[k].curve->setSamples(xaxis.data() + startingIndex, objects->U[k].smooth.data() + startingIndex, totalPoints);
+            DecimatedSeriesData::setSamples(objects->U[k].curve, xaxis.data() + startingIndex, objects->U[k].smooth.data() + startingIndex, totalPoints);
         }
     }
 
     if (!objects->wattsArray.empty()) {
-        objects->wattsCurve->setSamples(xaxis.data() + startingIndex, objects->smoothWatts.data() + startingIndex, totalPoints);
+        DecimatedSeriesData::setSamples(objects->wattsCurve, xaxis.data() + startingIndex, objects->smoothWatts.data() + startingIndex, totalPoints);
     }
 
     if (!objects->antissArray.empty()) {
-        objects->antissCurve->setSamples(xaxis.data() + startingIndex, objects->smoothANT.data() + startingIndex, totalPoints);
+        DecimatedSeriesData::setSamples(objects->antissCurve, xaxis.data() + startingIndex, objects->smoothANT.data() + startingIndex, totalPoints);
     }
 
     if (!objects->atissArray.empty()) {
-        objects->atissCurve->setSamples(xaxis.data() + startingIndex, objects->smoothAT.data() + startingIndex, totalPoints);
+        DecimatedSeriesData::setSamples(objects->atissCurve, xaxis.data() + startingIndex, objects->smoothAT.data() + startingIndex, totalPoints);
     }
 
     if (!objects->rvArray.empty()) {
-        objects->rvCurve->setSamples(xaxis.data() + startingIndex, objects->smoothRV.data() + startingIndex, totalPoints);
+        DecimatedSeriesData::setSamples(objects->rvCurve, xaxis.data() + startingIndex, objects->smoothRV.data() + startingIndex, totalPoints);
     }
 
     if (!objects->rcadArray.empty()) {
-        objects->rcadCurve->setSamples(xaxis.data() + startingIndex, objects->smoothRCad.data() + startingIndex, totalPoints);
+        DecimatedSeriesData::setSamples(objects->rcadCurve, xaxis.data() + startingIndex, objects->smoothRCad.data() + startingIndex, totalPoints);
     }
 
     if (!objects->rgctArray.empty()) {
-        objects->rgctCurve->setSamples(xaxis.data() + startingIndex, objects->smoothRGCT.data() + startingIndex, totalPoints);
+        DecimatedSeriesData::setSamples(objects->rgctCurve, xaxis.data() + startingIndex, objects->smoothRGCT.data() + startingIndex, totalPoints);
     }
 
     if (!objects->gearArray.empty()) {
-        objects->gearCurve->setSamples(xaxis.data() + startingIndex, objects->smoothGear.data() + startingIndex, totalPoints);
+        DecimatedSeriesData::setSamples(objects->gearCurve, xaxis.data() + startingIndex, objects->smoothGear.data() + startingIndex, totalPoints);
     }
 
     if (!objects->smo2Array.empty()) {
-        objects->smo2Curve->setSamples(xaxis.data() + startingIndex, objects->smoothSmO2.data() + startingIndex, totalPoints);
+        DecimatedSeriesData::setSamples(objects->smo2Curve, xaxis.data() + startingIndex, objects->smoothSmO2.data() + startingIndex, totalPoints);
     }
 
     if (!objects->thbArray.empty()) {
-        objects->thbCurve->setSamples(xaxis.data() + startingIndex, objects->smoothtHb.data() + startingIndex, totalPoints);
+        DecimatedSeriesData::setSamples(objects->thbCurve, xaxis.data() + startingIndex, objects->smoothtHb.data() + startingIndex, totalPoints);
     }
 
     if (!objects->o2hbArray.empty()) {
-        objects->o2hbCurve->setSamples(xaxis.data() + startingIndex, objects->smoothO2Hb.data() + startingIndex, totalPoints);
+        DecimatedSeriesData::setSamples(objects->o2hbCurve, xaxis.data() + startingIndex, objects->smoothO2Hb.data() + startingIndex, totalPoints);
     }
 
     if (!objects->hhbArray.empty()) {
-        objects->hhbCurve->setSamples(xaxis.data() + startingIndex, objects->smoothHHb.data() + startingIndex, totalPoints);
+        DecimatedSeriesData::setSamples(objects->hhbCurve, xaxis.data() + startingIndex, objects->smoothHHb.data() + startingIndex, totalPoints);
     }
 
     if (!objects->npArray.empty()) {
-        objects->npCurve->setSamples(xaxis.data() + startingIndex, objects->smoothNP.data() + startingIndex, totalPoints);
+        DecimatedSeriesData::setSamples(objects->npCurve, xaxis.data() + startingIndex, objects->smoothNP.data() + startingIndex, totalPoints);
     }
 
     if (!objects->xpArray.empty()) {
-        objects->xpCurve->setSamples(xaxis.data() + startingIndex, objects->smoothXP.data() + startingIndex, totalPoints);
+        DecimatedSeriesData::setSamples(objects->xpCurve, xaxis.data() + startingIndex, objects->smoothXP.data() + startingIndex, totalPoints);
     }
 
     if (!objects->apArray.empty()) {
-        objects->apCurve->setSamples(xaxis.data() + startingIndex, objects->smoothAP.data() + startingIndex, totalPoints);
+        DecimatedSeriesData::setSamples(objects->apCurve, xaxis.data() + startingIndex, objects->smoothAP.data() + startingIndex, totalPoints);
     }
 
     if (!objects->hrArray.empty()) {
-        objects->hrCurve->setSamples(xaxis.data() + startingIndex, objects->smoothHr.data() + startingIndex, totalPoints);
+        DecimatedSeriesData::setSamples(objects->hrCurve, xaxis.data() + startingIndex, objects->smoothHr.data() + startingIndex, totalPoints);
     }
 
     if (!objects->tcoreArray.empty()) {
-        objects->tcoreCurve->setSamples(xaxis.data() + startingIndex, objects->smoothTcore.data() + startingIndex, totalPoints);
+        DecimatedSeriesData::setSamples(objects->tcoreCurve, xaxis.data() + startingIndex, objects->smoothTcore.data() + startingIndex, totalPoints);
     }
 
     if (!objects->speedArray.empty()) {
-        objects->speedCurve->setSamples(xaxis.data() + startingIndex, objects->smoothSpeed.data() + startingIndex, totalPoints);
+        DecimatedSeriesData::setSamples(objects->speedCurve, xaxis.data() + startingIndex, objects->smoothSpeed.data() + startingIndex, totalPoints);
     }
 
     if (!objects->accelArray.empty()) {
-        objects->accelCurve->setSamples(xaxis.data() + startingIndex, objects->smoothAccel.data() + startingIndex, totalPoints);
+        DecimatedSeriesData::setSamples(objects->accelCurve, xaxis.data() + startingIndex, objects->smoothAccel.data() + startingIndex, totalPoints);
     }
 
     if (!objects->wattsDArray.empty()) {
-        objects->wattsDCurve->setSamples(xaxis.data() + startingIndex, objects->smoothWattsD.data() + startingIndex, totalPoints);
+        DecimatedSeriesData::setSamples(objects->wattsDCurve, xaxis.data() + startingIndex, objects->smoothWattsD.data() + startingIndex, totalPoints);
     }
 
     if (!objects->cadDArray.empty()) {
-        objects->cadDCurve->setSamples(xaxis.data() + startingIndex, objects->smoothCadD.data() + startingIndex, totalPoints);
+        DecimatedSeriesData::setSamples(objects->cadDCurve, xaxis.data() + startingIndex, objects->smoothCadD.data() + startingIndex, totalPoints);
     }
 
     if (!objects->nmDArray.empty()) {
-        objects->nmDCurve->setSamples(xaxis.data() + startingIndex, objects->smoothNmD.data() + startingIndex, totalPoints);
+        DecimatedSeriesData::setSamples(objects->nmDCurve, xaxis.data() + startingIndex, objects->smoothNmD.data() + startingIndex, totalPoints);
     }
 
     if (!objects->hrDArray.empty()) {
-        objects->hrDCurve->setSamples(xaxis.data() + startingIndex, objects->smoothHrD.data() + startingIndex, totalPoints);
+        DecimatedSeriesData::setSamples(objects->hrDCurve, xaxis.data() + startingIndex, objects->smoothHrD.data() + startingIndex, totalPoints);
     }
 
     if (!objects->cadArray.empty()) {
-        objects->cadCurve->setSamples(xaxis.data() + startingIndex, objects->smoothCad.data() + startingIndex, totalPoints);
+        DecimatedSeriesData::setSamples(objects->cadCurve, xaxis.data() + startingIndex, objects->smoothCad.data() + startingIndex, totalPoints);
     }
 
     if (!objects->altArray.empty()) {
-        objects->altCurve->setSamples(xaxis.data() + startingIndex, objects->smoothAltitude.data() + startingIndex, totalPoints);
+        DecimatedSeriesData::setSamples(objects->altCurve, xaxis.data() + startingIndex, objects->smoothAltitude.data() + startingIndex, totalPoints);
         objects->altSlopeCurve->setSamples(xaxis.data() + startingIndex, objects->smoothAltitude.data() + startingIndex, totalPoints);
     }
     if (!objects->slopeArray.empty()) {
-        objects->slopeCurve->setSamples(xaxis.data() + startingIndex, objects->smoothSlope.data() + startingIndex, totalPoints);
+        DecimatedSeriesData::setSamples(objects->slopeCurve, xaxis.data() + startingIndex, objects->smoothSlope.data() + startingIndex, totalPoints);
     }
 
     if (!objects->tempArray.empty()) {
-        objects->tempCurve->setSamples(xaxis.data() + startingIndex, objects->smoothTemp.data() + startingIndex, totalPoints);
+        DecimatedSeriesData::setSamples(objects->tempCurve, xaxis.data() + startingIndex, objects->smoothTemp.data() + startingIndex, totalPoints);
     }
 
 
@@ -2424,29 +2425,29 @@ AllPlot::recalc(AllPlotObject *objects)
     }
 
     if (!objects->torqueArray.empty()) {
-        objects->torqueCurve->setSamples(xaxis.data() + startingIndex, objects->smoothTorque.data() + startingIndex, totalPoints);
+        DecimatedSeriesData::setSamples(objects->torqueCurve, xaxis.data() + startingIndex, objects->smoothTorque.data() + startingIndex, totalPoints);
     }
 
     // left/right pedals
     if (!objects->balanceArray.empty()) {
-        objects->balanceLCurve->setSamples(xaxis.data() + startingIndex, 
-                                           objects->smoothBalanceL.data() + startingIndex, totalPoints);
-        objects->balanceRCurve->setSamples(xaxis.data() + startingIndex, 
-                                           objects->smoothBalanceR.data() + startingIndex, totalPoints);
-    }
-    if (!objects->lteArray.empty()) objects->lteCurve->setSamples(xaxis.data() + startingIndex, 
-                                             objects->smoothLTE.data() + startingIndex, totalPoints);
-    if (!objects->rteArray.empty()) objects->rteCurve->setSamples(xaxis.data() + startingIndex, 
-                                             objects->smoothRTE.data() + startingIndex, totalPoints);
-    if (!objects->lpsArray.empty()) objects->lpsCurve->setSamples(xaxis.data() + startingIndex, 
-                                             objects->smoothLPS.data() + startingIndex, totalPoints);
-    if (!objects->rpsArray.empty()) objects->rpsCurve->setSamples(xaxis.data() + startingIndex, 
-                                             objects->smoothRPS.data() + startingIndex, totalPoints);
-
-    if (!objects->lpcoArray.empty()) objects->lpcoCurve->setSamples(xaxis.data() + startingIndex,
-                                             objects->smoothLPCO.data() + startingIndex, totalPoints);
-    if (!objects->rpcoArray.empty()) objects->rpcoCurve->setSamples(xaxis.data() + startingIndex,
-                                             objects->smoothRPCO.data() + startingIndex, totalPoints);
+        DecimatedSeriesData::setSamples(objects->balanceLCurve, xaxis.data() + startingIndex, 
+                                        objects->smoothBalanceL.data() + startingIndex, totalPoints);
+        DecimatedSeriesData::setSamples(objects->balanceRCurve, xaxis.data() + startingIndex, 
+                                        objects->smoothBalanceR.data() + startingIndex, totalPoints);
+    }
+    if (!objects->lteArray.empty()) DecimatedSeriesData::setSamples(objects->lteCurve, xaxis.data() + startingIndex, 
+                                                                    objects->smoothLTE.data() + startingIndex, totalPoints);
+    if (!objects->rteArray.empty()) DecimatedSeriesData::setSamples(objects->rteCurve, xaxis.data() + startingIndex, 
+                                                                    objects->smoothRTE.data() + startingIndex, totalPoints);
+    if (!objects->lpsArray.empty()) DecimatedSeriesData::setSamples(objects->lpsCurve, xaxis.data() + startingIndex, 
+                                                                    objects->smoothLPS.data() + startingIndex, totalPoints);
+    if (!objects->rpsArray.empty()) DecimatedSeriesData::setSamples(objects->rpsCurve, xaxis.data() + startingIndex, 
+                                                                    objects->smoothRPS.data() + startingIndex, totalPoints);
+
+    if (!objects->lpcoArray.empty()) DecimatedSeriesData::setSamples(objects->lpcoCurve, xaxis.data() + startingIndex,
+                                                                     objects->smoothLPCO.data() + startingIndex, totalPoints);
+    if (!objects->rpcoArray.empty()) DecimatedSeriesData::setSamples(objects->rpcoCurve, xaxis.data() + startingIndex,
+                                                                     objects->smoothRPCO.data() + startingIndex, totalPoints);
     if (!objects->lppbArray.empty()) {
         objects->lppCurve->setSamples(new QwtIntervalSeriesData(objects->smoothLPP));
     }
@@ -3262,47 +3263,47 @@ AllPlot::setDataFromPlot(AllPlot *plot, int startidx, int stopidx)
         setMatchLabels(standard);
     }
     int points = stopidx - startidx + 1; // e.g. 10 to 12 is 3 points 10,11,12, so not 12-10 !
-    for(int k=0; k<standard->U.count(); k++) standard->U[k].curve->setSamples(xaxis,smoothU[k], points);
-    standard->wattsCurve->setSamples(xaxis,smoothW,points);
-    standard->atissCurve->setSamples(xaxis,smoothAT,points);
-    standard->antissCurve->setSamples(xaxis,smoothANT,points);
-    standard->npCurve->setSamples(xaxis,smoothN,points);
-    standard->rvCurve->setSamples(xaxis,smoothRV,points);
-    standard->rcadCurve->setSamples(xaxis,smoothRCad,points);
-    standard->rgctCurve->setSamples(xaxis,smoothRGCT,points);
-    standard->gearCurve->setSamples(xaxis,smoothGear,points);
-    standard->smo2Curve->setSamples(xaxis,smoothSmO2,points);
-    standard->thbCurve->setSamples(xaxis,smoothtHb,points);
-    standard->o2hbCurve->setSamples(xaxis,smoothO2Hb,points);
-    standard->hhbCurve->setSamples(xaxis,smoothHHb,points);
-    standard->xpCurve->setSamples(xaxis,smoothX,points);
-    standard->apCurve->setSamples(xaxis,smoothL,points);
-    standard->hrCurve->setSamples(xaxis, smoothHR,points);
-    standard->tcoreCurve->setSamples(xaxis, smoothTCORE,points);
-    standard->speedCurve->setSamples(xaxis, smoothS, points);
-    standard->accelCurve->setSamples(xaxis, smoothAC, points);
-    standard->wattsDCurve->setSamples(xaxis, smoothWD, points);
-    standard->cadDCurve->setSamples(xaxis, smoothCD, points);
-    standard->nmDCurve->setSamples(xaxis, smoothND, points);
-    standard->hrDCurve->setSamples(xaxis, smoothHD, points);
-    standard->cadCurve->setSamples(xaxis, smoothC, points);
-    standard->altCurve->setSamples(xaxis, smoothA, points);
+    for(int k=0; k<standard->U.count(); k++) DecimatedSeriesData::setSamples(standard->U[k].curve, xaxis,smoothU[k], points);
+    DecimatedSeriesData::setSamples(standard->wattsCurve, xaxis,smoothW,points);
+    DecimatedSeriesData::setSamples(standard->atissCurve, xaxis,smoothAT,points);
+    DecimatedSeriesData::setSamples(standard->antissCurve, xaxis,smoothANT,points);
+    DecimatedSeriesData::setSamples(standard->npCurve, xaxis,smoothN,points);
+    DecimatedSeriesData::setSamples(standard->rvCurve, xaxis,smoothRV,points);
+    DecimatedSeriesData::setSamples(standard->rcadCurve, xaxis,smoothRCad,points);
+    DecimatedSeriesData::setSamples(standard->rgctCurve, xaxis,smoothRGCT,points);
+    DecimatedSeriesData::setSamples(standard->gearCurve, xaxis,smoothGear,points);
+    DecimatedSeriesData::setSamples(standard->smo2Curve, xaxis,smoothSmO2,points);
+    DecimatedSeriesData::setSamples(standard->thbCurve, xaxis,smoothtHb,points);
+    DecimatedSeriesData::setSamples(standard->o2hbCurve, xaxis,smoothO2Hb,points);
+    DecimatedSeriesData::setSamples(standard->hhbCurve, xaxis,smoothHHb,points);
+    DecimatedSeriesData::setSamples(standard->xpCurve, xaxis,smoothX,points);
+    DecimatedSeriesData::setSamples(standard->apCurve, xaxis,smoothL,points);
+    DecimatedSeriesData::setSamples(standard->hrCurve, xaxis, smoothHR,points);
+    DecimatedSeriesData::setSamples(standard->tcoreCurve, xaxis, smoothTCORE,points);
+    DecimatedSeriesData::setSamples(standard->speedCurve, xaxis, smoothS, points);
+    DecimatedSeriesData::setSamples(standard->accelCurve, xaxis, smoothAC, points);
+    DecimatedSeriesData::setSamples(standard->wattsDCurve, xaxis, smoothWD, points);
+    DecimatedSeriesData::setSamples(standard->cadDCurve, xaxis, smoothCD, points);
+    DecimatedSeriesData::setSamples(standard->nmDCurve, xaxis, smoothND, points);
+    DecimatedSeriesData::setSamples(standard->hrDCurve, xaxis, smoothHD, points);
+    DecimatedSeriesData::setSamples(standard->cadCurve, xaxis, smoothC, points);
+    DecimatedSeriesData::setSamples(standard->altCurve, xaxis, smoothA, points);
     standard->altSlopeCurve->setSamples(xaxis, smoothA, points);
-    standard->slopeCurve->setSamples(xaxis, smoothSL, points);
-    standard->tempCurve->setSamples(xaxis, smoothTE, points);
+    DecimatedSeriesData::setSamples(standard->slopeCurve, xaxis, smoothSL, points);
+    DecimatedSeriesData::setSamples(standard->tempCurve, xaxis, smoothTE, points);
 
     QVector<QwtIntervalSample> tmpWND(points);
     memcpy(tmpWND.data(), smoothRS, (points) * sizeof(QwtIntervalSample));
     standard->windCurve->setSamples(new QwtIntervalSeriesData(tmpWND));
-    standard->torqueCurve->setSamples(xaxis, smoothNM, points);
-    standard->balanceLCurve->setSamples(xaxis, smoothBALL, points);
-    standard->balanceRCurve->setSamples(xaxis, smoothBALR, points);
-    standard->lteCurve->setSamples(xaxis, smoothLTE, points);
-    standard->rteCurve->setSamples(xaxis, smoothRTE, points);
-    standard->lpsCurve->setSamples(xaxis, smoothLPS, points);
-    standard->rpsCurve->setSamples(xaxis, smoothRPS, points);
-    standard->lpcoCurve->setSamples(xaxis, smoothLPCO, points);
-    standard->rpcoCurve->setSamples(xaxis, smoothRPCO, points);
+    DecimatedSeriesData::setSamples(standard->torqueCurve, xaxis, smoothNM, points);
+    DecimatedSeriesData::setSamples(standard->balanceLCurve, xaxis, smoothBALL, points);
+    DecimatedSeriesData::setSamples(standard->balanceRCurve, xaxis, smoothBALR, points);
+    DecimatedSeriesData::setSamples(standard->lteCurve, xaxis, smoothLTE, points);
+    DecimatedSeriesData::setSamples(standard->rteCurve, xaxis, smoothRTE, points);
+    DecimatedSeriesData::setSamples(standard->lpsCurve, xaxis, smoothLPS, points);
+    DecimatedSeriesData::setSamples(standard->rpsCurve, xaxis, smoothRPS, points);
+    DecimatedSeriesData::setSamples(standard->lpcoCurve, xaxis, smoothLPCO, points);
+    DecimatedSeriesData::setSamples(standard->rpcoCurve, xaxis, smoothRPCO, points);
 
     QVector<QwtIntervalSample> tmpLDC(points);
     memcpy(tmpLDC.data(), smoothLPP, (points) * sizeof(QwtIntervalSample));
@@ -3982,10 +3983,9 @@ AllPlot::setDataFromPlot(AllPlot *plot)
             ourCurve->attach(this);
 
             // lets clone the data
-            QVector<QPointF> array;
-            for (size_t i=0; i<thereCurve->data()->size(); i++) array << thereCurve->data()->sample(i);
+            QVector<QPointF> array = DecimatedSeriesData::samples(thereCurve);
 
-            ourCurve->setSamples(array);
+            DecimatedSeriesData::setSamples(ourCurve, array);
             ourCurve->setYAxis(yLeft);
             ourCurve->setBaseline(thereCurve->baseline());
             ourCurve->setStyle(thereCurve->style());
@@ -4011,10 +4011,9 @@ AllPlot::setDataFromPlot(AllPlot *plot)
             ourCurve2->attach(this);
 
             // lets clone the data
-            QVector<QPointF> array;
-            for (size_t i=0; i<thereCurve2->data()->size(); i++) array << thereCurve2->data()->sample(i);
+            QVector<QPointF> array = DecimatedSeriesData::samples(thereCurve2);
 
-            ourCurve2->setSamples(array);
+            DecimatedSeriesData::setSamples(ourCurve2, array);
             ourCurve2->setYAxis(yLeft);
             ourCurve2->setBaseline(thereCurve2->baseline());
 
@@ -4083,9 +4082,9 @@ AllPlot::setDataFromPlot(AllPlot *plot)
 
             // minimum non-zero value... worst case its zero !
             double minNZ = 0.00f;
-            for (size_t i=0; i<thereCurve->data()->size(); i++) {
-                if (!minNZ) minNZ = thereCurve->data()->sample(i).y();
-                else if (thereCurve->data()->sample(i).y()<minNZ) minNZ = thereCurve->data()->sample(i).y();
+            foreach(QPointF p, DecimatedSeriesData::samples(thereCurve)) {
+                if (!minNZ) minNZ = p.y();
+                else if (p.y()<minNZ) minNZ = p.y();
             }
             setAxisScale(QwtPlot::yLeft, minNZ, thereCurve->maxYValue() + 0.10f);
 
@@ -4715,13 +4714,9 @@ AllPlot::setDataFromPlots(QList<AllPlot *> plots)
                     ourCurve->attach(this);
 
                     // lets clone the data
-                    QVector<double> x,y;
-                    for (size_t i=0; i<thereCurve->data()->size(); i++) {
-                        x << thereCurve->data()->sample(i).x();
-                        y << thereCurve->data()->sample(i).y();
-                    }
+                    QVector<QPointF> array = DecimatedSeriesData::samples(thereCurve);
 
-                    ourCurve->setSamples(x,y);
+                    DecimatedSeriesData::setSamples(ourCurve, array);
                     ourCurve->setYAxis(yLeft);
                     ourCurve->setBaseline(thereCurve->baseline());
 
@@ -4729,7 +4724,7 @@ AllPlot::setDataFromPlots(QList<AllPlot *> plots)
                     if (ourCurve->minYValue() < MINY) MINY = ourCurve->minYValue();
 
                     // symbol when zoomed in super close
-                    if (x.size() < 150) {
+                    if (array.size() < 150) {
                         QwtSymbol *sym = new QwtSymbol;
                         sym->setPen(QPen(GColor(CPLOTMARKER)));
                         sym->setStyle(QwtSymbol::Ellipse);
@@ -4756,10 +4751,9 @@ AllPlot::setDataFromPlots(QList<AllPlot *> plots)
                     ourCurve2->setPen(pen);
 
                     // lets clone the data
-                    QVector<QPointF> array;
-                    for (size_t i=0; i<thereCurve2->data()->size(); i++) array << thereCurve2->data()->sample(i);
+                    QVector<QPointF> array = DecimatedSeriesData::samples(thereCurve2);
 
-                    ourCurve2->setSamples(array);
+                    DecimatedSeriesData::setSamples(ourCurve2, array);
                     ourCurve2->setYAxis(yLeft);
                     ourCurve2->setBaseline(thereCurve2->baseline());
 
@@ -5003,152 +4997,152 @@ AllPlot::setDataFromObject(AllPlotObject *object, AllPlot *reference)
 
         if (!object->U[k].smooth.empty()) {
 
-            standard->U[k].curve->setSamples(xaxis.data(), object->U[k].smooth.data(), totalPoints);
+            DecimatedSeriesData::setSamples(standard->U[k].curve, xaxis.data(), object->U[k].smooth.data(), totalPoints);
             standard->U[k].curve->attach(this);
             standard->U[k].curve->setVisible(true);
         }
     }
 
     if (!object->wattsArray.empty()) {
-        standard->wattsCurve->setSamples(xaxis.data(), object->smoothWatts.data(), totalPoints);
+        DecimatedSeriesData::setSamples(standard->wattsCurve, xaxis.data(), object->smoothWatts.data(), totalPoints);
         standard->wattsCurve->attach(this);
         standard->wattsCurve->setVisible(true);
     }
 
     if (!object->antissArray.empty()) {
-        standard->antissCurve->setSamples(xaxis.data(), object->smoothANT.data(), totalPoints);
+        DecimatedSeriesData::setSamples(standard->antissCurve, xaxis.data(), object->smoothANT.data(), totalPoints);
         standard->antissCurve->attach(this);
         standard->antissCurve->setVisible(true);
     }
 
     if (!object->atissArray.empty()) {
-        standard->atissCurve->setSamples(xaxis.data(), object->smoothAT.data(), totalPoints);
+        DecimatedSeriesData::setSamples(standard->atissCurve, xaxis.data(), object->smoothAT.data(), totalPoints);
         standard->atissCurve->attach(this);
         standard->atissCurve->setVisible(true);
     }
 
     if (!object->npArray.empty()) {
-        standard->npCurve->setSamples(xaxis.data(), object->smoothNP.data(), totalPoints);
+        DecimatedSeriesData::setSamples(standard->npCurve, xaxis.data(), object->smoothNP.data(), totalPoints);
         standard->npCurve->attach(this);
         standard->npCurve->setVisible(true);
     }
 
     if (!object->rvArray.empty()) {
-        standard->rvCurve->setSamples(xaxis.data(), object->smoothRV.data(), totalPoints);
+        DecimatedSeriesData::setSamples(standard->rvCurve, xaxis.data(), object->smoothRV.data(), totalPoints);
         standard->rvCurve->attach(this);
         standard->rvCurve->setVisible(true);
     }
 
     if (!object->rcadArray.empty()) {
-        standard->rcadCurve->setSamples(xaxis.data(), object->smoothRCad.data(), totalPoints);
+        DecimatedSeriesData::setSamples(standard->rcadCurve, xaxis.data(), object->smoothRCad.data(), totalPoints);
         standard->rcadCurve->attach(this);
         standard->rcadCurve->setVisible(true);
     }
 
     if (!object->rgctArray.empty()) {
-        standard->rgctCurve->setSamples(xaxis.data(), object->smoothRGCT.data(), totalPoints);
+        DecimatedSeriesData::setSamples(standard->rgctCurve, xaxis.data(), object->smoothRGCT.data(), totalPoints);
         standard->rgctCurve->attach(this);
         standard->rgctCurve->setVisible(true);
     }
 
     if (!object->gearArray.empty()) {
-        standard->gearCurve->setSamples(xaxis.data(), object->smoothGear.data(), totalPoints);
+        DecimatedSeriesData::setSamples(standard->gearCurve, xaxis.data(), object->smoothGear.data(), totalPoints);
         standard->gearCurve->attach(this);
         standard->gearCurve->setVisible(true);
     }
 
     if (!object->smo2Array.empty()) {
-        standard->smo2Curve->setSamples(xaxis.data(), object->smoothSmO2.data(), totalPoints);
+        DecimatedSeriesData::setSamples(standard->smo2Curve, xaxis.data(), object->smoothSmO2.data(), totalPoints);
         standard->smo2Curve->attach(this);
         standard->smo2Curve->setVisible(true);
     }
 
     if (!object->thbArray.empty()) {
-        standard->thbCurve->setSamples(xaxis.data(), object->smoothtHb.data(), totalPoints);
+        DecimatedSeriesData::setSamples(standard->thbCurve, xaxis.data(), object->smoothtHb.data(), totalPoints);
         standard->thbCurve->attach(this);
         standard->thbCurve->setVisible(true);
     }
 
     if (!object->o2hbArray.empty()) {
-        standard->o2hbCurve->setSamples(xaxis.data(), object->smoothO2Hb.data(), totalPoints);
+        DecimatedSeriesData::setSamples(standard->o2hbCurve, xaxis.data(), object->smoothO2Hb.data(), totalPoints);
         standard->o2hbCurve->attach(this);
         standard->o2hbCurve->setVisible(true);
     }
 
     if (!object->hhbArray.empty()) {
-        standard->hhbCurve->setSamples(xaxis.data(), object->smoothHHb.data(), totalPoints);
+        DecimatedSeriesData::setSamples(standard->hhbCurve, xaxis.data(), object->smoothHHb.data(), totalPoints);
         standard->hhbCurve->attach(this);
         standard->hhbCurve->setVisible(true);
     }
 
     if (!object->xpArray.empty()) {
-        standard->xpCurve->setSamples(xaxis.data(), object->smoothXP.data(), totalPoints);
+        DecimatedSeriesData::setSamples(standard->xpCurve, xaxis.data(), object->smoothXP.data(), totalPoints);
         standard->xpCurve->attach(this);
         standard->xpCurve->setVisible(true);
     }
 
     if (!object->apArray.empty()) {
-        standard->apCurve->setSamples(xaxis.data(), object->smoothAP.data(), totalPoints);
+        DecimatedSeriesData::setSamples(standard->apCurve, xaxis.data(), object->smoothAP.data(), totalPoints);
         standard->apCurve->attach(this);
         standard->apCurve->setVisible(true);
     }
 
     if (!object->tcoreArray.empty()) {
-        standard->tcoreCurve->setSamples(xaxis.data(), object->smoothTcore.data(), totalPoints);
+        DecimatedSeriesData::setSamples(standard->tcoreCurve, xaxis.data(), object->smoothTcore.data(), totalPoints);
         standard->tcoreCurve->attach(this);
         standard->tcoreCurve->setVisible(true);
     }
 
     if (!object->hrArray.empty()) {
-        standard->hrCurve->setSamples(xaxis.data(), object->smoothHr.data(), totalPoints);
+        DecimatedSeriesData::setSamples(standard->hrCurve, xaxis.data(), object->smoothHr.data(), totalPoints);
         standard->hrCurve->attach(this);
         standard->hrCurve->setVisible(true);
     }
 
     if (!object->speedArray.empty()) {
-        standard->speedCurve->setSamples(xaxis.data(), object->smoothSpeed.data(), totalPoints);
+        DecimatedSeriesData::setSamples(standard->speedCurve, xaxis.data(), object->smoothSpeed.data(), totalPoints);
         standard->speedCurve->attach(this);
         standard->speedCurve->setVisible(true);
     }
 
     if (!object->accelArray.empty()) {
-        standard->accelCurve->setSamples(xaxis.data(), object->smoothAccel.data(), totalPoints);
+        DecimatedSeriesData::setSamples(standard->accelCurve, xaxis.data(), object->smoothAccel.data(), totalPoints);
         standard->accelCurve->attach(this);
         standard->accelCurve->setVisible(true);
     }
 
     if (!object->wattsDArray.empty()) {
-        standard->wattsDCurve->setSamples(xaxis.data(), object->smoothWattsD.data(), totalPoints);
+        DecimatedSeriesData::setSamples(standard->wattsDCurve, xaxis.data(), object->smoothWattsD.data(), totalPoints);
         standard->wattsDCurve->attach(this);
         standard->wattsDCurve->setVisible(true);
     }
 
     if (!object->cadDArray.empty()) {
-        standard->cadDCurve->setSamples(xaxis.data(), object->smoothCadD.data(), totalPoints);
+        DecimatedSeriesData::setSamples(standard->cadDCurve, xaxis.data(), object->smoothCadD.data(), totalPoints);
         standard->cadDCurve->attach(this);
         standard->cadDCurve->setVisible(true);
     }
 
     if (!object->nmDArray.empty()) {
-        standard->nmDCurve->setSamples(xaxis.data(), object->smoothNmD.data(), totalPoints);
+        DecimatedSeriesData::setSamples(standard->nmDCurve, xaxis.data(), object->smoothNmD.data(), totalPoints);
         standard->nmDCurve->attach(this);
         standard->nmDCurve->setVisible(true);
     }
 
     if (!object->hrDArray.empty()) {
-        standard->hrDCurve->setSamples(xaxis.data(), object->smoothHrD.data(), totalPoints);
+        DecimatedSeriesData::setSamples(standard->hrDCurve, xaxis.data(), object->smoothHrD.data(), totalPoints);
         standard->hrDCurve->attach(this);
         standard->hrDCurve->setVisible(true);
     }
 
     if (!object->cadArray.empty()) {
-        standard->cadCurve->setSamples(xaxis.data(), object->smoothCad.data(), totalPoints);
+        DecimatedSeriesData::setSamples(standard->cadCurve, xaxis.data(), object->smoothCad.data(), totalPoints);
         standard->cadCurve->attach(this);
         standard->cadCurve->setVisible(true);
     }
 
     if (!object->altArray.empty()) {
-        standard->altCurve->setSamples(xaxis.data(), object->smoothAltitude.data(), totalPoints);
+        DecimatedSeriesData::setSamples(standard->altCurve, xaxis.data(), object->smoothAltitude.data(), totalPoints);
         standard->altCurve->attach(this);
         standard->altCurve->setVisible(true);
         standard->altSlopeCurve->setSamples(xaxis.data(), object->smoothAltitude.data(), totalPoints);
@@ -5157,13 +5151,13 @@ AllPlot::setDataFromObject(AllPlotObject *object, AllPlot *reference)
     }
 
     if (!object->slopeArray.empty()) {
-        standard->slopeCurve->setSamples(xaxis.data(), object->smoothSlope.data(), totalPoints);
+        DecimatedSeriesData::setSamples(standard->slopeCurve, xaxis.data(), object->smoothSlope.data(), totalPoints);
         standard->slopeCurve->attach(this);
         standard->slopeCurve->setVisible(true);
     }
 
     if (!object->tempArray.empty()) {
-        standard->tempCurve->setSamples(xaxis.data(), object->smoothTemp.data(), totalPoints);
+        DecimatedSeriesData::setSamples(standard->tempCurve, xaxis.data(), object->smoothTemp.data(), totalPoints);
         standard->tempCurve->attach(this);
         standard->tempCurve->setVisible(true);
     }
@@ -5176,14 +5170,14 @@ AllPlot::setDataFromObject(AllPlotObject *object, AllPlot *reference)
     }
 
     if (!object->torqueArray.empty()) {
-        standard->torqueCurve->setSamples(xaxis.data(), object->smoothTorque.data(), totalPoints);
+        DecimatedSeriesData::setSamples(standard->torqueCurve, xaxis.data(), object->smoothTorque.data(), totalPoints);
         standard->torqueCurve->attach(this);
         standard->torqueCurve->setVisible(true);
     }
 
     if (!object->balanceArray.empty()) {
-        standard->balanceLCurve->setSamples(xaxis.data(), object->smoothBalanceL.data(), totalPoints);
-        standard->balanceRCurve->setSamples(xaxis.data(), object->smoothBalanceR.data(), totalPoints);
+        DecimatedSeriesData::setSamples(standard->balanceLCurve, xaxis.data(), object->smoothBalanceL.data(), totalPoints);
+        DecimatedSeriesData::setSamples(standard->balanceRCurve, xaxis.data(), object->smoothBalanceR.data(), totalPoints);
         standard->balanceLCurve->attach(this);
         standard->balanceLCurve->setVisible(true);
         standard->balanceRCurve->attach(this);
@@ -5191,8 +5185,8 @@ AllPlot::setDataFromObject(AllPlotObject *object, AllPlot *reference)
     }
 
     if (!object->lteArray.empty()) {
-        standard->lteCurve->setSamples(xaxis.data(), object->smoothLTE.data(), totalPoints);
-        standard->rteCurve->setSamples(xaxis.data(), object->smoothRTE.data(), totalPoints);
+        DecimatedSeriesData::setSamples(standard->lteCurve, xaxis.data(), object->smoothLTE.data(), totalPoints);
+        DecimatedSeriesData::setSamples(standard->rteCurve, xaxis.data(), object->smoothRTE.data(), totalPoints);
         standard->lteCurve->attach(this);
         standard->lteCurve->setVisible(true);
         standard->rteCurve->attach(this);
@@ -5200,8 +5194,8 @@ AllPlot::setDataFromObject(AllPlotObject *object, AllPlot *reference)
     }
 
     if (!object->lpsArray.empty()) {
-        standard->lpsCurve->setSamples(xaxis.data(), object->smoothLPS.data(), totalPoints);
-        standard->rpsCurve->setSamples(xaxis.data(), object->smoothRPS.data(), totalPoints);
+        DecimatedSeriesData::setSamples(standard->lpsCurve, xaxis.data(), object->smoothLPS.data(), totalPoints);
+        DecimatedSeriesData::setSamples(standard->rpsCurve, xaxis.data(), object->smoothRPS.data(), totalPoints);
         standard->lpsCurve->attach(this);
         standard->lpsCurve->setVisible(true);
         standard->rpsCurve->attach(this);
@@ -5209,8 +5203,8 @@ AllPlot::setDataFromObject(AllPlotObject *object, AllPlot *reference)
     }
 
     if (!object->lpcoArray.empty()) {
-        standard->lpcoCurve->setSamples(xaxis.data(), object->smoothLPCO.data(), totalPoints);
-        standard->rpcoCurve->setSamples(xaxis.data(), object->smoothRPCO.data(), totalPoints);
+        DecimatedSeriesData::setSamples(standard->lpcoCurve, xaxis.data(), object->smoothLPCO.data(), totalPoints);
+        DecimatedSeriesData::setSamples(standard->rpcoCurve, xaxis.data(), object->smoothRPCO.data(), totalPoints);
         standard->lpcoCurve->attach(this);
         standard->lpcoCurve->setVisible(true);
         standard->rpcoCurve->attach(this);
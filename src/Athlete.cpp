@@ -53,6 +53,10 @@
 #include "GcUpgrade.h" // upgrade wizard
 #include "GcCrashDialog.h" // recovering from a crash?
 
+#include <QThreadPool>
+
+QList<Athlete*> Athlete::athletes;
+
 Athlete::Athlete(Context *context, const QDir &homeDir)
 {
     // athlete name / structured directory
@@ -72,6 +76,10 @@ Athlete::Athlete(Context *context, const QDir &homeDir)
     }
     appsettings->setCValue(cyclist, GC_SAFEEXIT, false); // will be set to true on exit
 
+    // before anything wants them
+    readSettings();
+    athletes << this;
+
     // make sure that the latest folder structure exists in Athlete Directory -
     // e.g. Cache could be deleted by mistake or empty folders are not copied
     // later GC expects the folders are available
@@ -209,6 +217,8 @@ Athlete::loadCharts()
 
 Athlete::~Athlete()
 {
+    athletes.removeOne(this);
+
     // close the ride cache down first
     delete rideCache;
 
@@ -238,6 +248,9 @@ Athlete::~Athlete()
     delete autoImportConfig;
     delete autoImport;
 
+    delete settings();
+    qDeleteAll(oldSettings);
+
 }
 
 void Athlete::selectRideFile(QString fileName)
@@ -328,6 +341,44 @@ Athlete::translateDefaultCharts(QList<LTMSettings>&charts)
     }
 }
 
+void
+Athlete::readSettings()
+{
+    AthleteSettings *update = new AthleteSettings;
+
+    update->discovery = appsettings->cvalue(cyclist, GC_DISCOVERY, 57).toInt(); // 57 does not include search for PEAKS
+    update->useCPforFTP = appsettings->cvalue(cyclist, GC_USE_CP_FOR_FTP, 0).toInt() ? true : false;
+    update->weight = appsettings->cvalue(cyclist, GC_WEIGHT, "75.0").toString().toDouble();
+    update->height = appsettings->cvalue(cyclist, GC_HEIGHT, 0.0f).toString().toDouble();
+    update->wbalTau = appsettings->cvalue(cyclist, GC_WBALTAU, 300).toInt();
+    update->wbalIntegral = (appsettings->value(NULL, GC_WBALFORM, "int").toString() == "int");
+    update->crankLength = appsettings->cvalue(cyclist, GC_CRANKLENGTH, 175.00f).toDouble();
+
+    // swap it in, readers may still have the old one
+    AthleteSettings *old = settings_.fetchAndStoreOrdered(update);
+    if (old) oldSettings << old;
+
+    releaseSettings();
+}
+
+void
+Athlete::releaseSettings()
+{
+    // readers only hold a snapshot whilst they use it, so only the workers
+    // on the global thread pool (e.g. the ride cache refresh) might still
+    // have an old one, nothing runs there, nothing has one
+    if (oldSettings.isEmpty() || QThreadPool::globalInstance()->activeThreadCount() > 0) return;
+
+    qDeleteAll(oldSettings);
+    oldSettings.clear();
+}
+
+void
+Athlete::readAllSettings()
+{
+    foreach(Athlete *athlete, athletes) athlete->readSettings();
+}
+
 void
 Athlete::configChanged(qint32 state)
 {
@@ -450,28 +501,19 @@ Athlete::setWithings(QList<WithingsReading>&x)
 {
     withings_ = x;
     qSort(withings_); // date order
+
+    // and index by date for getWithings
+    withingsIndex_.clear();
+    foreach(const WithingsReading &reading, withings_) withingsIndex_.append(reading.when.date());
 }
 
 void 
 Athlete::getWithings(QDate date, WithingsReading &here)
 {
-    // the optimisation below is not thread safe and should be encapsulated
-    // by a mutex, but this kind of defeats to purpose of the optimisation!
-
-    //if (withings_.count() && withings_.last().when.date() <= date) here = withings_.last();
-    //if (!withings_.count() || withings_.first().when.date() > date) here = WithingsReading();
-
-    // always set to not found before searching
-    here = WithingsReading();
-
-    // loop
-    foreach(WithingsReading x, withings_) {
-        if (x.when.date() <= date) here = x;
-        if (x.when.date() > date) break;
-    }
-
-    // will be empty if none found
-    return;
+    // last reading on or before date, will be empty if none found
+    int i = withingsIndex_.at(date);
+    if (i >= 0 && i < withings_.count()) here = withings_.at(i);
+    else here = WithingsReading();
 }
 
 double 
@@ -506,7 +548,7 @@ Athlete::getWeight(QDate date, RideFile *ride)
 
     // global options
     if (!weight)
-        weight = appsettings->cvalue(context->athlete->cyclist, GC_WEIGHT, "75.0").toString().toDouble(); // default to 75kg
+        weight = settings()->weight; // default to 75kg
 
     // No weight default is weird, we'll set to 80kg
     if (weight <= 0.00) weight = 80.00;
@@ -523,7 +565,7 @@ Athlete::getHeight(RideFile *ride)
     if (ride) height = ride->getTag("Height", "0.0").toDouble();
 
     // global options ?
-    if (!height) height = appsettings->cvalue(context->athlete->cyclist, GC_HEIGHT, 0.0f).toString().toDouble();
+    if (!height) height = settings()->height;
 
     // from weight via Stillman Average?
     if (!height && ride) height = (getWeight(ride->startTime().date(), ride)+100.0)/98.43;
@@ -540,15 +582,20 @@ Athlete::getPMCFor(QString metricName, int stsdays, int ltsdays)
 {
     PMCData *returning = NULL;
 
+    // one for each metric and set of parameters, shared
+    // by all the charts that want it
+    QString key = metricName;
+    if (stsdays >= 0 || ltsdays >= 0) key += QString(":%1:%2").arg(stsdays).arg(ltsdays);
+
     // if we don't already have one, create it
-    returning = pmcData.value(metricName, NULL);
+    returning = pmcData.value(key, NULL);
     if (!returning) {
 
         // specification is blank and passes for all
         returning = new PMCData(context, Specification(), metricName, stsdays, ltsdays);
 
         // add to our collection
-        pmcData.insert(metricName, returning);
+        pmcData.insert(key, returning);
     }
 
     return returning;
@@ -559,15 +606,19 @@ Athlete::getPMCFor(Leaf *expr, DataFilter *df, int stsdays, int ltsdays)
 {
     PMCData *returning = NULL;
 
+    // one for each expression and set of parameters
+    QString key = expr->signature();
+    if (stsdays >= 0 || ltsdays >= 0) key += QString(":%1:%2").arg(stsdays).arg(ltsdays);
+
     // if we don't already have one, create it
-    returning = pmcData.value(expr->signature(), NULL);
+    returning = pmcData.value(key, NULL);
     if (!returning) {
 
         // specification is blank and passes for all
         returning = new PMCData(context, Specification(), expr, df, stsdays, ltsdays);
 
         // add to our collection
-        pmcData.insert(expr->signature(), returning);
+        pmcData.insert(key, returning);
     }
 
     return returning;
@@ -26,9 +26,11 @@
 #include <QUuid>
 #include <QNetworkReply>
 #include <QHeaderView>
+#include <QAtomicPointer>
 
 // for WithingsReading
 #include "WithingsParser.h"
+#include "DateIndex.h"
 
 class Zones;
 class HrZones;
@@ -63,6 +65,26 @@ class Tab;
 class Leaf;
 class DataFilter;
 
+// athlete settings that are read for every ride, e.g. when refreshing
+// metrics in the background. they are read once when the config changes
+// rather than going to QSettings every time. a snapshot is never changed
+// once made, a new one replaces it, so worker threads can read it
+// without locking
+class AthleteSettings
+{
+    public:
+        AthleteSettings() : discovery(57), useCPforFTP(false), weight(75.0), height(0),
+                            wbalTau(300), wbalIntegral(true), crankLength(175.0) {}
+
+        int discovery;          // GC_DISCOVERY
+        bool useCPforFTP;       // GC_USE_CP_FOR_FTP
+        double weight;          // GC_WEIGHT
+        double height;          // GC_HEIGHT
+        int wbalTau;            // GC_WBALTAU
+        bool wbalIntegral;      // GC_WBALFORM
+        double crankLength;     // GC_CRANKLENGTH
+};
+
 class Athlete : public QObject
 {
     Q_OBJECT
@@ -99,6 +121,7 @@ class Athlete : public QObject
         QList<RideFileCache*> cpxCache;
         RideCache *rideCache;
         QList<WithingsReading> withings_;
+        DateIndex withingsIndex_; // julian day of each reading
 
         // Estimates
         PDEstimate getPDEstimateFor(QDate, QString model, bool wpk);
@@ -108,6 +131,20 @@ class Athlete : public QObject
         PMCData *getPMCFor(Leaf *expr, DataFilter *df, int stsDays = -1, int ltsDays = -1); // no Specification used!
         QMap<QString, PMCData*> pmcData; // all the different PMC series
 
+        // settings snapshot, replaced when the config changes
+        const AthleteSettings *settings() const {
+#if QT_VERSION >= 0x050000
+            return settings_.loadAcquire();
+#else
+            return settings_;
+#endif
+        }
+        void readSettings();
+        void releaseSettings(); // free replaced snapshots once no worker can have one
+
+        // a global setting (e.g. GC_WBALFORM) changed, update every open athlete
+        static void readAllSettings();
+
         // athlete measures
         // note ride can override if passed
         double getWeight(QDate date, RideFile *ride=NULL);
@@ -166,6 +203,11 @@ class Athlete : public QObject
         void checkCPX(RideItem*ride);
         void configChanged(qint32);
 
+    private:
+        QAtomicPointer<AthleteSettings> settings_;
+        QList<AthleteSettings*> oldSettings; // may still be in use by a worker thread
+        static QList<Athlete*> athletes; // all open, see readAllSettings()
+
 };
 
 
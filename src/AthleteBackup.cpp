@@ -31,6 +31,15 @@
 #include "../qzip/zipwriter.h"
 #include "../qzip/zipreader.h"
 
+#include <QThread>
+#include <QEventLoop>
+#include <QFutureWatcher>
+#if QT_VERSION > 0x050000
+# include <QtConcurrent>
+#else
+# include <QtConcurrentMap>
+#endif
+
 
 
 AthleteBackup::AthleteBackup(QDir athleteHome)
@@ -110,6 +119,36 @@ AthleteBackup::backupImmediate()
 
 // -- private methods
 
+// read and compress a file on a worker thread, the file name
+// is left empty if it couldn't be read
+static ZipWriter::PreparedFile
+compressBackupFile(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) return ZipWriter::PreparedFile();
+
+    ZipWriter::PreparedFile prepared = ZipWriter::prepareFile(path, file.readAll());
+    file.close();
+    return prepared;
+}
+
+// the most recent backup for this athlete in the backup folder
+QString
+AthleteBackup::previousBackup()
+{
+    QDir dir(backupFolder);
+    QStringList filters;
+    filters << QString("GC_*_%1_*.zip").arg(athlete);
+
+    // the wildcards could match other athletes too
+    QRegExp named(QString("^GC_[0-9]+_%1(_[0-9]+){6}\\.zip$").arg(QRegExp::escape(athlete)));
+
+    foreach(QFileInfo backup, dir.entryInfoList(filters, QDir::Files, QDir::Time))
+        if (named.exactMatch(backup.fileName())) return backup.canonicalFilePath();
+
+    return "";
+}
+
 bool
 AthleteBackup::backup(QString progressText)
 {
@@ -165,6 +204,10 @@ AthleteBackup::backup(QString progressText)
                        .arg ( QTime::currentTime().second(), 2, 10, zero );
 
 
+    // the last backup, files that haven't changed since are copied from it
+    // as they are rather than compressing them all over again
+    QString previous = previousBackup();
+
     // add files using zip writer
     QFile zipFile(backupFolder+"/"+targetFileName);
     if (!zipFile.open(QIODevice::WriteOnly)) {
@@ -174,30 +217,104 @@ AthleteBackup::backup(QString progressText)
     zipFile.close();
     ZipWriter writer(zipFile.fileName());
 
+    QHash<QString, ZipReader::FileInfo> before;
+    ZipReader *reader = NULL;
+    if (previous != "") {
+        reader = new ZipReader(previous);
+        foreach(ZipReader::FileInfo info, reader->fileInfoList())
+            if (info.isFile) before.insert(info.filePath, info);
+    }
+
     QProgressDialog progress(tr("Adding files to backup %1 for athlete %2 ...").arg(targetFileName).arg(athlete), progressText, 0, fileCount, NULL);
     progress.setWindowModality(Qt::WindowModal);
 
-    // now do the Zipping
+    // everything is stamped with when we started, so a file changed
+    // whilst we're running gets picked up next time
+    QDateTime started = QDateTime::currentDateTime();
+
+    // now do the Zipping, files are compressed a batch at a time in
+    // parallel and then added to the zip in order
+    int batchSize = 2 * QThread::idealThreadCount();
+    if (batchSize < 2) batchSize = 2;
+
     bool userCanceled = false;
     int fileCounter = 0;
     foreach (QDir folder, sourceFolderList) {
         // get all files
         writer.addDirectory(folder.dirName());
-        foreach (QFileInfo fileName, folder.entryInfoList(QDir::Files | QDir::NoDotAndDotDot | QDir::NoSymLinks)) {
-            QFile file(fileName.canonicalFilePath());
-            if (file.open(QIODevice::ReadOnly)) {
+        QFileInfoList files = folder.entryInfoList(QDir::Files | QDir::NoDotAndDotDot | QDir::NoSymLinks);
+
+        for (int i=0; i<files.count() && !userCanceled; i += batchSize) {
+
+            QList<ZipWriter::PreparedFile> batch;
+            QVector<bool> reused;
+            QStringList changed;
+            for (int j=i; j<files.count() && j<i+batchSize; j++) {
+
+                const QFileInfo &fileName = files.at(j);
+                QString name = folder.dirName()+"/"+fileName.fileName();
+
+                ZipWriter::PreparedFile prepared;
+                prepared.fileName = name;
+                prepared.lastModified = started;
+
+                // unchanged since the last backup ?
+                QHash<QString, ZipReader::FileInfo>::const_iterator it = before.find(name);
+                if (it != before.constEnd() && it.value().size == fileName.size() &&
+                    fileName.lastModified() < it.value().lastModified &&
+                    reader->rawFileData(name, prepared.data, prepared.deflated)) {
+
+                    prepared.crc32 = it.value().crc32;
+                    prepared.size = it.value().size;
+                    prepared.lastModified = it.value().lastModified; // when we actually read it
+                    reused << true;
+
+                } else {
+                    // compress it below
+                    changed << fileName.canonicalFilePath();
+                    reused << false;
+                }
+                batch << prepared;
+            }
+
+            // compress the changed files in parallel, giving the progress
+            // dialog a chance to run whilst we wait
+            QList<ZipWriter::PreparedFile> compressed;
+            if (changed.count()) {
+                QFuture<ZipWriter::PreparedFile> future = QtConcurrent::mapped(changed, compressBackupFile);
+                QFutureWatcher<ZipWriter::PreparedFile> watcher;
+                QEventLoop loop;
+                connect(&watcher, SIGNAL(finished()), &loop, SLOT(quit()));
+                watcher.setFuture(future);
+                if (!future.isFinished()) loop.exec();
+                compressed = future.results();
+            }
+
+            // and add them in order
+            int c = 0;
+            for (int k=0; k<batch.count(); k++) {
+
                 if (progress.wasCanceled()) {
                     userCanceled = true;
                     break;
                 }
-                writer.addFile(folder.dirName()+"/"+fileName.fileName(), file.readAll());
+
+                if (reused.at(k)) {
+                    writer.addFile(batch.at(k));
+                } else {
+                    ZipWriter::PreparedFile &fresh = compressed[c++];
+                    if (fresh.fileName == "") continue; // couldn't read it
+                    fresh.fileName = batch.at(k).fileName;
+                    fresh.lastModified = started;
+                    writer.addFile(fresh);
+                }
                 progress.setValue(fileCounter);
                 fileCounter++;
-                file.close();
             }
         }
         if (userCanceled) break;
     }
+    delete reader;
 
     // final processing
     writer.close();
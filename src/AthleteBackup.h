@@ -40,6 +40,7 @@ class AthleteBackup : public QObject
         QString backupFolder;
         QList<QDir> sourceFolderList;
         bool backup(QString progressText);
+        QString previousBackup();
 
 };
 
@@ -84,7 +84,7 @@ bool BT40Controller::doesPull() { return true; }
 bool BT40Controller::doesLoad() { return true; }
 
 /*
- * gets called from the GUI to get updated telemetry.
+ * gets called from the train engine thread to get updated telemetry.
  * so whilst we are at it we check button status too and
  * act accordingly.
  *
@@ -94,11 +94,9 @@ BT40Controller::getRealtimeData(RealtimeData &rtData)
 {
     if(!myBT40->isRunning())
     {
-        QMessageBox msgBox;
-        msgBox.setText(tr("Cannot Connect to BT40"));
-        msgBox.setIcon(QMessageBox::Critical);
-        msgBox.exec();
-        parent->Stop(1);
+        // not on the gui thread, so let it tell them
+        QMetaObject::invokeMethod(parent, "deviceError", Qt::QueuedConnection,
+                                  Q_ARG(QString, tr("Cannot Connect to BT40")));
         return;
     }
     // get latest telemetry
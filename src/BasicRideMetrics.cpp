@@ -99,10 +99,12 @@ static bool workoutTimeAdded =
 class TimeRiding : public RideMetric {
     Q_DECLARE_TR_FUNCTIONS(TimeRiding)
     double secsMovingOrPedaling;
+    double recIntSecs;
+    bool present;
 
     public:
 
-    TimeRiding() : secsMovingOrPedaling(0.0)
+    TimeRiding() : secsMovingOrPedaling(0.0), recIntSecs(0.0), present(false)
     {
         setSymbol("time_riding");
         setInternalName("Time Moving");
@@ -113,18 +115,20 @@ class TimeRiding : public RideMetric {
         setMetricUnits(tr("seconds"));
         setImperialUnits(tr("seconds"));
     }
-    void compute(const RideFile *ride, const Zones *, int,
+    bool isAccumulator() const { return true; }
+    void begin(const RideFile *ride) {
+        secsMovingOrPedaling = 0;
+        present = ride->areDataPresent()->kph || ride->areDataPresent()->cad;
+        recIntSecs = ride->recIntSecs();
+    }
+    void accumulate(const RideFilePoint *point) {
+        if (present && ((point->kph > 0.0) || (point->cad > 0.0)))
+            secsMovingOrPedaling += recIntSecs;
+    }
+    void compute(const RideFile *, const Zones *, int,
                  const HrZones *, int,
                  const QHash<QString,RideMetric*> &,
                  const Context *) {
-
-        secsMovingOrPedaling = 0;
-        if (ride->areDataPresent()->kph || ride->areDataPresent()->cad ) {
-            foreach (const RideFilePoint *point, ride->dataPoints()) {
-                if ((point->kph > 0.0) || (point->cad > 0.0))
-                    secsMovingOrPedaling += ride->recIntSecs();
-            }
-        }
         setValue(secsMovingOrPedaling);
     }
     void override(const QMap<QString,QString> &map) {
@@ -589,10 +593,12 @@ class ElevationGain : public RideMetric {
     Q_DECLARE_TR_FUNCTIONS(ElevationGain)
     double elegain;
     double prevalt;
+    double hysteresis;
+    bool first;
 
     public:
 
-    ElevationGain() : elegain(0.0), prevalt(0.0)
+    ElevationGain() : elegain(0.0), prevalt(0.0), hysteresis(3.0), first(true)
     {
         setSymbol("elevation_gain");
         setInternalName("Elevation Gain");
@@ -604,29 +610,31 @@ class ElevationGain : public RideMetric {
         setImperialUnits(tr("feet"));
         setConversion(FEET_PER_METER);
     }
-    void compute(const RideFile *ride, const Zones *, int,
-                 const HrZones *, int,
-                 const QHash<QString,RideMetric*> &,
-                 const Context *) {
-
+    bool isAccumulator() const { return true; }
+    void begin(const RideFile *) {
         // hysteresis can be configured, we default to 3.0
-        double hysteresis = appsettings->value(NULL, GC_ELEVATION_HYSTERESIS).toDouble();
+        hysteresis = appsettings->value(NULL, GC_ELEVATION_HYSTERESIS).toDouble();
         if (hysteresis <= 0.1) hysteresis = 3.00;
-
-        bool first = true;
-        foreach (const RideFilePoint *point, ride->dataPoints()) {
-            if (first) {
-                first = false;
-                prevalt = point->alt;
-            }
-            else if (point->alt > prevalt + hysteresis) {
-                elegain += point->alt - prevalt;
-                prevalt = point->alt;
-            }
-            else if (point->alt < prevalt - hysteresis) {
-                prevalt = point->alt;
-            }
+        elegain = 0;
+        first = true;
+    }
+    void accumulate(const RideFilePoint *point) {
+        if (first) {
+            first = false;
+            prevalt = point->alt;
+        }
+        else if (point->alt > prevalt + hysteresis) {
+            elegain += point->alt - prevalt;
+            prevalt = point->alt;
+        }
+        else if (point->alt < prevalt - hysteresis) {
+            prevalt = point->alt;
         }
+    }
+    void compute(const RideFile *, const Zones *, int,
+                 const HrZones *, int,
+                 const QHash<QString,RideMetric*> &,
+                 const Context *) {
         setValue(elegain);
     }
     bool isRelevantForRide(const RideItem *ride) const { return !ride->isSwim; }
@@ -642,10 +650,12 @@ class ElevationLoss : public RideMetric {
     Q_DECLARE_TR_FUNCTIONS(ElevationLoss)
     double eleLoss;
     double prevalt;
+    double hysteresis;
+    bool first;
 
     public:
 
-    ElevationLoss() : eleLoss(0.0), prevalt(0.0)
+    ElevationLoss() : eleLoss(0.0), prevalt(0.0), hysteresis(3.0), first(true)
     {
         setSymbol("elevation_loss");
         setInternalName("Elevation Loss");
@@ -657,29 +667,31 @@ class ElevationLoss : public RideMetric {
         setImperialUnits(tr("feet"));
         setConversion(FEET_PER_METER);
     }
-    void compute(const RideFile *ride, const Zones *, int,
-                 const HrZones *, int,
-                 const QHash<QString,RideMetric*> &,
-                 const Context *) {
-
+    bool isAccumulator() const { return true; }
+    void begin(const RideFile *) {
         // hysteresis can be configured, we default to 3.0
-        double hysteresis = appsettings->value(NULL, GC_ELEVATION_HYSTERESIS).toDouble();
+        hysteresis = appsettings->value(NULL, GC_ELEVATION_HYSTERESIS).toDouble();
         if (hysteresis <= 0.1) hysteresis = 3.00;
-
-        bool first = true;
-        foreach (const RideFilePoint *point, ride->dataPoints()) {
-            if (first) {
-                first = false;
-                prevalt = point->alt;
-            }
-            else if (point->alt < prevalt - hysteresis) {
-                eleLoss += prevalt - point->alt;
-                prevalt = point->alt;
-            }
-            else if (point->alt > prevalt + hysteresis) {
-                prevalt = point->alt;
-            }
+        eleLoss = 0;
+        first = true;
+    }
+    void accumulate(const RideFilePoint *point) {
+        if (first) {
+            first = false;
+            prevalt = point->alt;
+        }
+        else if (point->alt < prevalt - hysteresis) {
+            eleLoss += prevalt - point->alt;
+            prevalt = point->alt;
         }
+        else if (point->alt > prevalt + hysteresis) {
+            prevalt = point->alt;
+        }
+    }
+    void compute(const RideFile *, const Zones *, int,
+                 const HrZones *, int,
+                 const QHash<QString,RideMetric*> &,
+                 const Context *) {
         setValue(eleLoss);
     }
     bool isRelevantForRide(const RideItem *ride) const { return !ride->isSwim; }
@@ -713,9 +725,10 @@ class TotalWork : public RideMetric {
                  const Context *) {
 
         joules = 0;
-        foreach (const RideFilePoint *point, ride->dataPoints()) {
-            if (point->watts >= 0.0)
-                joules += point->watts * ride->recIntSecs();
+        const double *watts = ride->column(RideFile::watts);
+        for (int i=0; i<ride->dataPoints().count(); i++) {
+            if (watts[i] >= 0.0)
+                joules += watts[i] * ride->recIntSecs();
         }
         setValue(joules/1000);
     }
@@ -943,9 +956,10 @@ struct AvgPower : public RideMetric {
                  const QHash<QString,RideMetric*> &,
                  const Context *) {
         total = count = 0;
-        foreach (const RideFilePoint *point, ride->dataPoints()) {
-            if (point->watts >= 0.0) {
-                total += point->watts;
+        const double *watts = ride->column(RideFile::watts);
+        for (int i=0; i<ride->dataPoints().count(); i++) {
+            if (watts[i] >= 0.0) {
+                total += watts[i];
                 ++count;
             }
         }
@@ -979,17 +993,20 @@ struct AvgSmO2 : public RideMetric {
         setImperialUnits(tr("%"));
         setType(RideMetric::Average);
     }
-    void compute(const RideFile *ride, const Zones *, int,
+    bool isAccumulator() const { return true; }
+    void begin(const RideFile *) {
+        total = count = 0;
+    }
+    void accumulate(const RideFilePoint *point) {
+        if (point->smo2 >= 0.0) {
+            total += point->smo2;
+            ++count;
+        }
+    }
+    void compute(const RideFile *, const Zones *, int,
                  const HrZones *, int,
                  const QHash<QString,RideMetric*> &,
                  const Context *) {
-        total = count = 0;
-        foreach (const RideFilePoint *point, ride->dataPoints()) {
-            if (point->smo2 >= 0.0) {
-                total += point->smo2;
-                ++count;
-            }
-        }
         setValue(count > 0 ? total / count : 0);
         setCount(count);
     }
@@ -1021,17 +1038,20 @@ struct AvgtHb : public RideMetric {
         setType(RideMetric::Average);
         setPrecision(2);
     }
-    void compute(const RideFile *ride, const Zones *, int,
+    bool isAccumulator() const { return true; }
+    void begin(const RideFile *) {
+        total = count = 0;
+    }
+    void accumulate(const RideFilePoint *point) {
+        if (point->thb >= 0.0) {
+            total += point->thb;
+            ++count;
+        }
+    }
+    void compute(const RideFile *, const Zones *, int,
                  const HrZones *, int,
                  const QHash<QString,RideMetric*> &,
                  const Context *) {
-        total = count = 0;
-        foreach (const RideFilePoint *point, ride->dataPoints()) {
-            if (point->thb >= 0.0) {
-                total += point->thb;
-                ++count;
-            }
-        }
         setValue(count > 0 ? total / count : 0);
         setCount(count);
     }
@@ -1064,17 +1084,20 @@ struct AAvgPower : public RideMetric {
         setImperialUnits(tr("watts"));
         setType(RideMetric::Average);
     }
-    void compute(const RideFile *ride, const Zones *, int,
+    bool isAccumulator() const { return true; }
+    void begin(const RideFile *) {
+        total = count = 0;
+    }
+    void accumulate(const RideFilePoint *point) {
+        if (point->apower >= 0.0) {
+            total += point->apower;
+            ++count;
+        }
+    }
+    void compute(const RideFile *, const Zones *, int,
                  const HrZones *, int,
                  const QHash<QString,RideMetric*> &,
                  const Context *) {
-        total = count = 0;
-        foreach (const RideFilePoint *point, ride->dataPoints()) {
-            if (point->apower >= 0.0) {
-                total += point->apower;
-                ++count;
-            }
-        }
         setValue(count > 0 ? total / count : 0);
         setCount(count);
     }
@@ -1105,17 +1128,20 @@ struct NonZeroPower : public RideMetric {
         setImperialUnits(tr("watts"));
         setType(RideMetric::Average);
     }
-    void compute(const RideFile *ride, const Zones *, int,
+    bool isAccumulator() const { return true; }
+    void begin(const RideFile *) {
+        total = count = 0;
+    }
+    void accumulate(const RideFilePoint *point) {
+        if (point->watts > 0.0) {
+            total += point->watts;
+            ++count;
+        }
+    }
+    void compute(const RideFile *, const Zones *, int,
                  const HrZones *, int,
                  const QHash<QString,RideMetric*> &,
                  const Context *) {
-        total = count = 0;
-        foreach (const RideFilePoint *point, ride->dataPoints()) {
-            if (point->watts > 0.0) {
-                total += point->watts;
-                ++count;
-            }
-        }
         setValue(count > 0 ? total / count : 0);
         setCount(count);
     }
@@ -1146,17 +1172,20 @@ struct AvgHeartRate : public RideMetric {
         setImperialUnits(tr("bpm"));
         setType(RideMetric::Average);
     }
-    void compute(const RideFile *ride, const Zones *, int,
+    bool isAccumulator() const { return true; }
+    void begin(const RideFile *) {
+        total = count = 0;
+    }
+    void accumulate(const RideFilePoint *point) {
+        if (point->hr > 0) {
+            total += point->hr;
+            ++count;
+        }
+    }
+    void compute(const RideFile *, const Zones *, int,
                  const HrZones *, int,
                  const QHash<QString,RideMetric*> &,
                  const Context *) {
-        total = count = 0;
-        foreach (const RideFilePoint *point, ride->dataPoints()) {
-            if (point->hr > 0) {
-                total += point->hr;
-                ++count;
-            }
-        }
         setValue(count > 0 ? total / count : 0);
         setCount(count);
     }
@@ -1188,17 +1217,20 @@ struct AvgCoreTemp : public RideMetric {
         setImperialUnits(tr("C"));
         setType(RideMetric::Average);
     }
-    void compute(const RideFile *ride, const Zones *, int,
+    bool isAccumulator() const { return true; }
+    void begin(const RideFile *) {
+        total = count = 0;
+    }
+    void accumulate(const RideFilePoint *point) {
+        if (point->tcore > 0) {
+            total += point->tcore;
+            ++count;
+        }
+    }
+    void compute(const RideFile *, const Zones *, int,
                  const HrZones *, int,
                  const QHash<QString,RideMetric*> &,
                  const Context *) {
-        total = count = 0;
-        foreach (const RideFilePoint *point, ride->dataPoints()) {
-            if (point->tcore > 0) {
-                total += point->tcore;
-                ++count;
-            }
-        }
         setValue(count > 0 ? total / count : 0);
         setCount(count);
     }
@@ -1216,7 +1248,7 @@ static bool avgCTAdded =
 struct HeartBeats : public RideMetric {
     Q_DECLARE_TR_FUNCTIONS(HeartBeats)
 
-    double total;
+    double total, recIntSecs;
 
     public:
 
@@ -1231,14 +1263,18 @@ struct HeartBeats : public RideMetric {
         setImperialUnits(tr("beats"));
         setType(RideMetric::Total);
     }
-    void compute(const RideFile *ride, const Zones *, int,
+    bool isAccumulator() const { return true; }
+    void begin(const RideFile *ride) {
+        total = 0;
+        recIntSecs = ride->recIntSecs();
+    }
+    void accumulate(const RideFilePoint *point) {
+        total += (point->hr / 60) * recIntSecs;
+    }
+    void compute(const RideFile *, const Zones *, int,
                  const HrZones *, int,
                  const QHash<QString,RideMetric*> &,
                  const Context *) {
-        total = 0;
-        foreach (const RideFilePoint *point, ride->dataPoints()) {
-            total += (point->hr / 60) * ride->recIntSecs();
-        }
         setValue(total);
     }
 
@@ -1501,17 +1537,20 @@ struct AvgCadence : public RideMetric {
         setImperialUnits(tr("rpm"));
         setType(RideMetric::Average);
     }
-    void compute(const RideFile *ride, const Zones *, int,
+    bool isAccumulator() const { return true; }
+    void begin(const RideFile *) {
+        total = count = 0;
+    }
+    void accumulate(const RideFilePoint *point) {
+        if (point->cad > 0) {
+            total += point->cad;
+            ++count;
+        }
+    }
+    void compute(const RideFile *, const Zones *, int,
                  const HrZones *, int,
                  const QHash<QString,RideMetric*> &,
                  const Context *) {
-        total = count = 0;
-        foreach (const RideFilePoint *point, ride->dataPoints()) {
-            if (point->cad > 0) {
-                total += point->cad;
-                ++count;
-            }
-        }
         setValue(count > 0 ? total / count : count);
         setCount(count);
     }
@@ -1557,19 +1596,22 @@ struct AvgTemp : public RideMetric {
         setConversionSum(FAHRENHEIT_ADD_CENTIGRADE);
         setType(RideMetric::Average);
     }
+    bool isAccumulator() const { return true; }
+    void begin(const RideFile *) {
+        total = count = 0;
+    }
+    void accumulate(const RideFilePoint *point) {
+        if (point->temp != RideFile::NoTemp) {
+            total += point->temp;
+            ++count;
+        }
+    }
     void compute(const RideFile *ride, const Zones *, int,
                  const HrZones *, int,
                  const QHash<QString,RideMetric*> &,
                  const Context *) {
 
         if (ride->areDataPresent()->temp) {
-            total = count = 0;
-            foreach (const RideFilePoint *point, ride->dataPoints()) {
-                if (point->temp != RideFile::NoTemp) {
-                    total += point->temp;
-                    ++count;
-                }
-            }
             setValue(count > 0 ? total / count : count);
             setCount(count);
         } else {
@@ -1604,9 +1646,10 @@ class MaxPower : public RideMetric {
                  const HrZones *, int,
                  const QHash<QString,RideMetric*> &,
                  const Context *) {
-        foreach (const RideFilePoint *point, ride->dataPoints()) {
-            if (point->watts >= max)
-                max = point->watts;
+        const double *watts = ride->column(RideFile::watts);
+        for (int i=0; i<ride->dataPoints().count(); i++) {
+            if (watts[i] >= max)
+                max = watts[i];
         }
         setValue(max);
     }
@@ -1634,14 +1677,18 @@ class MaxSmO2 : public RideMetric {
         setImperialUnits(tr("%"));
         setType(RideMetric::Peak);
     }
-    void compute(const RideFile *ride, const Zones *, int,
+    bool isAccumulator() const { return true; }
+    void begin(const RideFile *) {
+        max = 0.0;
+    }
+    void accumulate(const RideFilePoint *point) {
+        if (point->smo2 >= max)
+            max = point->smo2;
+    }
+    void compute(const RideFile *, const Zones *, int,
                  const HrZones *, int,
                  const QHash<QString,RideMetric*> &,
                  const Context *) {
-        foreach (const RideFilePoint *point, ride->dataPoints()) {
-            if (point->smo2 >= max)
-                max = point->smo2;
-        }
         setValue(max);
     }
 
@@ -1669,14 +1716,18 @@ class MaxtHb : public RideMetric {
         setType(RideMetric::Peak);
         setPrecision(2);
     }
-    void compute(const RideFile *ride, const Zones *, int,
+    bool isAccumulator() const { return true; }
+    void begin(const RideFile *) {
+        max = 0.0;
+    }
+    void accumulate(const RideFilePoint *point) {
+        if (point->thb >= max)
+            max = point->thb;
+    }
+    void compute(const RideFile *, const Zones *, int,
                  const HrZones *, int,
                  const QHash<QString,RideMetric*> &,
                  const Context *) {
-        foreach (const RideFilePoint *point, ride->dataPoints()) {
-            if (point->thb >= max)
-                max = point->thb;
-        }
         setValue(max);
     }
 
@@ -1705,14 +1756,18 @@ class MinSmO2 : public RideMetric {
         setImperialUnits(tr("%"));
         setType(RideMetric::Peak);
     }
-    void compute(const RideFile *ride, const Zones *, int,
+    bool isAccumulator() const { return true; }
+    void begin(const RideFile *) {
+        min = 0.0;
+    }
+    void accumulate(const RideFilePoint *point) {
+        if (point->smo2 > 0 && point->smo2 >= min)
+            min = point->smo2;
+    }
+    void compute(const RideFile *, const Zones *, int,
                  const HrZones *, int,
                  const QHash<QString,RideMetric*> &,
                  const Context *) {
-        foreach (const RideFilePoint *point, ride->dataPoints()) {
-            if (point->smo2 > 0 && point->smo2 >= min)
-                min = point->smo2;
-        }
         setValue(min);
     }
     RideMetric *clone() const { return new MinSmO2(*this); }
@@ -1737,14 +1792,18 @@ class MintHb : public RideMetric {
         setType(RideMetric::Low);
         setPrecision(2);
     }
-    void compute(const RideFile *ride, const Zones *, int,
+    bool isAccumulator() const { return true; }
+    void begin(const RideFile *) {
+        min = 0.0;
+    }
+    void accumulate(const RideFilePoint *point) {
+        if (point->thb > 0 && point->thb >= min)
+            min = point->thb;
+    }
+    void compute(const RideFile *, const Zones *, int,
                  const HrZones *, int,
                  const QHash<QString,RideMetric*> &,
                  const Context *) {
-        foreach (const RideFilePoint *point, ride->dataPoints()) {
-            if (point->thb > 0 && point->thb >= min)
-                min = point->thb;
-        }
         setValue(min);
     }
     RideMetric *clone() const { return new MintHb(*this); }
@@ -1774,9 +1833,10 @@ class MaxHr : public RideMetric {
                  const HrZones *, int,
                  const QHash<QString,RideMetric*> &,
                  const Context *) {
-        foreach (const RideFilePoint *point, ride->dataPoints()) {
-            if (point->hr >= max)
-                max = point->hr;
+        const double *hr = ride->column(RideFile::hr);
+        for (int i=0; i<ride->dataPoints().count(); i++) {
+            if (hr[i] >= max)
+                max = hr[i];
         }
         setValue(max);
     }
@@ -363,7 +363,7 @@ ColorEngine::colorFor(QString text)
 
     foreach(QString code, workoutCodes.keys()) {
         if (text.contains(code, Qt::CaseInsensitive)) {
-           color = workoutCodes[code];
+           color = workoutCodes.value(code); // called from the refresh threads
         }
     }
     return color;
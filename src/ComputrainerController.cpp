@@ -68,7 +68,7 @@ bool ComputrainerController::doesPull() { return true; }
 bool ComputrainerController::doesLoad() { return true; }
 
 /*
- * gets called from the GUI to get updated telemetry.
+ * gets called from the train engine thread to get updated telemetry.
  * so whilst we are at it we check button status too and
  * act accordingly.
  *
@@ -83,11 +83,9 @@ ComputrainerController::getRealtimeData(RealtimeData &rtData)
 
     if(!myComputrainer->isRunning())
     {
-        QMessageBox msgBox;
-        msgBox.setText(tr("Cannot Connect to Computrainer"));
-        msgBox.setIcon(QMessageBox::Critical);
-        msgBox.exec();
-        parent->Stop(1);
+        // not on the gui thread, so let it tell them
+        QMetaObject::invokeMethod(parent, "deviceError", Qt::QueuedConnection,
+                                  Q_ARG(QString, tr("Cannot Connect to Computrainer")));
         return;
     }
 
@@ -97,7 +95,7 @@ ComputrainerController::getRealtimeData(RealtimeData &rtData)
 
 	// Check CT if F3 has been pressed for Calibration mode FIRST before we do anything else
     if (Buttons&CT_F3) {
-        parent->Calibrate();
+        QMetaObject::invokeMethod(parent, "Calibrate", Qt::QueuedConnection);
     }
 
     // ignore other buttons and anything else if calibrating
@@ -130,10 +128,10 @@ ComputrainerController::getRealtimeData(RealtimeData &rtData)
     Gradient = myComputrainer->getGradient();
 	// the calls to the parent will determine which mode we are on (ERG/SPIN) and adjust load/slop appropriately
     if ((Buttons&CT_PLUS) && !(Buttons&CT_F3)) {
-            parent->Higher();
+            QMetaObject::invokeMethod(parent, "Higher", Qt::QueuedConnection);
     }
     if ((Buttons&CT_MINUS) && !(Buttons&CT_F3)) {
-            parent->Lower();
+            QMetaObject::invokeMethod(parent, "Lower", Qt::QueuedConnection);
     }
     rtData.setLoad(Load);
 	rtData.setSlope(Gradient);
@@ -141,29 +139,29 @@ ComputrainerController::getRealtimeData(RealtimeData &rtData)
 #if 0 // F3 now toggles calibration
     // FFWD/REWIND
     if ((Buttons&CT_PLUS) && (Buttons&CT_F3)) {
-           parent->FFwd();
+           QMetaObject::invokeMethod(parent, "FFwd", Qt::QueuedConnection);
     }
     if ((Buttons&CT_MINUS) && (Buttons&CT_F3)) {
-           parent->Rewind();
+           QMetaObject::invokeMethod(parent, "Rewind", Qt::QueuedConnection);
     }
 #endif
 
     // LAP/INTERVAL
     if (Buttons&CT_F1 && !(Buttons&CT_F3)) {
-        parent->newLap();
+        QMetaObject::invokeMethod(parent, "newLap", Qt::QueuedConnection);
     }
     if ((Buttons&CT_F1) && (Buttons&CT_F3)) {
-           parent->FFwdLap();
+           QMetaObject::invokeMethod(parent, "FFwdLap", Qt::QueuedConnection);
     }
 
     // if Buttons == 0 we just pressed stop!
     if (Buttons&CT_RESET) {
-        parent->Stop(0);
+        QMetaObject::invokeMethod(parent, "Stop", Qt::QueuedConnection, Q_ARG(int, 0));
     }
 
     // displaymode
     if (Buttons&CT_F2) {
-        parent->nextDisplayMode();
+        QMetaObject::invokeMethod(parent, "nextDisplayMode", Qt::QueuedConnection);
     }
 }
 
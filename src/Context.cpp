@@ -21,6 +21,7 @@
 
 Context::Context(MainWindow *mainWindow): mainWindow(mainWindow)
 {
+    athlete = NULL;
     ride = NULL;
     workout = NULL;
     videosync = NULL;
@@ -69,6 +70,12 @@ Context::notifyConfigChanged(qint32 state)
     //if (state & CONFIG_APPEARANCE) qDebug()<<"Appearance config changed!";
     //if (state & CONFIG_NOTECOLOR) qDebug()<<"Note color config changed!";
     //if (state & CONFIG_FIELDS) qDebug()<<"Metadata config changed!";
+
+    // before anyone reads them, the general settings (e.g. the
+    // w'bal formula) are shared so every open athlete needs them
+    if (state & (CONFIG_GENERAL | CONFIG_WBAL)) Athlete::readAllSettings();
+    else if (athlete) athlete->readSettings();
+
     configChanged(state);
 }
 
@@ -25,6 +25,7 @@
 #include "PMCData.h"
 #include "VDOTCalculator.h"
 #include <QDebug>
+#include <string.h> // memcpy
 
 #include "Zones.h"
 #include "PaceZones.h"
@@ -37,6 +38,8 @@ static struct {
 
     QString name;
     int parameters; // -1 is end of list, 0 is variable number, >0 is number of parms needed
+    bool pure;      // result only depends on the parameters, so can be folded when they are constant
+    bool effects;   // changes the ride, so must be run for every sample
 
 } DataFilterFunctions[] = {
 
@@ -45,64 +48,77 @@ static struct {
     // TEMPTED TO ADD IN THE MIDDLE !!!!
 
     // math.h
-    { "cos", 1 },
-    { "tan", 1 },
-    { "sin", 1 },
-    { "acos", 1 },
-    { "atan", 1 },
-    { "asin", 1 },
-    { "cosh", 1 },
-    { "tanh", 1 },
-    { "sinh", 1 },
-    { "acosh", 1 },
-    { "atanh", 1 },
-    { "asinh", 1 },
-
-    { "exp", 1 },
-    { "log", 1 },
-    { "log10", 1 },
-
-    { "ceil", 1 },
-    { "floor", 1 },
-    { "round", 1 },
-
-    { "fabs", 1 },
-    { "isinf", 1 },
-    { "isnan", 1 },
+    { "cos", 1, true, false },
+    { "tan", 1, true, false },
+    { "sin", 1, true, false },
+    { "acos", 1, true, false },
+    { "atan", 1, true, false },
+    { "asin", 1, true, false },
+    { "cosh", 1, true, false },
+    { "tanh", 1, true, false },
+    { "sinh", 1, true, false },
+    { "acosh", 1, true, false },
+    { "atanh", 1, true, false },
+    { "asinh", 1, true, false },
+
+    { "exp", 1, true, false },
+    { "log", 1, true, false },
+    { "log10", 1, true, false },
+
+    { "ceil", 1, true, false },
+    { "floor", 1, true, false },
+    { "round", 1, true, false },
+
+    { "fabs", 1, true, false },
+    { "isinf", 1, true, false },
+    { "isnan", 1, true, false },
 
     // primarily for working with vectors, but can
     // have variable number of parameters so probably
     // quite useful for a number of things
-    { "sum", 0 },
-    { "mean", 0 },
-    { "max", 0 },
-    { "min", 0 },
-    { "count", 0 },
+    { "sum", 0, true, false },
+    { "mean", 0, true, false },
+    { "max", 0, true, false },
+    { "min", 0, true, false },
+    { "count", 0, true, false },
 
     // PMC functions
-    { "lts", 1 },
-    { "sts", 1 },
-    { "sb", 1 },
-    { "rr", 1 },
+    { "lts", 1, false, false },
+    { "sts", 1, false, false },
+    { "sb", 1, false, false },
+    { "rr", 1, false, false },
 
     // estimate
-    { "estimate", 2 }, // estimate(model, (cp|ftp|w'|pmax|x))
+    { "estimate", 2, false, false }, // estimate(model, (cp|ftp|w'|pmax|x))
 
     // more vector operations
-    { "which", 0 }, // which(expr, ...) - create vector contain values that pass expr
+    { "which", 0, true, false }, // which(expr, ...) - create vector contain values that pass expr
 
     // set
-    { "set", 3 }, // set(symbol, value, filter)
-    { "unset", 2 }, // unset(symbol, filter)
-    { "isset", 1 }, // isset(symbol) - is the metric or metadata overridden/defined
+    { "set", 3, false, true }, // set(symbol, value, filter)
+    { "unset", 2, false, true }, // unset(symbol, filter)
+    { "isset", 1, false, false }, // isset(symbol) - is the metric or metadata overridden/defined
 
     // VDOT functions
-    { "vdottime", 2 }, // vdottime(VDOT, distance[km]) - result is seconds
+    { "vdottime", 2, true, false }, // vdottime(VDOT, distance[km]) - result is seconds
 
     // add new ones above this line
-    { "", -1 }
+    { "", -1, false, false }
 };
 
+// functions that take a literal series name rather than a list of
+// parameters are resolved to these by Leaf::resolve()
+enum { FunctionBest = 1000, FunctionTiz, FunctionConfig };
+
+// what a symbol refers to, resolved by Leaf::resolve()
+enum { SymbolUnresolved = 0, SymbolX, SymbolIsRun, SymbolIsSwim, SymbolCurrent, SymbolToday,
+       SymbolDate, SymbolCTL, SymbolATL, SymbolTSB, SymbolNumber, SymbolSeries, SymbolText };
+
+// parameters for config()
+enum { ConfigUnknown = 0, ConfigCrankLength, ConfigCP, ConfigWPrime, ConfigPmax, ConfigCV,
+       ConfigDPrime, ConfigSCV, ConfigSDPrime, ConfigHeight, ConfigWeight, ConfigLTHR,
+       ConfigMaxHR, ConfigRHR, ConfigUnits };
+
 static QStringList pdmodels()
 {
     QStringList returning;
@@ -1143,7 +1159,8 @@ void Leaf::validateFilter(DataFilter *df, Leaf *leaf)
     }
 }
 
-DataFilter::DataFilter(QObject *parent, Context *context) : QObject(parent), context(context), isdynamic(false), treeRoot(NULL)
+DataFilter::DataFilter(QObject *parent, Context *context) : QObject(parent), context(context), isdynamic(false),
+                                                                       sampleItem(NULL), generation(0), treeRoot(NULL)
 {
     // set up the models we support
     models << new CP2Model(context);
@@ -1157,7 +1174,8 @@ DataFilter::DataFilter(QObject *parent, Context *context) : QObject(parent), con
     connect(context, SIGNAL(rideSelected(RideItem*)), this, SLOT(dynamicParse()));
 }
 
-DataFilter::DataFilter(QObject *parent, Context *context, QString formula) : QObject(parent), context(context), isdynamic(false), treeRoot(NULL)
+DataFilter::DataFilter(QObject *parent, Context *context, QString formula) : QObject(parent), context(context), isdynamic(false),
+                                                                       sampleItem(NULL), generation(0), treeRoot(NULL)
 {
     // set up the models we support
     models << new CP2Model(context);
@@ -1187,16 +1205,51 @@ DataFilter::DataFilter(QObject *parent, Context *context, QString formula) : QOb
     if (DataFiltererrors.count() != 0)
         treeRoot= NULL;
 
+    // ready to evaluate
+    if (treeRoot) treeRoot->compile(this, treeRoot);
 }
 
 Result DataFilter::evaluate(RideItem *item, RideFilePoint *p)
 {
     if (!item || !treeRoot || DataFiltererrors.count()) return Result(0);
 
+    // anything that doesn't depend on the sample is only calculated
+    // once per call, the ride's data or settings may have changed
+    // since the last one so nothing cached is reused after it. use
+    // evaluateSamples() to work through all the samples of a ride
+    sampleItem = p ? item : NULL;
+    generation++;
+
     Result res = treeRoot->eval(context, this, treeRoot, 0, item, p);
     return res;
 }
 
+QVector<double> DataFilter::evaluateSamples(RideItem *item, int start, int count)
+{
+    QVector<double> returning;
+
+    // need the samples
+    RideFile *f = item ? item->ride() : NULL;
+    if (!f) return returning;
+
+    int samples = f->dataPoints().count();
+    if (start < 0) start = 0;
+    if (count < 0 || start + count > samples) count = samples - start;
+    if (count <= 0) return returning;
+
+    // 0 for every sample, just like evaluate()
+    if (!treeRoot || DataFiltererrors.count()) return QVector<double>(count, 0);
+
+    // anything evaluated a sample at a time can still reuse
+    // values that don't change from sample to sample
+    sampleItem = item;
+    generation++;
+
+    returning.resize(count);
+    treeRoot->evalColumn(context, this, treeRoot, item, f, start, count, returning.data());
+    return returning;
+}
+
 QStringList DataFilter::check(QString query)
 {
     // since we may use it afterwards
@@ -1223,6 +1276,10 @@ QStringList DataFilter::check(QString query)
         // no errors just failed to finish
         if (!treeRoot) DataFiltererrors << tr("malformed expression.");
 
+    } else {
+
+        // ready to evaluate
+        treeRoot->compile(this, treeRoot);
     }
 
     errors = DataFiltererrors;
@@ -1271,6 +1328,9 @@ QStringList DataFilter::parseFilter(QString query, QStringList *list)
 
         isdynamic = treeRoot->isDynamic(treeRoot);
 
+        // resolve and fold before we evaluate it for every ride
+        treeRoot->compile(this, treeRoot);
+
         // successfully parsed, lets check semantics
         //treeRoot->print(treeRoot);
         emit parseGood();
@@ -1359,6 +1419,282 @@ void DataFilter::configChanged(qint32)
 
     // sample date series
     dataSeriesSymbols = RideFile::symbols();
+
+    // symbols may now refer to something else
+    if (treeRoot) treeRoot->compile(this, treeRoot);
+}
+
+// work out what symbols and functions refer to once rather
+// than looking them up by name every time they are evaluated
+void Leaf::resolve(DataFilter *df)
+{
+    compiled = true;
+
+    switch(type) {
+
+    case Leaf::Symbol :
+        {
+            QString name = *(lvalue.n);
+            metricIndex = -1;
+            rename = "";
+
+            if (name == "x") symbol = SymbolX;
+            else if (name == "isRun") symbol = SymbolIsRun;
+            else if (name == "isSwim") symbol = SymbolIsSwim;
+            else if (!name.compare("Current", Qt::CaseInsensitive)) symbol = SymbolCurrent;
+            else if (!name.compare("Today", Qt::CaseInsensitive)) symbol = SymbolToday;
+            else if (!name.compare("Date", Qt::CaseInsensitive)) symbol = SymbolDate;
+            else if (!name.compare("ctl", Qt::CaseInsensitive)) symbol = SymbolCTL;
+            else if (!name.compare("atl", Qt::CaseInsensitive)) symbol = SymbolATL;
+            else if (!name.compare("tsb", Qt::CaseInsensitive)) symbol = SymbolTSB;
+            else if (df->lookupType.value(name) == true) {
+
+                // metric or numeric metadata
+                symbol = SymbolNumber;
+                rename = df->lookupMap.value(name, "");
+                const RideMetric *metric = RideMetricFactory::instance().rideMetric(rename);
+                if (metric) metricIndex = metric->index();
+
+            } else if (df->dataSeriesSymbols.contains(name)) {
+
+                symbol = SymbolSeries;
+                sampleSeries = RideFile::seriesForSymbol(name);
+
+            } else {
+
+                symbol = SymbolText;
+                rename = df->lookupMap.value(name, "");
+            }
+        }
+        break;
+
+    case Leaf::Function :
+        {
+            fnum = -1;
+            symbol = ConfigUnknown;
+
+            if (series) {
+
+                if (function == "best") fnum = FunctionBest;
+                else if (function == "tiz") fnum = FunctionTiz;
+                else if (function == "config") {
+
+                    fnum = FunctionConfig;
+
+                    QString name = series->lvalue.n->toLower();
+                    if (name == "cranklength") symbol = ConfigCrankLength;
+                    else if (name == "cp") symbol = ConfigCP;
+                    else if (name == "w'") symbol = ConfigWPrime;
+                    else if (name == "pmax") symbol = ConfigPmax;
+                    else if (name == "cv") symbol = ConfigCV;
+                    else if (name == "d'") symbol = ConfigDPrime;
+                    else if (name == "scv") symbol = ConfigSCV;
+                    else if (name == "sd'") symbol = ConfigSDPrime;
+                    else if (name == "height") symbol = ConfigHeight;
+                    else if (name == "weight") symbol = ConfigWeight;
+                    else if (name == "lthr") symbol = ConfigLTHR;
+                    else if (name == "maxhr") symbol = ConfigMaxHR;
+                    else if (name == "rhr") symbol = ConfigRHR;
+                    else if (name == "units") symbol = ConfigUnits;
+                }
+
+            } else {
+
+                for (int i=0; DataFilterFunctions[i].parameters != -1; i++) {
+                    if (DataFilterFunctions[i].name == function) {
+
+                        // parameter mismatch not allowed; function signature mismatch
+                        // should be impossible...
+                        if (!DataFilterFunctions[i].parameters || DataFilterFunctions[i].parameters == fparms.count())
+                            fnum = i;
+                        break;
+                    }
+                }
+            }
+        }
+        break;
+
+    default:
+        break;
+    }
+}
+
+void Leaf::compile(DataFilter *df, Leaf *leaf)
+{
+    leaf->isConstant = false;
+    leaf->sampleInvariant = true;
+    leaf->cachedGeneration = -1;
+    leaf->effects = false;
+    leaf->resolve(df);
+
+    QList<Leaf*> children;
+    switch(leaf->type) {
+    case Leaf::Logical :
+        children << leaf->lvalue.l;
+        if (leaf->op) children << leaf->rvalue.l;
+        break;
+    case Leaf::UnaryOperation :
+        children << leaf->lvalue.l;
+        break;
+    case Leaf::Operation :
+    case Leaf::BinaryOperation :
+        children << leaf->lvalue.l << leaf->rvalue.l;
+        break;
+    case Leaf::Conditional :
+        children << leaf->cond.l << leaf->lvalue.l << leaf->rvalue.l;
+        break;
+    case Leaf::Vector :
+        children << leaf->lvalue.l << leaf->fparms;
+        break;
+    case Leaf::Function :
+        if (leaf->series) {
+            if (leaf->lvalue.l) children << leaf->lvalue.l;
+        } else children << leaf->fparms;
+        break;
+    default:
+        break;
+    }
+
+    bool constant = true;
+    foreach(Leaf *child, children) {
+        compile(df, child);
+        if (!child->isConstant) constant = false;
+        if (!child->sampleInvariant) leaf->sampleInvariant = false;
+        if (child->effects) leaf->effects = true;
+    }
+
+    switch(leaf->type) {
+    case Leaf::Float :
+    case Leaf::Integer :
+    case Leaf::String :
+        break;
+
+    case Leaf::Symbol :
+        constant = false;
+        if (leaf->symbol == SymbolX || leaf->symbol == SymbolSeries) leaf->sampleInvariant = false;
+        break;
+
+    case Leaf::Function :
+        // best, tiz and config aren't in the table, they depend on the ride
+        if (leaf->fnum < 0 || leaf->fnum >= FunctionBest || !DataFilterFunctions[leaf->fnum].pure) constant = false;
+
+        // set and unset must be run every time
+        if (leaf->fnum >= 0 && leaf->fnum < FunctionBest && DataFilterFunctions[leaf->fnum].effects) {
+            leaf->sampleInvariant = false;
+            leaf->effects = true;
+        }
+        break;
+
+    case Leaf::Logical :
+    case Leaf::UnaryOperation :
+    case Leaf::Operation :
+    case Leaf::BinaryOperation :
+    case Leaf::Conditional :
+        break;
+
+    default:
+    case Leaf::Vector : // depends on the rides
+        constant = false;
+        break;
+    }
+
+    // fold it, the ride isn't used
+    if (constant) {
+        leaf->constant = eval(df->context, df, leaf, 0, NULL, NULL);
+        leaf->isConstant = true;
+    }
+}
+
+// config() only looks up the zones it needs to
+static Result configValue(Context *context, int parameter, RideItem *m)
+{
+    switch(parameter) {
+
+    case ConfigCrankLength :
+        return Result(context->athlete->settings()->crankLength / 1000.0);
+
+    //
+    // Get CP and W' estimates for date of ride
+    //
+    case ConfigCP :
+    case ConfigWPrime :
+    case ConfigPmax :
+        {
+            double value = 0;
+
+            if (context->athlete->zones()) {
+
+                // if range is -1 we need to fall back to a default value
+                int zoneRange = context->athlete->zones()->whichRange(m->dateTime.date());
+                if (zoneRange >= 0) {
+                    if (parameter == ConfigCP) value = context->athlete->zones()->getCP(zoneRange);
+                    if (parameter == ConfigWPrime) value = context->athlete->zones()->getWprime(zoneRange);
+                    if (parameter == ConfigPmax) value = context->athlete->zones()->getPmax(zoneRange);
+                }
+
+                // did we override CP in metadata ?
+                int override = m->getText(parameter == ConfigCP ? "CP" :
+                                          parameter == ConfigWPrime ? "W'" : "Pmax", "0").toInt();
+                if (override) value = override;
+            }
+            return Result(value);
+        }
+
+    //
+    // LTHR, MaxHR, RHR
+    //
+    case ConfigLTHR :
+    case ConfigMaxHR :
+    case ConfigRHR :
+        {
+            int hrZoneRange = context->athlete->hrZones() ?
+                              context->athlete->hrZones()->whichRange(m->dateTime.date())
+                              : -1;
+            if (hrZoneRange == -1) return Result(0);
+
+            if (parameter == ConfigLTHR) return Result(context->athlete->hrZones()->getLT(hrZoneRange));
+            if (parameter == ConfigRHR) return Result(context->athlete->hrZones()->getRestHr(hrZoneRange));
+            return Result(context->athlete->hrZones()->getMaxHr(hrZoneRange));
+        }
+
+    //
+    // CV' D'
+    //
+    case ConfigCV :
+    case ConfigSCV :
+        {
+            bool swim = parameter == ConfigSCV;
+            int paceZoneRange = context->athlete->paceZones(swim) ?
+                                context->athlete->paceZones(swim)->whichRange(m->dateTime.date()) :
+                                -1;
+
+            return Result((paceZoneRange != -1) ? context->athlete->paceZones(swim)->getCV(paceZoneRange) : 0.0);
+        }
+
+    case ConfigDPrime :
+    case ConfigSDPrime :
+        return Result(0); //XXX not in pace zones yet
+
+    //
+    // HEIGHT and WEIGHT
+    //
+    case ConfigHeight :
+        {
+            double HEIGHT = m->getText("Height","0").toDouble();
+            if (HEIGHT == 0) HEIGHT = context->athlete->getHeight(NULL);
+            return Result(HEIGHT);
+        }
+
+    case ConfigWeight :
+        return Result(m->getWeight());
+
+    case ConfigUnits :
+        return Result(context->athlete->useMetricUnits ? 1 : 0);
+
+    default:
+        break;
+    }
+    return Result(0);
 }
 
 Result Leaf::eval(Context *context, DataFilter *df, Leaf *leaf, float x, RideItem *m, RideFilePoint *p)
@@ -1366,6 +1702,199 @@ Result Leaf::eval(Context *context, DataFilter *df, Leaf *leaf, float x, RideIte
     // if error state all bets are off
     if (inerror) return Result(0);
 
+    // folded when compiled
+    if (leaf->isConstant) return leaf->constant;
+
+    // working through the samples of the same ride ?
+    if (p && df && leaf->sampleInvariant && m == df->sampleItem) {
+        if (leaf->cachedGeneration != df->generation) {
+            leaf->cached = evalLeaf(context, df, leaf, x, m, p);
+            leaf->cachedGeneration = df->generation;
+        }
+        return leaf->cached;
+    }
+
+    return evalLeaf(context, df, leaf, x, m, p);
+}
+
+// evaluate a node for a run of samples at a time, working on the
+// ride's columns with loops the compiler can vectorise. Anything we
+// can't do that way (strings, vectors, which etc) is evaluated a
+// sample at a time as before
+void Leaf::evalColumn(Context *context, DataFilter *df, Leaf *leaf, RideItem *m, RideFile *f, int start, int count, double *out)
+{
+    // if error state all bets are off
+    if (inerror) {
+        for (int i=0; i<count; i++) out[i] = 0;
+        return;
+    }
+
+    // resolve on first use if not compiled
+    if (!leaf->compiled) leaf->resolve(df);
+
+    // the same for every sample
+    if (leaf->isConstant || leaf->sampleInvariant) {
+        double value = leaf->isConstant ? leaf->constant.number : eval(context, df, leaf, 0, m, NULL).number;
+        for (int i=0; i<count; i++) out[i] = value;
+        return;
+    }
+
+    switch(leaf->type) {
+
+    case Leaf::Symbol :
+        {
+            if (leaf->symbol == SymbolX) { // always zero for samples
+                for (int i=0; i<count; i++) out[i] = 0;
+                return;
+            }
+
+            if (leaf->symbol == SymbolSeries) {
+                const double *column = f->column(leaf->sampleSeries);
+                if (column) {
+                    memcpy(out, column + start, sizeof(double) * count);
+                } else {
+                    // derived on the fly, not held as a column
+                    const QVector<RideFilePoint*> &points = f->dataPoints();
+                    for (int i=0; i<count; i++) out[i] = points[start+i]->value(leaf->sampleSeries);
+                }
+                return;
+            }
+        }
+        break;
+
+    case Leaf::Logical :
+        {
+            // parenthesis
+            if (leaf->op == 0) {
+                evalColumn(context, df, leaf->lvalue.l, m, f, start, count, out);
+                return;
+            }
+
+            if (!isNumber(df, leaf->lvalue.l) || !isNumber(df, leaf->rvalue.l)) break;
+
+            // && and || don't always evaluate the right hand side
+            if (leaf->rvalue.l->effects) break;
+
+            QVector<double> rhs(count);
+            evalColumn(context, df, leaf->lvalue.l, m, f, start, count, out);
+            evalColumn(context, df, leaf->rvalue.l, m, f, start, count, rhs.data());
+            const double *r = rhs.constData();
+
+            if (leaf->op == AND) for (int i=0; i<count; i++) out[i] = (out[i] && r[i]) ? 1 : 0;
+            else for (int i=0; i<count; i++) out[i] = (out[i] || r[i]) ? 1 : 0;
+        }
+        return;
+
+    case Leaf::UnaryOperation :
+        {
+            evalColumn(context, df, leaf->lvalue.l, m, f, start, count, out);
+            for (int i=0; i<count; i++) out[i] *= -1;
+        }
+        return;
+
+    case Leaf::BinaryOperation :
+    case Leaf::Operation :
+        {
+            // string operations a sample at a time
+            if (!isNumber(df, leaf->lvalue.l)) break;
+
+            QVector<double> rhs(count);
+            evalColumn(context, df, leaf->lvalue.l, m, f, start, count, out);
+            evalColumn(context, df, leaf->rvalue.l, m, f, start, count, rhs.data());
+            const double *r = rhs.constData();
+
+            switch (leaf->op) {
+            case ADD: for (int i=0; i<count; i++) out[i] += r[i]; break;
+            case SUBTRACT: for (int i=0; i<count; i++) out[i] -= r[i]; break;
+            case MULTIPLY: for (int i=0; i<count; i++) out[i] *= r[i]; break;
+
+            // avoid divide by zero
+            case DIVIDE: for (int i=0; i<count; i++) out[i] = r[i] ? out[i] / r[i] : 0; break;
+            case POW: for (int i=0; i<count; i++) out[i] = r[i] ? pow(out[i], r[i]) : 0; break;
+
+            case EQ: for (int i=0; i<count; i++) out[i] = out[i] == r[i]; break;
+            case NEQ: for (int i=0; i<count; i++) out[i] = out[i] != r[i]; break;
+            case LT: for (int i=0; i<count; i++) out[i] = out[i] < r[i]; break;
+            case LTE: for (int i=0; i<count; i++) out[i] = out[i] <= r[i]; break;
+            case GT: for (int i=0; i<count; i++) out[i] = out[i] > r[i]; break;
+            case GTE: for (int i=0; i<count; i++) out[i] = out[i] >= r[i]; break;
+
+            default: // string operations on numbers are false
+                for (int i=0; i<count; i++) out[i] = 0;
+                break;
+            }
+        }
+        return;
+
+    case Leaf::Conditional :
+        {
+            if (!isNumber(df, leaf->cond.l)) break;
+
+            // both branches are worked out for every sample, which
+            // is only alright if neither of them changes the ride
+            if (leaf->lvalue.l->effects || leaf->rvalue.l->effects) break;
+
+            QVector<double> cond(count), rhs(count);
+            evalColumn(context, df, leaf->cond.l, m, f, start, count, cond.data());
+            evalColumn(context, df, leaf->lvalue.l, m, f, start, count, out);
+            evalColumn(context, df, leaf->rvalue.l, m, f, start, count, rhs.data());
+            const double *c = cond.constData();
+            const double *r = rhs.constData();
+
+            for (int i=0; i<count; i++) if (!c[i]) out[i] = r[i];
+        }
+        return;
+
+    case Leaf::Function :
+        {
+            // just the math.h functions
+            if (leaf->fnum < 0 || leaf->fnum > 20) break;
+
+            evalColumn(context, df, leaf->fparms[0], m, f, start, count, out);
+
+            switch (leaf->fnum) {
+            case 0 : for (int i=0; i<count; i++) out[i] = cos(out[i]); break;
+            case 1 : for (int i=0; i<count; i++) out[i] = tan(out[i]); break;
+            case 2 : for (int i=0; i<count; i++) out[i] = sin(out[i]); break;
+            case 3 : for (int i=0; i<count; i++) out[i] = acos(out[i]); break;
+            case 4 : for (int i=0; i<count; i++) out[i] = atan(out[i]); break;
+            case 5 : for (int i=0; i<count; i++) out[i] = asin(out[i]); break;
+            case 6 : for (int i=0; i<count; i++) out[i] = cosh(out[i]); break;
+            case 7 : for (int i=0; i<count; i++) out[i] = tanh(out[i]); break;
+            case 8 : for (int i=0; i<count; i++) out[i] = sinh(out[i]); break;
+            case 9 : for (int i=0; i<count; i++) out[i] = acosh(out[i]); break;
+            case 10 : for (int i=0; i<count; i++) out[i] = atanh(out[i]); break;
+            case 11 : for (int i=0; i<count; i++) out[i] = asinh(out[i]); break;
+
+            case 12 : for (int i=0; i<count; i++) out[i] = exp(out[i]); break;
+            case 13 : for (int i=0; i<count; i++) out[i] = log(out[i]); break;
+            case 14 : for (int i=0; i<count; i++) out[i] = log10(out[i]); break;
+
+            case 15 : for (int i=0; i<count; i++) out[i] = ceil(out[i]); break;
+            case 16 : for (int i=0; i<count; i++) out[i] = floor(out[i]); break;
+            case 17 : for (int i=0; i<count; i++) out[i] = round(out[i]); break;
+
+            case 18 : for (int i=0; i<count; i++) out[i] = fabs(out[i]); break;
+            case 19 : for (int i=0; i<count; i++) out[i] = std::isinf(out[i]); break;
+            case 20 : for (int i=0; i<count; i++) out[i] = std::isnan(out[i]); break;
+            }
+        }
+        return;
+
+    default:
+        break;
+    }
+
+    // a sample at a time
+    const QVector<RideFilePoint*> &points = f->dataPoints();
+    for (int i=0; i<count; i++) out[i] = eval(context, df, leaf, 0, m, points[start+i]).number;
+}
+
+Result Leaf::evalLeaf(Context *context, DataFilter *df, Leaf *leaf, float x, RideItem *m, RideFilePoint *p)
+{
+    // resolve on first use if not compiled
+    if (!leaf->compiled) leaf->resolve(df);
+
     switch(leaf->type) {
 
     //
@@ -1406,117 +1935,12 @@ Result Leaf::eval(Context *context, DataFilter *df, Leaf *leaf, float x, RideIte
     case Leaf::Function :
     {
         double duration;
+        int fnum = leaf->fnum;
 
-        if (leaf->function == "config") {
-
-            //
-            // Get CP and W' estimates for date of ride
-            //
-            double CP = 0;
-            double WPRIME = 0;
-            double PMAX = 0;
-            int zoneRange;
-
-            if (context->athlete->zones()) {
-
-                // if range is -1 we need to fall back to a default value
-                zoneRange = context->athlete->zones()->whichRange(m->dateTime.date());
-                CP = zoneRange >= 0 ? context->athlete->zones()->getCP(zoneRange) : 0;
-                WPRIME = zoneRange >= 0 ? context->athlete->zones()->getWprime(zoneRange) : 0;
-                PMAX = zoneRange >= 0 ? context->athlete->zones()->getPmax(zoneRange) : 0;
-
-                // did we override CP in metadata ?
-                int oCP = m->getText("CP","0").toInt();
-                int oW = m->getText("W'","0").toInt();
-                int oPMAX = m->getText("Pmax","0").toInt();
-                if (oCP) CP=oCP;
-                if (oW) WPRIME=oW;
-                if (oPMAX) PMAX=oPMAX;
-            }
-
-            //
-            // LTHR, MaxHR, RHR
-            //
-            int hrZoneRange = context->athlete->hrZones() ?
-                              context->athlete->hrZones()->whichRange(m->dateTime.date())
-                              : -1;
-
-            int LTHR = hrZoneRange != -1 ?  context->athlete->hrZones()->getLT(hrZoneRange) : 0;
-            int RHR = hrZoneRange != -1 ?  context->athlete->hrZones()->getRestHr(hrZoneRange) : 0;
-            int MaxHR = hrZoneRange != -1 ?  context->athlete->hrZones()->getMaxHr(hrZoneRange) : 0;
-
-            //
-            // CV' D'
-            //
-            int paceZoneRange = context->athlete->paceZones(false) ?
-                                context->athlete->paceZones(false)->whichRange(m->dateTime.date()) :
-                                -1;
-
-            double CV = (paceZoneRange != -1) ? context->athlete->paceZones(false)->getCV(paceZoneRange) : 0.0;
-            double DPRIME = 0; //XXX(paceZoneRange != -1) ? context->athlete->paceZones(false)->getDPrime(paceZoneRange) : 0.0;
-
-            int spaceZoneRange = context->athlete->paceZones(true) ?
-                                context->athlete->paceZones(true)->whichRange(m->dateTime.date()) :
-                                -1;
-            double SCV = (spaceZoneRange != -1) ? context->athlete->paceZones(true)->getCV(spaceZoneRange) : 0.0;
-            double SDPRIME = 0; //XXX (spaceZoneRange != -1) ? context->athlete->paceZones(true)->getDPrime(spaceZoneRange) : 0.0;
-
-            //
-            // HEIGHT and WEIGHT
-            //
-            double HEIGHT = m->getText("Height","0").toDouble();
-            if (HEIGHT == 0) HEIGHT = context->athlete->getHeight(NULL);
-            double WEIGHT = m->getWeight();
-
-            QString symbol = leaf->series->lvalue.n->toLower();
-
-            if (symbol == "cranklength") {
-                return Result(appsettings->cvalue(context->athlete->cyclist, GC_CRANKLENGTH, 175.00f).toDouble() / 1000.0);
-            }
-
-            if (symbol == "cp") {
-                return Result(CP);
-            }
-            if (symbol == "w'") {
-                return Result(WPRIME);
-            }
-            if (symbol == "pmax") {
-                return Result(PMAX);
-            }
-            if (symbol == "scv") {
-                return Result(SCV);
-            }
-            if (symbol == "sd'") {
-                return Result(SDPRIME);
-            }
-            if (symbol == "cv") {
-                return Result(CV);
-            }
-            if (symbol == "d'") {
-                return Result(DPRIME);
-            }
-            if (symbol == "lthr") {
-                return Result(LTHR);
-            }
-            if (symbol == "rhr") {
-                return Result(RHR);
-            }
-            if (symbol == "maxhr") {
-                return Result(MaxHR);
-            }
-            if (symbol == "weight") {
-                return Result(WEIGHT);
-            }
-            if (symbol == "height") {
-                return Result(HEIGHT);
-            }
-            if (symbol == "units") {
-                return Result(context->athlete->useMetricUnits ? 1 : 0);
-            }
-        }
+        if (fnum == FunctionConfig) return configValue(context, leaf->symbol, m);
 
         // get here for tiz and best
-        if (leaf->function == "best" || leaf->function == "tiz") {
+        if (fnum == FunctionBest || fnum == FunctionTiz) {
 
             switch (leaf->lvalue.l->type) {
 
@@ -1557,29 +1981,14 @@ Result Leaf::eval(Context *context, DataFilter *df, Leaf *leaf, float x, RideIte
                 break;
             }
 
-            if (leaf->function == "best")
+            if (fnum == FunctionBest)
                 return Result(RideFileCache::best(df->context, m->fileName, leaf->seriesType, duration));
 
-            if (leaf->function == "tiz") // duration is really zone number
+            else // duration is really zone number
                 return Result(RideFileCache::tiz(df->context, m->fileName, leaf->seriesType, duration));
         }
 
         // if we get here its general function handling
-        // what function is being called?
-        int fnum=-1;
-        for (int i=0; DataFilterFunctions[i].parameters != -1; i++) {
-            if (DataFilterFunctions[i].name == leaf->function) {
-
-                // parameter mismatch not allowed; function signature mismatch
-                // should be impossible...
-                if (DataFilterFunctions[i].parameters && DataFilterFunctions[i].parameters != leaf->fparms.count())
-                    fnum=-1;
-                else
-                    fnum = i;
-                break;
-            }
-        }
-
         // not found...
         if (fnum < 0) return Result(0);
 
@@ -1979,77 +2388,63 @@ Result Leaf::eval(Context *context, DataFilter *df, Leaf *leaf, float x, RideIte
     //
     case Leaf::Symbol :
     {
-        double lhsdouble=0.0f;
-        bool lhsisNumber=false;
-        QString lhsstring;
-        QString rename;
-        QString symbol = *(leaf->lvalue.n);
+        switch (leaf->symbol) {
 
-        // is it isRun ?
-        if (symbol == "x") {
+        case SymbolX :
+            return Result(x);
 
-            lhsdouble = x;
-            lhsisNumber = true;
+        case SymbolIsRun :
+            return Result(m->isRun ? 1 : 0);
 
-        } else if (symbol == "isRun") {
-            lhsdouble = m->isRun ? 1 : 0;
-            lhsisNumber = true;
-
-        } else if (symbol == "isSwim") {
-            lhsdouble = m->isSwim ? 1 : 0;
-            lhsisNumber = true;
-
-        } else if (!symbol.compare("Current", Qt::CaseInsensitive)) {
+        case SymbolIsSwim :
+            return Result(m->isSwim ? 1 : 0);
 
+        case SymbolCurrent :
             if (context->currentRideItem())
-                lhsdouble = QDate(1900,01,01).
-                daysTo(context->currentRideItem()->dateTime.date());
+                return Result(QDate(1900,01,01).daysTo(context->currentRideItem()->dateTime.date()));
             else
-                lhsdouble = 0;
-            lhsisNumber = true;
-
-        } else if (!symbol.compare("Today", Qt::CaseInsensitive)) {
-
-            lhsdouble = QDate(1900,01,01).daysTo(QDate::currentDate());
-            lhsisNumber = true;
+                return Result(0);
 
-        } else if (!symbol.compare("Date", Qt::CaseInsensitive)) {
+        case SymbolToday :
+            return Result(QDate(1900,01,01).daysTo(QDate::currentDate()));
 
-            lhsdouble = QDate(1900,01,01).daysTo(m->dateTime.date());
-            lhsisNumber = true;
+        case SymbolDate :
+            return Result(QDate(1900,01,01).daysTo(m->dateTime.date()));
 
-        } else if (isCoggan(symbol)) {
-            // a coggan PMC metric
-            PMCData *pmcData = context->athlete->getPMCFor("coggan_tss");
-            if (!symbol.compare("ctl", Qt::CaseInsensitive)) lhsdouble = pmcData->lts(m->dateTime.date());
-            if (!symbol.compare("atl", Qt::CaseInsensitive)) lhsdouble = pmcData->sts(m->dateTime.date());
-            if (!symbol.compare("tsb", Qt::CaseInsensitive)) lhsdouble = pmcData->sb(m->dateTime.date());
-            lhsisNumber = true;
+        case SymbolCTL :
+        case SymbolATL :
+        case SymbolTSB :
+            {
+                // a coggan PMC metric
+                PMCData *pmcData = context->athlete->getPMCFor("coggan_tss");
+                if (leaf->symbol == SymbolCTL) return Result(pmcData->lts(m->dateTime.date()));
+                if (leaf->symbol == SymbolATL) return Result(pmcData->sts(m->dateTime.date()));
+                return Result(pmcData->sb(m->dateTime.date()));
+            }
 
-        } else if ((lhsisNumber = df->lookupType.value(*(leaf->lvalue.n))) == true) {
-            // get symbol value
-            // check metadata string to number first ...
-            QString meta = m->getText(rename=df->lookupMap.value(symbol,""), "unknown");
-            if (meta == "unknown")
-                lhsdouble = m->getForSymbol(rename=df->lookupMap.value(symbol,""));
-            else
-                lhsdouble = meta.toDouble();
-            lhsisNumber = true;
+        case SymbolNumber :
+            {
+                // check metadata string to number first ...
+                if (m->hasText(leaf->rename)) {
+                    QString meta = m->getText(leaf->rename, "unknown");
+                    if (meta != "unknown") return Result(meta.toDouble());
+                }
 
-            //qDebug()<<"symbol" << *(lvalue.n) << "is" << lhsdouble << "via" << rename;
-        } else if ((lhsisNumber = df->dataSeriesSymbols.contains(*(leaf->lvalue.n))) == true) {
+                if (leaf->metricIndex >= 0 && leaf->metricIndex < m->metrics().size())
+                    return Result(m->metrics()[leaf->metricIndex]);
+                return Result(0);
+            }
 
+        case SymbolSeries :
             // its a ride series symbol !
-            if (p) return Result(p->value(RideFile::seriesForSymbol((*(leaf->lvalue.n)))));
+            if (p) return Result(p->value(leaf->sampleSeries));
             else return Result(0); 
 
-        } else {
+        default:
+        case SymbolText :
             // string symbol will evaluate to zero as unary expression
-            lhsstring = m->getText(rename=df->lookupMap.value(symbol,""), "");
-            //qDebug()<<"symbol" << *(lvalue.n) << "is" << lhsstring << "via" << rename;
+            return Result(m->getText(leaf->rename, ""));
         }
-        if (lhsisNumber) return Result(lhsdouble);
-        else return Result(lhsstring);
     }
     break;
 
@@ -23,6 +23,7 @@
 #include <QObject>
 #include <QDebug>
 #include <QList>
+#include <QVector>
 #include <QMap>
 #include <QHash>
 #include <QStringList>
@@ -56,11 +57,22 @@ class Leaf {
 
     public:
 
-        Leaf(int loc, int leng) : type(none),op(0),series(NULL),dynamic(false),loc(loc),leng(leng),inerror(false) { }
+        Leaf(int loc, int leng) : type(none),op(0),series(NULL),dynamic(false),loc(loc),leng(leng),inerror(false),
+                                  compiled(false),fnum(-1),symbol(0),metricIndex(-1),sampleSeries(RideFile::none),
+                                  isConstant(false),sampleInvariant(false),cachedGeneration(-1),
+                                  effects(true) { }
 
         // evaluate against a RideItem
         Result eval(Context *context, DataFilter *df, Leaf *, float x, RideItem *m, RideFilePoint *p = NULL);
 
+        // evaluate against count samples of the ride from start, into out
+        void evalColumn(Context *context, DataFilter *df, Leaf *, RideItem *m, RideFile *f, int start, int count, double *out);
+
+        // resolve symbols and functions, fold constants etc once
+        // the tree has been validated, so eval doesn't have to
+        void compile(DataFilter *df, Leaf *);
+        void resolve(DataFilter *df);
+
         // tree traversal etc
         void print(Leaf *, int level);  // print leaf and all children
         void color(Leaf *, QTextDocument *);  // update the document to match
@@ -93,6 +105,31 @@ class Leaf {
         RideFile::SeriesType seriesType; // for ridefilecache
         int loc, leng;
         bool inerror;
+
+        // resolved by compile()
+        bool compiled;
+        int fnum;                           // function id
+        int symbol;                         // symbol or config() parameter id
+        int metricIndex;                    // into RideItem::metrics() or -1
+        QString rename;                     // internal name for metric/metadata symbols
+        RideFile::SeriesType sampleSeries;  // for a sample series symbol
+
+        // constant sub expressions are only evaluated once
+        bool isConstant;
+        Result constant;
+
+        // when evaluating sample by sample, anything that doesn't
+        // depend upon the sample is only evaluated once per ride
+        bool sampleInvariant;
+        int cachedGeneration;
+        Result cached;
+
+        // it, or something below it, changes the ride (set/unset) so
+        // must only be evaluated for the samples it is asked for
+        bool effects;
+
+    private:
+        Result evalLeaf(Context *context, DataFilter *df, Leaf *, float x, RideItem *m, RideFilePoint *p);
 };
 
 class DataFilter : public QObject
@@ -115,8 +152,14 @@ class DataFilter : public QObject
         QMap<QString,QString> lookupMap;
         QMap<QString,bool> lookupType; // true if a number, false if a string
 
+        // the ride being evaluated sample by sample and a generation
+        // count that changes with every evaluate, see Leaf::eval
+        RideItem *sampleItem;
+        int generation;
+
         // when used for formulas
         Result evaluate(RideItem *rideItem, RideFilePoint *p = NULL);
+        QVector<double> evaluateSamples(RideItem *rideItem, int start=0, int count=-1); // all samples by default
         QStringList getErrors() { return errors; };
         void colorSyntax(QTextDocument *content, int pos);
 
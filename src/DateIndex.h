@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) 2015 Mark Liversedge (liversedge@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _GC_DateIndex_h
+#define _GC_DateIndex_h 1
+
+#include <QDate>
+#include <QList>
+#include <QVector>
+#include <algorithm>
+
+// Lookups by date for the athlete's history; body measurements and
+// the power, hr and pace zone ranges. These are consulted for every
+// ride on refresh and by the datafilter so we binary search rather
+// than scanning from the start each time.
+
+// A sorted array of julian days, one for each entry in a date ordered
+// list of readings. at() returns the index of the last entry on or
+// before the date, or -1 if there isn't one.
+class DateIndex
+{
+    public:
+        void clear() { days.clear(); }
+        void append(const QDate &date) { days.append(date.toJulianDay()); }
+
+        int at(const QDate &date) const {
+            QVector<qint64>::const_iterator it = std::upper_bound(days.constBegin(), days.constEnd(),
+                                                                  date.toJulianDay());
+            return (it - days.constBegin()) - 1;
+        }
+
+    private:
+        QVector<qint64> days;
+};
+
+// Which of a list of ranges (ZoneRange, HrZoneRange, PaceZoneRange) holds
+// the date, or -1 if none do. A null begin or end is open ended.
+//
+// Ranges are kept sorted by begin date and normally run end to end, so
+// we binary search for the last one beginning on or before the date and
+// work back from there to the first that holds it. Where ranges overlap
+// that is the one that began most recently, i.e. the latest setting, and
+// not the earliest as a scan from the start would find. If the list isn't
+// sorted, e.g. whilst the user is editing it, and that finds nothing we
+// fall back to a scan from the start.
+template <class T>
+static inline bool dateInRange(const T &range, const QDate &date)
+{
+    return ((date >= range.begin) || (range.begin.isNull())) &&
+           ((date < range.end) || (range.end.isNull()));
+}
+
+template <class T>
+int whichDateRange(const QList<T> &ranges, const QDate &date)
+{
+    // last range that begins on or before date
+    int lo = 0, hi = ranges.size();
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        const T &range = ranges.at(mid);
+        if (range.begin.isNull() || range.begin <= date) lo = mid + 1;
+        else hi = mid;
+    }
+
+    // the most recent that holds it, usually the first we look at
+    for (int rnum = lo - 1; rnum >= 0; --rnum)
+        if (dateInRange(ranges.at(rnum), date)) return rnum;
+
+    // out of order or just not there
+    for (int rnum = 0; rnum < ranges.size(); ++rnum)
+        if (dateInRange(ranges.at(rnum), date)) return rnum;
+
+    return -1;
+}
+
+#endif // _GC_DateIndex_h
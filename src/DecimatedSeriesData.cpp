@@ -0,0 +1,251 @@
+/*
+ * Copyright (c) 2015 Mark Liversedge (liversedge@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "DecimatedSeriesData.h"
+
+#include <QtAlgorithms>
+
+// the lowest and highest of the group of points from i, in the order they came
+static void
+bucket(const QVector<QPointF> &in, int i, int group, QPointF &first, QPointF &second)
+{
+    int lo = i, hi = i;
+    int end = qMin(i + group, in.count());
+    for (int j=i+1; j<end; j++) {
+        if (in.at(j).y() < in.at(lo).y()) lo = j;
+        if (in.at(j).y() > in.at(hi).y()) hi = j;
+    }
+    first = in.at(qMin(lo, hi));
+    second = in.at(qMax(lo, hi));
+}
+
+// and of each group of points
+static QVector<QPointF>
+decimate(const QVector<QPointF> &in, int group)
+{
+    QVector<QPointF> out;
+    out.reserve(2 * ((in.count() + group - 1) / group));
+
+    for (int i=0; i<in.count(); i += group) {
+        QPointF first, second;
+        bucket(in, i, group, first, second);
+        out << first << second;
+    }
+    return out;
+}
+
+static bool
+lessX(const QPointF &a, const QPointF &b)
+{
+    return a.x() < b.x();
+}
+
+DecimatedSeriesData::DecimatedSeriesData(const double *x, const double *y, size_t count) : gapped(NULL)
+{
+    points.resize(count);
+    for (size_t i=0; i<count; i++) points[i] = QPointF(x[i], y[i]);
+    build();
+}
+
+DecimatedSeriesData::DecimatedSeriesData(const QVector<QPointF> &points) : points(points), gapped(NULL)
+{
+    build();
+}
+
+void
+DecimatedSeriesData::build()
+{
+    // bounds of all the samples, and check they're in x order
+    ordered = true;
+    double minX=0, maxX=0, minY=0, maxY=0;
+    for (int i=0; i<points.count(); i++) {
+
+        const QPointF &p = points.at(i);
+        if (i == 0) {
+            minX = maxX = p.x();
+            minY = maxY = p.y();
+            continue;
+        }
+        if (p.x() < points.at(i-1).x()) ordered = false;
+        if (p.x() < minX) minX = p.x();
+        if (p.x() > maxX) maxX = p.x();
+        if (p.y() < minY) minY = p.y();
+        if (p.y() > maxY) maxY = p.y();
+    }
+    if (points.count()) bounds = QRectF(minX, minY, maxX - minX, maxY - minY);
+    else bounds = QRectF(1.0, 1.0, -2.0, -2.0); // invalid, like qwt
+
+    // draw everything until we know what's in view
+    view = &points;
+    from = 0;
+    count = points.count();
+    spacing = 1;
+
+    buildLevels();
+}
+
+void
+DecimatedSeriesData::buildLevels()
+{
+    // each level halves the one before until it will fit when
+    // zoomed right out, none at all if it always fits
+    levels.clear();
+    if (!ordered || points.count() <= target) return;
+
+    levels << decimate(points, 4);
+    while (levels.last().count() > target) levels << decimate(levels.last(), 4);
+}
+
+// a sample added to the end only changes the last bucket of each
+// level, so they are updated rather than built again from scratch
+void
+DecimatedSeriesData::append(const QPointF &point)
+{
+    if (points.isEmpty()) {
+        bounds = QRectF(point.x(), point.y(), 0, 0);
+    } else {
+        if (point.x() < points.last().x()) ordered = false;
+
+        double left = qMin(bounds.left(), point.x());
+        double right = qMax(bounds.right(), point.x());
+        double top = qMin(bounds.top(), point.y());
+        double bottom = qMax(bounds.bottom(), point.y());
+        bounds = QRectF(left, top, right - left, bottom - top);
+    }
+    points << point;
+
+    // draw everything until we know what's in view, the
+    // levels move about in memory as they grow
+    view = &points;
+    from = 0;
+    count = points.count();
+    setSpacing(1);
+
+    // just got too big, or went backwards
+    if (!ordered || levels.isEmpty()) {
+        if (!ordered || points.count() > target) buildLevels();
+        return;
+    }
+
+    const QVector<QPointF> *below = &points;
+    for (int k=0; k<levels.count(); k++) {
+
+        int b = (below->count() - 1) / 4;
+        QPointF first, second;
+        bucket(*below, 4 * b, 4, first, second);
+
+        QVector<QPointF> &level = levels[k];
+        if (level.count() == 2 * b) {
+            level << first << second;
+        } else {
+            level[2 * b] = first;
+            level[2 * b + 1] = second;
+        }
+        below = &levels.at(k);
+    }
+
+    // another when zoomed right out no longer fits
+    if (levels.last().count() > target) levels << decimate(levels.last(), 4);
+}
+
+void
+DecimatedSeriesData::setSpacing(int spacing)
+{
+    this->spacing = spacing;
+    if (gapped) gapped->setGapScale(spacing);
+}
+
+void
+DecimatedSeriesData::setRectOfInterest(const QRectF &rect)
+{
+    view = &points;
+    from = 0;
+    count = points.count();
+    setSpacing(1);
+
+    QRectF r = rect.normalized();
+    if (levels.isEmpty() || r.width() <= 0) return;
+
+    // the samples in view, and one either side so the line runs off the edge
+    int first = qLowerBound(points.constBegin(), points.constEnd(), QPointF(r.left(), 0), lessX) - points.constBegin() - 1;
+    int last = qUpperBound(points.constBegin(), points.constEnd(), QPointF(r.right(), 0), lessX) - points.constBegin();
+    first = qMax(0, first);
+    last = qMin(points.count() - 1, last);
+    int visible = last - first + 1;
+
+    // few enough to draw them all
+    if (visible <= target) {
+        from = first;
+        count = visible;
+        return;
+    }
+
+    // coarsest level we need, level k has 2 points for every 4<<k samples
+    int k = 0;
+    while (k < levels.count() - 1 && (visible >> (k + 1)) > target) k++;
+
+    int bucket = 4 << k;
+    view = &levels.at(k);
+    from = 2 * (first / bucket);
+    count = qMin(view->count(), 2 * (last / bucket) + 2) - from;
+    setSpacing(2 * bucket);
+}
+
+void
+DecimatedSeriesData::setSamples(QwtPlotCurve *curve, const double *x, const double *y, size_t count)
+{
+    DecimatedSeriesData *data = new DecimatedSeriesData(x, y, count);
+    data->gapped = dynamic_cast<QwtPlotGappedCurve*>(curve);
+    data->setSpacing(1);
+    curve->setSamples(data);
+}
+
+void
+DecimatedSeriesData::setSamples(QwtPlotCurve *curve, const QVector<QPointF> &points)
+{
+    DecimatedSeriesData *data = new DecimatedSeriesData(points);
+    data->gapped = dynamic_cast<QwtPlotGappedCurve*>(curve);
+    data->setSpacing(1);
+    curve->setSamples(data);
+}
+
+void
+DecimatedSeriesData::append(QwtPlotCurve *curve, double x, double y)
+{
+    DecimatedSeriesData *decimated = dynamic_cast<DecimatedSeriesData*>(curve->data());
+    if (decimated) {
+        decimated->append(QPointF(x, y));
+        curve->itemChanged();
+        return;
+    }
+
+    QVector<QPointF> all = samples(curve);
+    all << QPointF(x, y);
+    setSamples(curve, all);
+}
+
+QVector<QPointF>
+DecimatedSeriesData::samples(const QwtPlotCurve *curve)
+{
+    const DecimatedSeriesData *decimated = dynamic_cast<const DecimatedSeriesData*>(curve->data());
+    if (decimated) return decimated->points;
+
+    QVector<QPointF> array;
+    for (size_t i=0; i<curve->data()->size(); i++) array << curve->data()->sample(i);
+    return array;
+}
@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2015 Mark Liversedge (liversedge@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _GC_DecimatedSeriesData_h
+#define _GC_DecimatedSeriesData_h 1
+#include "GoldenCheetah.h"
+
+#include <QVector>
+#include <QPointF>
+#include <QRectF>
+#include <qwt_series_data.h>
+#include <qwt_plot_curve.h>
+#include "qwt_plot_gapped_curve.h"
+
+// Series data for long curves, such as a ride of many hours at 1s
+// samples, that only hands the curve as many points as it can draw.
+//
+// When the samples are set we build a pyramid of decimated copies,
+// each half the size of the one before, keeping the lowest and highest
+// value in each bucket of samples (in the order they occurred) so peaks
+// and troughs still show however far out we are zoomed.
+//
+// Qwt tells us the range of the x axis before every replot, so we pick
+// the coarsest level that still has a couple of points per pixel for
+// the samples in view and only hand over those; zoom in and the detail
+// comes back until it is drawing the samples themselves.
+//
+// size() and sample() are what is being drawn, if you want the samples
+// themselves (e.g. to copy a curve) use samples().
+//
+// A gapped curve (e.g. power) is told how far apart the points being
+// drawn are each time the level changes, so it doesn't see gaps in the
+// recording where there are none.
+class DecimatedSeriesData : public QwtSeriesData<QPointF>
+{
+    public:
+        // the samples are copied, just like QwtPointArrayData
+        DecimatedSeriesData(const double *x, const double *y, size_t count);
+        DecimatedSeriesData(const QVector<QPointF> &points);
+
+        // what is drawn
+        size_t size() const { return count; }
+        QPointF sample(size_t i) const { return view->at(from + i); }
+
+        // of all the samples
+        QRectF boundingRect() const { return bounds; }
+
+        // choose the level and range to draw
+        void setRectOfInterest(const QRectF &rect);
+
+        // add a sample at the end, e.g. as telemetry arrives
+        void append(const QPointF &point);
+
+        // most samples between one point drawn and the next
+        int spread() const { return spacing; }
+
+        // set a curve's samples to a decimated series, keeping it
+        // up to date with the spread if it is a gapped curve
+        static void setSamples(QwtPlotCurve *curve, const double *x, const double *y, size_t count);
+        static void setSamples(QwtPlotCurve *curve, const QVector<QPointF> &points);
+
+        // add a sample to the end of a curve's decimated series
+        static void append(QwtPlotCurve *curve, double x, double y);
+
+        // all of a curve's samples, whatever is being drawn
+        static QVector<QPointF> samples(const QwtPlotCurve *curve);
+
+    private:
+        void build();
+        void buildLevels();
+        void setSpacing(int spacing);
+
+        static const int target = 4096; // points in view, 2 a pixel on a big screen
+
+        QVector<QPointF> points;            // the samples
+        QVector< QVector<QPointF> > levels; // levels[k] is the min and max of each 4<<k samples
+        bool ordered;                       // x never goes backwards, or we can't decimate
+        QRectF bounds;
+
+        // being drawn
+        const QVector<QPointF> *view;
+        int from, count, spacing;
+
+        QwtPlotGappedCurve *gapped; // the curve we belong to, if it is one
+};
+
+#endif // _GC_DecimatedSeriesData_h
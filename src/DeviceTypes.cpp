@@ -72,6 +72,10 @@ DeviceTypes::DeviceTypes()
         tr("Testing device used for development only. If an ERG file is selected it will "
         "replay back, with a little randomness thrown in."),
         "" },
+      { DEV_SIMULATOR, DEV_TCP,    (char *) "Simulator", false,   false,
+        tr("Testing device used for development only. Replays the sensor readings from a ride "
+        "(the port) at a number of readings a second (the profile, 4 by default)."),
+        "" },
 #endif
       { 0, 0, NULL, 0, 0, "", "" }
     };
@@ -22,6 +22,8 @@
 #include <stdint.h>
 #include "Units.h"
 
+#include <QtAlgorithms>
+
 // Supported file types
 static QStringList supported;
 static bool setSupported()
@@ -44,16 +46,18 @@ bool ErgFile::isWorkout(QString name)
 ErgFile::ErgFile(QString filename, int &mode, Context *context) : 
     filename(filename), context(context), mode(mode)
 {
-    if (context->athlete->zones()) {
+    if (context && context->athlete->zones()) {
         int zonerange = context->athlete->zones()->whichRange(QDateTime::currentDateTime().date());
         if (zonerange >= 0) CP = context->athlete->zones()->getCP(zonerange);
+    } else {
+        CP = 300; // no athlete when run headless
     }
     reload();
 }
 
 ErgFile::ErgFile(Context *context) : context(context), mode(nomode)
 {
-    if (context->athlete->zones()) {
+    if (context && context->athlete->zones()) {
         int zonerange = context->athlete->zones()->whichRange(QDateTime::currentDateTime().date());
         if (zonerange >= 0) CP = context->athlete->zones()->getCP(zonerange);
     } else {
@@ -90,7 +94,6 @@ void ErgFile::parseTacx()
     Ftp = 0;            // FTP this file was targetted at
     MaxWatts = 0;       // maxWatts in this ergfile (scaling)
     valid = false;             // did it parse ok?
-    rightPoint = leftPoint = 0;
     format = CRS; // default to couse until we know
     Points.clear();
     Laps.clear();
@@ -251,8 +254,6 @@ void ErgFile::parseTacx()
 
         // set ErgFile duration
         Duration = Points.last().x;      // last is the end point in msecs
-        leftPoint = 0;
-        rightPoint = 1;
 
         // calculate climbing etc
         calculateMetrics();
@@ -263,7 +264,6 @@ void ErgFile::parseComputrainer(QString p)
 {
     QFile ergFile(filename);
     int section = NOMANSLAND;            // section 0=init, 1=header data, 2=course data
-    leftPoint=rightPoint=0;
     MaxWatts = Ftp = 0;
     int lapcounter = 0;
     format = ERG;                         // either ERG or MRC
@@ -490,9 +490,6 @@ void ErgFile::parseComputrainer(QString p)
         // set ErgFile duration
         Duration = Points.last().x;      // last is the end point in msecs
 
-        leftPoint = 0;
-        rightPoint = 1;
-
         calculateMetrics();
 
     } else {
@@ -522,49 +519,28 @@ ErgFile::wattsAt(long x, int &lapnum)
     if (x < 0 || x > Duration) return -100;   // out of bounds!!!
 
     // do we need to return the Lap marker?
-    if (Laps.count() > 0) {
-        int lap=0;
-        for (int i=0; i<Laps.count(); i++) {
-            if (x>=Laps.at(i).x) lap += 1;
-        }
-        lapnum = lap;
-
-    } else lapnum = 0;
+    lapnum = lapAt(x);
 
     // find right section of the file
-    while (x < Points.at(leftPoint).x || x > Points.at(rightPoint).x) {
-        if (x < Points.at(leftPoint).x) {
-            leftPoint--;
-            rightPoint--;
-        } else if (x > Points.at(rightPoint).x) {
-            leftPoint++;
-            rightPoint++;
-        }
-    }
+    int i = segmentAt(x);
+    const ErgFilePoint &left = Points.at(i);
+    if (i+1 == Points.count()) return left.val;
+    const ErgFilePoint &right = Points.at(i+1);
 
     // two different points in time but the same watts
     // at both, it doesn't really matter which value
     // we use
-    if (Points.at(leftPoint).val == Points.at(rightPoint).val)
-        return Points.at(rightPoint).val;
+    if (left.val == right.val) return right.val;
 
     // the erg file will list the point in time twice
     // to show a jump from one wattage to another
     // at this point in ime (i.e x=100 watts=100 followed
     // by x=100 watts=200)
-    if (Points.at(leftPoint).x == Points.at(rightPoint).x)
-        return Points.at(rightPoint).val;
+    if (left.x == right.x) return right.val;
 
     // so this point in time between two points and
     // we are ramping from one point and another
-    // the steps in the calculation have been explicitly
-    // listed for code clarity
-    double deltaW = Points.at(rightPoint).val - Points.at(leftPoint).val;
-    double deltaT = Points.at(rightPoint).x - Points.at(leftPoint).x;
-    double offT = x - Points.at(leftPoint).x;
-    double factor = offT / deltaT;
-
-    double nowW = Points.at(leftPoint).val + (deltaW * factor);
+    double nowW = left.val + (pointRate.at(i) * (x - left.x));
 
     return nowW;
 }
@@ -580,26 +556,10 @@ ErgFile::gradientAt(long x, int &lapnum)
     if (x < 0 || x > Duration) return -100;   // out of bounds!!! (-10 through +15 are valid return vals)
 
     // do we need to return the Lap marker?
-    if (Laps.count() > 0) {
-        int lap=0;
-        for (int i=0; i<Laps.count(); i++) {
-            if (x>=Laps.at(i).x) lap += 1;
-        }
-        lapnum = lap;
-
-    } else lapnum = 0;
+    lapnum = lapAt(x);
 
     // find right section of the file
-    while (x < Points.at(leftPoint).x || x > Points.at(rightPoint).x) {
-        if (x < Points.at(leftPoint).x) {
-            leftPoint--;
-            rightPoint--;
-        } else if (x > Points.at(rightPoint).x) {
-            leftPoint++;
-            rightPoint++;
-        }
-    }
-    return Points.at(leftPoint).val;
+    return Points.at(segmentAt(x)).val;
 }
 
 int ErgFile::nextLap(long x)
@@ -607,14 +567,50 @@ int ErgFile::nextLap(long x)
     if (!isValid()) return -1; // not a valid ergfile
 
     // do we need to return the Lap marker?
-    if (Laps.count() > 0) {
-        for (int i=0; i<Laps.count(); i++) {
-            if (x<Laps.at(i).x) return Laps.at(i).x;
-        }
-    }
+    QVector<long>::const_iterator next = qUpperBound(lapX.constBegin(), lapX.constEnd(), x);
+    if (next != lapX.constEnd()) return *next;
+
     return -1; // nope, no marker ahead of there
 }
 
+void
+ErgFile::buildIndex()
+{
+    // the x of each point in one place to binary search, and
+    // how fast the value changes from each point to the next
+    pointX.resize(Points.count());
+    pointRate.fill(0, Points.count());
+    for (int i=0; i<Points.count(); i++) {
+        pointX[i] = Points.at(i).x;
+        if (i && Points.at(i).x != Points.at(i-1).x)
+            pointRate[i-1] = (Points.at(i).val - Points.at(i-1).val) / (Points.at(i).x - Points.at(i-1).x);
+    }
+
+    // lap markers in order
+    lapX.clear();
+    foreach(ErgFileLap lap, Laps) lapX << lap.x;
+    qSort(lapX);
+}
+
+int
+ErgFile::segmentAt(double x) const
+{
+    // the first point at or after x ends the section we are in
+    // when x is exactly on a point we stay in the section before
+    // it, and a step listed twice is taken once we are past it
+    int i = qLowerBound(pointX.constBegin(), pointX.constEnd(), x) - pointX.constBegin();
+    if (i > pointX.count() - 1) i = pointX.count() - 1;
+    if (i > 0) i--;
+    return i;
+}
+
+int
+ErgFile::lapAt(double x) const
+{
+    // how many lap markers are at or before x
+    return qUpperBound(lapX.constBegin(), lapX.constEnd(), long(x)) - lapX.constBegin();
+}
+
 void
 ErgFile::calculateMetrics()
 {
@@ -623,7 +619,10 @@ ErgFile::calculateMetrics()
     XP = CP = AP = NP = IF = RI = TSS = BS = SVI = VI = 0;
     ELE = ELEDIST = GRADE = 0;
 
-    maxY = 0; // we need to reset it
+    maxY = minY = 0; // we need to reset it
+
+    // points may have moved, so look them up afresh
+    buildIndex();
 
     // is it valid?
     if (!isValid()) return;
@@ -636,6 +635,7 @@ ErgFile::calculateMetrics()
 
             // set the maximum Y value
             if (p.y > maxY) maxY= p.y;
+            if (p.y < minY) minY= p.y;
 
             if (first == true) {
                 first = false;
@@ -680,6 +680,7 @@ ErgFile::calculateMetrics()
 
             // set the maximum Y value
             if (p.y > maxY) maxY= p.y;
+            if (p.y < minY) minY= p.y;
 
             while (nextSecs < p.x) {
 
@@ -720,7 +721,7 @@ ErgFile::calculateMetrics()
         AP = apsum / count;
 
         // CP
-        if (context->athlete->zones()) {
+        if (context && context->athlete->zones()) {
             int zonerange = context->athlete->zones()->whichRange(QDateTime::currentDateTime().date());
             if (zonerange >= 0) CP = context->athlete->zones()->getCP(zonerange);
         }
@@ -97,15 +97,13 @@ class ErgFile
         bool valid;             // did it parse ok?
 
 
-        int leftPoint, rightPoint;            // current points we are between
-
         QList<ErgFilePoint> Points;    // points in workout
         QList<ErgFileLap>   Laps;      // interval markers in the file
 
-        void calculateMetrics(); // calculate NP value for ErgFile
+        void calculateMetrics(); // calculate NP value for ErgFile, call when the points change
 
         // Metrics for this workout
-        double maxY;                // maximum Y value
+        double maxY, minY;          // maximum and minimum Y value
         double CP;
         double AP, NP, IF, TSS, VI; // Coggan for erg / mrc
         double XP, RI, BS, SVI; // Skiba for erg / mrc
@@ -116,6 +114,17 @@ class ErgFile
     private:
         int &mode;
         int nomode;
+
+        // lookups by time or distance are a binary search rather than a
+        // walk through the points, so seeking a long course is quick and
+        // any thread can ask without disturbing where another one was
+        void buildIndex();              // from the points and laps
+        int segmentAt(double x) const;  // section of the workout x is in, from Points[i] to Points[i+1]
+        int lapAt(double x) const;      // lap markers at or before x
+
+        QVector<double> pointX;         // x of each point
+        QVector<double> pointRate;      // change in val per unit of x to the next point
+        QVector<long> lapX;             // lap markers in order
 };
 
 #endif
@@ -20,6 +20,7 @@
 #include "ErgFilePlot.h"
 #include "WPrime.h"
 #include "Context.h"
+#include "DecimatedSeriesData.h"
 
 // Bridge between QwtPlot and ErgFile to avoid having to
 // create a separate array for the ergfile data, we plot
@@ -46,15 +47,15 @@ QPointF ErgFileData::sample(size_t i) const
 
 QRectF ErgFileData::boundingRect() const
 {
-    if (context->currentErgFile()) {
+    ErgFile *ergFile = context->currentErgFile();
+    if (ergFile) {
+        // points are in x order and y extremes are kept by the
+        // ergfile, so no need to look through them every replot
         double minX, minY, maxX, maxY;
-        minX=minY=maxX=maxY=0.0f;
-        foreach(ErgFilePoint x, context->currentErgFile()->Points) {
-            if (x.y > maxY) maxY = x.y;
-            if (x.x > maxX) maxX = x.x;
-            if (x.y < minY) minY = x.y;
-            if (x.x < minX) minX = x.x;
-        }
+        minX = 0.0f;
+        maxX = ergFile->Points.count() ? qMax(0.0, ergFile->Points.last().x) : 0.0f;
+        minY = ergFile->minY;
+        maxY = ergFile->maxY;
         maxY *= 1.3f; // always need a bit of headroom
         return QRectF(minX, minY, maxX, maxY);
     }
@@ -180,7 +181,7 @@ ErgFilePlot::ErgFilePlot(Context *context) : context(context)
     QPen wbalPenA = QPen(GColor(CWBAL), 1.0); // actual lighter
     wbalCurve->setPen(wbalPenA);
     wbalData = new CurveData;
-    wbalCurve->setSamples(wbalData->x(), wbalData->y(), wbalData->count());
+    DecimatedSeriesData::setSamples(wbalCurve, wbalData->x(), wbalData->y(), wbalData->count());
 
     sd = new QwtScaleDraw;
     sd->enableComponent(QwtScaleDraw::Ticks, false);
@@ -204,7 +205,7 @@ ErgFilePlot::ErgFilePlot(Context *context) : context(context)
     wattsCurve->setYAxis(QwtPlot::yLeft);
     // dgr wattsCurve->setPaintAttribute(QwtPlotCurve::PaintFiltered);
     wattsData = new CurveData;
-    wattsCurve->setSamples(wattsData->x(), wattsData->y(), wattsData->count());
+    DecimatedSeriesData::setSamples(wattsCurve, wattsData->x(), wattsData->y(), wattsData->count());
 
     // telemetry history
     hrCurve = new QwtPlotCurve("Heartrate");
@@ -213,7 +214,7 @@ ErgFilePlot::ErgFilePlot(Context *context) : context(context)
     hrCurve->attach(this);
     hrCurve->setYAxis(QwtPlot::yRight);
     hrData = new CurveData;
-    hrCurve->setSamples(hrData->x(), hrData->y(), hrData->count());
+    DecimatedSeriesData::setSamples(hrCurve, hrData->x(), hrData->y(), hrData->count());
 
     // telemetry history
     cadCurve = new QwtPlotCurve("Cadence");
@@ -222,7 +223,7 @@ ErgFilePlot::ErgFilePlot(Context *context) : context(context)
     cadCurve->attach(this);
     cadCurve->setYAxis(QwtPlot::yRight);
     cadData = new CurveData;
-    cadCurve->setSamples(cadData->x(), cadData->y(), cadData->count());
+    DecimatedSeriesData::setSamples(cadCurve, cadData->x(), cadData->y(), cadData->count());
 
     // telemetry history
     speedCurve = new QwtPlotCurve("Speed");
@@ -231,7 +232,7 @@ ErgFilePlot::ErgFilePlot(Context *context) : context(context)
     speedCurve->attach(this);
     speedCurve->setYAxis(QwtAxisId(QwtAxis::yRight,2).id);
     speedData = new CurveData;
-    speedCurve->setSamples(speedData->x(), speedData->y(), speedData->count());
+    DecimatedSeriesData::setSamples(speedCurve, speedData->x(), speedData->y(), speedData->count());
 
     // Now data bridge
     nowData = new NowData(context);
@@ -457,6 +458,20 @@ ErgFilePlot::setNow(long /*msecs*/)
     replot(); // and update
 }
 
+// add to the history and its curve, the first point is at 0 too
+static void
+addPoint(CurveData *data, QwtPlotCurve *curve, double x, double y)
+{
+    double zero = 0;
+
+    if (!data->count()) {
+        data->append(&zero, &y, 1);
+        DecimatedSeriesData::append(curve, zero, y);
+    }
+    data->append(&x, &y, 1);
+    DecimatedSeriesData::append(curve, x, y);
+}
+
 void
 ErgFilePlot::performancePlot(RealtimeData rtdata)
 {
@@ -497,27 +512,13 @@ ErgFilePlot::performancePlot(RealtimeData rtdata)
         wbalsum = wattssum = hrsum = cadsum = speedsum = 0;
     }
 
-    double zero = 0;
-
-    if (!wattsData->count()) wattsData->append(&zero, &watts, 1);
-    wattsData->append(&x, &watts, 1);
-    wattsCurve->setSamples(wattsData->x(), wattsData->y(), wattsData->count());
-
-    if (!hrData->count()) hrData->append(&zero, &hr, 1);
-    hrData->append(&x, &hr, 1);
-    hrCurve->setSamples(hrData->x(), hrData->y(), hrData->count());
-
-    if (!speedData->count()) speedData->append(&zero, &speed, 1);
-    speedData->append(&x, &speed, 1);
-    speedCurve->setSamples(speedData->x(), speedData->y(), speedData->count());
-
-    if (!cadData->count()) cadData->append(&zero, &cad, 1);
-    cadData->append(&x, &cad, 1);
-    cadCurve->setSamples(cadData->x(), cadData->y(), cadData->count());
-
-    if (!wbalData->count()) wbalData->append(&zero, &wbal, 1);
-    wbalData->append(&x, &wbal, 1);
-    wbalCurve->setSamples(wbalData->x(), wbalData->y(), wbalData->count());
+    // only the newest point is added to each curve, the
+    // decimated series just updates its last buckets
+    addPoint(wattsData, wattsCurve, x, watts);
+    addPoint(hrData, hrCurve, x, hr);
+    addPoint(speedData, speedCurve, x, speed);
+    addPoint(cadData, cadCurve, x, cad);
+    addPoint(wbalData, wbalCurve, x, wbal);
 }
 
 void
@@ -539,15 +540,15 @@ ErgFilePlot::reset()
     // instead when we place the first points on the plots we add them twice
     // once for time/distance of 0 and once for the current point in time
     wattsData->clear();
-    wattsCurve->setSamples(wattsData->x(), wattsData->y(), wattsData->count());
+    DecimatedSeriesData::setSamples(wattsCurve, wattsData->x(), wattsData->y(), wattsData->count());
     wbalData->clear();
-    wbalCurve->setSamples(wbalData->x(), wbalData->y(), wbalData->count());
+    DecimatedSeriesData::setSamples(wbalCurve, wbalData->x(), wbalData->y(), wbalData->count());
     wbalData->clear();
-    cadCurve->setSamples(cadData->x(), cadData->y(), cadData->count());
+    DecimatedSeriesData::setSamples(cadCurve, cadData->x(), cadData->y(), cadData->count());
     hrData->clear();
-    hrCurve->setSamples(hrData->x(), hrData->y(), hrData->count());
+    DecimatedSeriesData::setSamples(hrCurve, hrData->x(), hrData->y(), hrData->count());
     speedData->clear();
-    speedCurve->setSamples(speedData->x(), speedData->y(), speedData->count());
+    DecimatedSeriesData::setSamples(speedCurve, speedData->x(), speedData->y(), speedData->count());
 }
 
 // curve data.. code snaffled in from the Qwt example (realtime_plot)
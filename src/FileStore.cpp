@@ -29,6 +29,7 @@
 #include <QFileIconProvider>
 #include <QMessageBox>
 #include <QHeaderView>
+#include <QBuffer>
 
 #include "../qzip/zipwriter.h"
 #include "../qzip/zipreader.h"
@@ -75,36 +76,15 @@ FileStore::upload(QWidget *parent, FileStore *store, RideItem *item)
 void
 FileStore::compressRide(RideFile*ride, QByteArray &data, QString name)
 {
-    // compress via a temporary file
-    QTemporaryFile tempfile;
-    tempfile.open();
-    tempfile.close();
-
-    // write as json
-    QFile jsonFile(tempfile.fileName());
-    if (RideFileFactory::instance().writeRideFile(NULL, ride, jsonFile, "json") == true) {
-
-        // create a temp zip file
-        QTemporaryFile zipFile;
-        zipFile.open();
-        zipFile.close();
-
-        // add files using zip writer
-        QString zipname = zipFile.fileName();
-        ZipWriter writer(zipname);
-
-        // read the ride file back and add to zip file
-        jsonFile.open(QFile::ReadOnly);
-        writer.addFile(name, jsonFile.readAll());
-        jsonFile.close();
-        writer.close();
-
-        // now read in the zipfile
-        QFile zip(zipname);
-        zip.open(QFile::ReadOnly);
-        data = zip.readAll();
-        zip.close();
-    }
+    // serialize as json and zip it up, all in memory
+    JsonFileReader reader;
+    QByteArray json = reader.toByteArray(context, ride);
+
+    QBuffer buffer(&data);
+    buffer.open(QIODevice::WriteOnly);
+    ZipWriter writer(&buffer);
+    writer.addFile(name, json);
+    writer.close(); // closes the buffer too
 }
 
 // name is the source name (i.e. what it is called on the file store (xxxxx.json.zip)
@@ -117,32 +97,21 @@ FileStore::uncompressRide(QByteArray *data, QString name, QStringList &errors)
         return NULL;
     }
 
-    // write out to a zip file first
-    QTemporaryFile zipfile;
-    zipfile.open();
-    zipfile.write(*data);
-    zipfile.close();
-
-    // open zip
-    ZipReader reader(zipfile.fileName());
+    // unzip it in memory
+    QBuffer buffer(data);
+    buffer.open(QIODevice::ReadOnly);
+    ZipReader reader(&buffer);
     ZipReader::FileInfo info = reader.entryInfoAt(0);
     QByteArray jsonData = reader.fileData(info.filePath);
+    reader.close();
 
-    // uncompress and write to tmp without the .zip
+    // parse it, then setup as if it was read from tmp without the .zip
     name = name.mid(0, name.length()-4);
     QString tmp = context->athlete->home->temp().absolutePath() + "/" + QFileInfo(name).baseName() + "." + QFileInfo(name).suffix();
-    
-    // uncompress and write a file
-    QFile file(tmp);
-    file.open(QFile::WriteOnly);
-    file.write(jsonData);
-    file.close();
-
-    // read the file in using the correct ridefile reader
-    RideFile *ride = RideFileFactory::instance().openRideFile(context, file, errors);
-
-    // remove temp
-    file.remove();
+
+    JsonFileReader json;
+    RideFile *ride = json.fromByteArray(jsonData, errors);
+    if (ride) RideFileFactory::instance().setupRideFile(context, ride, tmp);
 
     // return whatever we got
     return ride;
@@ -26,6 +26,7 @@
 #include <QDebug>
 #include <QTime>
 #include <stdio.h>
+#include <string.h>
 #include <stdint.h>
 #include <time.h>
 #include <limits>
@@ -50,6 +51,7 @@ struct FitField {
 struct FitDefinition {
     int global_msg_num;
     bool is_big_endian;
+    int size; // of the data record, so we only check for truncation once
     std::vector<FitField> fields;
 };
 
@@ -99,152 +101,120 @@ struct FitFileReaderState
     FitFileReaderState(QFile &file, QStringList &errors) :
         file(file), errors(errors), rideFile(NULL), start_time(0),
         last_time(0), last_distance(0.00f), interval(0), calibration(0), devices(0), stopped(true), isLapSwim(false), pool_length(0.0),
-        last_event_type(-1), last_event(-1), last_msg_type(-1)
+        last_event_type(-1), last_event(-1), last_msg_type(-1), buf(NULL), pos(0), bufLen(0)
     {
     }
 
     struct TruncatedRead {};
 
-    void read_unknown( int size, int *count = NULL ){
-        char c[size+1];
+    // the whole file is read into memory and decoded from there,
+    // reading a few bytes at a time from the QFile is very slow
+    QByteArray data;
+    const uchar *buf;
+    int pos, bufLen;
 
-        if (file.read(c, size ) != size)
+    // the next n bytes, or throw if there aren't enough
+    const uchar *take(int n, int *count) {
+        if (n < 0 || pos + n > bufLen)
             throw TruncatedRead();
+        const uchar *p = buf + pos;
+        pos += n;
         if (count)
-            (*count) += size;
+            (*count) += n;
+        return p;
+    }
+
+    // check the next n bytes are there before reading them
+    void need(int n) {
+        if (n < 0 || pos + n > bufLen)
+            throw TruncatedRead();
+    }
+
+    void read_unknown( int size, int *count = NULL ){
+        take(size, count);
     }
 
     fit_string_value read_text(int len, int *count = NULL)
     {
-        char c;
-        fit_string_value res = "";
-        for (int i = 0; i < len; ++i) {
-            if (file.read(&c, 1) != 1)
-                throw TruncatedRead();
-            if (count)
-                *count += 1;
-
-            if (c != 0)
-                res += c;
-        }
+        const uchar *p = take(len, count);
+        fit_string_value res;
+        res.reserve(len);
+        for (int i = 0; i < len; ++i)
+            if (p[i] != 0)
+                res += char(p[i]);
         return res;
     }
 
     fit_value_t read_int8(int *count = NULL) {
-        qint8 i;
-        if (file.read(reinterpret_cast<char*>( &i), 1) != 1)
-            throw TruncatedRead();
-        if (count)
-            (*count) += 1;
-
+        qint8 i = qint8(*take(1, count));
         return i == 0x7f ? NA_VALUE : i;
     }
 
     fit_value_t read_uint8(int *count = NULL) {
-        quint8 i;
-        if (file.read(reinterpret_cast<char*>( &i), 1) != 1)
-            throw TruncatedRead();
-        if (count)
-            (*count) += 1;
-
+        quint8 i = *take(1, count);
         return i == 0xff ? NA_VALUE : i;
     }
 
     fit_value_t read_uint8z(int *count = NULL) {
-        quint8 i;
-        if (file.read(reinterpret_cast<char*>( &i), 1) != 1)
-            throw TruncatedRead();
-        if (count)
-            (*count) += 1;
-
+        quint8 i = *take(1, count);
         return i == 0x00 ? NA_VALUE : i;
     }
 
     fit_value_t read_int16(bool is_big_endian, int *count = NULL) {
-        qint16 i;
-        if (file.read(reinterpret_cast<char*>(&i), 2) != 2)
-            throw TruncatedRead();
-        if (count)
-            (*count) += 2;
-
-        i = is_big_endian
-            ? qFromBigEndian<qint16>( i )
-            : qFromLittleEndian<qint16>( i );
+        const uchar *p = take(2, count);
+        qint16 i = is_big_endian
+            ? qFromBigEndian<qint16>( p )
+            : qFromLittleEndian<qint16>( p );
 
         return i == 0x7fff ? NA_VALUE : i;
     }
 
     fit_value_t read_uint16(bool is_big_endian, int *count = NULL) {
-        quint16 i;
-        if (file.read(reinterpret_cast<char*>(&i), 2) != 2)
-            throw TruncatedRead();
-        if (count)
-            (*count) += 2;
-
-        i = is_big_endian
-            ? qFromBigEndian<quint16>( i )
-            : qFromLittleEndian<quint16>( i );
+        const uchar *p = take(2, count);
+        quint16 i = is_big_endian
+            ? qFromBigEndian<quint16>( p )
+            : qFromLittleEndian<quint16>( p );
 
         return i == 0xffff ? NA_VALUE : i;
     }
 
     fit_value_t read_uint16z(bool is_big_endian, int *count = NULL) {
-        quint16 i;
-        if (file.read(reinterpret_cast<char*>(&i), 2) != 2)
-            throw TruncatedRead();
-        if (count)
-            (*count) += 2;
-
-        i = is_big_endian
-            ? qFromBigEndian<quint16>( i )
-            : qFromLittleEndian<quint16>( i );
+        const uchar *p = take(2, count);
+        quint16 i = is_big_endian
+            ? qFromBigEndian<quint16>( p )
+            : qFromLittleEndian<quint16>( p );
 
         return i == 0x0000 ? NA_VALUE : i;
     }
 
     fit_value_t read_int32(bool is_big_endian, int *count = NULL) {
-        qint32 i;
-        if (file.read(reinterpret_cast<char*>(&i), 4) != 4)
-            throw TruncatedRead();
-        if (count)
-            (*count) += 4;
-
-        i = is_big_endian
-            ? qFromBigEndian<qint32>( i )
-            : qFromLittleEndian<qint32>( i );
+        const uchar *p = take(4, count);
+        qint32 i = is_big_endian
+            ? qFromBigEndian<qint32>( p )
+            : qFromLittleEndian<qint32>( p );
 
         return i == 0x7fffffff ? NA_VALUE : i;
     }
 
     fit_value_t read_uint32(bool is_big_endian, int *count = NULL) {
-        quint32 i;
-        if (file.read(reinterpret_cast<char*>(&i), 4) != 4)
-            throw TruncatedRead();
-        if (count)
-            (*count) += 4;
-
-        i = is_big_endian
-            ? qFromBigEndian<quint32>( i )
-            : qFromLittleEndian<quint32>( i );
+        const uchar *p = take(4, count);
+        quint32 i = is_big_endian
+            ? qFromBigEndian<quint32>( p )
+            : qFromLittleEndian<quint32>( p );
 
         return i == 0xffffffff ? NA_VALUE : i;
     }
 
     fit_value_t read_uint32z(bool is_big_endian, int *count = NULL) {
-        quint32 i;
-        if (file.read(reinterpret_cast<char*>(&i), 4) != 4)
-            throw TruncatedRead();
-        if (count)
-            (*count) += 4;
-
-        i = is_big_endian
-            ? qFromBigEndian<quint32>( i )
-            : qFromLittleEndian<quint32>( i );
+        const uchar *p = take(4, count);
+        quint32 i = is_big_endian
+            ? qFromBigEndian<quint32>( p )
+            : qFromLittleEndian<quint32>( p );
 
         return i == 0x00000000 ? NA_VALUE : i;
     }
 
-    void decodeFileId(const FitDefinition &def, int, const std::vector<FitValue> values) {
+    void decodeFileId(const FitDefinition &def, int, const std::vector<FitValue> &values) {
         int i = 0;
         int manu = -1, prod = -1;
         foreach(const FitField &field, def.fields) {
@@ -342,7 +312,7 @@ struct FitFileReaderState
         rideFile->setFileFormat("FIT (*.fit)");
     }
 
-    void decodeSession(const FitDefinition &def, int, const std::vector<FitValue> values) {
+    void decodeSession(const FitDefinition &def, int, const std::vector<FitValue> &values) {
         int i = 0;
         foreach(const FitField &field, def.fields) {
             fit_value_t value = values[i++].v;
@@ -380,7 +350,7 @@ struct FitFileReaderState
         }
     }
 
-    void decodeDeviceInfo(const FitDefinition &def, int, const std::vector<FitValue> values) {
+    void decodeDeviceInfo(const FitDefinition &def, int, const std::vector<FitValue> &values) {
         int i = 0;
         foreach(const FitField &field, def.fields) {
             fit_value_t value = values[i++].v;
@@ -394,7 +364,7 @@ struct FitFileReaderState
         }
     }
 
-    void decodeEvent(const FitDefinition &def, int, const std::vector<FitValue> values) {
+    void decodeEvent(const FitDefinition &def, int, const std::vector<FitValue> &values) {
         int time = -1;
         int event = -1;
         int event_type = -1;
@@ -467,7 +437,7 @@ struct FitFileReaderState
         last_event_type = event_type;
     }
 
-    void decodeLap(const FitDefinition &def, int time_offset, const std::vector<FitValue> values) {
+    void decodeLap(const FitDefinition &def, int time_offset, const std::vector<FitValue> &values) {
         time_t time = 0;
         if (time_offset > 0)
             time = last_time + time_offset;
@@ -511,7 +481,7 @@ struct FitFileReaderState
         }
     }
 
-    void decodeRecord(const FitDefinition &def, int time_offset, const std::vector<FitValue> values) {
+    void decodeRecord(const FitDefinition &def, int time_offset, const std::vector<FitValue> &values) {
         if (isLapSwim) return; // We use the length message for Lap Swimming
         time_t time = 0;
         if (time_offset > 0)
@@ -810,7 +780,7 @@ struct FitFileReaderState
         last_distance = km;
     }
 
-    void decodeLength(const FitDefinition &def, int time_offset, const std::vector<FitValue> values) {
+    void decodeLength(const FitDefinition &def, int time_offset, const std::vector<FitValue> &values) {
         if (!isLapSwim) {
             isLapSwim = true;
             // reset rideFile if not empty
@@ -981,6 +951,8 @@ struct FitFileReaderState
             def.is_big_endian = read_uint8(&count);
             def.global_msg_num = read_uint16(def.is_big_endian, &count);
             int num_fields = read_uint8(&count);
+            def.size = 0;
+            def.fields.reserve(num_fields);
 
             if (FIT_DEBUG)  {
                 printf("definition: local type=%d global=%d arch=%d fields=%d\n",
@@ -996,6 +968,7 @@ struct FitFileReaderState
                 field.size = read_uint8(&count);
                 int base_type = read_uint8(&count);
                 field.type = base_type & 0x1f;
+                def.size += field.size;
 
                 if (FIT_DEBUG)  {
                     printf("  field %d: %d bytes, num %d, type %d, size %d\n",
@@ -1028,7 +1001,11 @@ struct FitFileReaderState
                     def.global_msg_num );
             }
 
+            // the whole record must be there before we decode it
+            need(def.size);
+
             std::vector<FitValue> values;
+            values.reserve(def.fields.size());
             foreach(const FitField &field, def.fields) {
                 FitValue value;
                 int size;
@@ -1156,6 +1133,10 @@ struct FitFileReaderState
             delete rideFile;
             return NULL;
         }
+        data = file.readAll();
+        buf = reinterpret_cast<const uchar *>(data.constData());
+        pos = 0;
+        bufLen = data.size();
 
         int data_size = 0;
         try {
@@ -1178,12 +1159,13 @@ struct FitFileReaderState
 
             data_size = read_uint32(false); // always littleEndian
             char fit_str[5];
-            if (file.read(fit_str, 4) != 4) {
+            if (pos + 4 > bufLen) {
                 errors << "truncated header";
                 file.close();
                 delete rideFile;
                 return NULL;
             }
+            memcpy(fit_str, take(4, NULL), 4);
             fit_str[4] = '\0';
             if (strcmp(fit_str, ".FIT") != 0) {
                 errors << QString("bad header, expected \".FIT\" but got \"%1\"").arg(fit_str);
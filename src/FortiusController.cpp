@@ -68,7 +68,7 @@ bool FortiusController::doesPull() { return true; }
 bool FortiusController::doesLoad() { return true; }
 
 /*
- * gets called from the GUI to get updated telemetry.
+ * gets called from the train engine thread to get updated telemetry.
  * so whilst we are at it we check button status too and
  * act accordingly.
  *
@@ -83,11 +83,9 @@ FortiusController::getRealtimeData(RealtimeData &rtData)
 
     if(!myFortius->isRunning())
     {
-        QMessageBox msgBox;
-        msgBox.setText(tr("Cannot Connect to Fortius"));
-        msgBox.setIcon(QMessageBox::Critical);
-        msgBox.exec();
-        parent->Stop(1);
+        // not on the gui thread, so let it tell them
+        QMetaObject::invokeMethod(parent, "deviceError", Qt::QueuedConnection,
+                                  Q_ARG(QString, tr("Cannot Connect to Fortius")));
         return;
     }
     // get latest telemetry
@@ -118,15 +116,15 @@ FortiusController::getRealtimeData(RealtimeData &rtData)
     if (parent->calibrating) return;
 
     // ADJUST LOAD
-    if ((Buttons&FT_PLUS)) parent->Higher();
+    if ((Buttons&FT_PLUS)) QMetaObject::invokeMethod(parent, "Higher", Qt::QueuedConnection);
     
-    if ((Buttons&FT_MINUS)) parent->Lower();
+    if ((Buttons&FT_MINUS)) QMetaObject::invokeMethod(parent, "Lower", Qt::QueuedConnection);
 
     // LAP/INTERVAL
-    if (Buttons&FT_ENTER) parent->newLap();
+    if (Buttons&FT_ENTER) QMetaObject::invokeMethod(parent, "newLap", Qt::QueuedConnection);
 
     // CANCEL
-    if (Buttons&FT_CANCEL) parent->Stop(0);
+    if (Buttons&FT_CANCEL) QMetaObject::invokeMethod(parent, "Stop", Qt::QueuedConnection, Q_ARG(int, 0));
 
     // Ensure we set the UI load to the actual setpoint from the fortius (as it will clamp)
     rtData.setLoad(myFortius->getLoad());
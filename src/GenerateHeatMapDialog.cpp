@@ -23,6 +23,11 @@
 #include "Athlete.h"
 #include "RideCache.h"
 #include "HelpWhatsThis.h"
+#if QT_VERSION > 0x050000
+# include <QtConcurrent>
+#else
+# include <QtConcurrentMap>
+#endif
 
 GenerateHeatMapDialog::GenerateHeatMapDialog(Context *context) : QDialog(context->mainWindow), context(context)
 {
@@ -119,6 +124,39 @@ GenerateHeatMapDialog::GenerateHeatMapDialog(Context *context) : QDialog(context
     connect(ok, SIGNAL(clicked()), this, SLOT(okClicked()));
     connect(all, SIGNAL(stateChanged(int)), this, SLOT(allClicked()));
     connect(cancel, SIGNAL(clicked()), this, SLOT(cancelClicked()));
+    connect(&watcher, SIGNAL(progressValueChanged(int)), this, SLOT(progressing(int)));
+    connect(&watcher, SIGNAL(finished()), this, SLOT(generated()));
+}
+
+GenerateHeatMapDialog::~GenerateHeatMapDialog()
+{
+    // closed whilst still generating
+    stopGenerating();
+}
+
+void
+GenerateHeatMapDialog::stopGenerating()
+{
+    // so generated() doesn't write anything when it gets called
+    if (future.isRunning()) {
+        aborted = true;
+        future.cancel();
+        future.waitForFinished();
+    }
+}
+
+void
+GenerateHeatMapDialog::closeEvent(QCloseEvent *event)
+{
+    stopGenerating();
+    QDialog::closeEvent(event);
+}
+
+void
+GenerateHeatMapDialog::reject()
+{
+    stopGenerating();
+    QDialog::reject();
 }
 
 void
@@ -158,12 +196,11 @@ GenerateHeatMapDialog::okClicked()
         cancel->hide();
         ok->setText(tr("Abort"));
         appsettings->setValue(GC_BE_LASTDIR, dirName->text());
-        generateNow();
-        status->setText(QString(tr("%1 activities exported, %2 failed or skipped.")).arg(exports).arg(fails));
-        ok->setText(tr("Finish"));
+        generateNow(); // finishes in generated()
 
     } else if (ok->text() == "Abort" || ok->text() == tr("Abort")) {
         aborted = true;
+        future.cancel();
     } else if (ok->text() == "Finish" || ok->text() == tr("Finish")) {
         accept(); // our work is done!
     }
@@ -175,88 +212,134 @@ GenerateHeatMapDialog::cancelClicked()
     reject();
 }
 
-void
-GenerateHeatMapDialog::generateNow()
+// bin the points in a ride, runs in a worker thread
+class HeatMapBinner
 {
+    public:
+        typedef HeatMapBins result_type;
 
-    double minLat = 999;
-    double maxLat = -999;
-    double minLon = 999;
-    double maxLon = -999;
-    QHash<QString, int> hash;
+        HeatMapBinner(Context *context) : context(context) {}
 
-    // loop through the table and export all selected
-    for(int i=0; i<files->invisibleRootItem()->childCount(); i++) {
+        HeatMapBins operator()(const QString &filename) {
 
-        // give user a chance to abort..
-        QApplication::processEvents();
-
-        // did they?
-        if (aborted == true) return; // user aborted!
-
-        QTreeWidgetItem *current = files->invisibleRootItem()->child(i);
-
-        // is it selected
-        if (static_cast<QCheckBox*>(files->itemWidget(current,0))->isChecked()) {
-
-            files->setCurrentItem(current); QApplication::processEvents();
-
-            // this one then
-            current->setText(4, tr("Reading...")); QApplication::processEvents();
+            HeatMapBins returning;
 
             // open it..
             QStringList errors;
             QList<RideFile*> rides;
-            QFile thisfile(QString(context->athlete->home->activities().absolutePath()+"/"+current->text(1)));
+            QFile thisfile(filename);
             RideFile *ride = RideFileFactory::instance().openRideFile(context, thisfile, errors, &rides);
 
-            // open success?
-            if (ride) {
-                current->setText(4, tr("Writing...")); QApplication::processEvents();
-
-                if (ride->areDataPresent()->lat == true && ride->areDataPresent()->lon == true) {
-                    int lastDistance = 0;
-                    foreach(const RideFilePoint *point, ride->dataPoints()) {
-
-                        if (lastDistance < (int) (point->km * 1000) &&
-                           (point->lon!=0 || point->lat!=0)) {
+            // open failed
+            if (!ride) {
+                returning.fails = 1;
+                return returning;
+            }
+            returning.rides = 1;
 
-                            // Pick up a point max every 15m
-                            lastDistance = (int) (point->km * 1000) + 15;
-                            //outhtml << "  new google.maps.LatLng("<<point->lat<<", "<<point->lon<<"),\n";
-                            QString lonlat = QString("%1,%2").arg(floorf(point->lat*100000)/100000).arg(floorf(point->lon*100000)/100000);
-                            if (hash.contains(lonlat)) {
-                                hash[lonlat] = hash[lonlat] + 1;
-                            } else {
-                                hash[lonlat] = 1;
-                            }
+            if (ride->areDataPresent()->lat == true && ride->areDataPresent()->lon == true) {
+                int lastDistance = 0;
+                foreach(const RideFilePoint *point, ride->dataPoints()) {
 
-                            if (minLon > point->lon) minLon = point->lon;
-                            if (minLat > point->lat) minLat = point->lat;
-                            if (maxLon < point->lon) maxLon = point->lon;
-                            if (maxLat < point->lat) maxLat = point->lat;
+                    if (lastDistance < (int) (point->km * 1000) &&
+                       (point->lon!=0 || point->lat!=0)) {
 
-                        }
+                        // Pick up a point max every 15m
+                        lastDistance = (int) (point->km * 1000) + 15;
+                        returning.bins[HeatMapBins::key(point->lat, point->lon)]++;
 
+                        if (returning.minLon > point->lon) returning.minLon = point->lon;
+                        if (returning.minLat > point->lat) returning.minLat = point->lat;
+                        if (returning.maxLon < point->lon) returning.maxLon = point->lon;
+                        if (returning.maxLat < point->lat) returning.maxLat = point->lat;
                     }
                 }
-
-                delete ride; // free memory!
-            // open failed
-            } else {
-                current->setText(4, tr("Read error")); QApplication::processEvents();
             }
+
+            delete ride; // free memory!
+            return returning;
         }
-    }
 
-    QHashIterator<QString, int> i(hash);
-    QString datapoints = "";
+    private:
+        Context *context;
+};
+
+void
+HeatMapBins::merge(const HeatMapBins &other)
+{
+    QHashIterator<qint64, int> i(other.bins);
     while (i.hasNext()) {
-         i.next();
-         datapoints += QString("[%1,%2],")
-                    .arg(i.key())
-                    .arg(i.value());
+        i.next();
+        bins[i.key()] += i.value();
+    }
+
+    if (minLat > other.minLat) minLat = other.minLat;
+    if (maxLat < other.maxLat) maxLat = other.maxLat;
+    if (minLon > other.minLon) minLon = other.minLon;
+    if (maxLon < other.maxLon) maxLon = other.maxLon;
+    rides += other.rides;
+    fails += other.fails;
+}
+
+static void
+mergeHeatMapBins(HeatMapBins &result, const HeatMapBins &bins)
+{
+    result.merge(bins);
+}
+
+void
+GenerateHeatMapDialog::generateNow()
+{
+    // all the selected rides
+    QStringList filenames;
+    for(int i=0; i<files->invisibleRootItem()->childCount(); i++) {
+
+        QTreeWidgetItem *current = files->invisibleRootItem()->child(i);
+
+        // is it selected
+        if (static_cast<QCheckBox*>(files->itemWidget(current,0))->isChecked())
+            filenames << QString(context->athlete->home->activities().absolutePath()+"/"+current->text(1));
+    }
+
+    // bin them in the background, we carry on in generated()
+    future = QtConcurrent::mappedReduced(filenames, HeatMapBinner(context), mergeHeatMapBins,
+                                         QtConcurrent::UnorderedReduce);
+    watcher.setFuture(future);
+}
+
+void
+GenerateHeatMapDialog::progressing(int value)
+{
+    status->setText(QString(tr("Reading %1 of %2...")).arg(value).arg(watcher.progressMaximum()));
+}
+
+void
+GenerateHeatMapDialog::generated()
+{
+    ok->setText(tr("Finish"));
+
+    // did they abort?
+    if (aborted || future.isCanceled()) {
+        status->setText(tr("Aborted."));
+        return;
     }
+
+    HeatMapBins result = future.result();
+    exports = result.rides;
+    fails = result.fails;
+
+    writeHeatMap(result);
+    status->setText(QString(tr("%1 activities exported, %2 failed or skipped.")).arg(exports).arg(fails));
+}
+
+void
+GenerateHeatMapDialog::writeHeatMap(const HeatMapBins &result)
+{
+    double minLat = result.minLat;
+    double maxLat = result.maxLat;
+    double minLon = result.minLon;
+    double maxLon = result.maxLon;
+
     QFile filehtml(dirName->text() + "/HeatMap.htm");
     filehtml.open(QIODevice::WriteOnly | QIODevice::Text);
     QTextStream outhtml(&filehtml);
@@ -267,7 +350,14 @@ GenerateHeatMapDialog::generateNow()
     outhtml << "<script>\n";
     outhtml << "var map,pointarray,heatmap;\n";
     outhtml << "var dataarray = [\n";
-    outhtml << datapoints;
+    QHashIterator<qint64, int> i(result.bins);
+    while (i.hasNext()) {
+         i.next();
+         outhtml << QString("[%1,%2,%3],")
+                    .arg(HeatMapBins::lat(i.key()), 0, 'f', 5)
+                    .arg(HeatMapBins::lon(i.key()), 0, 'f', 5)
+                    .arg(i.value());
+    }
     outhtml << "];\n";
     outhtml << "var hmData = [];\n";
     outhtml << "function initialize() {\n";
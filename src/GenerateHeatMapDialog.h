@@ -26,6 +26,7 @@
 
 #include "RideItem.h"
 #include "RideFile.h"
+#include <cmath>
 
 #include <QtGui>
 #include <QTreeWidget>
@@ -36,6 +37,31 @@
 #include <QLabel>
 #include <QListIterator>
 #include <QDebug>
+#include <QHash>
+#include <QFuture>
+#include <QFutureWatcher>
+
+// GPS points binned on a grid of 0.00001 degrees (about 1m), keyed on the
+// lat and lon grid cells packed into 64 bits. Each ride is binned in a
+// worker thread and the results are merged as they complete
+class HeatMapBins
+{
+    public:
+        HeatMapBins() : minLat(999), maxLat(-999), minLon(999), maxLon(-999), rides(0), fails(0) {}
+
+        static qint64 key(double lat, double lon) {
+            qint32 ilat = floor(lat * 100000), ilon = floor(lon * 100000);
+            return (qint64(ilat) << 32) | quint32(ilon);
+        }
+        static double lat(qint64 key) { return qint32(key >> 32) / 100000.0; }
+        static double lon(qint64 key) { return qint32(key & 0xffffffff) / 100000.0; }
+
+        void merge(const HeatMapBins &other);
+
+        QHash<qint64, int> bins;
+        double minLat, maxLat, minLon, maxLon;
+        int rides, fails;
+};
 
 // Dialog class to show filenames, import progress and to capture user input
 // of ride date and time
@@ -48,9 +74,15 @@ class GenerateHeatMapDialog : public QDialog
 
 public:
     GenerateHeatMapDialog(Context *context);
+    ~GenerateHeatMapDialog();
 
     QTreeWidget *files; // choose files to export
 
+protected:
+    // closed or escape whilst generating stops it
+    void closeEvent(QCloseEvent *event);
+    void reject();
+
 signals:
 
 private slots:
@@ -60,6 +92,10 @@ private slots:
     void generateNow();
     void allClicked();
 
+    // background binning
+    void progressing(int);
+    void generated();
+
 private:
     Context *context;
     bool aborted;
@@ -78,6 +114,12 @@ private:
     int exports, fails;
     QLabel *status;
 
+    void writeHeatMap(const HeatMapBins &result);
+    void stopGenerating();
+
+    QFuture<HeatMapBins> future;
+    QFutureWatcher<HeatMapBins> watcher;
+
 };
 #endif // _GenerateHeatMapDialog_h
 
@@ -20,6 +20,7 @@
 #include "HrZones.h"
 #include "Colors.h"
 #include "TimeUtils.h"
+#include "DateIndex.h"
 #include <QtGui>
 #include <QtAlgorithms>
 #include <qcolor.h>
@@ -420,13 +421,7 @@ bool HrZones::read(QFile &file)
 // end of range
 int HrZones::whichRange(const QDate &date) const
 {
-    for (int rnum = 0; rnum < ranges.size(); ++rnum) {
-        const HrZoneRange &range = ranges[rnum];
-        if (((date >= range.begin) || (range.begin.isNull())) &&
-            ((date < range.end) || (range.end.isNull())))
-            return rnum;
-    }
-    return -1;
+    return whichDateRange(ranges, date);
 }
 
 int HrZones::numZones(int rnum) const
@@ -89,31 +89,18 @@ IntervalItem::refresh()
     RideFile *f = rideItem_->ride_;
     if (!f) return;
 
-    // create a temporary ride
-    RideFile intervalRide(f);
-    for (int i = f->intervalBeginSecs(start); i>= 0 &&i < f->dataPoints().size(); ++i) {
-
-        // iterate
-        const RideFilePoint *p = f->dataPoints()[i];
-        if (p->secs+f->recIntSecs() > stop) break;
-
-        // append all values
-        intervalRide.appendPoint(p->secs, p->cad, p->hr, p->km, p->kph, p->nm,
-                    p->watts, p->alt, p->lon, p->lat, p->headwind,
-                    p->slope, p->temp, p->lrbalance,
-                    p->lte, p->rte, p->lps, p->rps,
-                    p->lpco, p->rpco, p->lppb, p->rppb, p->lppe, p->rppe, p->lpppb, p->rpppb, p->lpppe, p->rpppe,
-                    p->smo2, p->thb, p->rvert, p->rcad, p->rcontact, p->tcore, 0);
-
-        // copy derived data
-        RideFilePoint *l = intervalRide.dataPoints().last();
-        l->np = p->np;
-        l->xp = p->xp;
-        l->apower = p->apower;
-    }
+    // find the samples in the interval
+    int begin = f->intervalBeginSecs(start);
+    if (begin < 0) return;
+
+    int end = begin;
+    while (end < f->dataPoints().size() && f->dataPoints()[end]->secs+f->recIntSecs() <= stop) end++;
 
     // we created a blank ride (?)
-    if (intervalRide.dataPoints().size() == 0) return;
+    if (end == begin) return;
+
+    // a view over the interval, the samples are not copied
+    RideFile intervalRide(f, begin, end - begin);
 
     // ok, lets collect the metrics
     const RideMetricFactory &factory = RideMetricFactory::instance();
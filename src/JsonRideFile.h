@@ -25,6 +25,7 @@
 #include <algorithm> // for std::sort
 #include <QDomDocument>
 #include <QVector>
+#include <QIODevice>
 #include <assert.h>
 #include <QDebug>
 #define DATETIME_FORMAT "yyyy/MM/dd hh:mm:ss' UTC'"
@@ -34,6 +35,14 @@ struct JsonFileReader : public RideFileReader {
     virtual RideFile *openRideFile(QFile &file, QStringList &errors, QList<RideFile*>* = 0) const; 
     bool writeRideFile(Context *, const RideFile *ride, QFile &file) const;
     bool hasWrite() const { return true; }
+
+    // serialize to and parse from memory
+    QByteArray toByteArray(Context *, const RideFile *ride) const;
+    RideFile *fromByteArray(const QByteArray &data, QStringList &errors) const;
+
+    private:
+        void writeRide(const RideFile *ride, QIODevice &device) const;
+        RideFile *parse(const QString &contents, QStringList &errors) const;
 };
 
 #endif // _JsonRideFile_h
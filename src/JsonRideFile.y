@@ -35,6 +35,7 @@
 // in writeRideFile below, this is NOT a generic json parser.
 
 #include "JsonRideFile.h"
+#include <QBuffer>
 
 // now we have a reentrant parser we save context data
 // in a structure rather than in global variables -- so
@@ -347,6 +348,32 @@ JsonFileReader::openRideFile(QFile &file, QStringList &errors, QList<RideFile*>*
         return NULL; 
     }
 
+    return parse(contents, errors);
+}
+
+// parse from memory, the file stores unzip into a byte array
+RideFile *
+JsonFileReader::fromByteArray(const QByteArray &data, QStringList &errors) const
+{
+    // as above, UTF-8 but fall back to Latin1 for older files
+    QString contents;
+    {
+        QTextStream in(data);
+        in.setCodec ("UTF-8");
+        contents = in.readAll();
+    }
+    if (contents.contains(QChar::ReplacementCharacter)) {
+        QTextStream in(data);
+        in.setCodec ("ISO 8859-1");
+        contents = in.readAll();
+    }
+
+    return parse(contents, errors);
+}
+
+RideFile *
+JsonFileReader::parse(const QString &contents, QStringList &errors) const
+{
     // create scanner context for reentrant parsing
     JsonContext *jc = new JsonContext;
     JsonRideFilelex_init(&scanner);
@@ -393,8 +420,32 @@ JsonFileReader::writeRideFile(Context *, const RideFile *ride, QFile &file) cons
     // truncate existing
     file.resize(0);
 
+    writeRide(ride, file);
+
+    // close
+    file.close();
+
+    return true;
+}
+
+// serialize to memory, the file stores zip it up without going to disk
+QByteArray
+JsonFileReader::toByteArray(Context *, const RideFile *ride) const
+{
+    QByteArray data;
+    QBuffer buffer(&data);
+    buffer.open(QIODevice::WriteOnly);
+    writeRide(ride, buffer);
+    buffer.close();
+
+    return data;
+}
+
+void
+JsonFileReader::writeRide(const RideFile *ride, QIODevice &device) const
+{
     // setup streamer
-    QTextStream out(&file);
+    QTextStream out(&device);
     // unified codepage and BOM for identification on all platforms
     out.setCodec("UTF-8");
     out.setGenerateByteOrderMark(true);
@@ -594,9 +645,5 @@ JsonFileReader::writeRideFile(Context *, const RideFile *ride, QFile &file) cons
 
     // end of ride and document
     out << "\n\t}\n}\n";
-
-    // close
-    file.close();
-
-    return true;
+    out.flush();
 }
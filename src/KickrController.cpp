@@ -78,7 +78,7 @@ bool KickrController::doesPull() { return true; }
 bool KickrController::doesLoad() { return true; }
 
 /*
- * gets called from the GUI to get updated telemetry.
+ * gets called from the train engine thread to get updated telemetry.
  * so whilst we are at it we check button status too and
  * act accordingly.
  *
@@ -88,11 +88,9 @@ KickrController::getRealtimeData(RealtimeData &rtData)
 {
     if(!myKickr->isRunning())
     {
-        QMessageBox msgBox;
-        msgBox.setText(tr("Cannot Connect to Kickr"));
-        msgBox.setIcon(QMessageBox::Critical);
-        msgBox.exec();
-        parent->Stop(1);
+        // not on the gui thread, so let it tell them
+        QMetaObject::invokeMethod(parent, "deviceError", Qt::QueuedConnection,
+                                  Q_ARG(QString, tr("Cannot Connect to Kickr")));
         return;
     }
     // get latest telemetry
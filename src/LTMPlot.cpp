@@ -2450,7 +2450,7 @@ LTMPlot::createTODCurveData(Context *context, LTMSettings *settings, MetricDetai
     if (!SearchFilterBox::isNull(metricDetail.datafilter))
         spec.addMatches(SearchFilterBox::matches(context, metricDetail.datafilter));
 
-    foreach (RideItem *ride, context->athlete->rideCache->rides()) {
+    foreach (RideItem *ride, context->athlete->rideCache->ridesIn(spec)) {
 
         if (!spec.pass(ride)) continue;
 
@@ -2562,7 +2562,7 @@ LTMPlot::createMetricData(Context *context, LTMSettings *settings, MetricDetail
     if (!SearchFilterBox::isNull(metricDetail.datafilter))
         spec.addMatches(SearchFilterBox::matches(context, metricDetail.datafilter));
 
-    foreach (RideItem *ride, context->athlete->rideCache->rides()) { 
+    foreach (RideItem *ride, context->athlete->rideCache->ridesIn(spec)) { 
 
         // filter out unwanted stuff
         if (!spec.pass(ride)) continue;
@@ -2690,7 +2690,7 @@ LTMPlot::createFormulaData(Context *context, LTMSettings *settings, MetricDetail
     if (!SearchFilterBox::isNull(metricDetail.datafilter))
         spec.addMatches(SearchFilterBox::matches(context, metricDetail.datafilter));
 
-    foreach (RideItem *ride, context->athlete->rideCache->rides()) { 
+    foreach (RideItem *ride, context->athlete->rideCache->ridesIn(spec)) { 
 
         // filter out unwanted stuff
         if (!spec.pass(ride)) continue;
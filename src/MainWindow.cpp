@@ -669,6 +669,7 @@ MainWindow::MainWindow(const QDir &home)
 
     optionsMenu->addAction(tr("Create Heat Map..."), this, SLOT(generateHeatMap()), tr(""));
     optionsMenu->addAction(tr("Export Metrics as CSV..."), this, SLOT(exportMetrics()), tr(""));
+    optionsMenu->addAction(tr("Export Ride Cache as JSON..."), this, SLOT(exportRideCache()), tr(""));
     optionsMenu->addSeparator();
     optionsMenu->addAction(tr("Find intervals..."), this, SLOT(addIntervals()), tr (""));
 
@@ -1379,7 +1380,7 @@ void
 MainWindow::generateHeatMap()
 {
     GenerateHeatMapDialog *d = new GenerateHeatMapDialog(currentTab->context);
-    d->exec();
+    d->exec(); // deletes itself on close
 }
 
 void
@@ -1946,6 +1947,24 @@ MainWindow::exportMetrics()
     currentTab->context->athlete->rideCache->writeAsCSV(fileName);
 }
 
+void
+MainWindow::exportRideCache()
+{
+    // if the refresh process is running, try again when its completed
+    if (currentTab->context->athlete->rideCache->isRunning()) {
+        QMessageBox::warning(this, tr("Refresh in Progress"), 
+        "A metric refresh is currently running, please try again once that has completed.");
+        return;
+    }
+
+    // all good lets choose a file
+    QString fileName = QFileDialog::getSaveFileName( this, tr("Export Ride Cache"), QDir::homePath(), tr("JSON (*.json)"));
+    if (fileName.length() == 0) return;
+
+    // export
+    currentTab->context->athlete->rideCache->writeAsJSON(fileName);
+}
+
 /*----------------------------------------------------------------------
  * Twitter
  *--------------------------------------------------------------------*/
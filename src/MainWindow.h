@@ -179,6 +179,7 @@ class MainWindow : public QMainWindow
         void exportBatch();
         void generateHeatMap();
         void exportMetrics();
+        void exportRideCache();
 #ifdef GC_HAVE_KQOAUTH
         void tweetRide();
 #endif
@@ -0,0 +1,424 @@
+/*
+ * Copyright (c) 2015 Mark Liversedge (liversedge@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "MeanMaxIndex.h"
+#include "RideFileCache.h"
+
+#include <QDir>
+#include <QFile>
+#include <QDataStream>
+#include <QDateTime>
+#include <QMutexLocker>
+
+// the order of the meanmax blocks in the .cpx (see RideFileCache::serialize)
+static const RideFile::SeriesType meanMaxOrder[MeanMaxAggregate::MeanMaxBlocks] = {
+    RideFile::watts, RideFile::wattsKg, RideFile::hr, RideFile::cad, RideFile::nm,
+    RideFile::kph, RideFile::kphd, RideFile::wattsd, RideFile::cadd, RideFile::nmd,
+    RideFile::hrd, RideFile::xPower, RideFile::NP, RideFile::vam, RideFile::aPower
+};
+
+// time in zone blocks are fixed size; watts, wattsCP, hr, hrCP, pace, paceCP, wbal
+static const int tizSizes[MeanMaxAggregate::TizBlocks] = { 10, 4, 10, 4, 10, 4, 4 };
+
+//
+// AGGREGATE
+//
+MeanMaxAggregate::MeanMaxAggregate() : incomplete(false), rides(0)
+{
+    for (int i=0; i<TizBlocks; i++) tiz[i].resize(tizSizes[i]);
+}
+
+RideFile::SeriesType
+MeanMaxAggregate::meanMaxSeries(int block)
+{
+    return meanMaxOrder[block];
+}
+
+int
+MeanMaxAggregate::tizSize(int block)
+{
+    return tizSizes[block];
+}
+
+bool
+MeanMaxAggregate::readRide(QString cpxFilename, QDate date)
+{
+    QFile cacheFile(cpxFilename);
+    if (cacheFile.size() < (int)sizeof(struct RideFileCacheHeader)) return false;
+    if (cacheFile.open(QIODevice::ReadOnly) == false) return false;
+
+    RideFileCacheHeader head;
+    QDataStream inFile(&cacheFile);
+    inFile.readRawData((char *) &head, sizeof(head));
+
+    // old format, will be refreshed
+    if (head.version != RideFileCacheVersion) {
+        cacheFile.close();
+        return false;
+    }
+
+    // counts in the order the blocks are written
+    unsigned int meanMaxCounts[MeanMaxBlocks] = {
+        head.wattsMeanMaxCount, head.wattsKgMeanMaxCount, head.hrMeanMaxCount,
+        head.cadMeanMaxCount, head.nmMeanMaxCount, head.kphMeanMaxCount,
+        head.kphdMeanMaxCount, head.wattsdMeanMaxCount, head.caddMeanMaxCount,
+        head.nmdMeanMaxCount, head.hrdMeanMaxCount, head.xPowerMeanMaxCount,
+        head.npMeanMaxCount, head.vamMeanMaxCount, head.aPowerMeanMaxCount
+    };
+    unsigned int distCounts[DistBlocks] = {
+        head.wattsDistCount, head.hrDistCount, head.cadDistCount, head.gearDistCount,
+        head.nmDistrCount, head.kphDistCount, head.xPowerDistCount, head.npDistCount,
+        head.wattsKgDistCount, head.aPowerDistCount, head.smo2DistCount, head.wbalDistCount
+    };
+
+    // every best in a ride is on the ride date
+    qint32 julian = date.toJulianDay();
+    for (int i=0; i<MeanMaxBlocks; i++) {
+        meanMax[i].resize(meanMaxCounts[i]);
+        inFile.readRawData((char *) meanMax[i].data(), sizeof(float) * meanMax[i].size());
+        dates[i].fill(julian, meanMax[i].size());
+    }
+
+    // distributions are stored as float, but we sum them as doubles
+    QVector<float> buffer;
+    for (int i=0; i<DistBlocks; i++) {
+        buffer.resize(distCounts[i]);
+        inFile.readRawData((char *) buffer.data(), sizeof(float) * buffer.size());
+        dist[i].resize(buffer.size());
+        for (int j=0; j<buffer.size(); j++) dist[i][j] = buffer[j];
+    }
+
+    for (int i=0; i<TizBlocks; i++) {
+        tiz[i].resize(tizSizes[i]);
+        inFile.readRawData((char *) tiz[i].data(), sizeof(float) * tiz[i].size());
+    }
+
+    bool ok = inFile.status() == QDataStream::Ok;
+    cacheFile.close();
+
+    rides = ok ? 1 : 0;
+    return ok;
+}
+
+bool
+MeanMaxAggregate::read(QString filename)
+{
+    QFile file(filename);
+    if (file.size() < (int)sizeof(struct MeanMaxIndexHeader)) return false;
+    if (file.open(QIODevice::ReadOnly) == false) return false;
+
+    MeanMaxIndexHeader head;
+    QDataStream inFile(&file);
+    inFile.readRawData((char *) &head, sizeof(head));
+
+    if (head.version != MeanMaxIndexVersion || head.cacheVersion != RideFileCacheVersion) {
+        file.close();
+        return false;
+    }
+
+    for (int i=0; i<MeanMaxBlocks; i++) {
+        meanMax[i].resize(head.meanMaxCount[i]);
+        inFile.readRawData((char *) meanMax[i].data(), sizeof(float) * meanMax[i].size());
+    }
+    for (int i=0; i<MeanMaxBlocks; i++) {
+        dates[i].resize(head.meanMaxCount[i]);
+        inFile.readRawData((char *) dates[i].data(), sizeof(qint32) * dates[i].size());
+    }
+    for (int i=0; i<DistBlocks; i++) {
+        dist[i].resize(head.distCount[i]);
+        inFile.readRawData((char *) dist[i].data(), sizeof(double) * dist[i].size());
+    }
+    for (int i=0; i<TizBlocks; i++) {
+        tiz[i].resize(tizSizes[i]);
+        inFile.readRawData((char *) tiz[i].data(), sizeof(float) * tiz[i].size());
+    }
+
+    bool ok = inFile.status() == QDataStream::Ok;
+    file.close();
+
+    // truncated, so start again
+    if (!ok) *this = MeanMaxAggregate();
+    else rides = head.rides;
+
+    return ok;
+}
+
+bool
+MeanMaxAggregate::write(QString filename) const
+{
+    QFile file(filename);
+    if (file.open(QIODevice::WriteOnly) == false) return false;
+
+    MeanMaxIndexHeader head;
+    head.version = MeanMaxIndexVersion;
+    head.cacheVersion = RideFileCacheVersion;
+    head.rides = rides;
+    for (int i=0; i<MeanMaxBlocks; i++) head.meanMaxCount[i] = meanMax[i].size();
+    for (int i=0; i<DistBlocks; i++) head.distCount[i] = dist[i].size();
+
+    QDataStream out(&file);
+    out.writeRawData((const char *) &head, sizeof(head));
+    for (int i=0; i<MeanMaxBlocks; i++)
+        out.writeRawData((const char *) meanMax[i].constData(), sizeof(float) * meanMax[i].size());
+    for (int i=0; i<MeanMaxBlocks; i++)
+        out.writeRawData((const char *) dates[i].constData(), sizeof(qint32) * dates[i].size());
+    for (int i=0; i<DistBlocks; i++)
+        out.writeRawData((const char *) dist[i].constData(), sizeof(double) * dist[i].size());
+    for (int i=0; i<TizBlocks; i++)
+        out.writeRawData((const char *) tiz[i].constData(), sizeof(float) * tiz[i].size());
+
+    file.close();
+    return out.status() == QDataStream::Ok;
+}
+
+void
+MeanMaxAggregate::merge(const MeanMaxAggregate &other)
+{
+    if (other.incomplete) incomplete = true;
+    rides += other.rides;
+
+    // select and update bests
+    for (int i=0; i<MeanMaxBlocks; i++) {
+
+        const QVector<float> &from = other.meanMax[i];
+        const QVector<qint32> &when = other.dates[i];
+
+        if (meanMax[i].size() < from.size()) {
+            meanMax[i].resize(from.size());
+            dates[i].resize(from.size());
+        }
+
+        float *into = meanMax[i].data();
+        qint32 *date = dates[i].data();
+        for (int j=0; j<from.size(); j++) {
+            if (from[j] > into[j]) {
+                into[j] = from[j];
+                date[j] = when[j];
+            }
+        }
+    }
+
+    // resize and sum the distributions
+    for (int i=0; i<DistBlocks; i++) {
+        const QVector<double> &from = other.dist[i];
+        if (dist[i].size() < from.size()) dist[i].resize(from.size());
+
+        double *into = dist[i].data();
+        for (int j=0; j<from.size(); j++) into[j] += from[j];
+    }
+
+    // cumulate timeinzones
+    for (int i=0; i<TizBlocks; i++)
+        for (int j=0; j<tizSizes[i] && j<other.tiz[i].size(); j++)
+            tiz[i][j] += other.tiz[i][j];
+}
+
+//
+// INDEX
+//
+static QMutex indexesLock;
+static QMap<QString, MeanMaxIndex*> indexes; // never deleted, one per athlete
+
+MeanMaxIndex *
+MeanMaxIndex::index(QString cacheDir)
+{
+    // the app uses canonical paths, the API doesn't
+    QString path = QDir(cacheDir).canonicalPath();
+    if (path == "") path = cacheDir;
+
+    QMutexLocker locker(&indexesLock);
+
+    MeanMaxIndex *returning = indexes.value(path, NULL);
+    if (returning == NULL) {
+        returning = new MeanMaxIndex(path);
+        indexes.insert(path, returning);
+    }
+    return returning;
+}
+
+MeanMaxIndex::MeanMaxIndex(QString cacheDir) : cacheDir(cacheDir), listed(false)
+{
+}
+
+void
+MeanMaxIndex::invalidate(QString cacheDir, QDate date)
+{
+    MeanMaxIndex *index = MeanMaxIndex::index(cacheDir);
+
+    QMutexLocker locker(&index->lock);
+
+    // rides may have been added or removed
+    index->listed = false;
+
+    // wipe the periods that contain the ride, they
+    // get rebuilt from what's left next time round
+    QDate start, end;
+    for (int type=year; type<=week; type++) {
+        periodFor(PeriodType(type), date, start, end);
+        QFile::remove(index->periodFilename(PeriodType(type), start));
+    }
+}
+
+void
+MeanMaxIndex::periodFor(PeriodType type, QDate date, QDate &start, QDate &end)
+{
+    switch (type) {
+
+    case year:
+        start = QDate(date.year(), 1, 1);
+        end = QDate(date.year(), 12, 31);
+        break;
+
+    case month:
+        start = QDate(date.year(), date.month(), 1);
+        end = start.addMonths(1).addDays(-1);
+        break;
+
+    case week:
+        {
+            // monday to sunday, but clipped to the month
+            QDate first(date.year(), date.month(), 1);
+            QDate last = first.addMonths(1).addDays(-1);
+
+            start = date.addDays(1 - date.dayOfWeek());
+            end = start.addDays(6);
+            if (start < first) start = first;
+            if (end > last) end = last;
+        }
+        break;
+    }
+}
+
+QString
+MeanMaxIndex::periodFilename(PeriodType type, QDate start) const
+{
+    QString format;
+    switch (type) {
+    case year: format = "yyyy"; break;
+    case month: format = "yyyy-MM"; break;
+    case week: format = "yyyy-MM-dd"; break;
+    }
+    return cacheDir + "/bests-" + start.toString(format) + ".mmx";
+}
+
+void
+MeanMaxIndex::refreshRides()
+{
+    rides.clear();
+
+    // sorted by name, so rides on the same day are in time order
+    foreach(QString cacheFilename, QDir(cacheDir).entryList(QStringList() << "*.cpx", QDir::Files, QDir::Name)) {
+
+        QDateTime dt;
+        if (!RideFile::parseRideFileName(cacheFilename, &dt)) continue;
+
+        rides[dt.date()] << cacheFilename;
+    }
+    listed = true;
+}
+
+void
+MeanMaxIndex::mergeDay(MeanMaxAggregate &into, QDate date)
+{
+    foreach(QString cacheFilename, rides.value(date)) {
+
+        MeanMaxAggregate ride;
+        if (ride.readRide(cacheDir + "/" + cacheFilename, date) == false) {
+            // ack, data not available !
+            ride = MeanMaxAggregate();
+            ride.incomplete = true;
+        }
+        into.merge(ride);
+    }
+}
+
+MeanMaxAggregate
+MeanMaxIndex::period(PeriodType type, QDate start, QDate end)
+{
+    MeanMaxAggregate returning;
+
+    // no rides in this period
+    QMap<QDate, QStringList>::const_iterator first = rides.lowerBound(start);
+    if (first == rides.constEnd() || first.key() > end) return returning;
+
+    // already saved ?
+    QString filename = periodFilename(type, start);
+    if (returning.read(filename)) return returning;
+
+    // build from the days or periods it contains
+    if (type == week) {
+
+        for (QDate date = start; date <= end; date = date.addDays(1))
+            mergeDay(returning, date);
+
+    } else {
+
+        PeriodType child = (type == year) ? month : week;
+        QDate date = start;
+        while (date <= end) {
+            QDate childStart, childEnd;
+            periodFor(child, date, childStart, childEnd);
+            returning.merge(period(child, childStart, childEnd));
+            date = childEnd.addDays(1);
+        }
+    }
+
+    // don't save if its going to change when the rides get refreshed
+    if (returning.incomplete == false) returning.write(filename);
+
+    return returning;
+}
+
+MeanMaxAggregate
+MeanMaxIndex::aggregate(QDate from, QDate to)
+{
+    QMutexLocker locker(&lock);
+
+    if (!listed) refreshRides();
+
+    MeanMaxAggregate returning;
+    if (rides.isEmpty()) return returning;
+
+    // no point looking before the first or after the last ride
+    QDate date = from > rides.firstKey() ? from : rides.firstKey();
+    QDate last = to < rides.lastKey() ? to : rides.lastKey();
+
+    while (date <= last) {
+
+        // take the biggest period that starts here and fits in the range
+        bool found = false;
+        for (int type=year; type<=week && !found; type++) {
+
+            QDate start, end;
+            periodFor(PeriodType(type), date, start, end);
+            if (start == date && start >= from && end <= to) {
+                returning.merge(period(PeriodType(type), start, end));
+                date = end.addDays(1);
+                found = true;
+            }
+        }
+
+        // partial week at the start or end of the range
+        if (!found) {
+            mergeDay(returning, date);
+            date = date.addDays(1);
+        }
+    }
+
+    return returning;
+}
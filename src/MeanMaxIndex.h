@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) 2015 Mark Liversedge (liversedge@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _GC_MeanMaxIndex_h
+#define _GC_MeanMaxIndex_h 1
+#include "GoldenCheetah.h"
+#include "RideFile.h"
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QDate>
+#include <QMap>
+#include <QMutex>
+
+// The mean max index keeps pre-aggregated bests, distributions and
+// time in zone for calendar periods so that the aggregate for any
+// date range can be built by merging a handful of envelopes instead
+// of reading every .cpx file in the range.
+//
+// Periods nest; year -> month -> week -> rides. A week is an iso week
+// clipped to the month it is in so that weeks always nest inside
+// months. A query takes the largest periods that lie wholly within
+// the range and only reads rides individually for the partial weeks
+// at either end of it.
+//
+// Period aggregates are saved in the cache directory as .mmx files
+// and are deleted whenever a .cpx for a ride in that period is written
+// or removed, so they are rebuilt on demand from their child periods.
+//
+static const unsigned int MeanMaxIndexVersion = 1;
+// revision history:
+// version  date         description
+// 1        19-Jun-15    Initial - header, mean-max, dates, distribution and tiz blocks
+
+// The .mmx file has a binary format:
+// 1 x Header - versions and block counts
+// 15 x meanmax blocks in .cpx order (float)
+// 15 x dates blocks for the meanmax (julian day, qint32, 0 if no best)
+// 12 x distribution blocks in .cpx order (double)
+// 7 x time in zone blocks in .cpx order (float)
+struct MeanMaxIndexHeader {
+
+    unsigned int version;       // MeanMaxIndexVersion
+    unsigned int cacheVersion;  // RideFileCacheVersion of the .cpx aggregated
+    unsigned int rides;         // how many rides were aggregated
+
+    unsigned int meanMaxCount[15];
+    unsigned int distCount[12];
+};
+
+class MeanMaxAggregate
+{
+    public:
+        enum { MeanMaxBlocks = 15, DistBlocks = 12, TizBlocks = 7 };
+
+        MeanMaxAggregate();
+
+        // load the arrays from a ride's .cpx, all bests are on date
+        bool readRide(QString cpxFilename, QDate date);
+
+        // load or save a period aggregate (.mmx)
+        bool read(QString filename);
+        bool write(QString filename) const;
+
+        // fold in another aggregate; bests are taken with their dates
+        // and distributions and time in zone are summed. merge in date
+        // order so ties go to the earliest date, as they always have
+        void merge(const MeanMaxAggregate &other);
+
+        // the series held in each block of the .cpx
+        static RideFile::SeriesType meanMaxSeries(int block);
+        static int tizSize(int block);
+
+        bool incomplete; // a ride in range didn't have a usable .cpx
+        int rides;       // how many rides were aggregated
+
+        QVector<float> meanMax[MeanMaxBlocks];  // in .cpx units (see RideFileCache::decimalsFor)
+        QVector<qint32> dates[MeanMaxBlocks];   // julian day of each best
+        QVector<double> dist[DistBlocks];
+        QVector<float> tiz[TizBlocks];
+};
+
+class MeanMaxIndex
+{
+    public:
+
+        // there is one index per cache directory
+        static MeanMaxIndex *index(QString cacheDir);
+
+        // a ride on this date has been (re)cached or deleted
+        static void invalidate(QString cacheDir, QDate date);
+
+        // aggregate across the date range, inclusive
+        MeanMaxAggregate aggregate(QDate from, QDate to);
+
+    private:
+        MeanMaxIndex(QString cacheDir);
+
+        enum periodtype { year, month, week };
+        typedef enum periodtype PeriodType;
+
+        // the period of the given type that contains date
+        static void periodFor(PeriodType type, QDate date, QDate &start, QDate &end);
+        QString periodFilename(PeriodType type, QDate start) const;
+
+        // get a period aggregate from disk or build it from its children
+        MeanMaxAggregate period(PeriodType type, QDate start, QDate end);
+
+        // all the rides on a given day
+        void mergeDay(MeanMaxAggregate &into, QDate date);
+
+        // list the .cpx files in the cache
+        void refreshRides();
+
+        QString cacheDir;
+        QMutex lock;
+
+        bool listed;
+        QMap<QDate, QStringList> rides; // .cpx files by ride date
+};
+
+#endif // _GC_MeanMaxIndex_h
@@ -74,7 +74,7 @@ bool MonarkController::doesPull() { return true; }
 bool MonarkController::doesLoad() { return true; }
 
 /*
- * gets called from the GUI to get updated telemetry.
+ * gets called from the train engine thread to get updated telemetry.
  * so whilst we are at it we check button status too and
  * act accordingly.
  *
@@ -34,7 +34,8 @@
 #include <QProgressDialog>
 
 PMCData::PMCData(Context *context, Specification spec, QString metricName, int stsDays, int ltsDays) 
-    : context(context), specification_(spec), metricName_(metricName), stsDays_(stsDays), ltsDays_(ltsDays), isstale(true)
+    : context(context), specification_(spec), metricName_(metricName), stsDays_(stsDays), ltsDays_(ltsDays), isstale(true),
+      fullRefresh(true), lastSts(0), lastLts(0), lastSbToday(false)
 {
     // get defaults if not passed
     useDefaults = false;
@@ -59,13 +60,14 @@ PMCData::PMCData(Context *context, Specification spec, QString metricName, int s
 
 
     refresh();
-    connect(context, SIGNAL(rideAdded(RideItem*)), this, SLOT(invalidate()));
-    connect(context, SIGNAL(rideDeleted(RideItem*)), this, SLOT(invalidate()));
-    connect(context, SIGNAL(refreshUpdate(QDate)), this, SLOT(invalidate()));
+    connect(context, SIGNAL(rideAdded(RideItem*)), this, SLOT(invalidate(RideItem*)));
+    connect(context, SIGNAL(rideDeleted(RideItem*)), this, SLOT(invalidate(RideItem*)));
+    connect(context, SIGNAL(refreshUpdate(QDate)), this, SLOT(invalidate(QDate)));
 }
 
 PMCData::PMCData(Context *context, Specification spec, Leaf *expr, DataFilter *df, int stsDays, int ltsDays) 
-    : context(context), specification_(spec), metricName_(""), stsDays_(stsDays), ltsDays_(ltsDays), isstale(true)
+    : context(context), specification_(spec), metricName_(""), stsDays_(stsDays), ltsDays_(ltsDays), isstale(true),
+      fullRefresh(true), lastSts(0), lastLts(0), lastSbToday(false)
 {
     // get defaults if not passed
     useDefaults = false;
@@ -90,14 +92,34 @@ PMCData::PMCData(Context *context, Specification spec, Leaf *expr, DataFilter *d
 
 
     refresh();
-    connect(context, SIGNAL(rideAdded(RideItem*)), this, SLOT(invalidate()));
-    connect(context, SIGNAL(rideDeleted(RideItem*)), this, SLOT(invalidate()));
-    connect(context, SIGNAL(refreshUpdate(QDate)), this, SLOT(invalidate()));
+    connect(context, SIGNAL(rideAdded(RideItem*)), this, SLOT(invalidate(RideItem*)));
+    connect(context, SIGNAL(rideDeleted(RideItem*)), this, SLOT(invalidate(RideItem*)));
+    connect(context, SIGNAL(refreshUpdate(QDate)), this, SLOT(invalidate(QDate)));
 }
 
 void PMCData::invalidate()
 {
     isstale=true;
+    fullRefresh=true;
+}
+
+void PMCData::invalidate(RideItem *item)
+{
+    invalidate(item->dateTime.date());
+}
+
+void PMCData::invalidate(QDate date)
+{
+    // no idea what changed
+    if (date == QDate()) {
+        invalidate();
+        return;
+    }
+
+    // the refresh is working backwards from the most recent
+    // ride so everything after the earliest date may change
+    isstale=true;
+    if (staleFrom == QDate() || date < staleFrom) staleFrom = date;
 }
 
 void PMCData::refresh()
@@ -115,6 +137,7 @@ void PMCData::refresh()
         if (sts.isNull() || sts.toInt() == 0) stsDays_ = 7;
         else stsDays_ = sts.toInt();
     }
+    bool sbToday = appsettings->cvalue(context->athlete->cyclist, GC_SB_TODAY).toInt();
 
     QTime timer;
     timer.start();
@@ -141,30 +164,20 @@ void PMCData::refresh()
     }
 
     // what is earliest date we got ?
-    start_ = QDate(9999,12,31);
-    if (seed != QDate() && seed < start_) start_ = seed;
-    if (first != QDate() && first < start_) start_ = first;
+    QDate start = QDate(9999,12,31);
+    if (seed != QDate() && seed < start) start = seed;
+    if (first != QDate() && first < start) start = first;
 
     // whats the latest date we got ? (and add a year for decay)
-    end_ = QDate();
-    if (last > seed) end_ = last.addDays(365);
-    else if (seed != QDate()) end_ = seed.addDays(365);
+    QDate end = QDate();
+    if (last > seed) end = last.addDays(365);
+    else if (seed != QDate()) end = seed.addDays(365);
 
     // back to null date if not set, just to get round date arithmetic
-    if (start_ == QDate(9999,12,31)) start_ = QDate();
+    if (start == QDate(9999,12,31)) start = QDate();
 
     // We got a valid range ?
-    if (start_ != QDate() && end_ != QDate() && start_ < end_) {
-
-        // resize arrays
-        days_ = start_.daysTo(end_)+1;
-        stress_.resize(days_);
-        lts_.resize(days_);
-        sts_.resize(days_);
-        sb_.resize(days_+1); // for SB tomorrow!
-        rr_.resize(days_); // for SB tomorrow!
-
-    } else {
+    if (start == QDate() || end == QDate() || start >= end) {
 
         // nothing to calculate
         start_= QDate();
@@ -175,42 +188,66 @@ void PMCData::refresh()
         sts_.resize(0);
         sb_.resize(0);
         rr_.resize(0);
+        seeds_.clear();
 
         // give up
         return;
     }
-    //qDebug()<<"refresh PMC dates:"<<metricName_<<"days="<<days_<<"start="<<start_<<"end="<<end_;
+
+    // the seeded values from seasons
+    QMap<int, double> seeds;
+    foreach(Season x, context->athlete->seasons->seasons)
+        if (x.getSeed()) seeds.insert(start.daysTo(x.getStart()), x.getSeed());
+
+    // where do we need to recalculate from ?
+    int from = 0;
+    if (!fullRefresh && staleFrom != QDate() && start == start_ && seeds == seeds_ &&
+        stsDays_ == lastSts && ltsDays_ == lastLts && sbToday == lastSbToday) {
+
+        from = start_.daysTo(staleFrom);
+        if (from < 0) from = 0;
+        if (from > days_) from = days_; // the range got longer
+    }
+
+    // resize arrays, existing values are kept
+    start_ = start;
+    end_ = end;
+    days_ = start_.daysTo(end_)+1;
+    stress_.resize(days_);
+    lts_.resize(days_);
+    sts_.resize(days_);
+    sb_.resize(days_+1); // for SB tomorrow!
+    rr_.resize(days_); // for SB tomorrow!
+    //qDebug()<<"refresh PMC dates:"<<metricName_<<"days="<<days_<<"start="<<start_<<"end="<<end_<<"from="<<from;
 
     //
     // STEP TWO What are the seedings and ride values
     //
-    bool sbToday = appsettings->cvalue(context->athlete->cyclist, GC_SB_TODAY).toInt();
     double lte = (double)exp(-1.0/ltsDays_);
     double ste = (double)exp(-1.0/stsDays_);
 
-    // clear what's there
-    stress_.fill(0);
-    lts_.fill(0);
-    sts_.fill(0);
-    sb_.fill(0);
-    rr_.fill(0);
-
-    // add the seeded values from seasons
-    foreach(Season x, context->athlete->seasons->seasons) {
-        if (x.getSeed()) {
-            int offset = start_.daysTo(x.getStart());
-            lts_[offset] = x.getSeed() * -1;
-            sts_[offset] = x.getSeed() * -1;
-        }
+    // clear what's there from the first day that changed
+    for (int day=from; day < days_; day++) {
+        stress_[day] = 0;
+        lts_[day] = 0;
+        sts_[day] = 0;
+        rr_[day] = 0;
     }
+    for (int day=from + (sbToday || !from ? 0 : 1); day <= days_; day++) sb_[day] = 0; // sb may be for tomorrow
 
-    // add the stress scores
-    foreach(RideItem *item, context->athlete->rideCache->rides()) {
+    // add the stress scores, rides are in date order so we
+    // work back from the last ride to the first day that changed
+    QVector<RideItem*> &rides = context->athlete->rideCache->rides();
+    for (int i=rides.count()-1; i >= 0; i--) {
 
-        if (!specification_.pass(item)) continue;
+        RideItem *item = rides[i];
 
         // seed with score for this one
         int offset = start_.daysTo(item->dateTime.date());
+        if (offset < from) break;
+
+        if (!specification_.pass(item)) continue;
+
         if (offset > 0 && offset < stress_.count()) {
 
             // although metrics are cleansed, we check here because development
@@ -227,40 +264,27 @@ void PMCData::refresh()
     //
     // STEP THREE Calculate sts/lts, sb and rr
     //
-    double lastLTS=0.0f;
-    double lastSTS=0.0f;
-
-    double rollingStress=0;
+    for(int day=from; day < days_; day++) {
 
-    for(int day=0; day < days_; day++) {
-
-        // not seeded
-        if (lts_[day] >=0 || sts_[day]>=0) {
+        if (!seeds.contains(day)) {
 
             // LTS
-            if (day) lastLTS = lts_[day-1];
+            double lastLTS = day ? lts_[day-1] : 0.0f;
             lts_[day] = (stress_[day] * (1.0 - lte)) + (lastLTS * lte);
 
             // STS
-            if (day) lastSTS = sts_[day-1];
+            double lastSTS = day ? sts_[day-1] : 0.0f;
             sts_[day] = (stress_[day] * (1.0 - ste)) + (lastSTS * ste);
 
-        } else if (lts_[day]< 0|| sts_[day]<0) {
+        } else {
 
-            lts_[day] *= -1;
-            sts_[day] *= -1;
+            // seeded
+            lts_[day] = seeds.value(day);
+            sts_[day] = seeds.value(day);
         }
 
-        // rolling stress for STS days
-        if (day && day <= stsDays_) {
-            // just starting out
-            rollingStress += lts_[day] - lts_[day-1];
-            rr_[day] = rollingStress;
-        } else if (day) {
-            rollingStress += lts_[day] - lts_[day-1];
-            rollingStress -= lts_[day-stsDays_] - lts_[day-stsDays_-1];
-            rr_[day] = rollingStress;
-        }
+        // rolling stress is the change in lts over the last STS days
+        if (day) rr_[day] = lts_[day] - lts_[day > stsDays_ ? day-stsDays_ : 0];
 
         // SB (stress balance)  long term - short term
         // We allow it to be shown today or tomorrow where
@@ -270,6 +294,14 @@ void PMCData::refresh()
 
     //qDebug()<<"refresh PMC in="<<timer.elapsed()<<"ms";
 
+    // remember what we calculated with
+    seeds_ = seeds;
+    lastSts = stsDays_;
+    lastLts = ltsDays_;
+    lastSbToday = sbToday;
+
+    fullRefresh = false;
+    staleFrom = QDate();
     isstale=false;
 }
 
@@ -28,10 +28,12 @@
 
 #include <QtCore>
 #include <QList>
+#include <QMap>
 #include <QDateTime>
 #include <QTreeWidgetItem>
 
 class Context;
+class RideItem;
 
 class PMCData : public QObject {
 
@@ -91,6 +93,10 @@ class PMCData : public QObject {
         void invalidate();
         void refresh();
 
+        // only the days from here on need refreshing
+        void invalidate(QDate);
+        void invalidate(RideItem*);
+
     private:
 
         // who we for ?
@@ -113,6 +119,15 @@ class PMCData : public QObject {
         QVector<double> stress_, lts_, sts_, sb_, rr_;
 
         bool isstale; // needs refreshing
+
+        // the model is a recurrence so when rides change we only
+        // need to recalculate from the earliest day that changed,
+        // unless the dates, seeds or parameters have changed
+        bool fullRefresh;
+        QDate staleFrom;
+        QMap<int, double> seeds_; // lts/sts seeded from seasons by day
+        int lastSts, lastLts;
+        bool lastSbToday;
 };
 
 #endif // _GC_StressCalculator_h
@@ -24,6 +24,7 @@
 #include "Colors.h"
 #include "Settings.h"
 #include "TimeUtils.h"
+#include "DateIndex.h"
 #include "Units.h"
 #include <QtGui>
 #include <QtAlgorithms>
@@ -507,15 +508,7 @@ next_line: {}
 // end of range
 int PaceZones::whichRange(const QDate &date) const
 {
-    for (int rnum = 0; rnum < ranges.size(); ++rnum) {
-
-        const PaceZoneRange &range = ranges[rnum];
-        if (((date >= range.begin) || (range.begin.isNull())) &&
-            ((date < range.end) || (range.end.isNull())))
-            return rnum;
-
-    }
-    return -1;
+    return whichDateRange(ranges, date);
 }
 
 int PaceZones::numZones(int rnum) const
@@ -21,7 +21,9 @@
 #include "Context.h"
 #include "Athlete.h"
 #include "RideFileCache.h"
+#include "MeanMaxIndex.h"
 #include "RideCacheModel.h"
+#include "RideDBStore.h"
 #include "Specification.h"
 
 #include "Route.h"
@@ -32,6 +34,8 @@
 
 #include "JsonRideFile.h" // for DATETIME_FORMAT
 
+#include <algorithm> // lower_bound, upper_bound
+
 #ifdef SLOW_REFRESH
 #include "unistd.h"
 #endif
@@ -40,6 +44,10 @@
 bool rideCacheGreaterThan(const RideItem *a, const RideItem *b) { return a->dateTime > b->dateTime; }
 bool rideCacheLessThan(const RideItem *a, const RideItem *b) { return a->dateTime < b->dateTime; }
 
+// for searching by date
+static bool rideBeforeDate(const RideItem *a, const QDate &b) { return a->dateTime.date() < b; }
+static bool dateBeforeRide(const QDate &a, const RideItem *b) { return a < b->dateTime.date(); }
+
 RideCache::RideCache(Context *context) : context(context)
 {
     progress_ = 100;
@@ -63,6 +71,7 @@ RideCache::RideCache(Context *context) : context(context)
     }
 
     // load the store - will unstale once cache restored
+    store = new RideDBStore(QString("%1/rideDB.bin").arg(context->athlete->home->cache().canonicalPath()));
     load();
 
     // now sort it
@@ -79,9 +88,7 @@ RideCache::RideCache(Context *context) : context(context)
 
     // future watching
     connect(&watcher, SIGNAL(finished()), this, SLOT(garbageCollect()));
-    connect(&watcher, SIGNAL(finished()), this, SLOT(save()));
-    connect(&watcher, SIGNAL(finished()), context, SLOT(notifyRefreshEnd()));
-    connect(&watcher, SIGNAL(started()), context, SLOT(notifyRefreshStart()));
+    connect(&watcher, SIGNAL(finished()), this, SLOT(refreshFinished()));
     connect(&watcher, SIGNAL(progressValueChanged(int)), this, SLOT(progressing(int)));
 }
 
@@ -94,6 +101,7 @@ RideCache::~RideCache()
 
     // save to store
     save();
+    delete store;
 }
 
 void
@@ -103,6 +111,9 @@ RideCache::garbageCollect()
         if (item) item->deleteLater();
     }
     delete_.clear();
+
+    // the refresh may have had old settings snapshots
+    context->athlete->releaseSettings();
 }
 
 void
@@ -213,6 +224,20 @@ RideCache::addRide(QString name, bool dosignal, bool useTempActivities)
     context->notifyRideSelected(last);
 }
 
+void
+RideCache::sortRides()
+{
+    // still in order, e.g. the date didn't really change
+    int i=1;
+    while (i < rides_.count() && !rideCacheLessThan(rides_[i], rides_[i-1])) i++;
+    if (i >= rides_.count()) return;
+
+    // ridesIn() relies on it, model needs to know !
+    model_->beginReset();
+    qSort(rides_.begin(), rides_.end(), rideCacheLessThan);
+    model_->endReset();
+}
+
 void
 RideCache::removeCurrentRide()
 {
@@ -281,6 +306,9 @@ RideCache::removeCurrentRide()
 
     }
 
+    // the pre-aggregated bests included the cpx we just removed
+    MeanMaxIndex::invalidate(context->athlete->home->cache().canonicalPath(), todelete->dateTime.date());
+
     // we don't want the whole delete, select next flicker
     context->mainWindow->setUpdatesEnabled(false);
 
@@ -358,32 +386,81 @@ RideCache::writeAsCSV(QString filename)
     file.close();
 }
 
-void
-itemRefresh(RideItem *&item)
+// the staleness check is done here too, so the rides are checked in
+// parallel and refreshed as soon as we find they're stale rather than
+// checking them all on the gui thread before we start
+class RideCacheBackgroundRefresh
 {
-    // need parser to be reentrant !item->refresh();
-    if (item->isstale) {
-        item->refresh();
+    public:
+        typedef void result_type;
+
+        RideCacheBackgroundRefresh(RideCache *cache) : cache(cache) {}
 
-        // and trap changes during refresh to current ride
-        if (item == item->context->currentRideItem())
-            item->context->notifyRideChanged(item);
+        void operator()(RideItem *&item) {
+
+            // a ride that was only touched isn't stale, but its
+            // timestamp caught up and needs saving all the same
+            unsigned long timestamp = item->timestamp;
+            bool stale = item->checkStale();
+            if (stale || item->timestamp != timestamp) cache->changed_.fetchAndStoreOrdered(1);
+
+            if (stale) {
+
+                // first one we found, let everyone know we're refreshing
+                if (cache->stale_.fetchAndAddOrdered(1) == 0)
+                    QMetaObject::invokeMethod(cache, "refreshStarted", Qt::QueuedConnection);
+
+                // need parser to be reentrant !item->refresh();
+                item->refresh();
+
+                // and trap changes during refresh to current ride
+                if (item == item->context->currentRideItem())
+                    item->context->notifyRideChanged(item);
+
+                // only rides we actually refreshed need anyone to look again
+                QMetaObject::invokeMethod(cache, "refreshUpdated", Qt::QueuedConnection,
+                                          Q_ARG(QDate, item->dateTime.date()));
 
 #ifdef SLOW_REFRESH
-        sleep(1);
+                sleep(1);
 #endif
-    }
+            }
+        }
+
+    private:
+        RideCache *cache;
+};
+
+void
+RideCache::refreshStarted()
+{
+    context->notifyRefreshStart();
+}
+
+void
+RideCache::refreshFinished()
+{
+    // save anything that changed, even if it was only a timestamp
+    if (changed_.fetchAndStoreOrdered(0)) save();
+
+    // nothing was stale, nothing to tell anyone
+    if (stale_.fetchAndStoreOrdered(0) == 0) return;
+
+    context->notifyRefreshEnd();
+}
+
+void
+RideCache::refreshUpdated(QDate here)
+{
+    // a stale ride was refreshed, notify everyone where we got
+    context->notifyRefreshUpdate(here);
 }
 
 void
 RideCache::progressing(int value)
 {
-    // we're working away, notfy everyone where we got
+    // we're working away, checking isn't worth telling anyone about
     progress_ = 100.0f * (double(value) / double(watcher.progressMaximum()));
-    if (value) {
-        QDate here = reverse_.at(value-1)->dateTime.date();
-        context->notifyRefreshUpdate(here);
-    }
 }
 
 // cancel the refresh map, we're about to exit !
@@ -403,24 +480,14 @@ RideCache::refresh()
     // already on it !
     if (future.isRunning()) return;
 
-    // how many need refreshing ?
-    int staleCount = 0;
-
-    foreach(RideItem *item, rides_) {
-
-        // ok set stale so we refresh
-        if (item->checkStale()) 
-            staleCount++;
-    }
-
-    // start if there is work to do
+    // check and refresh in the background, newest first
     // and future watcher can notify of updates
-    if (staleCount)  {
-        reverse_ = rides_;
-        qSort(reverse_.begin(), reverse_.end(), rideCacheGreaterThan);
-        future = QtConcurrent::map(reverse_, itemRefresh);
-        watcher.setFuture(future);
-    }
+    stale_ = 0;
+    changed_ = 0;
+    reverse_ = rides_;
+    qSort(reverse_.begin(), reverse_.end(), rideCacheGreaterThan);
+    future = QtConcurrent::map(reverse_, RideCacheBackgroundRefresh(this));
+    watcher.setFuture(future);
 }
 
 QString
@@ -438,7 +505,7 @@ RideCache::getAggregate(QString name, Specification spec, bool useMetricUnits, b
     double rcount = 0; // using double to avoid rounding issues with int when dividing
 
     // loop through and aggregate
-    foreach (RideItem *item, rides()) {
+    foreach (RideItem *item, ridesIn(spec)) {
 
         // skip filtered rides
         if (!spec.pass(item)) continue;
@@ -527,7 +594,7 @@ RideCache::getBests(QString symbol, int n, Specification specification, bool use
     if (!metric) return results;
 
     // loop through and aggregate
-    foreach (RideItem *ride, rides_) {
+    foreach (RideItem *ride, ridesIn(specification)) {
 
         // skip filtered rides
         if (!specification.pass(ride)) continue;
@@ -817,6 +884,19 @@ RideCache::getDistinctValues(QString field)
     return returning;
 }
 
+QVector<RideItem*>
+RideCache::ridesIn(Specification specification)
+{
+    DateRange dr = specification.dateRange();
+
+    QVector<RideItem*>::const_iterator first = rides_.constBegin();
+    QVector<RideItem*>::const_iterator last = rides_.constEnd();
+    if (dr.from != QDate()) first = std::lower_bound(first, last, dr.from, rideBeforeDate);
+    if (dr.to != QDate()) last = std::upper_bound(first, last, dr.to, dateBeforeRide);
+
+    return rides_.mid(first - rides_.constBegin(), last - first);
+}
+
 void
 RideCache::getRideTypeCounts(Specification specification, int& nActivities,
                              int& nRides, int& nRuns, int& nSwims)
@@ -824,7 +904,7 @@ RideCache::getRideTypeCounts(Specification specification, int& nActivities,
     nActivities = nRides = nRuns = nSwims = 0;
 
     // loop through and aggregate
-    foreach (RideItem *ride, rides_) {
+    foreach (RideItem *ride, ridesIn(specification)) {
 
         // skip filtered rides
         if (!specification.pass(ride)) continue;
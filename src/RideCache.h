@@ -41,6 +41,7 @@ class RideCacheBackgroundRefresh;
 class Specification;
 class AthleteBest;
 class RideCacheModel;
+class RideDBStore;
 
 class RideCache : public QObject
 {
@@ -81,13 +82,24 @@ class RideCache : public QObject
         // the ride list
 	    QVector<RideItem*>&rides() { return rides_; } 
 
+        // the rides in the specification's date range, found by a binary
+        // search of the ride list (it is in date order). they still need
+        // to be checked against its filters
+        QVector<RideItem*> ridesIn(Specification specification);
+
         // add/remove a ride to the list
         void addRide(QString name, bool dosignal, bool useTempActivities);
         void removeCurrentRide();
 
+        // put the ride list back in date order when a ride's date changes
+        void sortRides();
+
         // export metrics in CSV format
         void writeAsCSV(QString filename);
 
+        // export the cache in the rideDB.json format
+        void writeAsJSON(QString filename);
+
         // the background refresher !
         void refresh();
         double progress() { return progress_; }
@@ -97,7 +109,7 @@ class RideCache : public QObject
 
     public slots:
 
-        // restore / dump cache to disk (json)
+        // restore / dump cache to disk (see RideDBStore)
         void load();
         void save();
 
@@ -116,6 +128,11 @@ class RideCache : public QObject
         // clear deleted objects
         void garbageCollect();
 
+        // background refresh found something stale / has finished
+        void refreshStarted();
+        void refreshUpdated(QDate);
+        void refreshFinished();
+
     signals:
 
         void modelProgress(int, int); // let others know when we're refreshing the model estimates
@@ -130,11 +147,14 @@ class RideCache : public QObject
         Context *context;
         QVector<RideItem*> rides_, reverse_, delete_;
         RideCacheModel *model_;
+        RideDBStore *store;
         bool exiting;
 	    double progress_; // percent
 
         QFuture<void> future;
         QFutureWatcher<void> watcher;
+        QAtomicInt stale_; // how many rides the refresh found stale
+        QAtomicInt changed_; // the refresh changed something that needs saving
 
 };
 
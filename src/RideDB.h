@@ -55,6 +55,9 @@ struct RideDBContext {
     HttpRequest *request;
     HttpResponse *response;
 
+    // ... or collecting a copy of the rides (RideDBStore only)
+    QList<RideItem*> *items;
+
     // the scanner
     void *scanner;
 
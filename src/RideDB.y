@@ -18,6 +18,7 @@
  */
 
 #include "RideDB.h"
+#include "RideDBStore.h"
 
 #ifdef GC_WANT_HTTP
 #include "APIWebService.h"
@@ -233,6 +234,25 @@ string: STRING                                               { jc->JsonString =
 void 
 RideCache::load()
 {
+    // create scanner context for reentrant parsing
+    RideDBContext *jc = new RideDBContext;
+    jc->cache = this;
+    jc->api = NULL;
+    jc->items = NULL;
+    jc->old = false;
+
+    // clean item
+    jc->item.path = context->athlete->home->activities().canonicalPath();
+    jc->item.context = context;
+    jc->item.isstale = jc->item.isdirty = jc->item.isedit = false;
+
+    // the binary store is much quicker, we only read
+    // rideDB.json when upgrading from an older version
+    if (store->read(jc) == true) {
+        delete jc;
+        return;
+    }
+
     // only load if it exists !
     QFile rideDB(QString("%1/rideDB.json").arg(context->athlete->home->cache().canonicalPath()));
     if (rideDB.exists() && rideDB.open(QFile::ReadOnly)) {
@@ -247,17 +267,6 @@ RideCache::load()
         QString contents = stream.readAll();
         rideDB.close();
 
-        // create scanner context for reentrant parsing
-        RideDBContext *jc = new RideDBContext;
-        jc->cache = this;
-        jc->api = NULL;
-        jc->old = false;
-
-        // clean item
-        jc->item.path = context->athlete->home->activities().canonicalPath();
-        jc->item.context = context;
-        jc->item.isstale = jc->item.isdirty = jc->item.isedit = false;
-
         RideDBlex_init(&scanner);
 
         // inform the parser/lexer we have a new file
@@ -276,12 +285,10 @@ RideCache::load()
 
         // clean up
         RideDBlex_destroy(scanner);
-
-        // regardless of errors we're done !
-        delete jc;
-
-        return;
     }
+
+    // regardless of errors we're done !
+    delete jc;
 }
 
 // Escape special characters (JSON compliance)
@@ -303,12 +310,28 @@ static QString protect(const QString string)
     return s;
 }
 
-// save cache to disk, "cache/rideDB.json"
+// save cache to disk, "cache/rideDB.bin", only the rides
+// that have changed since we last loaded or saved are written
 void RideCache::save()
+{
+    if (store->write(this) == false) return;
+
+    // a rideDB.json left from before the upgrade is out of date now,
+    // move it aside so it can't be read as if it were current
+    QString json = QString("%1/rideDB.json").arg(context->athlete->home->cache().canonicalPath());
+    if (QFile::exists(json)) {
+        QFile::remove(json + ".old");
+        if (!QFile::rename(json, json + ".old")) QFile::remove(json);
+    }
+}
+
+// export the cache as json, in the format that used to be saved
+// as "cache/rideDB.json" (see Tools menu)
+void RideCache::writeAsJSON(QString filename)
 {
 
     // now save data away
-    QFile rideDB(QString("%1/rideDB.json").arg(context->athlete->home->cache().canonicalPath()));
+    QFile rideDB(filename);
     if (rideDB.open(QFile::WriteOnly)) {
 
         const RideMetricFactory &factory = RideMetricFactory::instance();
@@ -469,21 +492,103 @@ void RideCache::save()
 
 #ifdef GC_WANT_HTTP
 #include "RideMetadata.h"
+#include <QFileInfo>
+
+void
+APIAthleteIndex::clear()
+{
+    // the ride items don't own their intervals
+    foreach(RideItem *item, rides) {
+        qDeleteAll(item->intervals());
+        delete item;
+    }
+    rides.clear();
+}
+
+// the rides for an athlete, read from the ride store the first time
+// they are asked for and again whenever the store has been saved
+APIAthleteIndexPtr
+APIWebService::athleteIndex(QString athlete)
+{
+    QString ridestore = QString("%1/%2/cache/rideDB.bin").arg(home.absolutePath()).arg(athlete);
+    QFileInfo info(ridestore);
+    if (!info.exists()) return APIAthleteIndexPtr();
+
+    APIAthleteIndexPtr index;
+    {
+        QMutexLocker locker(&indexLock);
+        index = indexes.value(athlete);
+        if (index.isNull()) {
+            index = APIAthleteIndexPtr(new APIAthleteIndex);
+            indexes.insert(athlete, index);
+        }
+
+        // forget the one asked for longest ago
+        recent.removeAll(athlete);
+        recent.prepend(athlete);
+        while (recent.count() > maxIndexes) indexes.remove(recent.takeLast());
+    }
+
+    // still current ?
+    {
+        QReadLocker locker(&index->lock);
+        if (index->modified == info.lastModified() && index->size == info.size()) return index;
+    }
+
+    QWriteLocker locker(&index->lock);
+
+    // another thread may have got there first
+    if (index->modified == info.lastModified() && index->size == info.size()) return index;
+
+    index->clear();
+
+    // create context to collect the rides
+    RideDBContext *jc = new RideDBContext;
+    jc->cache = NULL;
+    jc->api = NULL;
+    jc->items = &index->rides;
+    jc->response = NULL;
+    jc->request = NULL;
+    jc->old = false;
+
+    // clean item
+    jc->item.path = home.absolutePath() + "/" + athlete + "/activities";
+    jc->item.context = NULL;
+    jc->item.isstale = jc->item.isdirty = jc->item.isedit = false;
+
+    RideDBStore store(ridestore);
+    bool read = store.read(jc);
+    delete jc;
+
+    if (!read) {
+        // so the caller can fall back to rideDB.json, and we try again next time
+        qDebug()<<"api: cannot read ride store"<<ridestore;
+        index->clear();
+        index->modified = QDateTime();
+        index->size = -1;
+        return APIAthleteIndexPtr();
+    }
+
+    index->modified = info.lastModified();
+    index->size = info.size();
+    return index;
+}
 
 void
 APIWebService::listRides(QString athlete, HttpRequest &request, HttpResponse &response)
 {
     listRideSettings settings;
 
-    // the ride db
+    // the ride db, json is only there if we haven't saved since upgrading
     QString ridedb = QString("%1/%2/cache/rideDB.json").arg(home.absolutePath()).arg(athlete);
     QFile rideDB(ridedb);
+    QString ridestore = QString("%1/%2/cache/rideDB.bin").arg(home.absolutePath()).arg(athlete);
 
     // list activities and associated metrics
     response.setHeader("Content-Type", "text; charset=ISO-8859-1");
 
     // not known..
-    if (!rideDB.exists()) {
+    if (!rideDB.exists() && !QFile(ridestore).exists()) {
         response.setStatus(404);
         response.write("malformed URL or unknown athlete.\n");
         return;
@@ -608,8 +713,18 @@ APIWebService::listRides(QString athlete, HttpRequest &request, HttpResponse &re
         }
         response.bwrite("\n");
 
-        // parse the rideDB and write a line for each entry
-        if (rideDB.exists() && rideDB.open(QFile::ReadOnly)) {
+        // the rides are held in memory once the store has been read
+        APIAthleteIndexPtr index = athleteIndex(athlete);
+        if (index) {
+
+            QReadLocker locker(&index->lock);
+            foreach(RideItem *item, index->rides)
+                writeRideLine(*item, &request, &response);
+
+        } else if (rideDB.exists() && rideDB.open(QFile::ReadOnly)) {
+
+            // no store yet, so parse the rideDB.json and
+            // write a line for each entry as we go
 
             // ok, lets read it in
             QTextStream stream(&rideDB);
@@ -625,6 +740,7 @@ APIWebService::listRides(QString athlete, HttpRequest &request, HttpResponse &re
             RideDBContext *jc = new RideDBContext;
             jc->cache = NULL;
             jc->api = this;
+            jc->items = NULL;
             jc->response = &response;
             jc->request = &request;
             jc->old = false;
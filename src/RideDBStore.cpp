@@ -0,0 +1,527 @@
+/*
+ * Copyright (c) 2015 Mark Liversedge (liversedge@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "RideDBStore.h"
+#include "RideDB.h"
+#include "RideMetric.h"
+
+#ifdef GC_WANT_HTTP
+#include "APIWebService.h"
+#endif
+
+#include <QFile>
+#if QT_VERSION >= 0x050100
+#include <QSaveFile>
+#endif
+#include <QDataStream>
+#include <QDebug>
+#include <string.h> // memcpy, memcmp
+
+#ifdef Q_OS_WIN
+#include <io.h> // _commit
+#else
+#include <unistd.h> // fsync
+#endif
+
+// records and the directory are written with a fixed stream version
+// so they don't change when we build against a newer Qt
+static const int streamVersion = QDataStream::Qt_4_6;
+
+// make sure what we've written is on the disk before we point at it,
+// otherwise after a power cut the header can get there before the data
+static void
+syncToDisk(QFile &file)
+{
+    file.flush();
+#ifdef Q_OS_WIN
+    _commit(file.handle());
+#else
+    fsync(file.handle());
+#endif
+}
+
+RideDBStore::RideDBStore(QString filename) :
+    filename(filename), end(0), directorySize(0), garbage(0), valid(false)
+{
+}
+
+int
+RideDBStore::key(const QString &name)
+{
+    int index = keyIndex.value(name, -1);
+    if (index == -1) {
+        index = keys.count();
+        keys << name;
+        keyIndex.insert(name, index);
+    }
+    return index;
+}
+
+//
+// READING
+//
+
+// metrics are stored at the index they had when written, which will
+// only differ from the current index when metrics are added or removed
+static void readMetrics(QDataStream &in, QVector<double> &into, const QVector<int> &mapping, bool same, QVector<double> &buffer)
+{
+    quint32 count;
+    in >> count;
+
+    if (same && int(count) == into.size()) {
+        in.readRawData((char *) into.data(), sizeof(double) * count);
+        return;
+    }
+
+    buffer.resize(count);
+    in.readRawData((char *) buffer.data(), sizeof(double) * count);
+    for (int i=0; i<buffer.size() && i<mapping.size(); i++)
+        if (mapping[i] >= 0 && mapping[i] < into.size()) into[mapping[i]] = buffer[i];
+}
+
+bool
+RideDBStore::read(RideDBContext *jc)
+{
+    QFile file(filename);
+    if (!file.exists() || file.size() < (int)sizeof(struct RideDBStoreHeader)) return false;
+    if (file.open(QIODevice::ReadOnly) == false) return false;
+
+    // map the whole thing, it is only read once
+    quint64 size = file.size();
+    const char *map = (const char *) file.map(0, size);
+    if (map == NULL) {
+        file.close();
+        return false;
+    }
+
+    RideDBStoreHeader head;
+    memcpy(&head, map, sizeof(head));
+
+    if (memcmp(head.magic, "GCDB", 4) || head.version != RideDBStoreVersion ||
+        head.directory + head.directorySize > size) {
+        file.unmap((uchar *) map);
+        file.close();
+        return false;
+    }
+
+    // the directory
+    QString version;
+    QStringList names, strings;
+    QStringList order;
+    QHash<QString, Entry> loaded;
+
+    QByteArray dir = QByteArray::fromRawData(map + head.directory, head.directorySize);
+    QDataStream in(dir);
+    in.setVersion(streamVersion);
+
+    quint32 count;
+    in >> version >> names >> strings >> count;
+    for (quint32 i=0; i<count && in.status() == QDataStream::Ok; i++) {
+        QString name;
+        Entry entry;
+        in >> name >> entry.offset >> entry.size >> entry.hash;
+        if (entry.offset + entry.size > size) continue;
+        loaded.insert(name, entry);
+        order << name;
+    }
+
+    if (in.status() != QDataStream::Ok) {
+        file.unmap((uchar *) map);
+        file.close();
+        return false;
+    }
+
+    // older ridedb means metrics need refreshing
+    if (version != RIDEDB_VERSION) {
+        jc->old = true;
+        jc->item.isstale = true; // force refresh after load
+    }
+
+    // metrics may have been added or removed since it was written
+    const RideMetricFactory &factory = RideMetricFactory::instance();
+    QVector<int> mapping(names.count());
+    bool same = names.count() == factory.metricCount();
+    for (int i=0; i<names.count(); i++) {
+        const RideMetric *m = factory.rideMetric(names[i]);
+        mapping[i] = m ? m->index() : -1;
+        if (mapping[i] != i) same = false;
+    }
+
+    // rather than a serial search for every ride
+    QHash<QString, RideItem*> rides;
+    if (jc->cache) foreach(RideItem *item, jc->cache->rides()) rides.insert(item->fileName, item);
+
+    QVector<double> buffer;
+    foreach(QString name, order) {
+
+        const Entry &entry = loaded[name];
+        QByteArray record = QByteArray::fromRawData(map + entry.offset, entry.size);
+        QDataStream in(record);
+        in.setVersion(streamVersion);
+
+        // ride state
+        qint64 date;
+        quint64 fingerprint, crc, metacrc, timestamp;
+        qint32 dbversion;
+        QString color;
+        bool samples;
+
+        RideItem &item = jc->item;
+        in >> item.fileName >> date >> fingerprint >> crc >> metacrc >> timestamp >> dbversion
+           >> color >> item.present >> item.isRun >> item.isSwim >> item.weight >> item.overrides_ >> samples;
+
+        item.dateTime = QDateTime::fromMSecsSinceEpoch(date);
+        item.fingerprint = fingerprint;
+        item.crc = crc;
+        item.metacrc = metacrc;
+        item.timestamp = timestamp;
+        item.dbversion = dbversion;
+        item.color = QColor(color);
+        item.samples = samples;
+
+        readMetrics(in, item.metrics(), mapping, same, buffer);
+
+        // metadata
+        quint32 tags;
+        in >> tags;
+        for (quint32 i=0; i<tags && in.status() == QDataStream::Ok; i++) {
+            quint32 key;
+            QString value;
+            in >> key >> value;
+            if (int(key) < strings.count()) item.metadata().insert(strings[key], value);
+        }
+
+        // intervals
+        quint32 intervals;
+        in >> intervals;
+        for (quint32 i=0; i<intervals && in.status() == QDataStream::Ok; i++) {
+
+            IntervalItem &interval = jc->interval;
+            qint32 type, seq;
+            QString color, route;
+
+            in >> interval.name >> interval.start >> interval.stop >> interval.startKM >> interval.stopKM
+               >> type >> color >> seq >> route;
+
+            interval.type = static_cast<RideFileInterval::intervaltype>(type);
+            interval.color = QColor(color);
+            interval.displaySequence = seq;
+            interval.route = route == "" ? QUuid() : QUuid(route);
+
+            readMetrics(in, interval.metrics(), mapping, same, buffer);
+
+            item.addInterval(interval);
+            interval.metrics().fill(0.0f);
+        }
+
+        bool used = false;
+        if (in.status() != QDataStream::Ok) {
+
+            qDebug()<<"bad record in rideDB.bin:"<<name;
+
+        } else if (jc->items != NULL) {
+
+            // keeping a copy, it takes the intervals
+            RideItem *copy = new RideItem();
+            copy->setFrom(item);
+            jc->items->append(copy);
+            used = true;
+
+        } else if (jc->api != NULL) {
+
+#ifdef GC_WANT_HTTP
+            // we're listing rides in the api
+            jc->api->writeRideLine(item, jc->request, jc->response);
+#endif
+
+        } else {
+
+            // we're loading the cache
+            RideItem *here = rides.value(item.fileName, NULL);
+            if (here) {
+                // update from our loaded value
+                here->setFrom(item);
+                used = true;
+            } else {
+                qDebug()<<"unable to load:"<<item.fileName<<item.dateTime<<item.weight;
+            }
+        }
+
+        // intervals belong to the ride item if it took them
+        if (!used) qDeleteAll(item.intervals());
+
+        // now set our ride item clean again, so we don't
+        // overwrite with prior data
+        item.metadata().clear();
+        item.metrics().fill(0.0f);
+        jc->interval.metrics().fill(0.0f);
+        jc->interval.route = QUuid();
+        item.clearIntervals();
+        item.overrides_.clear();
+        item.fileName = "";
+    }
+
+    file.unmap((uchar *) map);
+    file.close();
+
+    // remember what is on disk so we only write changes
+    entries = loaded;
+    metricNames = names;
+    keys = strings;
+    keyIndex.clear();
+    for (int i=0; i<keys.count(); i++) keyIndex.insert(keys[i], i);
+    end = head.directory + head.directorySize;
+    directorySize = head.directorySize;
+    garbage = head.garbage;
+    valid = true;
+
+    return true;
+}
+
+//
+// WRITING
+//
+void
+RideDBStore::serialize(RideItem *item, QByteArray &record)
+{
+    QDataStream out(&record, QIODevice::WriteOnly);
+    out.setVersion(streamVersion);
+
+    // ride state
+    out << item->fileName << qint64(item->dateTime.toMSecsSinceEpoch())
+        << quint64(item->fingerprint) << quint64(item->crc) << quint64(item->metacrc) << quint64(item->timestamp)
+        << qint32(item->dbversion) << item->color.name() << item->present
+        << item->isRun << item->isSwim << item->weight << item->overrides_ << item->samples;
+
+    // pre-computed metrics, at their index
+    out << quint32(item->metrics().count());
+    out.writeRawData((const char *) item->metrics().constData(), sizeof(double) * item->metrics().count());
+
+    // pre-loaded metadata
+    out << quint32(item->metadata().count());
+    QMap<QString,QString>::const_iterator i;
+    for (i=item->metadata().constBegin(); i != item->metadata().constEnd(); i++)
+        out << quint32(key(i.key())) << i.value();
+
+    // intervals
+    out << quint32(item->intervals().count());
+    foreach(IntervalItem *interval, item->intervals()) {
+
+        out << interval->name << interval->start << interval->stop << interval->startKM << interval->stopKM
+            << qint32(interval->type) << interval->color.name() << qint32(interval->displaySequence)
+            << (interval->type == RideFileInterval::ROUTE ? interval->route.toString() : QString(""));
+
+        out << quint32(interval->metrics().count());
+        out.writeRawData((const char *) interval->metrics().constData(), sizeof(double) * interval->metrics().count());
+    }
+}
+
+QByteArray
+RideDBStore::directory(const QStringList &order, const QHash<QString, Entry> &updated)
+{
+    QByteArray returning;
+    QDataStream out(&returning, QIODevice::WriteOnly);
+    out.setVersion(streamVersion);
+
+    out << QString(RIDEDB_VERSION) << RideMetricFactory::instance().allMetrics() << keys << quint32(order.count());
+    foreach(QString name, order) {
+        const Entry &entry = updated[name];
+        out << name << entry.offset << entry.size << entry.hash;
+    }
+    return returning;
+}
+
+bool
+RideDBStore::write(RideCache *cache)
+{
+    QStringList order;
+    QList<QByteArray> records;
+
+    foreach(RideItem *item, cache->rides()) {
+
+        // skip if not loaded/refreshed, a special case
+        // if saving during an initial refresh
+        if (item->metrics().count() == 0) continue;
+
+        // don't save files with discarded changes at exit
+        if (item->skipsave == true) continue;
+
+        QByteArray record;
+        serialize(item, record);
+
+        order << item->fileName;
+        records << record;
+    }
+
+    // if the metrics have changed all the records need rewriting
+    if (!valid || metricNames != RideMetricFactory::instance().allMetrics() || !QFile(filename).exists())
+        return rewrite(order, records);
+
+    // which have changed ?
+    QHash<QString, Entry> updated;
+    QList<int> changed;
+    quint64 live = 0;
+    quint64 unused = garbage + directorySize;
+
+    for (int i=0; i<order.count(); i++) {
+
+        Entry entry;
+        entry.size = records[i].size();
+        entry.hash = qHash(records[i]);
+        live += entry.size;
+
+        QHash<QString, Entry>::const_iterator old = entries.find(order[i]);
+        if (old != entries.constEnd() && old.value().size == entry.size && old.value().hash == entry.hash) {
+            updated.insert(order[i], old.value());
+        } else {
+            if (old != entries.constEnd()) unused += old.value().size;
+            updated.insert(order[i], entry);
+            changed << i;
+        }
+    }
+
+    // and any that were deleted
+    QHash<QString, Entry>::const_iterator i;
+    for (i=entries.constBegin(); i != entries.constEnd(); i++)
+        if (!updated.contains(i.key())) unused += i.value().size;
+
+    // nothing to do
+    if (changed.count() == 0 && updated.count() == entries.count()) return true;
+
+    // mostly garbage, so start again
+    if (unused > live) return rewrite(order, records);
+
+    QFile file(filename);
+    if (file.open(QIODevice::ReadWrite) == false) {
+        qDebug()<<"cannot write"<<filename;
+        return false;
+    }
+
+    // append the rides that have changed
+    file.seek(end);
+    foreach(int index, changed) {
+        updated[order[index]].offset = file.pos();
+        file.write(records[index]);
+    }
+
+    // then the new directory
+    QByteArray dir = directory(order, updated);
+    quint64 dirOffset = file.pos();
+    file.write(dir);
+    file.resize(file.pos()); // anything after is left from a crash
+    syncToDisk(file);
+
+    // only now point at it
+    RideDBStoreHeader head;
+    memset(&head, 0, sizeof(head)); // padding too, it goes to disk
+    memcpy(head.magic, "GCDB", 4);
+    head.version = RideDBStoreVersion;
+    head.directory = dirOffset;
+    head.directorySize = dir.size();
+    head.rides = order.count();
+    head.garbage = unused;
+
+    file.seek(0);
+    file.write((const char *) &head, sizeof(head));
+    syncToDisk(file);
+    file.close();
+
+    entries = updated;
+    end = dirOffset + dir.size();
+    directorySize = dir.size();
+    garbage = unused;
+
+    return true;
+}
+
+bool
+RideDBStore::rewrite(const QStringList &order, const QList<QByteArray> &records)
+{
+    // write alongside and swap over when done, so there is always
+    // a complete store on disk whenever we crash
+#if QT_VERSION >= 0x050100
+    QSaveFile file(filename);
+#else
+    QString tmpname = filename + ".tmp";
+    QFile file(tmpname);
+#endif
+    if (file.open(QIODevice::WriteOnly | QIODevice::Truncate) == false) {
+        qDebug()<<"cannot write"<<file.fileName();
+        return false;
+    }
+
+    // header goes at the front, fill it in at the end
+    RideDBStoreHeader head;
+    memset(&head, 0, sizeof(head));
+    file.write((const char *) &head, sizeof(head));
+
+    QHash<QString, Entry> updated;
+    for (int i=0; i<order.count(); i++) {
+        Entry entry;
+        entry.offset = file.pos();
+        entry.size = records[i].size();
+        entry.hash = qHash(records[i]);
+        updated.insert(order[i], entry);
+
+        file.write(records[i]);
+    }
+
+    QByteArray dir = directory(order, updated);
+    quint64 dirOffset = file.pos();
+    file.write(dir);
+
+    memcpy(head.magic, "GCDB", 4);
+    head.version = RideDBStoreVersion;
+    head.directory = dirOffset;
+    head.directorySize = dir.size();
+    head.rides = order.count();
+    head.garbage = 0;
+
+    file.seek(0);
+    file.write((const char *) &head, sizeof(head));
+
+    // swap over, QSaveFile syncs and renames over the old one in one go
+#if QT_VERSION >= 0x050100
+    if (!file.commit()) {
+        qDebug()<<"cannot replace"<<filename<<file.errorString();
+        valid = false;
+        return false;
+    }
+#else
+    syncToDisk(file);
+    file.close();
+
+    // no atomic replace before Qt 5.1 so there is a moment without one,
+    // but the old store is only a cache and gets rebuilt from the rides
+    QFile::remove(filename);
+    if (!QFile::rename(tmpname, filename)) {
+        qDebug()<<"cannot rename"<<tmpname<<"to"<<filename;
+        valid = false;
+        return false;
+    }
+#endif
+
+    entries = updated;
+    metricNames = RideMetricFactory::instance().allMetrics();
+    end = dirOffset + dir.size();
+    directorySize = dir.size();
+    garbage = 0;
+    valid = true;
+
+    return true;
+}
@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2015 Mark Liversedge (liversedge@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _GC_RideDBStore_h
+#define _GC_RideDBStore_h 1
+#include "GoldenCheetah.h"
+
+#include <QString>
+#include <QStringList>
+#include <QHash>
+#include <QByteArray>
+
+class RideCache;
+class RideItem;
+struct RideDBContext;
+
+// The ride store (cache/rideDB.bin) is a binary replacement for
+// cache/rideDB.json, which is now only read when upgrading. It is
+// moved aside to rideDB.json.old once the store has been written, and
+// can still be written as an export (RideCache::writeAsJSON).
+//
+// Each ride is a self contained record, its metrics are held as a
+// raw array at RideMetric::index() offsets and its metadata keys
+// refer to a string table in the directory. On save only the rides
+// whose record has changed are appended, followed by a new directory
+// and then the header is updated to point at it. So if we crash part
+// way through the old directory is still intact and the file is still
+// good. When over half the file is unused it is rewritten in full.
+//
+// The file is memory mapped when it is read.
+//
+static const unsigned int RideDBStoreVersion = 1;
+// revision history:
+// version  date         description
+// 1        07-Sep-15    Initial - header, records and directory
+
+// The file has a binary format:
+// 1 x Header - fixed layout, always at the start of the file
+// n x Records - one for each ride, written with QDataStream
+// 1 x Directory - ridedb version, metric names in index order, metadata
+//                 key string table and an entry for each ride record
+//
+// As with the .cpx files these are local caches so we do not worry
+// about endianness
+struct RideDBStoreHeader {
+
+    char magic[4];          // "GCDB"
+    unsigned int version;   // RideDBStoreVersion
+
+    quint64 directory;      // where the directory starts
+    quint32 directorySize;  // and how long it is
+    quint32 rides;          // entries in the directory
+    quint64 garbage;        // bytes no longer referenced
+};
+
+class RideDBStore
+{
+    public:
+        RideDBStore(QString filename);
+
+        // read every ride in the store, each one is loaded into jc->item
+        // and then either updates the ride cache, is copied to jc->items
+        // or writes an api line, much like the rideDB.json parser.
+        // returns false if there is no usable store, e.g. first run
+        // after upgrading
+        bool read(RideDBContext *jc);
+
+        // write the rides in the cache that have changed
+        bool write(RideCache *cache);
+
+    private:
+
+        struct Entry {
+            quint64 offset;
+            quint32 size;
+            uint hash;
+        };
+
+        // rides as they are in the file on disk
+        QString filename;
+        QHash<QString, Entry> entries;
+        QStringList metricNames; // in index order when written
+        quint64 end;             // where the next record goes
+        quint32 directorySize;   // the current directory becomes garbage on save
+        quint64 garbage;
+        bool valid;              // the above reflect the file on disk
+
+        // metadata key string table
+        QStringList keys;
+        QHash<QString, int> keyIndex;
+        int key(const QString &name);
+
+        void serialize(RideItem *item, QByteArray &record);
+        QByteArray directory(const QStringList &order, const QHash<QString, Entry> &updated);
+
+        // write the whole file from scratch
+        bool rewrite(const QStringList &order, const QList<QByteArray> &records);
+};
+
+#endif // _GC_RideDBStore_h
@@ -55,6 +55,9 @@ RideFile::RideFile(const QDateTime &startTime, double recIntSecs) :
             weight_(0), totalCount(0), totalTemp(0), dstale(true)
 {
     command = new RideFileCommand(this);
+    columns_ = new RideFileColumns(this);
+    parent_ = NULL;
+    offset_ = 0;
 
     minPoint = new RideFilePoint();
     maxPoint = new RideFilePoint();
@@ -79,6 +82,9 @@ RideFile::RideFile(RideFile *p) :
     context = p->context;
 
     command = new RideFileCommand(this);
+    columns_ = new RideFileColumns(this);
+    parent_ = NULL;
+    offset_ = 0;
     minPoint = new RideFilePoint();
     maxPoint = new RideFilePoint();
     avgPoint = new RideFilePoint();
@@ -86,11 +92,45 @@ RideFile::RideFile(RideFile *p) :
 
 }
 
+// construct a view over a range of samples in another ride, again
+// mostly used when computing interval metrics. The points (and columns)
+// belong to the parent and are shared not copied, so the view must not
+// outlive the parent or be modified.
+RideFile::RideFile(const RideFile *p, int start, int count) :
+    wstale(true), recIntSecs_(p->recIntSecs_), deviceType_(p->deviceType_), data(NULL), wprime_(NULL), 
+    weight_(p->weight_), totalCount(0), totalTemp(0), dstale(false)
+{
+    startTime_ = p->startTime_;
+    tags_ = p->tags_;
+    referencePoints_ = p->referencePoints_;
+    fileFormat_ = p->fileFormat_;
+    intervals_ = p->intervals_;
+    calibrations_ = p->calibrations_;
+    context = p->context;
+
+    command = new RideFileCommand(this);
+    columns_ = new RideFileColumns(this);
+    parent_ = p;
+    offset_ = start;
+    minPoint = new RideFilePoint();
+    maxPoint = new RideFilePoint();
+    avgPoint = new RideFilePoint();
+    totalPoint = new RideFilePoint();
+
+    // share the points and work out what is present
+    // and the min/max/avg for just this range
+    dataPoints_ = p->dataPoints_.mid(start, count);
+    foreach(RideFilePoint *point, dataPoints_) updatePresent(point);
+}
+
 RideFile::RideFile() : 
     wstale(true), recIntSecs_(0.0), deviceType_("unknown"), data(NULL), wprime_(NULL), 
     weight_(0), totalCount(0), dstale(true)
 {
     command = new RideFileCommand(this);
+    columns_ = new RideFileColumns(this);
+    parent_ = NULL;
+    offset_ = 0;
 
     minPoint = new RideFilePoint();
     maxPoint = new RideFilePoint();
@@ -101,35 +141,53 @@ RideFile::RideFile() :
 RideFile::~RideFile()
 {
     emit deleted();
-    foreach(RideFilePoint *point, dataPoints_)
-        delete point;
+    if (!parent_) { // views don't own their points
+        foreach(RideFilePoint *point, dataPoints_)
+            delete point;
+    }
     //foreach(RideFileCalibration *calibration, calibrations_)
         //delete calibration;
     //foreach(RideFileInterval *interval, intervals_)
         //delete interval;
     delete command;
+    delete columns_;
     if (wprime_) delete wprime_;
     //!!! if (data) delete data; // need a mechanism to notify the editor
 }
 
-unsigned int
-RideFile::computeFileCRC(QString filename)
+// FNV-1a over the file contents, read a chunk at a time so we don't
+// need to hold the whole file in memory. 64 bits so edits don't get
+// missed as they could with the old 16 bit qChecksum
+quint64
+RideFile::computeFileHash(QString filename)
 {
     QFile file(filename);
-    QFileInfo fileinfo(file);
 
     // open file
     if (!file.open(QFile::ReadOnly)) return 0;
 
-    // allocate space
-    QScopedArrayPointer<char> data(new char[file.size()]);
+    quint64 hash = Q_UINT64_C(14695981039346656037);
+    QScopedArrayPointer<char> chunk(new char[65536]);
 
-    // read entire file into memory
-    QDataStream *rawstream(new QDataStream(&file));
-    rawstream->readRawData(&data[0], file.size());
+    qint64 n;
+    while ((n = file.read(&chunk[0], 65536)) > 0) {
+        const unsigned char *p = reinterpret_cast<const unsigned char *>(&chunk[0]);
+        for (qint64 i=0; i<n; i++) {
+            hash ^= p[i];
+            hash *= Q_UINT64_C(1099511628211);
+        }
+    }
     file.close();
 
-    return qChecksum(&data[0], file.size());
+    return hash;
+}
+
+// the ridefilecache header only has room for 32 bits
+unsigned int
+RideFile::computeFileCRC(QString filename)
+{
+    quint64 hash = computeFileHash(filename);
+    return static_cast<unsigned int>(hash ^ (hash >> 32));
 }
 
 WPrime *
@@ -585,123 +643,128 @@ RideFile *RideFileFactory::openRideFile(Context *context, QFile &file,
 //qDebug()<<"open"<<file.fileName()<<"end:"<<QDateTime::currentDateTime().toString("hh:mm:ss.zzz");
 
     // NULL returned to indicate openRide failed
-    if (result) {
-        result->context = context;
+    if (result) setupRideFile(context, result, file.fileName());
 
-        if (result->intervals().empty()) result->fillInIntervals();
-        // override the file ride time with that set from the filename
-        // but only if it matches the GC format
-        QFileInfo fileInfo(file.fileName());
-        QRegExp rx ("^((\\d\\d\\d\\d)_(\\d\\d)_(\\d\\d)_(\\d\\d)_(\\d\\d)_(\\d\\d))\\.(.+)$");
+    return result;
+}
 
-        if (rx.exactMatch(fileInfo.fileName())) {
+// everything we do to a ride once the reader has parsed it, also
+// used for rides that are read from memory (see FileStore)
+void
+RideFileFactory::setupRideFile(Context *context, RideFile *result, QString filename) const
+{
+    result->context = context;
 
-            QDate date(rx.cap(2).toInt(), rx.cap(3).toInt(),rx.cap(4).toInt());
-            QTime time(rx.cap(5).toInt(), rx.cap(6).toInt(),rx.cap(7).toInt());
-            QDateTime datetime(date, time);
-            result->setStartTime(datetime);
-        }
+    if (result->intervals().empty()) result->fillInIntervals();
+    // override the file ride time with that set from the filename
+    // but only if it matches the GC format
+    QFileInfo fileInfo(filename);
+    QRegExp rx ("^((\\d\\d\\d\\d)_(\\d\\d)_(\\d\\d)_(\\d\\d)_(\\d\\d)_(\\d\\d))\\.(.+)$");
 
-        // legacy support for .notes file
-        QString notesFileName = fileInfo.canonicalPath() + '/' + fileInfo.baseName() + ".notes";
-        QFile notesFile(notesFileName);
+    if (rx.exactMatch(fileInfo.fileName())) {
 
-        // read it in if it exists and "Notes" is not already set
-        if (result->getTag("Notes", "") == "" && notesFile.exists() &&
-            notesFile.open(QFile::ReadOnly | QFile::Text)) {
-            QTextStream in(&notesFile);
-            result->setTag("Notes", in.readAll());
-            notesFile.close();
-        }
+        QDate date(rx.cap(2).toInt(), rx.cap(3).toInt(),rx.cap(4).toInt());
+        QTime time(rx.cap(5).toInt(), rx.cap(6).toInt(),rx.cap(7).toInt());
+        QDateTime datetime(date, time);
+        result->setStartTime(datetime);
+    }
 
-        // Construct the summary text used on the calendar
-        QString calendarText;
-        if (context) { // will be null in standalone open
-            foreach (FieldDefinition field, context->athlete->rideMetadata()->getFields()) {
-                if (field.diary == true && result->getTag(field.name, "") != "") {
-                    calendarText += field.calendarText(result->getTag(field.name, ""));
-                }
-            }
-        }
-        result->setTag("Calendar Text", calendarText);
-
-        // set other "special" fields
-        result->setTag("Filename", QFileInfo(file.fileName()).fileName());
-        result->setTag("Device", result->deviceType());
-        result->setTag("File Format", result->fileFormat());
-        if (context) result->setTag("Athlete", context->athlete->cyclist);
-        result->setTag("Year", result->startTime().toString("yyyy"));
-        result->setTag("Month", result->startTime().toString("MMMM"));
-        result->setTag("Weekday", result->startTime().toString("ddd"));
-
-        // reset timestamps and distances to always start from zero
-        double timeOffset=0.00f, kmOffset=0.00f;
-        if (result->dataPoints().count()) {
-            timeOffset=result->dataPoints()[0]->secs;
-            kmOffset=result->dataPoints()[0]->km;
-        }
+    // legacy support for .notes file
+    QString notesFileName = fileInfo.canonicalPath() + '/' + fileInfo.baseName() + ".notes";
+    QFile notesFile(notesFileName);
 
-        // drag back samples
-        if (timeOffset || kmOffset) {
-            foreach (RideFilePoint *p, result->dataPoints()) {
-                p->km = p->km - kmOffset;
-                p->secs = p->secs - timeOffset;
+    // read it in if it exists and "Notes" is not already set
+    if (result->getTag("Notes", "") == "" && notesFile.exists() &&
+        notesFile.open(QFile::ReadOnly | QFile::Text)) {
+        QTextStream in(&notesFile);
+        result->setTag("Notes", in.readAll());
+        notesFile.close();
+    }
+
+    // Construct the summary text used on the calendar
+    QString calendarText;
+    if (context) { // will be null in standalone open
+        foreach (FieldDefinition field, context->athlete->rideMetadata()->getFields()) {
+            if (field.diary == true && result->getTag(field.name, "") != "") {
+                calendarText += field.calendarText(result->getTag(field.name, ""));
             }
         }
+    }
+    result->setTag("Calendar Text", calendarText);
+
+    // set other "special" fields
+    result->setTag("Filename", QFileInfo(filename).fileName());
+    result->setTag("Device", result->deviceType());
+    result->setTag("File Format", result->fileFormat());
+    if (context) result->setTag("Athlete", context->athlete->cyclist);
+    result->setTag("Year", result->startTime().toString("yyyy"));
+    result->setTag("Month", result->startTime().toString("MMMM"));
+    result->setTag("Weekday", result->startTime().toString("ddd"));
+
+    // reset timestamps and distances to always start from zero
+    double timeOffset=0.00f, kmOffset=0.00f;
+    if (result->dataPoints().count()) {
+        timeOffset=result->dataPoints()[0]->secs;
+        kmOffset=result->dataPoints()[0]->km;
+    }
 
-        // drag back intervals
-        foreach(RideFileInterval *i, result->intervals()) {
-            i->start -= timeOffset;
-            i->stop -= timeOffset;
+    // drag back samples
+    if (timeOffset || kmOffset) {
+        foreach (RideFilePoint *p, result->dataPoints()) {
+            p->km = p->km - kmOffset;
+            p->secs = p->secs - timeOffset;
         }
+    }
 
-        // calculate derived data series -- after data fixers applied above
-        if (context) result->recalculateDerivedSeries();
-
-        // what data is present - after processor in case 'derived' or adjusted
-        QString flags;
-
-        if (result->areDataPresent()->secs) flags += 'T'; // time
-        else flags += '-';
-        if (result->areDataPresent()->km) flags += 'D'; // distance
-        else flags += '-';
-        if (result->areDataPresent()->kph) flags += 'S'; // speed
-        else flags += '-';
-        if (result->areDataPresent()->watts) flags += 'P'; // Power
-        else flags += '-';
-        if (result->areDataPresent()->hr) flags += 'H'; // Heartrate
-        else flags += '-';
-        if (result->areDataPresent()->cad) flags += 'C'; // cadence
-        else flags += '-';
-        if (result->areDataPresent()->nm) flags += 'N'; // Torque
-        else flags += '-';
-        if (result->areDataPresent()->alt) flags += 'A'; // Altitude
-        else flags += '-';
-        if (result->areDataPresent()->lat ||
-            result->areDataPresent()->lon ) flags += 'G'; // GPS
-        else flags += '-';
-        if (result->areDataPresent()->slope) flags += 'L'; // Slope
-        else flags += '-';
-        if (result->areDataPresent()->headwind) flags += 'W'; // Windspeed
-        else flags += '-';
-        if (result->areDataPresent()->temp) flags += 'E'; // Temperature
-        else flags += '-';
-        if (result->areDataPresent()->lrbalance) flags += 'V'; // V for "Vector" aka lr pedal data
-        else flags += '-';
-        if (result->areDataPresent()->smo2 ||
-            result->areDataPresent()->thb) flags += 'O'; // Moxy O2/Haemoglobin
-        else flags += '-';
-        if (result->areDataPresent()->rcontact ||
-            result->areDataPresent()->rvert ||
-            result->areDataPresent()->rcontact) flags += 'R'; // R is for running dynamics
-        else flags += '-';
-        result->setTag("Data", flags);
-
-        //foreach(RideFile::seriestype x, result->arePresent()) qDebug()<<"present="<<x;
-
+    // drag back intervals
+    foreach(RideFileInterval *i, result->intervals()) {
+        i->start -= timeOffset;
+        i->stop -= timeOffset;
     }
 
-    return result;
+    // calculate derived data series -- after data fixers applied above
+    if (context) result->recalculateDerivedSeries();
+
+    // what data is present - after processor in case 'derived' or adjusted
+    QString flags;
+
+    if (result->areDataPresent()->secs) flags += 'T'; // time
+    else flags += '-';
+    if (result->areDataPresent()->km) flags += 'D'; // distance
+    else flags += '-';
+    if (result->areDataPresent()->kph) flags += 'S'; // speed
+    else flags += '-';
+    if (result->areDataPresent()->watts) flags += 'P'; // Power
+    else flags += '-';
+    if (result->areDataPresent()->hr) flags += 'H'; // Heartrate
+    else flags += '-';
+    if (result->areDataPresent()->cad) flags += 'C'; // cadence
+    else flags += '-';
+    if (result->areDataPresent()->nm) flags += 'N'; // Torque
+    else flags += '-';
+    if (result->areDataPresent()->alt) flags += 'A'; // Altitude
+    else flags += '-';
+    if (result->areDataPresent()->lat ||
+        result->areDataPresent()->lon ) flags += 'G'; // GPS
+    else flags += '-';
+    if (result->areDataPresent()->slope) flags += 'L'; // Slope
+    else flags += '-';
+    if (result->areDataPresent()->headwind) flags += 'W'; // Windspeed
+    else flags += '-';
+    if (result->areDataPresent()->temp) flags += 'E'; // Temperature
+    else flags += '-';
+    if (result->areDataPresent()->lrbalance) flags += 'V'; // V for "Vector" aka lr pedal data
+    else flags += '-';
+    if (result->areDataPresent()->smo2 ||
+        result->areDataPresent()->thb) flags += 'O'; // Moxy O2/Haemoglobin
+    else flags += '-';
+    if (result->areDataPresent()->rcontact ||
+        result->areDataPresent()->rvert ||
+        result->areDataPresent()->rcontact) flags += 'R'; // R is for running dynamics
+    else flags += '-';
+    result->setTag("Data", flags);
+
+    //foreach(RideFile::seriestype x, result->arePresent()) qDebug()<<"present="<<x;
 }
 
 QStringList RideFileFactory::listRideFiles(const QDir &dir) const
@@ -1021,42 +1084,48 @@ void RideFile::appendPoint(double secs, double cad, double hr, double km,
                                              rvert, rcad, rcontact, tcore,
                                              interval);
     dataPoints_.append(point);
-
-    dataPresent.secs     |= (secs != 0);
-    dataPresent.cad      |= (cad != 0);
-    dataPresent.hr       |= (hr != 0);
-    dataPresent.km       |= (km != 0);
-    dataPresent.kph      |= (kph != 0);
-    dataPresent.nm       |= (nm != 0);
-    dataPresent.watts    |= (watts != 0);
-    dataPresent.alt      |= (alt != 0);
-    dataPresent.lon      |= (lon != 0);
-    dataPresent.lat      |= (lat != 0);
-    dataPresent.headwind |= (headwind != 0);
-    dataPresent.slope    |= (slope != 0);
-    dataPresent.temp     |= (temp != NoTemp);
-    dataPresent.lrbalance|= (lrbalance != 0);
-    dataPresent.lte      |= (lte != 0);
-    dataPresent.rte      |= (rte != 0);
-    dataPresent.lps      |= (lps != 0);
-    dataPresent.rps      |= (rps != 0);
-    dataPresent.lpco     |= (lpco != 0);
-    dataPresent.rpco     |= (rpco != 0);
-    dataPresent.lppb     |= (lppb != 0);
-    dataPresent.rppb     |= (rppb != 0);
-    dataPresent.lppe     |= (lppe != 0);
-    dataPresent.rppe     |= (rppe != 0);
-    dataPresent.lpppb    |= (lpppb != 0);
-    dataPresent.rpppb    |= (rpppb != 0);
-    dataPresent.lpppe    |= (lpppe != 0);
-    dataPresent.rpppe    |= (rpppe != 0);
-    dataPresent.smo2     |= (smo2 != 0);
-    dataPresent.thb      |= (thb != 0);
-    dataPresent.rvert    |= (rvert != 0);
-    dataPresent.rcad     |= (rcad != 0);
-    dataPresent.rcontact |= (rcontact != 0);
-    dataPresent.tcore    |= (tcore != 0);
-    dataPresent.interval |= (interval != 0);
+    columns_->invalidate();
+
+    updatePresent(point);
+}
+
+void RideFile::updatePresent(RideFilePoint *point)
+{
+    dataPresent.secs     |= (point->secs != 0);
+    dataPresent.cad      |= (point->cad != 0);
+    dataPresent.hr       |= (point->hr != 0);
+    dataPresent.km       |= (point->km != 0);
+    dataPresent.kph      |= (point->kph != 0);
+    dataPresent.nm       |= (point->nm != 0);
+    dataPresent.watts    |= (point->watts != 0);
+    dataPresent.alt      |= (point->alt != 0);
+    dataPresent.lon      |= (point->lon != 0);
+    dataPresent.lat      |= (point->lat != 0);
+    dataPresent.headwind |= (point->headwind != 0);
+    dataPresent.slope    |= (point->slope != 0);
+    dataPresent.temp     |= (point->temp != NoTemp);
+    dataPresent.lrbalance|= (point->lrbalance != 0);
+    dataPresent.lte      |= (point->lte != 0);
+    dataPresent.rte      |= (point->rte != 0);
+    dataPresent.lps      |= (point->lps != 0);
+    dataPresent.rps      |= (point->rps != 0);
+    dataPresent.lpco     |= (point->lpco != 0);
+    dataPresent.rpco     |= (point->rpco != 0);
+    dataPresent.lppb     |= (point->lppb != 0);
+    dataPresent.rppb     |= (point->rppb != 0);
+    dataPresent.lppe     |= (point->lppe != 0);
+    dataPresent.rppe     |= (point->rppe != 0);
+    dataPresent.lpppb    |= (point->lpppb != 0);
+    dataPresent.rpppb    |= (point->rpppb != 0);
+    dataPresent.lpppe    |= (point->lpppe != 0);
+    dataPresent.rpppe    |= (point->rpppe != 0);
+    dataPresent.smo2     |= (point->smo2 != 0);
+    dataPresent.thb      |= (point->thb != 0);
+    dataPresent.rvert    |= (point->rvert != 0);
+    dataPresent.rcad     |= (point->rcad != 0);
+    dataPresent.rcontact |= (point->rcontact != 0);
+    dataPresent.tcore    |= (point->tcore != 0);
+    dataPresent.interval |= (point->interval != 0);
 
     updateMin(point);
     updateMax(point);
@@ -1179,6 +1248,7 @@ RideFile::isDataPresent(SeriesType series)
 void
 RideFile::setPointValue(int index, SeriesType series, double value)
 {
+    columns_->invalidate();
     switch (series) {
         case secs : dataPoints_[index]->secs = value; break;
         case cad : dataPoints_[index]->cad = value; break;
@@ -1345,6 +1415,78 @@ RideFile::getPointValue(int index, SeriesType series) const
     return dataPoints_[index]->value(series);
 }
 
+const double *
+RideFile::column(SeriesType series) const
+{
+    // views use the parent's columns
+    if (parent_) {
+        const double *here = parent_->column(series);
+        return here ? here + offset_ : NULL;
+    }
+    return columns_->column(series);
+}
+
+RideFileColumns::RideFileColumns(const RideFile *ride) : ride(ride), empty(true)
+{
+    for (int i=0; i<RideFile::none; i++) columns[i] = NULL;
+}
+
+RideFileColumns::~RideFileColumns()
+{
+    invalidate();
+}
+
+void
+RideFileColumns::invalidate()
+{
+    // called for every appendPoint when reading a file
+    // so don't bother scanning an empty set of columns,
+    // checked under the lock as a column may be being built
+    QMutexLocker locker(&lock);
+    if (empty) return;
+
+    for (int i=0; i<RideFile::none; i++) {
+        if (columns[i]) {
+            qFreeAligned(columns[i]);
+            columns[i] = NULL;
+        }
+    }
+    empty = true;
+}
+
+const double *
+RideFileColumns::column(RideFile::SeriesType series)
+{
+    // these are computed on the fly elsewhere, not held in RideFilePoint
+    switch (series) {
+    case RideFile::vam:
+    case RideFile::wattsKg:
+    case RideFile::wprime:
+    case RideFile::wbal:
+    case RideFile::none:
+        return NULL;
+    default:
+        break;
+    }
+
+    QMutexLocker locker(&lock);
+
+    if (columns[series] == NULL) {
+
+        const QVector<RideFilePoint*> &points = ride->dataPoints();
+        int n = points.count();
+
+        // 16 byte aligned so the compiler can vectorise loops over it
+        // always allocate at least one value so we never return NULL
+        double *here = static_cast<double*>(qMallocAligned(sizeof(double) * (n ? n : 1), 16));
+        for (int i=0; i<n; i++) here[i] = points[i]->value(series);
+
+        columns[series] = here;
+        empty = false;
+    }
+    return columns[series];
+}
+
 QVariant
 RideFile::getPointFromValue(double value, SeriesType series) const
 {
@@ -1555,6 +1697,7 @@ RideFile::deletePoint(int index)
 {
     delete dataPoints_[index];
     dataPoints_.remove(index);
+    columns_->invalidate();
 }
 
 void
@@ -1562,18 +1705,21 @@ RideFile::deletePoints(int index, int count)
 {
     for(int i=index; i<(index+count); i++) delete dataPoints_[i];
     dataPoints_.remove(index, count);
+    columns_->invalidate();
 }
 
 void
 RideFile::insertPoint(int index, RideFilePoint *point)
 {
     dataPoints_.insert(index, point);
+    columns_->invalidate();
 }
 
 void
 RideFile::appendPoints(QVector <struct RideFilePoint *> newRows)
 {
     dataPoints_ += newRows;
+    columns_->invalidate();
 }
 
 void
@@ -1581,6 +1727,7 @@ RideFile::emitSaved()
 {
     weight_ = 0;
     wstale = dstale = true;
+    columns_->invalidate();
     emit saved();
 }
 
@@ -1589,6 +1736,7 @@ RideFile::emitReverted()
 {
     weight_ = 0;
     wstale = dstale = true;
+    columns_->invalidate();
     emit reverted();
 }
 
@@ -1597,6 +1745,7 @@ RideFile::emitModified()
 {
     weight_ = 0;
     wstale = dstale = true;
+    columns_->invalidate();
     emit modified();
 }
 
@@ -1692,6 +1841,10 @@ RideFile::recalculateDerivedSeries(bool force)
     // be called after data is deleted or added
     if (!force && dstale == false) return; // we're already up to date
 
+    // views share the parent's points, which are already up to date
+    // so we mustn't overwrite them with values for just the range
+    if (parent_) return;
+
     //
     // NP Initialisation -- working variables
     //
@@ -2188,6 +2341,9 @@ RideFile::recalculateDerivedSeries(bool force)
     avgPoint->apower = APcount ? (APtotal / APcount) : 0;
     totalPoint->apower = APtotal;
 
+    // derived values have changed
+    columns_->invalidate();
+
     // and we're done
     dstale=false;
 }
@@ -27,6 +27,7 @@
 #include <QMap>
 #include <QVector>
 #include <QObject>
+#include <QMutex>
 
 class RideItem;
 class RideCache;
@@ -35,18 +36,22 @@ class WPrime;
 class RideFile;
 struct RideFilePoint;
 struct RideFileDataPresent;
+class RideFileColumns;
 class RideFileInterval;
 class EditorData;      // attached to a RideFile
 class RideFileCommand; // for manipulating ride data
 class Context;      // for context; cyclist, homedir
 
-// This file defines four classes:
+// This file defines five classes:
 //
 // RideFile, as the name suggests, represents the data stored in a ride file,
 // regardless of what type of file it is (.raw, .srm, .csv).
 //
 // RideFilePoint represents the data for a single sample in a RideFile.
 //
+// RideFileColumns holds the same samples as one contiguous array per data
+// series, for code that only needs to walk one or two series at a time.
+//
 // RideFileReader is an abstract base class for function-objects that take a
 // filename and return a RideFile object representing the ride stored in the
 // corresponding file.
@@ -178,10 +183,12 @@ class RideFile : public QObject // QObject to emit signals
 
         // utility
         static unsigned int computeFileCRC(QString); 
+        static quint64 computeFileHash(QString); // 64 bit, read in chunks
 
         // Constructor / Destructor
         RideFile();
         RideFile(RideFile*);
+        RideFile(const RideFile *parent, int start, int count); // view over parent's samples
         RideFile(const QDateTime &startTime, double recIntSecs);
         virtual ~RideFile();
 
@@ -242,6 +249,12 @@ class RideFile : public QObject // QObject to emit signals
         void appendPoint(const RideFilePoint &);
         const QVector<RideFilePoint*> &dataPoints() const { return dataPoints_; }
 
+        // Working with COLUMNS -- read only, one contiguous array of
+        // dataPoints().count() values per series, built on first use and
+        // discarded whenever the data points are modified. Returns NULL
+        // for series that are not held in RideFilePoint (e.g. wbal, vam)
+        const double *column(SeriesType series) const;
+
         // recalculate all the derived data series
         // might want to move to a factory for these
         // at some point, but for now hard coded
@@ -362,6 +375,9 @@ class RideFile : public QObject // QObject to emit signals
         double recIntSecs_;    // recording interval in seconds
         QVector<RideFilePoint*> dataPoints_;
         QVector<RideFilePoint*> referencePoints_;
+        RideFileColumns *columns_; // columnar copy of dataPoints_
+        const RideFile *parent_; // when we are a view over another ride
+        int offset_; // and where we start in it
         RideFilePoint* minPoint;
         RideFilePoint* maxPoint;
         RideFilePoint* avgPoint;
@@ -381,6 +397,7 @@ class RideFile : public QObject // QObject to emit signals
         void updateMin(RideFilePoint* point);
         void updateMax(RideFilePoint* point);
         void updateAvg(RideFilePoint* point);
+        void updatePresent(RideFilePoint* point);
 
         bool dstale; // is derived data up to date?
 };
@@ -459,6 +476,32 @@ struct RideFilePoint
     void setValue(RideFile::SeriesType series, double value);
 };
 
+// Columnar (struct-of-arrays) copy of the data points
+//
+// Each series is materialised into its own aligned array the first time it
+// is asked for, so a metric that only looks at watts only pays for the watts
+// column and walks it sequentially rather than striding through every
+// RideFilePoint. The row store (RideFile::dataPoints) remains the master copy,
+// columns are simply thrown away when it changes.
+class RideFileColumns
+{
+    public:
+        RideFileColumns(const RideFile *ride);
+        ~RideFileColumns();
+
+        // get the column, building it if needed
+        const double *column(RideFile::SeriesType series);
+
+        // drop all columns, they will be rebuilt on next use
+        void invalidate();
+
+    private:
+        const RideFile *ride;
+        QMutex lock; // the meanmax computer threads share a ride
+        bool empty;  // nothing to invalidate
+        double *columns[RideFile::none];
+};
+
 struct RideFileReader {
     virtual ~RideFileReader() {}
     virtual RideFile *openRideFile(QFile &file, QStringList &errors, QList<RideFile*>* = 0) const = 0;
@@ -498,6 +541,7 @@ class RideFileFactory {
         int registerReader(const QString &suffix, const QString &description,
                            RideFileReader *reader);
         RideFile *openRideFile(Context *context, QFile &file, QStringList &errors, QList<RideFile*>* = 0) const;
+        void setupRideFile(Context *context, RideFile *ride, QString filename) const;
         bool writeRideFile(Context *context, const RideFile *ride, QFile &file, QString format) const;
         QStringList suffixes() const;
         QStringList writeSuffixes() const;
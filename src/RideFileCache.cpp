@@ -17,6 +17,7 @@
  */
 
 #include "RideFileCache.h"
+#include "MeanMaxIndex.h"
 #include "MainWindow.h"
 #include "Context.h"
 #include "Athlete.h"
@@ -32,9 +33,66 @@
 #include <QFileInfo>
 #include <QMessageBox>
 #include <QtAlgorithms> // for qStableSort
+#include <QScopedPointer>
+#if QT_VERSION > 0x050000
+# include <QtConcurrent>
+#else
+# include <QtConcurrentMap>
+#endif
+
+#ifdef __SSE2__
+# include <emmintrin.h> // for the mean max window search
+#endif
+
+#ifndef WIN32
+#include <sys/stat.h> // for the inode
+#endif
 
 static const int maxcache = 25; // lets max out at 25 caches
 
+// what we can tell about the ride file without reading it
+static void
+stampRideFile(QString rideFileName, RideFileCacheHeader &head)
+{
+    QFileInfo info(rideFileName);
+    head.fileSize = info.size();
+    head.fileModified = info.lastModified().toTime_t();
+    head.fileInode = 0;
+#ifndef WIN32
+    struct stat st;
+    if (stat(rideFileName.toLocal8Bit().constData(), &st) == 0) head.fileInode = st.st_ino;
+#endif
+}
+
+// is the cache for the ride file as it is now ? if it was touched,
+// or restored from a backup, the crc tells us and we update the stamp
+// in the header so we don't have to read it all again next time
+static bool
+sameRideFile(QString rideFileName, QString cacheFileName, RideFileCacheHeader &head)
+{
+    RideFileCacheHeader now;
+    stampRideFile(rideFileName, now);
+
+    // different size, definitely changed
+    if (now.fileSize != head.fileSize) return false;
+
+    // not been near it
+    if (now.fileModified == head.fileModified && now.fileInode == head.fileInode) return true;
+
+    // have to look then
+    if (RideFile::computeFileCRC(rideFileName) != head.crc) return false;
+
+    head.fileModified = now.fileModified;
+    head.fileInode = now.fileInode;
+
+    QFile cacheFile(cacheFileName);
+    if (cacheFile.open(QIODevice::ReadWrite) == true) {
+        cacheFile.write((const char *) &head, sizeof(head));
+        cacheFile.close();
+    }
+    return true;
+}
+
 // cache from ride
 RideFileCache::RideFileCache(Context *context, QString fileName, double weight, RideFile *passedride, bool check, bool refresh) :
                incomplete(false), context(context), rideFileName(fileName), ride(passedride)
@@ -86,8 +144,8 @@ RideFileCache::RideFileCache(Context *context, QString fileName, double weight,
     // is it up-to-date?
     if (cacheFileInfo.exists() && cacheFileInfo.size() >= (int)sizeof(struct RideFileCacheHeader)) {
 
-        // we have a file, it is more recent than the ride file
-        // but is it the latest version?
+        // we have a file, but is it the latest version
+        // and for the ride file as it is now?
         RideFileCacheHeader head;
         QFile cacheFile(cacheFileName);
         if (cacheFile.open(QIODevice::ReadOnly) == true) {
@@ -97,21 +155,18 @@ RideFileCache::RideFileCache(Context *context, QString fileName, double weight,
             inFile.readRawData((char *) &head, sizeof(head));
             cacheFile.close();
 
-            // its more recent -or- the crc is the same
-            if (rideFileInfo.lastModified() <= cacheFileInfo.lastModified() ||
-                head.crc == RideFile::computeFileCRC(rideFileName)) {
- 
-                // it is the same ?
-                if (head.version == RideFileCacheVersion && head.WEIGHT == weight) {
+            // it is the same version and weight, and the ride file hasn't changed ?
+            // (the version first, an older header doesn't have the ride file stamp)
+            if (head.version == RideFileCacheVersion && head.WEIGHT == weight &&
+                sameRideFile(rideFileName, cacheFileName, head)) {
 
-                    // WE'RE GOOD
-                    if (check == false) readCache(); // if check is false we aren't just checking
-                    return;
-                } else {
-                    // for debug only
-                    //qDebug()<<"refresh because version ("<<RideFileCacheVersion<<","<<head.version<<")"
-                    //        << " weight ("<< weight <<"," <<head.WEIGHT<<")";
-                }
+                // WE'RE GOOD
+                if (check == false) readCache(); // if check is false we aren't just checking
+                return;
+            } else {
+                // for debug only
+                //qDebug()<<"refresh because version ("<<RideFileCacheVersion<<","<<head.version<<")"
+                //        << " weight ("<< weight <<"," <<head.WEIGHT<<")";
             }
         }
     }
@@ -159,8 +214,8 @@ RideFileCache::checkStale(Context *context, RideItem*item)
     // is it up-to-date?
     if (cacheFileInfo.exists() && cacheFileInfo.size() >= (int)sizeof(struct RideFileCacheHeader)) {
 
-        // we have a file, it is more recent than the ride file
-        // but is it the latest version?
+        // we have a file, but is it the latest version
+        // and for the ride file as it is now?
         RideFileCacheHeader head;
         QFile cacheFile(cacheFileName);
         if (cacheFile.open(QIODevice::ReadOnly) == true) {
@@ -170,16 +225,12 @@ RideFileCache::checkStale(Context *context, RideItem*item)
             inFile.readRawData((char *) &head, sizeof(head));
             cacheFile.close();
 
-            // its more recent -or- the crc is the same
-            if (rideFileInfo.lastModified() <= cacheFileInfo.lastModified() ||
-                head.crc == RideFile::computeFileCRC(rideFileName)) {
+            // it is the same version and weight, and the ride file hasn't changed ?
+            if (head.version == RideFileCacheVersion && head.WEIGHT == item->getWeight() &&
+                sameRideFile(rideFileName, cacheFileName, head)) {
 
-                // it is the same ?
-                if (head.version == RideFileCacheVersion && head.WEIGHT == item->getWeight()) {
-
-                    // WE'RE GOOD
-                    return false;
-                }
+                // WE'RE GOOD
+                return false;
             }
         }
     }
@@ -291,48 +342,14 @@ static long countForMeanMax(RideFileCacheHeader head, RideFile::SeriesType serie
 
 QVector<float> RideFileCache::meanMaxPowerFor(Context *context, QVector<float> &wpk, QDate from, QDate to)
 {
-    QVector<float> returning;
-    QVector<float> returningwpk;
-    bool first = true;
+    // merge the pre-aggregated periods and rides in range
+    MeanMaxAggregate bests = MeanMaxIndex::index(context->athlete->home->cache().canonicalPath())->aggregate(from, to);
 
-    // look at all the rides
-    foreach (RideItem *item, context->athlete->rideCache->rides()) {
-
-        if (item->dateTime.date() < from || item->dateTime.date() > to) continue; // not one we want
-
-        // get the power data
-        if (first == true) {
-
-            // first time through the whole thing is going to be best
-            returning =  meanMaxPowerFor(context, returningwpk, context->athlete->home->activities().canonicalPath() + "/" + item->fileName);
-            first = false;
-
-        } else {
+    // blocks 0 and 1 are watts and wattsKg, as in the cpx
+    wpk = bests.meanMax[1];
+    for(int i=0; i<wpk.size(); i++) wpk[i] = wpk[i] / 100.00f;
 
-            QVector<float> thiswpk;
-
-            // next time through we should only pick out better times
-            QVector<float> ridebest = meanMaxPowerFor(context, thiswpk, context->athlete->home->activities().canonicalPath() + "/" + item->fileName);
-
-            // do we need to increase the returning array?
-            if (returning.size() < ridebest.size()) returning.resize(ridebest.size());
-
-            // now update where its a better number
-            for (int i=0; i<ridebest.size(); i++)
-                if (ridebest[i] > returning[i]) returning[i] = ridebest[i];
-
-            // do we need to increase the returning array?
-            if (returningwpk.size() < thiswpk.size()) returningwpk.resize(thiswpk.size());
-
-            // now update where its a better number
-            for (int i=0; i<thiswpk.size(); i++)
-                if (thiswpk[i] > returningwpk[i]) returningwpk[i] =thiswpk[i];
-        }
-    }
-
-    // set aggregated wpk
-    wpk = returningwpk;
-    return returning;
+    return bests.meanMax[0];
 }
 
 QVector<float> RideFileCache::meanMaxPowerFor(Context *context, QVector<float>&wpk, QString fileName)
@@ -446,40 +463,19 @@ QVector<float> RideFileCache::meanMaxFor(QString cacheFilename, RideFile::Series
 // API bests for a date range
 QVector<float> RideFileCache::meanMaxFor(QString cacheDir, RideFile::SeriesType series, QDate from, QDate to)
 {
-    QTime start;
-    start.start();
-
-    bool first = true;
     QVector<float> returning;
 
-    // loop through all CPX files
-    foreach(QString cacheFilename, QDir(cacheDir).entryList(QDir::Files)) {
-
-        // is it a cpx file ?
-        if (!cacheFilename.endsWith(".cpx")) continue;
-   
-        // is it big enough ? 
-        if (QFileInfo(cacheDir + "/" + cacheFilename).size() < (int)sizeof(struct RideFileCacheHeader)) continue;
+    // which block is it in the cpx ?
+    int block = -1;
+    for (int i=0; i<MeanMaxAggregate::MeanMaxBlocks; i++)
+        if (MeanMaxAggregate::meanMaxSeries(i) == series) block = i;
 
-        // lets check it parses ok ?
-        QDateTime dt;
-        if (!RideFile::parseRideFileName(cacheFilename, &dt)) continue; 
+    // not a series we cache
+    if (block == -1) return returning;
 
-        // in range?
-        if (dt.date() < from || dt.date() > to) continue;
-
-        // get data
-        QVector<float> current = RideFileCache::meanMaxFor(cacheDir + "/" + cacheFilename, series);
-
-        // first ?
-        if (first) {
-            first = false;
-            returning = current;
-        } else {
-            if (current.size() > returning.size()) returning.resize(current.size());
-            for(int i=0; i< current.size(); i++) if (current[i] > returning[i]) returning[i]=current[i];
-        }
-    }
+    // merge the pre-aggregated periods and rides in range
+    MeanMaxAggregate bests = MeanMaxIndex::index(cacheDir)->aggregate(from, to);
+    returning = bests.meanMax[block];
 
     // will be empty if no up to date cache
     return returning;
@@ -810,6 +806,7 @@ RideFileCache::refreshCache()
         // invalidate any incore cache of aggregate
         // that contains this ride in its date range
         QDate date = ride->startTime().date();
+        MeanMaxIndex::invalidate(context->athlete->home->cache().canonicalPath(), date);
         for (int i=0; i<context->athlete->cpxCache.count();) {
             if (date >= context->athlete->cpxCache.at(i)->start &&
                 date <= context->athlete->cpxCache.at(i)->end) {
@@ -850,33 +847,21 @@ void RideFileCache::refresh(RideFile *file)
     compute();
 }
 
-// this function is a candidate for supporting
-// threaded calculations, each of the computes
-// in here could go in its own thread. Users
-// with many cores would benefit enormously
+// run on the global thread pool by compute()
+static void runMeanMaxComputer(MeanMaxComputer *&computer)
+{
+    computer->run();
+}
+
+// the mean maxes are computed on the global thread pool so that
+// refreshing lots of rides at once doesn't start 15 threads
+// for each of them, the distributions are cheap so stay here
 void RideFileCache::RideFileCache::compute()
 {
     if (ride == NULL) {
         return;
     }
 
-    // all the mean maxes
-    MeanMaxComputer thread1(ride, wattsMeanMax, RideFile::watts); thread1.start();
-    MeanMaxComputer thread2(ride, hrMeanMax, RideFile::hr); thread2.start();
-    MeanMaxComputer thread3(ride, cadMeanMax, RideFile::cad); thread3.start();
-    MeanMaxComputer thread4(ride, nmMeanMax, RideFile::nm); thread4.start();
-    MeanMaxComputer thread5(ride, kphMeanMax, RideFile::kph); thread5.start();
-    MeanMaxComputer thread6(ride, xPowerMeanMax, RideFile::xPower); thread6.start();
-    MeanMaxComputer thread7(ride, npMeanMax, RideFile::NP); thread7.start();
-    MeanMaxComputer thread8(ride, vamMeanMax, RideFile::vam); thread8.start();
-    MeanMaxComputer thread9(ride, wattsKgMeanMax, RideFile::wattsKg); thread9.start();
-    MeanMaxComputer thread10(ride, aPowerMeanMax, RideFile::aPower); thread10.start();
-    MeanMaxComputer thread11(ride, kphdMeanMax, RideFile::kphd); thread11.start();
-    MeanMaxComputer thread12(ride, wattsdMeanMax, RideFile::wattsd); thread12.start();
-    MeanMaxComputer thread13(ride, caddMeanMax, RideFile::cadd); thread13.start();
-    MeanMaxComputer thread14(ride, nmdMeanMax, RideFile::nmd); thread14.start();
-    MeanMaxComputer thread15(ride, hrdMeanMax, RideFile::hrd); thread15.start();
-
     // all the different distributions
     computeDistribution(wattsDistribution, RideFile::watts);
     computeDistribution(hrDistribution, RideFile::hr);
@@ -889,22 +874,38 @@ void RideFileCache::RideFileCache::compute()
     computeDistribution(smo2Distribution, RideFile::smo2);
     computeDistribution(wbalDistribution, RideFile::wbal);
 
-    // wait for them threads
-    thread1.wait();
-    thread2.wait();
-    thread3.wait();
-    thread4.wait();
-    thread5.wait();
-    thread6.wait();
-    thread7.wait();
-    thread8.wait();
-    thread9.wait();
-    thread10.wait();
-    thread11.wait();
-    thread12.wait();
-    thread13.wait();
-    thread14.wait();
-    thread15.wait();
+    // decritize the samples once for all the series
+    MeanMaxTimeline timeline(ride);
+
+    // and one integrated buffer with a slice for each series
+    const int computers = 15;
+    int slice = timeline.samples.count() + 1;
+    QVector<data_t> integrated(computers * slice);
+    data_t *buffer = integrated.data();
+
+    // all the mean maxes
+    QList<MeanMaxComputer*> meanmax;
+    meanmax << new MeanMaxComputer(ride, wattsMeanMax, RideFile::watts, &timeline, buffer);
+    meanmax << new MeanMaxComputer(ride, hrMeanMax, RideFile::hr, &timeline, buffer + slice);
+    meanmax << new MeanMaxComputer(ride, cadMeanMax, RideFile::cad, &timeline, buffer + 2*slice);
+    meanmax << new MeanMaxComputer(ride, nmMeanMax, RideFile::nm, &timeline, buffer + 3*slice);
+    meanmax << new MeanMaxComputer(ride, kphMeanMax, RideFile::kph, &timeline, buffer + 4*slice);
+    meanmax << new MeanMaxComputer(ride, xPowerMeanMax, RideFile::xPower, &timeline, buffer + 5*slice);
+    meanmax << new MeanMaxComputer(ride, npMeanMax, RideFile::NP, &timeline, buffer + 6*slice);
+    meanmax << new MeanMaxComputer(ride, vamMeanMax, RideFile::vam, &timeline, buffer + 7*slice);
+    meanmax << new MeanMaxComputer(ride, wattsKgMeanMax, RideFile::wattsKg, &timeline, buffer + 8*slice);
+    meanmax << new MeanMaxComputer(ride, aPowerMeanMax, RideFile::aPower, &timeline, buffer + 9*slice);
+    meanmax << new MeanMaxComputer(ride, kphdMeanMax, RideFile::kphd, &timeline, buffer + 10*slice);
+    meanmax << new MeanMaxComputer(ride, wattsdMeanMax, RideFile::wattsd, &timeline, buffer + 11*slice);
+    meanmax << new MeanMaxComputer(ride, caddMeanMax, RideFile::cadd, &timeline, buffer + 12*slice);
+    meanmax << new MeanMaxComputer(ride, nmdMeanMax, RideFile::nmd, &timeline, buffer + 13*slice);
+    meanmax << new MeanMaxComputer(ride, hrdMeanMax, RideFile::hrd, &timeline, buffer + 14*slice);
+
+    // the calling thread joins in, so this is safe when we are
+    // already running on the pool (e.g. from RideCache::refresh)
+    // and we never use more threads than the pool allows
+    QtConcurrent::blockingMap(meanmax, runMeanMaxComputer);
+    qDeleteAll(meanmax);
 
     // setup the doubles the users use
     doubleArray(wattsMeanMaxDouble, wattsMeanMax, RideFile::watts);
@@ -1058,39 +1059,51 @@ void RideFileCache::RideFileCache::compute()
 
 */
 
-data_t *
-MeanMaxComputer::integrate_series(cpintdata &data)
-{
-    // would be better to do pure QT and use QVector -- but no memory leak
-    data_t *integrated= (data_t *)malloc(sizeof(data_t)*(data.points.size()+1)); 
-    int i;
-    data_t acc=0;
-
-    for (i=0; i<data.points.size(); i++) {
-        integrated[i]=acc;
-        acc+=data.points[i].value;
-    }
-    integrated[i]=acc;
-
-    return integrated;
-}
-
 data_t
 MeanMaxComputer::partial_max_mean(data_t *dataseries_i, int start, int end, int length, int *offset)
 {
-    int i=0;
+    int i=start;
+    int last=1+end-length;
     data_t candidate=0;
 
+    // when we don't need to know where the best window starts
+    // its just a max over the differences, which we do 4 at a time
+    if (offset == NULL) {
+
+#ifdef __SSE2__
+        __m128d best1 = _mm_setzero_pd();
+        __m128d best2 = _mm_setzero_pd();
+
+        for (; i+4<=last; i+=4) {
+            __m128d energy1 = _mm_sub_pd(_mm_loadu_pd(dataseries_i+length+i), _mm_loadu_pd(dataseries_i+i));
+            __m128d energy2 = _mm_sub_pd(_mm_loadu_pd(dataseries_i+length+i+2), _mm_loadu_pd(dataseries_i+i+2));
+            best1 = _mm_max_pd(best1, energy1);
+            best2 = _mm_max_pd(best2, energy2);
+        }
+
+        double lanes[2];
+        _mm_storeu_pd(lanes, _mm_max_pd(best1, best2));
+        candidate = lanes[0] > lanes[1] ? lanes[0] : lanes[1];
+#endif
+
+        // and the remainder
+        for (; i<last; i++) {
+            data_t test_energy=dataseries_i[length+i]-dataseries_i[i];
+            if (test_energy>candidate) candidate=test_energy;
+        }
+        return candidate;
+    }
+
     int best_i=0;
 
-    for (i=start; i<(1+end-length); i++) {
+    for (; i<last; i++) {
         data_t test_energy=dataseries_i[length+i]-dataseries_i[i];
         if (test_energy>candidate) {
             candidate=test_energy;
             best_i=i;
         }
     }
-    if (offset) *offset=best_i;
+    *offset=best_i;
 
     return candidate;
 }
@@ -1123,7 +1136,7 @@ MeanMaxComputer::divided_max_mean(data_t *dataseries_i, int datalength, int leng
         if (energy < candidate) {
           continue;
         }
-        data_t window_mm=partial_max_mean(dataseries_i, start, end, length, &this_offset);
+        data_t window_mm=partial_max_mean(dataseries_i, start, end, length, offset ? &this_offset : NULL);
 
         if (window_mm>candidate) {
             candidate=window_mm;
@@ -1141,7 +1154,7 @@ MeanMaxComputer::divided_max_mean(data_t *dataseries_i, int datalength, int leng
 
         if (energy >= candidate) {
 
-            data_t window_mm=partial_max_mean(dataseries_i, start, end, length, &this_offset);
+            data_t window_mm=partial_max_mean(dataseries_i, start, end, length, offset ? &this_offset : NULL);
 
             if (window_mm>candidate) {
                 candidate=window_mm;
@@ -1154,34 +1167,8 @@ MeanMaxComputer::divided_max_mean(data_t *dataseries_i, int datalength, int leng
 }
 
 
-void
-MeanMaxComputer::run()
+MeanMaxTimeline::MeanMaxTimeline(RideFile *ride) : total_secs(0)
 {
-    // xPower and NP need watts to be present
-    RideFile::SeriesType baseSeries = (series == RideFile::xPower || series == RideFile::NP || series == RideFile::wattsKg) ?
-                                      RideFile::watts : series;
-
-    if (series == RideFile::vam) baseSeries = RideFile::alt;
-
-    // there is a distinction between needing it present and using it in calcs
-    RideFile::SeriesType needSeries = baseSeries;
-    if (series == RideFile::kphd) needSeries = RideFile::kph;
-    if (series == RideFile::wattsd) needSeries = RideFile::watts;
-    if (series == RideFile::cadd) needSeries = RideFile::cad;
-    if (series == RideFile::nmd) needSeries = RideFile::nm;
-    if (series == RideFile::hrd) needSeries = RideFile::hr;
-
-    // only bother if the data series is actually present
-    if (ride->isDataPresent(needSeries) == false) return;
-
-    // if we want decimal places only keep to 1 dp max
-    // this is a factor that is applied at the end to
-    // convert from high-precision double to long
-    // e.g. 145.456 becomes 1455 if we want decimals
-    // and becomes 145 if we don't
-    double decimals =  pow(10, RideFileCache::decimalsFor(series));
-    //double decimals = RideFile::decimalsFor(baseSeries) ? 10 : 1;
-
     // decritize the data series - seems wrong, since it just
     // rounds to the nearest second - what if the recIntSecs
     // is less than a second? Has been used for a long while
@@ -1195,41 +1182,85 @@ MeanMaxComputer::run()
     // zero, since some files have a very large start time
     // that creates work for nil effect (but increases compute
     // time drastically).
-    cpintdata data;
-    data.rec_int_ms = (int) round(ride->recIntSecs() * 1000.0);
     double lastsecs = 0;
-    bool first = true;
     double offset = 0;
-    foreach (const RideFilePoint *p, ride->dataPoints()) {
+    double endsecs = 0;
 
-        // get offset to apply on all samples if first sample
-        if (first == true) {
-            offset = p->secs;
-            first = false;
-        }
+    // we only need time, the values are looked up by each series
+    const double *secsColumn = ride->column(RideFile::secs);
+    int count = ride->dataPoints().count();
+    if (count) offset = secsColumn[0];
+    samples.reserve(count);
+
+    for (int s=0; s<count; s++) {
 
         // drag back to start at 1s or whatever recIntSecs() is !
-        double psecs = p->secs - offset + ride->recIntSecs();
+        double psecs = secsColumn[s] - offset + ride->recIntSecs();
 
         // fill in any gaps in recording - use same dodgy rounding as before
-        int count = (psecs - lastsecs - ride->recIntSecs()) / ride->recIntSecs();
+        int gaps = (psecs - lastsecs - ride->recIntSecs()) / ride->recIntSecs();
 
         // gap more than an hour, damn that ride file is a mess
-        if (count > 3600) count = 1;
+        if (gaps > 3600) gaps = 1;
 
-        for(int i=0; i<count; i++)
-            data.points.append(cpintpoint(round(lastsecs+((i+1)*ride->recIntSecs() *1000.0)/1000), 0));
+        for(int i=0; i<gaps; i++) {
+            samples.append(-1);
+            endsecs = round(lastsecs+((i+1)*ride->recIntSecs() *1000.0)/1000);
+        }
         lastsecs = psecs;
 
         double secs = round(psecs * 1000.0) / 1000;
-        if (secs > 0) data.points.append(cpintpoint(secs, (int) round(p->value(baseSeries)*double(decimals))));
+        if (secs > 0) {
+            samples.append(s);
+            endsecs = secs;
+        }
     }
 
+    if (samples.count()) total_secs = (int) ceil(endsecs);
+}
+
+void
+MeanMaxComputer::run()
+{
+    // xPower and NP need watts to be present
+    RideFile::SeriesType baseSeries = (series == RideFile::xPower || series == RideFile::NP || series == RideFile::wattsKg) ?
+                                      RideFile::watts : series;
+
+    if (series == RideFile::vam) baseSeries = RideFile::alt;
+
+    // there is a distinction between needing it present and using it in calcs
+    RideFile::SeriesType needSeries = baseSeries;
+    if (series == RideFile::kphd) needSeries = RideFile::kph;
+    if (series == RideFile::wattsd) needSeries = RideFile::watts;
+    if (series == RideFile::cadd) needSeries = RideFile::cad;
+    if (series == RideFile::nmd) needSeries = RideFile::nm;
+    if (series == RideFile::hrd) needSeries = RideFile::hr;
+
+    // only bother if the data series is actually present
+    if (ride->isDataPresent(needSeries) == false) return;
+
+    // if we want decimal places only keep to 1 dp max
+    // this is a factor that is applied at the end to
+    // convert from high-precision double to long
+    // e.g. 145.456 becomes 1455 if we want decimals
+    // and becomes 145 if we don't
+    double decimals =  pow(10, RideFileCache::decimalsFor(series));
+    //double decimals = RideFile::decimalsFor(baseSeries) ? 10 : 1;
+
+    // the timeline is shared when computing all the series
+    // for a ride, but we make our own if we weren't given one
+    QScopedPointer<MeanMaxTimeline> ownTimeline;
+    const MeanMaxTimeline *timeline = this->timeline;
+    if (timeline == NULL) {
+        ownTimeline.reset(new MeanMaxTimeline(ride));
+        timeline = ownTimeline.data();
+    }
+    int samples = timeline->samples.count();
 
     // don't bother with insufficient data
-    if (!data.points.count()) return;
+    if (!samples) return;
 
-    int total_secs = (int) ceil(data.points.back().secs);
+    int total_secs = timeline->total_secs;
 
     // don't allow data more than two days
     // was one week, but no single ride is longer
@@ -1239,6 +1270,22 @@ MeanMaxComputer::run()
     // don't allow if badly parsed or time goes backwards
     if (total_secs < 0) return;
 
+    // the values are placed in the buffer and pre-processed
+    // then integrated in place, so no copying about
+    QVector<data_t> ownBuffer;
+    data_t *dataseries_i = buffer;
+    if (dataseries_i == NULL) {
+        ownBuffer.resize(samples+1);
+        dataseries_i = ownBuffer.data();
+    }
+
+    // gaps are zero, values are rounded at the
+    // precision we keep (see decimals above)
+    const double *valueColumn = ride->column(baseSeries);
+    const int *index = timeline->samples.constData();
+    for (int i=0; i<samples; i++)
+        dataseries_i[i] = index[i] < 0 ? 0 : (int) round(valueColumn[index[i]]*double(decimals));
+
     //
     // Pre-process the data for NP, xPower and VAM
     //
@@ -1248,19 +1295,19 @@ MeanMaxComputer::run()
 
         double lastAlt=0;
 
-        for (int i=0; i<data.points.size(); i++) {
+        for (int i=0; i<samples; i++) {
 
             // handle drops gracefully (and first sample too)
             // if you manage to rise >5m in a second thats a data error too!
-            if (!lastAlt || (data.points[i].value - lastAlt) > 5) lastAlt=data.points[i].value;
+            if (!lastAlt || (dataseries_i[i] - lastAlt) > 5) lastAlt=dataseries_i[i];
 
             // NOTE: It is 360 not 3600 because Altitude is factored for decimal places
             //       since it is the base data series, but we are calculating VAM
             //       And we multiply by 10 at the end!
-            double vam = (((data.points[i].value - lastAlt) * 360)/ride->recIntSecs()) * 10;
+            double vam = (((dataseries_i[i] - lastAlt) * 360)/ride->recIntSecs()) * 10;
             if (vam < 0) vam = 0;
-            lastAlt = data.points[i].value;
-            data.points[i].value = vam;
+            lastAlt = dataseries_i[i];
+            dataseries_i[i] = vam;
         }
     }
 
@@ -1280,13 +1327,13 @@ MeanMaxComputer::run()
 
             // loop over the data and convert to a rolling
             // average for the given windowsize
-            for (int i=0; i<data.points.size(); i++) {
+            for (int i=0; i<samples; i++) {
 
-                sum += data.points[i].value;
+                sum += dataseries_i[i];
                 sum -= rolling[index];
 
-                rolling[index] = data.points[i].value;
-                data.points[i].value = pow(sum/(double)rollingwindowsize,4.0f); // raise rolling average to 4th power
+                rolling[index] = dataseries_i[i];
+                dataseries_i[i] = pow(sum/(double)rollingwindowsize,4.0f); // raise rolling average to 4th power
 
                 // move index on/round
                 index = (index >= rollingwindowsize-1) ? 0 : index+1;
@@ -1302,7 +1349,6 @@ MeanMaxComputer::run()
 
         int rollingwindowsize = 25 / ride->recIntSecs();
         double ewma = 0.0;
-        double sum = 0.0; // as we ramp up
 
         // no point doing a rolling average if the
         // sample rate is greater than the rolling average
@@ -1310,41 +1356,37 @@ MeanMaxComputer::run()
         if (rollingwindowsize > 1) {
 
             // loop over the data and convert to a EWMA
-            for (int i=0; i<data.points.size(); i++) {
-
-                // dgr : BikeScore has weighting value from first point
-                if (false && i < rollingwindowsize) {
-
-                    // get up to speed
-                    sum += data.points[i].value;
-                    ewma = sum / (i+1);
-
-                } else {
-
-                    // we're up to speed
-                    ewma = (data.points[i].value * exp) + (ewma * rem);
-                }
-                data.points[i].value = pow(ewma, 4.0f);
+            // dgr : BikeScore has weighting value from first point
+            for (int i=0; i<samples; i++) {
+                ewma = (dataseries_i[i] * exp) + (ewma * rem);
+                dataseries_i[i] = pow(ewma, 4.0f);
             }
         }
     }
 
     if (series == RideFile::wattsKg) {
-        for (int i=0; i<data.points.size(); i++) {
-            double wattsKg = data.points[i].value / ride->getWeight();
-            data.points[i].value = wattsKg;
+        for (int i=0; i<samples; i++) {
+            double wattsKg = dataseries_i[i] / ride->getWeight();
+            dataseries_i[i] = wattsKg;
         }
     }
 
+    // integrate in place
+    data_t acc=0;
+    for (int i=0; i<samples; i++) {
+        data_t value = dataseries_i[i];
+        dataseries_i[i] = acc;
+        acc += value;
+    }
+    dataseries_i[samples] = acc;
+
     // the bests go in here...
     QVector <double> ride_bests(total_secs + 1);
 
-    data_t *dataseries_i = integrate_series(data);
+    for (int i=1; i<samples;) {
 
-    for (int i=1; i<data.points.size();) {
-
-        int offset;
-        data_t c=divided_max_mean(dataseries_i,data.points.size(),i,&offset);
+        // we don't need to know where the best was
+        data_t c=divided_max_mean(dataseries_i,samples,i,NULL);
 
         // snaffle it away
         int sec = i*ride->recIntSecs();
@@ -1366,7 +1408,6 @@ MeanMaxComputer::run()
         else if (i<7200) i += 120;
         else i += 300;
     }
-    free(dataseries_i);
 
     //
     // FILL IN THE GAPS AND FILL TARGET ARRAY
@@ -1639,69 +1680,119 @@ RideFileCache::RideFileCache(Context *context, QDate start, QDate end, bool filt
     // and less intrusive than a popup box
     context->mainWindow->setCursor(Qt::WaitCursor);
 
-    // Iterate over the ride files (not the cpx files since they /might/ not
-    // exist, or /might/ be out of date.
-    foreach (RideItem *item, context->athlete->rideCache->rides()) {
+    // when not filtered we can merge the pre-aggregated periods
+    // from the index rather than reading every ride in range
+    if (!filter && !context->isfiltered && (!onhome || !context->ishomefiltered) && !rideItem) {
 
-        QDate rideDate = item->dateTime.date();
+        MeanMaxAggregate bests = MeanMaxIndex::index(context->athlete->home->cache().canonicalPath())->aggregate(start, end);
 
-        if (((filter == true && files.contains(item->fileName)) || filter == false) &&
-            rideDate >= start && rideDate <= end) {
+        // any rides without an up to date cpx ?
+        int count = 0;
+        foreach (RideItem *item, context->athlete->rideCache->rides())
+            if (item->dateTime.date() >= start && item->dateTime.date() <= end) count++;
+        if (bests.incomplete || bests.rides != count) incomplete = true;
 
-            // skip globally filtered values
-            if (context->isfiltered && !context->filters.contains(item->fileName)) continue;
-            if (onhome && context->ishomefiltered && !context->homeFilters.contains(item->fileName)) continue;
-            // skip other sports if rideItem is given
-            if (rideItem && ((rideItem->isRun != item->isRun) || (rideItem->isSwim != item->isSwim))) continue;
-
-            // get its cached values (will NOT! refresh if needed...)
-            // the true means it will check only
-            RideFileCache rideCache(context, context->athlete->home->activities().canonicalPath() + "/" + item->fileName, item->getWeight(), NULL, false, false);
-            if (rideCache.incomplete == true) {
-                // ack, data not available !
-                incomplete = true;
-            } else {
+        // bests and their dates
+        for (int i=0; i<MeanMaxAggregate::MeanMaxBlocks; i++) {
+            RideFile::SeriesType series = MeanMaxAggregate::meanMaxSeries(i);
+
+            doubleArray(meanMaxArray(series), bests.meanMax[i], series);
+
+            QVector<QDate> &dates = meanMaxDates(series);
+            dates.resize(bests.dates[i].size());
+            for (int j=0; j<dates.size(); j++)
+                if (bests.dates[i][j]) dates[j] = QDate::fromJulianDay(bests.dates[i][j]);
+        }
+
+        // distributions in cpx order
+        wattsDistributionDouble = bests.dist[0];
+        hrDistributionDouble = bests.dist[1];
+        cadDistributionDouble = bests.dist[2];
+        gearDistributionDouble = bests.dist[3];
+        nmDistributionDouble = bests.dist[4];
+        kphDistributionDouble = bests.dist[5];
+        xPowerDistributionDouble = bests.dist[6];
+        npDistributionDouble = bests.dist[7];
+        wattsKgDistributionDouble = bests.dist[8];
+        aPowerDistributionDouble = bests.dist[9];
+        smo2DistributionDouble = bests.dist[10];
+        wbalDistributionDouble = bests.dist[11];
+
+        // and time in zone
+        wattsTimeInZone = bests.tiz[0];
+        wattsCPTimeInZone = bests.tiz[1];
+        hrTimeInZone = bests.tiz[2];
+        hrCPTimeInZone = bests.tiz[3];
+        paceTimeInZone = bests.tiz[4];
+        paceCPTimeInZone = bests.tiz[5];
+        wbalTimeInZone = bests.tiz[6];
+
+    } else {
+
+        // Iterate over the ride files (not the cpx files since they /might/ not
+        // exist, or /might/ be out of date.
+        foreach (RideItem *item, context->athlete->rideCache->rides()) {
+
+            QDate rideDate = item->dateTime.date();
+
+            if (((filter == true && files.contains(item->fileName)) || filter == false) &&
+                rideDate >= start && rideDate <= end) {
+
+                // skip globally filtered values
+                if (context->isfiltered && !context->filters.contains(item->fileName)) continue;
+                if (onhome && context->ishomefiltered && !context->homeFilters.contains(item->fileName)) continue;
+                // skip other sports if rideItem is given
+                if (rideItem && ((rideItem->isRun != item->isRun) || (rideItem->isSwim != item->isSwim))) continue;
+
+                // get its cached values (will NOT! refresh if needed...)
+                // the true means it will check only
+                RideFileCache rideCache(context, context->athlete->home->activities().canonicalPath() + "/" + item->fileName, item->getWeight(), NULL, false, false);
+                if (rideCache.incomplete == true) {
+                    // ack, data not available !
+                    incomplete = true;
+                } else {
 
-                // lets aggregate
-                meanMaxAggregate(wattsMeanMaxDouble, rideCache.wattsMeanMaxDouble, wattsMeanMaxDate, rideDate);
-                meanMaxAggregate(hrMeanMaxDouble, rideCache.hrMeanMaxDouble, hrMeanMaxDate, rideDate);
-                meanMaxAggregate(cadMeanMaxDouble, rideCache.cadMeanMaxDouble, cadMeanMaxDate, rideDate);
-                meanMaxAggregate(nmMeanMaxDouble, rideCache.nmMeanMaxDouble, nmMeanMaxDate, rideDate);
-                meanMaxAggregate(kphMeanMaxDouble, rideCache.kphMeanMaxDouble, kphMeanMaxDate, rideDate);
-                meanMaxAggregate(kphdMeanMaxDouble, rideCache.kphdMeanMaxDouble, kphdMeanMaxDate, rideDate);
-                meanMaxAggregate(wattsdMeanMaxDouble, rideCache.wattsdMeanMaxDouble, wattsdMeanMaxDate, rideDate);
-                meanMaxAggregate(caddMeanMaxDouble, rideCache.caddMeanMaxDouble, caddMeanMaxDate, rideDate);
-                meanMaxAggregate(nmdMeanMaxDouble, rideCache.nmdMeanMaxDouble, nmdMeanMaxDate, rideDate);
-                meanMaxAggregate(hrdMeanMaxDouble, rideCache.hrdMeanMaxDouble, hrdMeanMaxDate, rideDate);
-                meanMaxAggregate(xPowerMeanMaxDouble, rideCache.xPowerMeanMaxDouble, xPowerMeanMaxDate, rideDate);
-                meanMaxAggregate(npMeanMaxDouble, rideCache.npMeanMaxDouble, npMeanMaxDate, rideDate);
-                meanMaxAggregate(vamMeanMaxDouble, rideCache.vamMeanMaxDouble, vamMeanMaxDate, rideDate);
-                meanMaxAggregate(wattsKgMeanMaxDouble, rideCache.wattsKgMeanMaxDouble, wattsKgMeanMaxDate, rideDate);
-                meanMaxAggregate(aPowerMeanMaxDouble, rideCache.aPowerMeanMaxDouble, aPowerMeanMaxDate, rideDate);
-
-                distAggregate(wattsDistributionDouble, rideCache.wattsDistributionDouble);
-                distAggregate(hrDistributionDouble, rideCache.hrDistributionDouble);
-                distAggregate(cadDistributionDouble, rideCache.cadDistributionDouble);
-                distAggregate(gearDistributionDouble, rideCache.gearDistributionDouble);
-                distAggregate(nmDistributionDouble, rideCache.nmDistributionDouble);
-                distAggregate(kphDistributionDouble, rideCache.kphDistributionDouble);
-                distAggregate(xPowerDistributionDouble, rideCache.xPowerDistributionDouble);
-                distAggregate(npDistributionDouble, rideCache.npDistributionDouble);
-                distAggregate(wattsKgDistributionDouble, rideCache.wattsKgDistributionDouble);
-                distAggregate(aPowerDistributionDouble, rideCache.aPowerDistributionDouble);
-                distAggregate(smo2DistributionDouble, rideCache.smo2DistributionDouble);
-                distAggregate(wbalDistributionDouble, rideCache.wbalDistributionDouble);
-
-                // cumulate timeinzones
-                for (int i=0; i<10; i++) {
-                    paceTimeInZone[i] += rideCache.paceTimeInZone[i];
-                    hrTimeInZone[i] += rideCache.hrTimeInZone[i];
-                    wattsTimeInZone[i] += rideCache.wattsTimeInZone[i];
-                    if (i<4) {
-                        paceCPTimeInZone[i] += rideCache.paceCPTimeInZone[i];
-                        hrCPTimeInZone[i] += rideCache.hrCPTimeInZone[i];
-                        wattsCPTimeInZone[i] += rideCache.wattsCPTimeInZone[i];
-                        wbalTimeInZone[i] += rideCache.wbalTimeInZone[i];
+                    // lets aggregate
+                    meanMaxAggregate(wattsMeanMaxDouble, rideCache.wattsMeanMaxDouble, wattsMeanMaxDate, rideDate);
+                    meanMaxAggregate(hrMeanMaxDouble, rideCache.hrMeanMaxDouble, hrMeanMaxDate, rideDate);
+                    meanMaxAggregate(cadMeanMaxDouble, rideCache.cadMeanMaxDouble, cadMeanMaxDate, rideDate);
+                    meanMaxAggregate(nmMeanMaxDouble, rideCache.nmMeanMaxDouble, nmMeanMaxDate, rideDate);
+                    meanMaxAggregate(kphMeanMaxDouble, rideCache.kphMeanMaxDouble, kphMeanMaxDate, rideDate);
+                    meanMaxAggregate(kphdMeanMaxDouble, rideCache.kphdMeanMaxDouble, kphdMeanMaxDate, rideDate);
+                    meanMaxAggregate(wattsdMeanMaxDouble, rideCache.wattsdMeanMaxDouble, wattsdMeanMaxDate, rideDate);
+                    meanMaxAggregate(caddMeanMaxDouble, rideCache.caddMeanMaxDouble, caddMeanMaxDate, rideDate);
+                    meanMaxAggregate(nmdMeanMaxDouble, rideCache.nmdMeanMaxDouble, nmdMeanMaxDate, rideDate);
+                    meanMaxAggregate(hrdMeanMaxDouble, rideCache.hrdMeanMaxDouble, hrdMeanMaxDate, rideDate);
+                    meanMaxAggregate(xPowerMeanMaxDouble, rideCache.xPowerMeanMaxDouble, xPowerMeanMaxDate, rideDate);
+                    meanMaxAggregate(npMeanMaxDouble, rideCache.npMeanMaxDouble, npMeanMaxDate, rideDate);
+                    meanMaxAggregate(vamMeanMaxDouble, rideCache.vamMeanMaxDouble, vamMeanMaxDate, rideDate);
+                    meanMaxAggregate(wattsKgMeanMaxDouble, rideCache.wattsKgMeanMaxDouble, wattsKgMeanMaxDate, rideDate);
+                    meanMaxAggregate(aPowerMeanMaxDouble, rideCache.aPowerMeanMaxDouble, aPowerMeanMaxDate, rideDate);
+
+                    distAggregate(wattsDistributionDouble, rideCache.wattsDistributionDouble);
+                    distAggregate(hrDistributionDouble, rideCache.hrDistributionDouble);
+                    distAggregate(cadDistributionDouble, rideCache.cadDistributionDouble);
+                    distAggregate(gearDistributionDouble, rideCache.gearDistributionDouble);
+                    distAggregate(nmDistributionDouble, rideCache.nmDistributionDouble);
+                    distAggregate(kphDistributionDouble, rideCache.kphDistributionDouble);
+                    distAggregate(xPowerDistributionDouble, rideCache.xPowerDistributionDouble);
+                    distAggregate(npDistributionDouble, rideCache.npDistributionDouble);
+                    distAggregate(wattsKgDistributionDouble, rideCache.wattsKgDistributionDouble);
+                    distAggregate(aPowerDistributionDouble, rideCache.aPowerDistributionDouble);
+                    distAggregate(smo2DistributionDouble, rideCache.smo2DistributionDouble);
+                    distAggregate(wbalDistributionDouble, rideCache.wbalDistributionDouble);
+
+                    // cumulate timeinzones
+                    for (int i=0; i<10; i++) {
+                        paceTimeInZone[i] += rideCache.paceTimeInZone[i];
+                        hrTimeInZone[i] += rideCache.hrTimeInZone[i];
+                        wattsTimeInZone[i] += rideCache.wattsTimeInZone[i];
+                        if (i<4) {
+                            paceCPTimeInZone[i] += rideCache.paceCPTimeInZone[i];
+                            hrCPTimeInZone[i] += rideCache.hrCPTimeInZone[i];
+                            wattsCPTimeInZone[i] += rideCache.wattsCPTimeInZone[i];
+                            wbalTimeInZone[i] += rideCache.wbalTimeInZone[i];
+                        }
                     }
                 }
             }
@@ -1772,6 +1863,7 @@ RideFileCache::serialize(QDataStream *out)
     // write header
     head.version = RideFileCacheVersion;
     head.crc = crc;
+    stampRideFile(rideFileName, head);
     head.CP = CP;
     head.WPRIME = WPRIME;
     head.LTHR = LTHR;
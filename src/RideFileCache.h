@@ -41,7 +41,7 @@ typedef double data_t;
 // arrays when plotting CP curves and histograms. It is precoputed
 // to save time and cached in a file .cpx
 //
-static const unsigned int RideFileCacheVersion = 24;
+static const unsigned int RideFileCacheVersion = 25;
 // revision history:
 // version  date         description
 // 1        29-Apr-11    Initial - header, mean-max & distribution data blocks
@@ -67,6 +67,7 @@ static const unsigned int RideFileCacheVersion = 24;
 // 22       02-Feb-15    Added weight to header
 // 23       14-Jun-15    Added W'bal TiZ and Distribution
 // 24       15-Jun-15    Fix percentify error on W'bal Distribution
+// 25       18-Oct-15    Added ride file size, inode and mtime to header
 
 // The cache file (.cpx) has a binary format:
 // 1 x Header data - describing the version and contents of the cache
@@ -117,7 +118,12 @@ struct RideFileCacheHeader {
     double CV;   // used to calculate Time in Zone (TIZ)
     double WEIGHT; // weight in kg x 10 used for w/kg
     double WPRIME; // W' used from config used to calculate (TIZ)
-                
+
+    // the ride file as it was when we last checked its crc, so
+    // we only read it again when one of these changes
+    qint64 fileSize;
+    quint64 fileInode; // 0 where there aren't any
+    qint64 fileModified; // secs since epoch
 };
 
 
@@ -392,25 +398,40 @@ struct cpintdata {
     cpintdata() : rec_int_ms(0) {}
 };
 
-// the mean-max computer ... runs in a thread
-class MeanMaxComputer : public QThread
+// the ride samples decritized to recIntSecs with any gaps in
+// recording filled, this is the same for every series so it
+// is worked out once and shared by all the mean-max computers
+struct MeanMaxTimeline {
+    MeanMaxTimeline(RideFile *ride);
+
+    QVector<int> samples; // index into the ride, -1 for a gap
+    int total_secs;
+};
+
+// the mean-max computer ... RideFileCache::compute() runs one for
+// each series on the global thread pool, or just call run()
+class MeanMaxComputer
 {
     public:
-        MeanMaxComputer(RideFile *ride, QVector<float>&array, RideFile::SeriesType series)
-        : ride(ride), array(array), series(series) {}
+        MeanMaxComputer(RideFile *ride, QVector<float>&array, RideFile::SeriesType series,
+                        const MeanMaxTimeline *timeline = NULL, data_t *buffer = NULL)
+        : ride(ride), array(array), series(series), timeline(timeline), buffer(buffer) {}
         void run();
 
     private:
 
         // Mark Rages' algorithm for fast find of mean max
-        data_t *integrate_series(cpintdata &data);
         data_t partial_max_mean(data_t *dataseries_i, int start, int end, int length, int *offset);
         data_t divided_max_mean(data_t *dataseries_i, int datalength, int length, int *offset);
 
         RideFile *ride;
         QVector<float> &array;
-        QVector<data_t> integratedArray;
 
         RideFile::SeriesType series;
+
+        // shared timeline and our slice of the integrated buffer
+        // (samples+1 long), we make our own if not passed
+        const MeanMaxTimeline *timeline;
+        data_t *buffer;
 };
 #endif // _GC_RideFileCache_h
@@ -24,6 +24,8 @@
 #include "IntervalItem.h"
 #include "Route.h"
 #include "Context.h"
+#include "Athlete.h"
+#include "RideCache.h"
 #include "Zones.h"
 #include "HrZones.h"
 #include "PaceZones.h"
@@ -424,6 +426,9 @@ RideItem::setStartTime(QDateTime newDateTime)
 {
     dateTime = newDateTime;
     ride()->setStartTime(newDateTime);
+
+    // the ride list is kept in date order
+    context->athlete->rideCache->sortRides();
 }
 
 // check if we need to be refreshed
@@ -463,12 +468,12 @@ RideItem::checkStale()
 
             // get the new zone configuration fingerprint that applies for the ride date
             unsigned long rfingerprint = static_cast<unsigned long>(context->athlete->zones()->getFingerprint(dateTime.date()))
-                        + (appsettings->cvalue(context->athlete->cyclist, GC_USE_CP_FOR_FTP, 0).toInt() ? 1 : 0)
+                        + (context->athlete->settings()->useCPforFTP ? 1 : 0)
                         + static_cast<unsigned long>(context->athlete->paceZones(false)->getFingerprint(dateTime.date()))
                         + static_cast<unsigned long>(context->athlete->paceZones(true)->getFingerprint(dateTime.date()))
                         + static_cast<unsigned long>(context->athlete->hrZones()->getFingerprint(dateTime.date()))
                         + static_cast<unsigned long>(context->athlete->routes->getFingerprint())
-                        + appsettings->cvalue(context->athlete->cyclist, GC_DISCOVERY, 57).toInt(); // 57 does not include search for PEAKS
+                        + context->athlete->settings()->discovery; // 57 does not include search for PEAKS
 
             if (fingerprint != rfingerprint) {
 
@@ -481,14 +486,19 @@ RideItem::checkStale()
                 QFile file(fullPath);
 
                 // has timestamp changed ?
-                if (timestamp < QFileInfo(file).lastModified().toTime_t()) {
+                unsigned long modified = QFileInfo(file).lastModified().toTime_t();
+                if (timestamp < modified) {
 
                     // if timestamp has changed then check crc
-                    unsigned long fcrc = RideFile::computeFileCRC(fullPath);
+                    quint64 fcrc = RideFile::computeFileHash(fullPath);
 
                     if (crc == 0 || crc != fcrc) {
                         crc = fcrc; // update as expensive to calculate
                         isstale = true;
+                    } else {
+                        // only touched (e.g. by a sync tool), so catch up with
+                        // it to avoid reading the whole file again next time
+                        timestamp = modified;
                     }
                 }
 
@@ -578,12 +588,12 @@ RideItem::refresh()
 
         // update fingerprints etc, crc done above
         fingerprint = static_cast<unsigned long>(context->athlete->zones()->getFingerprint(dateTime.date()))
-                    + (appsettings->cvalue(context->athlete->cyclist, GC_USE_CP_FOR_FTP, 0).toInt() ? 1 : 0)
+                    + (context->athlete->settings()->useCPforFTP ? 1 : 0)
                     + static_cast<unsigned long>(context->athlete->paceZones(false)->getFingerprint(dateTime.date()))
                     + static_cast<unsigned long>(context->athlete->paceZones(true)->getFingerprint(dateTime.date()))
                     + static_cast<unsigned long>(context->athlete->hrZones()->getFingerprint(dateTime.date()))
                     + static_cast<unsigned long>(context->athlete->routes->getFingerprint()) +
-                    + appsettings->cvalue(context->athlete->cyclist, GC_DISCOVERY, 57).toInt(); // 57 does not include search for PEAKS
+                    + context->athlete->settings()->discovery; // 57 does not include search for PEAKS
 
         dbversion = DBSchemaVersion;
         timestamp = QDateTime::currentDateTime().toTime_t();
@@ -631,7 +641,7 @@ RideItem::getWeight(int type)
             if (!weight) weight = metadata_.value("Weight", "0.0").toDouble();
 
             // global options and if not set default to 75 kg.
-            if (!weight) weight = appsettings->cvalue(context->athlete->cyclist, GC_WEIGHT, "75.0").toString().toDouble();
+            if (!weight) weight = context->athlete->settings()->weight;
     
             // No weight default is weird, we'll set to 80kg
             if (weight <= 0.00) weight = 80.00;
@@ -702,7 +712,7 @@ void
 RideItem::updateIntervals()
 {
     // what do we need ?
-    int discovery = appsettings->cvalue(context->athlete->cyclist, GC_DISCOVERY, 57).toInt(); // 57 does not include search for PEAKS
+    int discovery = context->athlete->settings()->discovery; // 57 does not include search for PEAKS
 
     // DO NOT USE ride() since it will call a refresh !
     RideFile *f = ride_;
@@ -129,7 +129,9 @@ class RideItem : public QObject
 
         // context the item was updated to
         unsigned long fingerprint; // zones
-        unsigned long metacrc, crc, timestamp; // file content
+        unsigned long metacrc; // file content
+        quint64 crc; // see RideFile::computeFileHash
+        unsigned long timestamp;
         int dbversion; // metric version
         double weight; // what weight was used ?
 
@@ -133,6 +133,54 @@ int DBSchemaVersion = 123;
 RideMetricFactory *RideMetricFactory::_instance;
 QVector<QString> RideMetricFactory::noDeps;
 
+void
+RideMetricFactory::buildGraph()
+{
+    // only the first caller builds it, the rest wait for it
+    QMutexLocker locker(&graphLock);
+    if (graphBuilt.fetchAndAddAcquire(0)) return;
+
+    checkDependencies();
+
+    // resolve the dependencies to indexes
+    dependencyIndexes.clear();
+    dependencyIndexes.resize(metricNames.count());
+    for (int i=0; i<metricNames.count(); i++) {
+        QVector<QString> *deps = dependencyMap.value(metricNames[i]);
+        if (!deps) continue;
+        foreach(const QString &dep, *deps) {
+            RideMetric *m = metrics.value(dep, NULL);
+            if (m) dependencyIndexes[i] << m->index();
+        }
+    }
+
+    // depth first to sort into execution order
+    executionOrder.clear();
+    QVector<int> state(metricNames.count(), 0);
+    for (int i=0; i<metricNames.count(); i++) visit(i, state);
+
+    // publish it
+    graphBuilt.fetchAndStoreRelease(1);
+}
+
+void
+RideMetricFactory::visit(int index, QVector<int> &state)
+{
+    // 0 = not visited, 1 = in progress, 2 = done
+    if (state[index] == 2) return;
+
+    // a metric that ends up depending on itself can never be computed,
+    // like a missing dependency it is a mistake when registering them
+    assert(state[index] != 1);
+    if (state[index] == 1) return;
+
+    state[index] = 1;
+    foreach(int dep, dependencyIndexes[index]) visit(dep, state);
+    state[index] = 2;
+
+    executionOrder << index;
+}
+
 QHash<QString,RideMetricPtr>
 RideMetric::computeMetrics(const Context *context, const RideFile *ride, const Zones *zones, const HrZones *hrZones,
                            const QStringList &metrics)
@@ -141,34 +189,66 @@ RideMetric::computeMetrics(const Context *context, const RideFile *ride, const Z
     int hrZoneRange = hrZones->whichRange(ride->startTime().date());
 
     const RideMetricFactory &factory = RideMetricFactory::instance();
-    QStringList todo = metrics;
-    QHash<QString,RideMetric*> done;
+    const QVector<int> &order = factory.order();
+
+    // work out what we need, the metrics asked
+    // for and everything they depend upon
+    QVector<bool> needed(factory.metricCount(), false);
+    QVector<int> todo;
+    foreach (QString symbol, metrics) {
+        const RideMetric *m = factory.rideMetric(symbol);
+        if (m && !needed[m->index()]) {
+            needed[m->index()] = true;
+            todo << m->index();
+        }
+    }
     while (!todo.isEmpty()) {
-        QString symbol = todo.takeFirst();
-        if (!factory.haveMetric(symbol)) continue;
-        const QVector<QString> &deps = factory.dependencies(symbol);
-        bool ready = true;
-        foreach (QString dep, deps) {
-            if (!done.contains(dep)) {
-                ready = false;
-                if (!todo.contains(dep))
-                    todo.append(dep);
+        int index = todo.last();
+        todo.remove(todo.count()-1);
+        foreach (int dep, factory.dependencies(index)) {
+            if (!needed[dep]) {
+                needed[dep] = true;
+                todo << dep;
             }
         }
-        if (ready) {
-            RideMetric *m = factory.newMetric(symbol);
-            m->setValue(0.0);
-            m->setCount(0);
-            m->compute(ride, zones, zoneRange, hrZones, hrZoneRange, done, context);
-            if (ride->metricOverrides.contains(symbol))
-                m->override(ride->metricOverrides.value(symbol));
-            done.insert(symbol, m);
+    }
+
+    // create them in execution order, noting the accumulators
+    QVector<RideMetric*> instances;
+    QVector<RideMetric*> accumulators;
+    foreach (int index, order) {
+        if (!needed[index]) continue;
+
+        RideMetric *m = factory.newMetric(factory.metricName(index));
+        m->setValue(0.0);
+        m->setCount(0);
+        instances << m;
+
+        if (m->isAccumulator()) {
+            m->begin(ride);
+            accumulators << m;
         }
-        else {
-            if (!todo.contains(symbol))
-                todo.append(symbol);
+    }
+
+    // one sweep over the samples for all the accumulators
+    if (accumulators.count()) {
+        RideMetric **first = accumulators.data();
+        RideMetric **last = first + accumulators.count();
+        foreach (const RideFilePoint *p, ride->dataPoints()) {
+            for (RideMetric **m = first; m != last; m++) (*m)->accumulate(p);
         }
     }
+
+    // compute (or finalise accumulators) in dependency order
+    QHash<QString,RideMetric*> done;
+    foreach (RideMetric *m, instances) {
+        QString symbol = m->symbol();
+        m->compute(ride, zones, zoneRange, hrZones, hrZoneRange, done, context);
+        if (ride->metricOverrides.contains(symbol))
+            m->override(ride->metricOverrides.value(symbol));
+        done.insert(symbol, m);
+    }
+
     QHash<QString,RideMetricPtr> result;
     foreach (QString symbol, metrics) {
         result.insert(symbol, QSharedPointer<RideMetric>(done.value(symbol)));
@@ -24,6 +24,8 @@
 #include <QString>
 #include <QVector>
 #include <QSharedPointer>
+#include <QMutex>
+#include <QAtomicInt>
 #include <assert.h>
 #include <cmath>
 #include <QDebug>
@@ -122,6 +124,18 @@ public:
                          const QHash<QString,RideMetric*> &deps,
                          const Context *context = 0) = 0;
 
+    // Single pass metrics
+    //
+    // Most metrics just walk the samples once. Rather than each of them
+    // looping over ride->dataPoints() in compute() they can return true
+    // from isAccumulator() and implement begin() and accumulate().
+    // computeMetrics() will then make a single sweep over the samples
+    // for all accumulators together and call compute() afterwards, which
+    // should only turn the accumulated values into the metric value.
+    virtual bool isAccumulator() const { return false; }
+    virtual void begin(const RideFile *) {}
+    virtual void accumulate(const RideFilePoint *) {}
+
     // is a time value, ie. render as hh:mm:ss
     virtual bool isTime() const { return false; }
 
@@ -206,7 +220,19 @@ class RideMetricFactory {
     QHash<QString,QVector<QString>*> dependencyMap;
     bool dependenciesChecked;
 
-    RideMetricFactory() : dependenciesChecked(false) {}
+    // dependency graph resolved to metric indexes, built by initialize()
+    // once all the metrics have been registered and then shared by every
+    // call to RideMetric::computeMetrics, which runs on the refresh threads
+    // so graphBuilt is only set (with release) once the graph is complete
+    QVector<QVector<int> > dependencyIndexes;
+    QVector<int> executionOrder;
+    QAtomicInt graphBuilt;
+    QMutex graphLock;
+
+    void buildGraph();
+    void visit(int index, QVector<int> &state);
+
+    RideMetricFactory() : dependenciesChecked(false), graphBuilt(0) {}
     RideMetricFactory(const RideMetricFactory &other);
     RideMetricFactory &operator=(const RideMetricFactory &other);
 
@@ -232,6 +258,21 @@ class RideMetricFactory {
     void initialize() {
         foreach(const QString &metricName, metrics.keys())
             metrics[metricName]->initialize();
+        buildGraph();
+    }
+
+    // metric indexes sorted so every metric comes after its dependencies
+    const QVector<int> &order() const {
+        if (!const_cast<QAtomicInt&>(graphBuilt).fetchAndAddAcquire(0))
+            const_cast<RideMetricFactory*>(this)->buildGraph();
+        return executionOrder;
+    }
+
+    // the indexes of the metrics the metric at index depends upon
+    const QVector<int> &dependencies(int index) const {
+        if (!const_cast<QAtomicInt&>(graphBuilt).fetchAndAddAcquire(0))
+            const_cast<RideMetricFactory*>(this)->buildGraph();
+        return dependencyIndexes[index];
     }
 
     const QStringList &allMetrics() const { return metricNames; }
@@ -264,6 +305,7 @@ class RideMetricFactory {
             dependencyMap.insert(metric.symbol(), copy);
             dependenciesChecked = false;
         }
+        graphBuilt.fetchAndStoreOrdered(0);
         return true;
     }
 
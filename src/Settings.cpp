@@ -68,6 +68,17 @@ static const QString settingFileNamesAthlete[4] = {"athlete-general.ini","athlet
 
 
 
+// remove the <store> prefix from a key, the same as removing "^<.*>"
+// but without compiling a regular expression on every lookup
+static QString &StripStore(QString &key)
+{
+    if (key.startsWith('<')) {
+        int end = key.lastIndexOf('>');
+        if (end > 0) key.remove(0, end+1);
+    }
+    return key;
+}
+
 static QString DetermineKey(QString & key, int& store, int& fileIndex) {
 
     store = SETTINGS_SYSTEM; // default to systemsettings
@@ -93,7 +104,7 @@ static QString DetermineKey(QString & key, int& store, int& fileIndex) {
     }
 
     // and make sure <> text is removed
-    return key.remove(QRegExp("^<.*>"));
+    return StripStore(key);
 
 }
 
@@ -136,7 +147,7 @@ GSettings::value(const QObject * /*me*/, const QString key, const QVariant def)
         }
 
     } else {
-        keyVar.remove(QRegExp("^<.*>"));
+        StripStore(keyVar);
         return systemsettings->value(keyVar, def);
     }
     return QVariant();
@@ -163,7 +174,7 @@ GSettings::setValue(QString key, QVariant value)
 
         }
     } else {
-        keyVar.remove(QRegExp("^<.*>"));
+        StripStore(keyVar);
         systemsettings->setValue(keyVar, value);
     }
 
@@ -199,7 +210,7 @@ GSettings::cvalue(QString athleteName, QString key, QVariant def) {
         }
 
     } else {
-        keyVar.remove(QRegExp("^<.*>"));
+        StripStore(keyVar);
         return systemsettings->value(athleteName+"/"+keyVar, def);
     }
     return QVariant();
@@ -227,7 +238,7 @@ GSettings::setCValue(QString athleteName, QString key, QVariant value) {
             }
         } // if we do have have the athlete - then we do not store anything
     } else {
-        keyVar.remove(QRegExp("^<.*>"));
+        StripStore(keyVar);
         systemsettings->setValue(athleteName + "/" + keyVar,value);
 
     }
@@ -301,7 +312,7 @@ GSettings::contains(const QString & key) const {
             break;
         }
     } else {
-        keyVar.remove(QRegExp("^<.*>"));
+        StripStore(keyVar);
         return systemsettings->contains(keyVar);
     }
     return false;
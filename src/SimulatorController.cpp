@@ -0,0 +1,182 @@
+/*
+ * Copyright (c) 2015 Mark Liversedge (liversedge@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "SimulatorController.h"
+#include "TrainEngine.h" // for the clock
+#include "RideFile.h"
+
+#include <QFile>
+#include <QDebug>
+#include <cmath>
+
+SimulatorController::SimulatorController(TrainSidebar *parent, DeviceConfiguration *dc)
+  : RealtimeController(parent, dc), rate(4), mode(RT_MODE_ERGO), load(100), slope(0),
+    started(0), pausedAt(-1), pausedFor(0), last(-1), produced(0), overwritten(0)
+{
+    if (dc) {
+        if (dc->deviceProfile.toDouble() > 0) rate = dc->deviceProfile.toDouble();
+        if (dc->portSpec != "") {
+            QStringList errors;
+            if (!setTrace(dc->portSpec, errors))
+                qDebug()<<"simulator: can't replay"<<dc->portSpec<<errors;
+        }
+    }
+}
+
+bool
+SimulatorController::setTrace(QString filename, QStringList &errors)
+{
+    QFile file(filename);
+    RideFile *ride = RideFileFactory::instance().openRideFile(NULL, file, errors);
+    if (!ride) return false;
+
+    trace.clear();
+    foreach(const RideFilePoint *p, ride->dataPoints()) {
+        TracePoint add;
+        add.secs = p->secs;
+        add.watts = p->watts;
+        add.hr = p->hr;
+        add.cad = p->cad;
+        add.kph = p->kph;
+        trace << add;
+    }
+    delete ride;
+
+    if (trace.isEmpty()) {
+        errors << tr("%1 has no samples to replay").arg(filename);
+        return false;
+    }
+    return true;
+}
+
+int
+SimulatorController::start()
+{
+    started = TrainEngine::clock();
+    pausedAt = -1;
+    pausedFor = 0;
+    last = -1;
+    produced = overwritten = 0;
+    polled.clear();
+    loaded.clear();
+    graded.clear();
+    return 0;
+}
+
+int
+SimulatorController::stop()
+{
+    return 0;
+}
+
+int
+SimulatorController::pause()
+{
+    // the sensors stop producing too
+    if (pausedAt < 0) pausedAt = TrainEngine::clock();
+    return 0;
+}
+
+int
+SimulatorController::restart()
+{
+    if (pausedAt >= 0) pausedFor += TrainEngine::clock() - pausedAt;
+    pausedAt = -1;
+    return 0;
+}
+
+void
+SimulatorController::setLoad(double watts)
+{
+    SimulatorEvent add;
+    add.at = TrainEngine::clock();
+    add.value = watts;
+    loaded << add;
+
+    load = watts;
+}
+
+void
+SimulatorController::setGradient(double slope)
+{
+    SimulatorEvent add;
+    add.at = TrainEngine::clock();
+    add.value = slope;
+    graded << add;
+
+    this->slope = slope;
+}
+
+const SimulatorController::TracePoint &
+SimulatorController::traceAt(double secs) const
+{
+    // loop around when we run out
+    double span = trace.last().secs - trace.first().secs + 1;
+    double t = trace.first().secs + fmod(secs, span);
+
+    // last point at or before t
+    int lo = 0, hi = trace.count() - 1;
+    while (lo < hi) {
+        int mid = (lo + hi + 1) / 2;
+        if (trace.at(mid).secs <= t) lo = mid;
+        else hi = mid - 1;
+    }
+    return trace.at(lo);
+}
+
+void
+SimulatorController::getRealtimeData(RealtimeData &rtData)
+{
+    qint64 now = TrainEngine::clock();
+
+    // which reading are the sensors on, time stands still when paused
+    qint64 elapsed = (pausedAt >= 0 ? pausedAt : now) - started - pausedFor;
+    long reading = long(double(elapsed) * rate / 1000000.0);
+
+    // any in between were overwritten before anyone looked
+    if (reading > last) {
+        overwritten += reading - last - 1;
+        produced = reading + 1;
+        last = reading;
+    }
+
+    SimulatorEvent poll;
+    poll.at = now;
+    poll.value = double(started + pausedFor) + double(reading) * 1000000.0 / rate;
+    polled << poll;
+
+    rtData.setName((char *)"Simulator");
+    rtData.setLoad(load);
+
+    if (trace.count()) {
+        const TracePoint &p = traceAt(double(reading) / rate);
+        rtData.setWatts(p.watts);
+        rtData.setHr(p.hr);
+        rtData.setCadence(p.cad);
+        rtData.setSpeed(p.kph);
+
+    } else {
+        // a perfect trainer in ERG, and a steady rider otherwise
+        double watts = (mode & RT_MODE_ERGO) ? load : 200;
+        rtData.setWatts(watts);
+        rtData.setHr(100 + watts / 5);
+        rtData.setCadence(90);
+        rtData.setSpeed(slope < 10 ? 30 - (slope * 2) : 10);
+    }
+    processRealtimeData(rtData);
+}
@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2015 Mark Liversedge (liversedge@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _GC_SimulatorController_h
+#define _GC_SimulatorController_h 1
+#include "GoldenCheetah.h"
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+#include "RealtimeController.h"
+#include "RealtimeData.h"
+#include "DeviceTypes.h"
+#include "DeviceConfiguration.h"
+
+// The simulator stands in for a trainer and its sensors so the train
+// engine can be exercised without any hardware. The sensors produce a
+// new reading at a fixed rate (4 a second by default, like most ANT+
+// sensors) on the engine clock, and each poll returns the latest one.
+//
+// Readings are replayed from a recorded ride (any format we can import)
+// looping back to the start when it runs out, or if there isn't one made
+// up; following the load in ERG mode like a perfect trainer would.
+//
+// Every poll and every load/gradient the engine sends is logged against
+// the engine clock so the train benchmark can see how long things took.
+// The logs are written from the engine thread, so only look at them once
+// the session has stopped.
+//
+// When configured as a device the port is the ride to replay and the
+// profile is the rate in readings a second.
+
+struct SimulatorEvent
+{
+    qint64 at;      // engine clock usecs
+    double value;   // when the reading was produced, or load/gradient sent
+};
+
+class SimulatorController : public RealtimeController
+{
+    Q_OBJECT
+
+    public:
+
+        SimulatorController(TrainSidebar *parent, DeviceConfiguration *dc);
+        ~SimulatorController() { }
+
+        // replay this ride, false (and errors) if it can't be read
+        bool setTrace(QString filename, QStringList &errors);
+
+        // readings a second produced by the sensors
+        void setRate(double hz) { rate = hz > 0 ? hz : 4; }
+
+        int start();
+        int stop();
+        int pause();
+        int restart();
+        bool find() { return true; }
+        bool discover(QString) {  return true;  }
+        bool doesPush() {  return false; }
+        bool doesPull() {  return true; }
+        bool doesLoad() {  return true; }
+
+        void setLoad(double watts);
+        void setGradient(double slope);
+        void setMode(int mode) { this->mode = mode; }
+        void getRealtimeData(RealtimeData &rtData);
+
+        // what happened, see above
+        const QVector<SimulatorEvent> &polls() const { return polled; }
+        const QVector<SimulatorEvent> &loads() const { return loaded; }
+        const QVector<SimulatorEvent> &gradients() const { return graded; }
+        long readings() const { return produced; } // sensor readings produced
+        long missed() const { return overwritten; } // never polled before the next came along
+
+    private:
+
+        // a reading from the trace
+        struct TracePoint {
+            double secs, watts, hr, cad, kph;
+        };
+        const TracePoint &traceAt(double secs) const;
+
+        QVector<TracePoint> trace;
+        double rate;
+        int mode;
+        double load, slope;
+
+        qint64 started, pausedAt, pausedFor; // engine clock usecs
+        long last;                           // last reading we handed out
+
+        QVector<SimulatorEvent> polled, loaded, graded;
+        long produced, overwritten;
+};
+
+#endif // _GC_SimulatorController_h
@@ -21,6 +21,8 @@
 
 #include <QString>
 #include <QStringList>
+#include <QVector>
+#include <QSet>
 #include "TimeUtils.h"
 
 class RideItem;
@@ -28,14 +30,15 @@ class RideItem;
 class FilterSet
 {
 
-    // used to collect filters and apply if needed
-    QVector<QStringList> filters_;
+    // used to collect filters and apply if needed, they are
+    // held as sets since they are checked for every ride
+    QVector<QSet<QString> > filters_;
 
     public:
 
         // create one with a set
         FilterSet(bool on, QStringList list) {
-            if (on) filters_ << list;
+            if (on) filters_ << list.toSet();
         }
 
         // create an empty set
@@ -43,7 +46,7 @@ class FilterSet
 
         // add a new filter
         void addFilter(bool on, QStringList list) {
-            if (on) filters_ << list;
+            if (on) filters_ << list.toSet();
         }
 
         // clear the filter set
@@ -52,9 +55,9 @@ class FilterSet
         }
 
         // does the name in question pass the filter set ?
-        bool pass(QString name) {
-            foreach(QStringList list, filters_)
-                if (!list.contains(name))
+        bool pass(const QString &name) {
+            for (int i=0; i<filters_.count(); i++)
+                if (!filters_.at(i).contains(name))
                     return false;
             return true;
         }
@@ -0,0 +1,222 @@
+/*
+ * Copyright (c) 2015 Mark Liversedge (liversedge@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "TrainBenchmark.h"
+#include "TrainEngine.h"
+#include "TrainSidebar.h" // for the rates
+#include "SimulatorController.h"
+#include "ErgFile.h"
+
+#include <QVector>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QStringList>
+#include <stdio.h>
+#include <cmath>
+
+// a sample as it was taken off the queue
+struct BenchSample {
+    qint64 polled, consumed;    // engine clock usecs
+    long workoutMsecs;
+    bool control;
+};
+
+// print a distribution of values in usecs as msecs
+static void
+distribution(const char *name, QVector<double> values)
+{
+    if (values.isEmpty()) {
+        printf("%-28s n/a\n", name);
+        return;
+    }
+    qSort(values);
+
+    int n = values.count();
+    printf("%-28s n=%-6d p50 %8.3f  p90 %8.3f  p99 %8.3f  max %8.3f ms\n", name, n,
+           values[(n-1) * 50 / 100] / 1000.0,
+           values[(n-1) * 90 / 100] / 1000.0,
+           values[(n-1) * 99 / 100] / 1000.0,
+           values[n-1] / 1000.0);
+}
+
+TrainBenchmark::TrainBenchmark(QString workout) :
+    workout(workout), rate(4), duration(0), stall(0)
+{
+}
+
+int
+TrainBenchmark::run()
+{
+    int mode = 0;
+    ErgFile ergFile(workout, mode, NULL);
+    if (!ergFile.isValid()) {
+        fprintf(stderr, "trainbench: can't read workout %s\n", workout.toLocal8Bit().constData());
+        return 1;
+    }
+    bool ergo = (ergFile.format == ERG || ergFile.format == MRC);
+
+    SimulatorController simulator(NULL, NULL);
+    simulator.setRate(rate);
+    simulator.setMode(ergo ? RT_MODE_ERGO : RT_MODE_SPIN);
+    if (trace != "") {
+        QStringList errors;
+        if (!simulator.setTrace(trace, errors)) {
+            fprintf(stderr, "trainbench: can't replay %s %s\n", trace.toLocal8Bit().constData(),
+                    errors.join(" ").toLocal8Bit().constData());
+            return 1;
+        }
+    }
+
+    // courses are by distance, so we need telling how long
+    long length = duration > 0 ? duration * 1000L : (ergo ? ergFile.Duration : 60000L);
+
+    TrainEngine engine;
+    engine.addDevice(&simulator, DEV_SIMULATOR, true, true, true, true);
+    engine.setWorkout(&ergFile, ergFile.format);
+    engine.setAthlete(300, 20000, 300, 75);
+
+    printf("trainbench: %s for %ld secs, sensors at %.1f/s%s, stalling %d msecs a second\n",
+           workout.toLocal8Bit().constData(), length / 1000, rate,
+           trace != "" ? " replaying a ride" : "", stall);
+
+    simulator.start();
+    engine.startSession(100, 0);
+
+    // take samples like the train view does
+    QVector<BenchSample> taken;
+    QMutex sleeper;
+    QWaitCondition nap;
+    sleeper.lock();
+
+    qint64 nextStall = TrainEngine::clock() + 1000000;
+    bool done = false;
+    while (!done) {
+
+        // in between repaints
+        nap.wait(&sleeper, REFRESHRATE / 4);
+
+        // busy doing something else
+        if (stall > 0 && TrainEngine::clock() >= nextStall) {
+            nap.wait(&sleeper, stall);
+            nextStall += 1000000;
+        }
+
+        TrainSample sample;
+        while (engine.nextSample(sample)) {
+            BenchSample add;
+            add.polled = sample.polled;
+            add.consumed = TrainEngine::clock();
+            add.workoutMsecs = sample.workoutMsecs;
+            add.control = sample.control;
+            taken << add;
+
+            if (sample.finished || sample.rtData.getMsecs() >= length) done = true;
+        }
+    }
+    sleeper.unlock();
+
+    engine.stopSession();
+    simulator.stop();
+
+    //
+    // Control loop timing
+    //
+    QVector<double> tickJitter, controlJitter;
+    long missedTicks = 0;
+    qint64 lastControl = -1;
+    for (int i=0; i<taken.count(); i++) {
+
+        if (i) {
+            qint64 interval = taken[i].polled - taken[i-1].polled;
+            tickJitter << fabs(double(interval - REFRESHRATE * 1000));
+
+            // a gap of a tick or more
+            if (interval > REFRESHRATE * 1500)
+                missedTicks += qint64(double(interval) / (REFRESHRATE * 1000.0) + 0.5) - 1;
+        }
+
+        if (taken[i].control) {
+            if (lastControl >= 0)
+                controlJitter << fabs(double(taken[i].polled - lastControl - LOADRATE * 1000));
+            lastControl = taken[i].polled;
+        }
+    }
+
+    //
+    // Load update latency, from a step in the workout to the
+    // trainer being told, for the steps we got through
+    //
+    QVector<double> loadLatency;
+    int unanswered = 0;
+    if (ergo && taken.count()) {
+
+        // when the workout started on the engine clock
+        qint64 base = taken[0].polled - taken[0].workoutMsecs * 1000L;
+        for (int i=1; i<taken.count(); i++)
+            base = qMin(base, taken[i].polled - taken[i].workoutMsecs * 1000L);
+
+        const QVector<SimulatorEvent> &loads = simulator.loads();
+        int j = 0;
+        for (int i=1; i<ergFile.Points.count(); i++) {
+
+            const ErgFilePoint &from = ergFile.Points.at(i-1);
+            const ErgFilePoint &to = ergFile.Points.at(i);
+            if (to.x != from.x || to.val == from.val) continue; // not a step
+            if (to.x >= taken.last().workoutMsecs) break;       // didn't get that far
+
+            qint64 demand = base + qint64(to.x) * 1000L;
+            while (j < loads.count() && loads.at(j).at < demand) j++;
+
+            if (j < loads.count()) loadLatency << double(loads.at(j).at - demand);
+            else unanswered++;
+        }
+    }
+
+    //
+    // Freshness, how old the readings were when the gui got them
+    // and how long they sat in the queue
+    //
+    QVector<double> sensorLatency, queueLatency;
+    const QVector<SimulatorEvent> &polls = simulator.polls();
+    int j = 0;
+    for (int i=0; i<taken.count(); i++) {
+
+        // the poll that went into this sample
+        while (j < polls.count() && polls.at(j).at < taken[i].polled) j++;
+        if (j < polls.count()) sensorLatency << double(taken[i].consumed) - polls.at(j).value;
+
+        queueLatency << double(taken[i].consumed - taken[i].polled);
+    }
+
+    printf("\n");
+    distribution("tick jitter", tickJitter);
+    distribution("control jitter", controlJitter);
+    if (ergo) distribution("load update latency", loadLatency);
+    else printf("%-28s n/a, not an ERG workout\n", "load update latency");
+    distribution("sensor to consumer latency", sensorLatency);
+    distribution("engine to consumer latency", queueLatency);
+
+    printf("\n");
+    printf("%-28s %d\n", "samples taken", taken.count());
+    printf("%-28s %ld\n", "ticks missed", missedTicks);
+    printf("%-28s %d\n", "samples dropped", engine.overflowed());
+    printf("%-28s %ld of %ld\n", "sensor readings never seen", simulator.missed(), simulator.readings());
+    if (unanswered) printf("%-28s %d\n", "load steps never sent", unanswered);
+
+    return 0;
+}
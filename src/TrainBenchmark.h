@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2015 Mark Liversedge (liversedge@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _GC_TrainBenchmark_h
+#define _GC_TrainBenchmark_h 1
+#include "GoldenCheetah.h"
+
+#include <QString>
+
+// Runs a workout through the train engine with a simulated trainer and
+// no GUI, then reports how well the engine kept time; tick and control
+// loop jitter, how long a step in the workout took to get to the trainer,
+// how old the sensor readings were by the time they were taken off the
+// queue and anything that was dropped along the way.
+//
+// Samples are taken off the queue the way the train view does, every
+// so often between repaints, and a stall can be added once a second to
+// see what a busy GUI thread does to the numbers.
+//
+// It runs in real time, from the command line:
+//   GoldenCheetah --trainbench=workout.erg [--trace=ride.fit] [--rate=4]
+//                 [--duration=secs] [--stall=msecs]
+class TrainBenchmark
+{
+    public:
+        TrainBenchmark(QString workout);
+
+        void setTrace(QString trace) { this->trace = trace; }
+        void setRate(double rate) { this->rate = rate; }
+        void setDuration(int secs) { duration = secs; }
+        void setStall(int msecs) { stall = msecs; }
+
+        // runs it and prints the report, 0 if it ran
+        int run();
+
+    private:
+        QString workout, trace;
+        double rate;
+        int duration, stall;
+};
+
+#endif // _GC_TrainBenchmark_h
@@ -0,0 +1,567 @@
+/*
+ * Copyright (c) 2015 Mark Liversedge (liversedge@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "TrainEngine.h"
+#include "TrainSidebar.h" // for the rates
+#include "RealtimeController.h"
+#include "DeviceTypes.h"
+#include "ErgFile.h"
+
+#include <QElapsedTimer>
+#include <cmath>
+
+//----------------------------------------------------------------------
+// SAMPLE QUEUE
+//----------------------------------------------------------------------
+
+TrainSampleQueue::TrainSampleQueue() : ring(size), head(0), tail(0)
+{
+}
+
+bool
+TrainSampleQueue::push(const TrainSample &sample)
+{
+    int h = head.fetchAndAddRelaxed(0);
+    int next = (h + 1) % size;
+
+    // full, the gui hasn't kept up
+    if (next == tail.fetchAndAddAcquire(0)) return false;
+
+    ring[h] = sample;
+    head.fetchAndStoreRelease(next); // publish
+    return true;
+}
+
+bool
+TrainSampleQueue::pop(TrainSample &sample)
+{
+    int t = tail.fetchAndAddRelaxed(0);
+
+    // empty
+    if (t == head.fetchAndAddAcquire(0)) return false;
+
+    sample = ring[t];
+    tail.fetchAndStoreRelease((t + 1) % size); // free the slot
+    return true;
+}
+
+void
+TrainSampleQueue::clear()
+{
+    head.fetchAndStoreOrdered(0);
+    tail.fetchAndStoreOrdered(0);
+}
+
+//----------------------------------------------------------------------
+// ENGINE
+//----------------------------------------------------------------------
+
+// started before anyone can ask for it
+static struct EngineClock {
+    EngineClock() { timer.start(); }
+    QElapsedTimer timer;
+} engineClock;
+
+qint64
+TrainEngine::clock()
+{
+    return engineClock.timer.nsecsElapsed() / 1000;
+}
+
+TrainEngine::TrainEngine(QObject *parent) : QThread(parent),
+    stopping(false), paused(false), calibrating(false),
+    ergFile(NULL), mode(ERG), ergo(true), workoutLap(0), laps(0),
+    workout_msecs(0), sinceControl(0), workout_distance(0),
+    load_(0), slope_(0), loadChanged(false), slopeChanged(false),
+    session_msecs(0), lap_msecs(0), distance(0), lastSpeed(0),
+    cp(285), wprime(20000), tau(300), wbalr(0), weight(0),
+    signalled(0), overflow(0)
+{
+}
+
+TrainEngine::~TrainEngine()
+{
+    stopSession();
+}
+
+void
+TrainEngine::clearDevices()
+{
+    devices.clear();
+}
+
+void
+TrainEngine::addDevice(RealtimeController *controller, int type,
+                       bool hr, bool cadence, bool speed, bool power)
+{
+    Device add;
+    add.controller = controller;
+    add.type = type;
+    add.hr = hr;
+    add.cadence = cadence;
+    add.speed = speed;
+    add.power = power;
+    devices << add;
+}
+
+void
+TrainEngine::setWorkout(ErgFile *ergFile, int mode)
+{
+    QMutexLocker locker(&mutex);
+    this->ergFile = ergFile;
+    this->mode = mode;
+    ergo = (mode == ERG || mode == MRC);
+}
+
+void
+TrainEngine::setAthlete(int cp, int wprime, double tau, double weight)
+{
+    QMutexLocker locker(&mutex);
+    this->cp = cp;
+    this->wprime = wprime;
+    this->tau = tau > 0 ? tau : 300;
+    this->weight = weight;
+}
+
+bool
+TrainEngine::record(QString filename, QDateTime start)
+{
+    if (isRunning()) return false;
+
+    QList<int> types;
+    foreach(Device device, devices) types << device.type;
+
+    return recorder.open(filename, start, REFRESHRATE, types);
+}
+
+void
+TrainEngine::startSession(long load, double slope)
+{
+    if (isRunning()) stopSession();
+
+    // nobody else is looking at it whilst we are stopped
+    queue.clear();
+    signalled.fetchAndStoreOrdered(0);
+
+    stopping = paused = calibrating = false;
+    workoutLap = laps = 0;
+    workout_msecs = sinceControl = 0;
+    workout_distance = 0;
+    load_ = load;
+    slope_ = slope;
+    loadChanged = slopeChanged = false;
+    session_msecs = lap_msecs = 0;
+    distance = lastSpeed = 0;
+    wbalr = 0;
+    overflow = 0;
+
+    // get a look in ahead of the GUI
+    start(QThread::TimeCriticalPriority);
+}
+
+void
+TrainEngine::stopSession()
+{
+    if (!isRunning()) return;
+
+    mutex.lock();
+    stopping = true;
+    wake.wakeAll();
+    mutex.unlock();
+
+    wait();
+    recorder.close();
+}
+
+void
+TrainEngine::setPaused(bool pause)
+{
+    QMutexLocker locker(&mutex);
+    paused = pause;
+}
+
+void
+TrainEngine::setCalibrating(bool calibrate)
+{
+    QMutexLocker locker(&mutex);
+    calibrating = calibrate;
+}
+
+void
+TrainEngine::resetLap()
+{
+    QMutexLocker locker(&mutex);
+    lap_msecs = 0;
+}
+
+void
+TrainEngine::newLap()
+{
+    QMutexLocker locker(&mutex);
+    laps++;
+}
+
+void
+TrainEngine::setLoad(long load)
+{
+    QMutexLocker locker(&mutex);
+    load_ = load;
+    loadChanged = true;
+}
+
+void
+TrainEngine::setSlope(double slope)
+{
+    QMutexLocker locker(&mutex);
+    slope_ = slope;
+    slopeChanged = true;
+}
+
+long
+TrainEngine::load()
+{
+    QMutexLocker locker(&mutex);
+    return load_;
+}
+
+double
+TrainEngine::slope()
+{
+    QMutexLocker locker(&mutex);
+    return slope_;
+}
+
+long
+TrainEngine::workoutMsecs()
+{
+    QMutexLocker locker(&mutex);
+    return workout_msecs;
+}
+
+void
+TrainEngine::setWorkoutMsecs(long msecs)
+{
+    QMutexLocker locker(&mutex);
+    workout_msecs = msecs < 0 ? 0 : msecs;
+}
+
+double
+TrainEngine::workoutDistance()
+{
+    QMutexLocker locker(&mutex);
+    return workout_distance;
+}
+
+void
+TrainEngine::setWorkoutDistance(double km)
+{
+    QMutexLocker locker(&mutex);
+    workout_distance = km < 0 ? 0 : km;
+}
+
+bool
+TrainEngine::nextSample(TrainSample &sample)
+{
+    if (queue.pop(sample)) return true;
+
+    // drained, so the next push needs to tell us again, but
+    // look once more in case one arrived before we cleared it
+    signalled.fetchAndStoreOrdered(0);
+    return queue.pop(sample);
+}
+
+void
+TrainEngine::run()
+{
+    // monotonic, so wall clock changes don't upset us
+    QElapsedTimer clock;
+    clock.start();
+
+    qint64 last = 0, deadline = 0;
+    forever {
+
+        // ticks are on a fixed grid, so a late tick
+        // doesn't push all the ones after it back too
+        deadline += REFRESHRATE;
+
+        {
+            QMutexLocker locker(&mutex);
+            qint64 wait;
+            while (!stopping && (wait = deadline - clock.elapsed()) > 0)
+                wake.wait(&mutex, wait);
+            if (stopping) break;
+        }
+
+        qint64 now = clock.elapsed();
+
+        // if we fell a long way behind (suspend, debugger) start
+        // the grid again rather than bursting to catch up
+        if (now - deadline > REFRESHRATE) deadline = now;
+
+        tick(now - last);
+        last = now;
+    }
+}
+
+// the lock is only held to take and update our state, never whilst talking
+// to the devices, since a serial or usb device can take a while to answer
+// and the GUI would be stuck waiting for it in the meantime
+void
+TrainEngine::tick(long dt)
+{
+    TrainSample sample;
+    sample.second = sample.control = sample.finished = false;
+
+    // what we are going to ask of the devices
+    bool calibrate, sendLoad = false, sendSlope = false;
+    long load, msecs;
+    double slope;
+    int rtmode;
+    {
+        QMutexLocker locker(&mutex);
+
+        // time stands still whilst paused
+        if (paused) return;
+        calibrate = calibrating;
+
+        if (!calibrate) {
+            session_msecs += dt;
+            lap_msecs += dt;
+            workout_msecs += dt;
+
+            // once a second, without drifting
+            sample.second = (session_msecs / SAMPLERATE) != ((session_msecs - dt) / SAMPLERATE);
+
+            // workout sets load or gradient at LOADRATE
+            if (ergFile) {
+                sinceControl += dt;
+                if (sinceControl >= LOADRATE) {
+                    sinceControl -= LOADRATE;
+                    if (sinceControl >= LOADRATE) sinceControl = 0;
+                    control(sample);
+                }
+            }
+
+            // including manual adjustments made since the last tick
+            sendLoad = loadChanged;
+            sendSlope = slopeChanged;
+            loadChanged = slopeChanged = false;
+        }
+        load = load_;
+        slope = slope_;
+        rtmode = mode;
+        msecs = session_msecs;
+    }
+
+    // only the computrainer is polled whilst calibrating, to see
+    // if the F3 button was pressed to finish it
+    if (calibrate) {
+        foreach(Device device, devices) {
+            if (device.type == DEV_CT) {
+                RealtimeData local;
+                device.controller->getRealtimeData(local);
+            }
+        }
+        return;
+    }
+
+    if (sendLoad) foreach(Device device, devices) device.controller->setLoad(load);
+    if (sendSlope) foreach(Device device, devices) device.controller->setGradient(slope);
+
+    sample.polled = clock();
+
+    RealtimeData &rtData = sample.rtData;
+    rtData.mode = rtmode;
+    rtData.setLoad(load); // always set load..
+    rtData.setSlope(slope); // always set load..
+
+    // fetch the right data from each device...
+    for (int i=0; i<devices.count(); i++) {
+
+        // each device starts from scratch, knowing only what it is being
+        // asked to do, so what gets recorded is what it said on its own
+        const Device &device = devices.at(i);
+        RealtimeData local;
+        local.mode = rtmode;
+        local.setLoad(load);
+        local.setSlope(slope);
+        device.controller->getRealtimeData(local);
+
+        // keep what each device said, before we merge
+        recorder.write(local, msecs, i);
+
+        // get spinscan data from a computrainer?
+        if (device.type == DEV_CT) {
+            memcpy((uint8_t*)rtData.spinScan, (uint8_t*)local.spinScan, 24);
+            rtData.setLoad(local.getLoad()); // and get load in case it was adjusted
+            rtData.setSlope(local.getSlope()); // and get slope in case it was adjusted
+            // to within defined limits
+        }
+
+        if (device.type == DEV_FORTIUS) {
+            rtData.setLoad(local.getLoad()); // and get load in case it was adjusted
+            rtData.setSlope(local.getSlope()); // and get slope in case it was adjusted
+            // to within defined limits
+        }
+
+        if (device.type == DEV_ANTLOCAL || device.type == DEV_NULL) {
+            rtData.setHb(local.getSmO2(), local.gettHb()); //only moxy data from ant and robot devices right now
+        }
+
+        // what are we getting from this one?
+        if (device.hr) rtData.setHr(local.getHr());
+        if (device.cadence) rtData.setCadence(local.getCadence());
+        if (device.speed) {
+            rtData.setSpeed(local.getSpeed());
+            rtData.setDistance(local.getDistance());
+        }
+        if (device.power) {
+            rtData.setWatts(local.getWatts());
+            rtData.setAltWatts(local.getAltWatts());
+            rtData.setLRBalance(local.getLRBalance());
+            rtData.setLTE(local.getLTE());
+            rtData.setRTE(local.getRTE());
+            rtData.setLPS(local.getLPS());
+            rtData.setRPS(local.getRPS());
+        }
+        if (local.getTrainerStatusAvailable())
+        {
+            rtData.setTrainerStatusAvailable(true);
+            rtData.setTrainerReady(local.getTrainerReady());
+            rtData.setTrainerRunning(local.getTrainerRunning());
+            rtData.setTrainerCalibRequired(local.getTrainerCalibRequired());
+            rtData.setTrainerConfigRequired(local.getTrainerConfigRequired());
+            rtData.setTrainerBrakeFault(local.getTrainerBrakeFault());
+        }
+    }
+
+    {
+        QMutexLocker locker(&mutex);
+
+        // the trainer may have adjusted them, unless they
+        // were changed again whilst we were polling
+        if (!loadChanged) load_ = rtData.getLoad();
+        if (!slopeChanged) slope_ = rtData.getSlope();
+
+        // distance covered over the time that actually passed, taking
+        // the average speed across it. km/h * msecs -> km
+        double km = ((lastSpeed + rtData.getSpeed()) / 2.0) * double(dt) / 3600000.0;
+        lastSpeed = rtData.getSpeed();
+
+        // when following a videosync file the GUI moves us to
+        // wherever the video has got to as it takes the samples
+        distance += km;
+        workout_distance += km;
+        rtData.setDistance(distance);
+
+        // time
+        rtData.setMsecs(session_msecs);
+        rtData.setLapMsecs(lap_msecs);
+
+        long lapTimeRemaining;
+        if (ergFile) lapTimeRemaining = ergFile->nextLap(workout_msecs) - workout_msecs;
+        else lapTimeRemaining = 0;
+
+        if(lapTimeRemaining < 0) {
+                if (ergFile) lapTimeRemaining =  ergFile->Duration - workout_msecs;
+                if(lapTimeRemaining < 0)
+                    lapTimeRemaining = 0;
+        }
+        rtData.setLapMsecsRemaining(lapTimeRemaining);
+
+        // virtual speed
+        double crr = 0.004f; // typical for asphalt surfaces
+        double g = 9.81;     // g constant 9.81 m/s
+        double m = weight ? weight + 8 : 83; // default to 75kg weight, plus 8kg bike
+        double sl = slope_ / 100; // 10% = 0.1
+        double ad = 1.226f; // default air density at sea level
+        double cdA = 0.5f; // typical
+        double pw = rtData.getWatts();
+
+        // algorithm supplied by Tom Compton
+        // from www.AnalyticCycling.com
+        // 3.6 * ... converts from meters per second to kph
+        double vs = 3.6f * (
+        (-2*pow(2,0.3333333333333333)*(crr*m + g*m*sl)) /
+            pow(54*pow(ad,2)*pow(cdA,2)*pw +
+            sqrt(2916*pow(ad,4)*pow(cdA,4)*pow(pw,2) +
+            864*pow(ad,3)*pow(cdA,3)*pow(crr*m +
+            g*m*sl,3)),0.3333333333333333) +
+            pow(54*pow(ad,2)*pow(cdA,2)*pw +
+            sqrt(2916*pow(ad,4)*pow(cdA,4)*pow(pw,2) +
+            864*pow(ad,3)*pow(cdA,3)*pow(crr*m +
+            g*m*sl,3)),0.3333333333333333)/
+            (3.*pow(2,0.3333333333333333)*ad*cdA));
+
+        // just in case...
+        if (std::isnan(vs) || std::isinf(vs)) vs = 0.00f;
+        rtData.setVirtualSpeed(vs);
+
+        // W'bal on the fly
+        // using Dave Waterworth's reformulation
+
+        // any watts expended since the last tick?
+        double JOULES = double(rtData.getWatts() - cp) * double(dt) / 1000.00f;
+        if (JOULES < 0) JOULES = 0;
+
+        // running total of replenishment
+        wbalr += JOULES * exp((session_msecs/1000.00f) / tau);
+        rtData.setWbal(wprime - (wbalr * exp((-session_msecs/1000.00f) / tau)));
+
+        sample.workoutDistance = workout_distance;
+        sample.workoutMsecs = workout_msecs;
+        sample.workoutLap = workoutLap;
+
+        rtData.setLap(laps + workoutLap); // user laps + predefined workout lap
+    }
+    recorder.write(rtData, msecs);
+
+    if (!queue.push(sample)) overflow++;
+
+    // tell the GUI, unless it already knows
+    if (signalled.testAndSetOrdered(0, 1)) emit sampled();
+}
+
+void
+TrainEngine::control(TrainSample &sample)
+{
+    int curLap = workoutLap;
+
+    if (ergo) {
+        long load = ergFile->wattsAt(workout_msecs, curLap);
+
+        // we got to the end!
+        if (load == -100) sample.finished = true;
+        else {
+            load_ = load;
+            loadChanged = true;
+        }
+
+    } else {
+        double slope = ergFile->gradientAt(workout_distance*1000, curLap);
+
+        // we got to the end!
+        if (slope == -100) sample.finished = true;
+        else {
+            slope_ = slope;
+            slopeChanged = true;
+        }
+    }
+    workoutLap = curLap;
+    sample.control = true;
+}
@@ -0,0 +1,175 @@
+/*
+ * Copyright (c) 2015 Mark Liversedge (liversedge@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _GC_TrainEngine_h
+#define _GC_TrainEngine_h 1
+#include "GoldenCheetah.h"
+#include "RealtimeData.h"
+#include "TrainRecorder.h"
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QAtomicInt>
+#include <QVector>
+#include <QDateTime>
+
+class ErgFile;
+class RealtimeController;
+
+// The train engine runs a session on its own thread so that device
+// polling, the ERG/slope control loop and the integration of distance
+// and W'bal run at a fixed rate against a monotonic clock, regardless
+// of how busy the GUI thread is repainting video, plots and meters.
+//
+// Each tick the merged telemetry is published as a TrainSample on a
+// lock free single producer / single consumer queue and the GUI is
+// told (once, until it drains the queue) that samples are waiting.
+// When recording, the engine also writes every tick (and each device's
+// raw values) to a TrainRecorder, so the GUI doesn't touch the disk.
+
+// a telemetry sample as published by the engine
+struct TrainSample
+{
+    RealtimeData rtData;        // merged telemetry with times, distance and W'bal
+    double workoutDistance;     // km into the workout
+    long workoutMsecs;          // msecs into the workout
+    qint64 polled;              // engine clock usecs when the devices were polled
+    int workoutLap;             // lap we are in according to the workout
+    bool second;                // first sample of a new second
+    bool control;               // load/gradient was set from the workout this tick
+    bool finished;              // we got to the end of the workout
+};
+
+// ring buffer of samples, only the engine pushes
+// and only the GUI pops so no locking is needed
+class TrainSampleQueue
+{
+    public:
+        TrainSampleQueue();
+
+        bool push(const TrainSample &sample); // false if full
+        bool pop(TrainSample &sample);        // false if empty
+        void clear();                         // only when the engine is stopped
+
+    private:
+        static const int size = 512; // over a minute and a half at 5 a second
+        QVector<TrainSample> ring;
+        QAtomicInt head,              // next to write, engine only
+                   tail;              // next to read, gui only
+};
+
+class TrainEngine : public QThread
+{
+    Q_OBJECT
+    G_OBJECT
+
+    public:
+        TrainEngine(QObject *parent = 0);
+        ~TrainEngine();
+
+        // setup before a session is started
+        void clearDevices();
+        void addDevice(RealtimeController *controller, int type,
+                       bool hr, bool cadence, bool speed, bool power);
+        void setWorkout(ErgFile *ergFile, int mode);
+        void setAthlete(int cp, int wprime, double tau, double weight);
+        bool record(QString filename, QDateTime start); // until the session stops
+
+        // session control, called from the GUI thread
+        void startSession(long load, double slope);
+        void stopSession();
+        void setPaused(bool);
+        void setCalibrating(bool);
+        void resetLap();
+        void newLap();
+
+        // manual load and gradient, sent to the devices on the next tick
+        void setLoad(long);
+        void setSlope(double);
+        long load();
+        double slope();
+
+        // where we are in the workout (for ffwd/rewind and videosync)
+        long workoutMsecs();
+        void setWorkoutMsecs(long);
+        double workoutDistance();
+        void setWorkoutDistance(double);
+
+        // held whilst the engine consults the workout, so take it
+        // before changing the points in the ergfile mid session
+        QMutex *workoutLock() { return &mutex; }
+
+        // GUI thread takes samples in order until empty
+        bool nextSample(TrainSample &sample);
+        int overflowed() const { return overflow; } // samples it didn't take in time
+
+        // monotonic usecs, shared with the devices so
+        // their timings can be compared with the samples
+        static qint64 clock();
+
+    signals:
+        void sampled();             // samples are waiting
+
+    protected:
+        void run();
+
+    private:
+        void tick(long dt);
+        void control(TrainSample &sample);
+
+        struct Device {
+            RealtimeController *controller;
+            int type;
+            bool hr, cadence, speed, power;
+        };
+        QVector<Device> devices;
+
+        QMutex mutex;               // guards everything below, but never the devices
+        QWaitCondition wake;        // to stop promptly
+        bool stopping, paused, calibrating;
+
+        // workout
+        ErgFile *ergFile;
+        int mode;
+        bool ergo;
+        int workoutLap, laps;
+        long workout_msecs, sinceControl;
+        double workout_distance;
+
+        // load/gradient and pending changes for the devices
+        long load_;
+        double slope_;
+        bool loadChanged, slopeChanged;
+
+        // session
+        long session_msecs, lap_msecs;
+        double distance, lastSpeed;
+
+        // W'bal and virtual speed
+        int cp, wprime;
+        double tau, wbalr, weight;
+
+        TrainRecorder recorder;
+
+        TrainSampleQueue queue;
+        QAtomicInt signalled;       // sampled() emitted, not yet drained
+        int overflow;               // samples the GUI never took
+};
+
+#endif // _GC_TrainEngine_h
@@ -0,0 +1,314 @@
+/*
+ * Copyright (c) 2015 Mark Liversedge (liversedge@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "TrainRecorder.h"
+#include "ErgFile.h" // for the modes
+
+#include <QtEndian>
+#include <string.h>
+
+static int trainRecordFileReaderRegistered =
+    RideFileFactory::instance().registerReader(
+        "gcrec", "GoldenCheetah Train Recording", new TrainRecordFileReader());
+
+static const char TrainRecordMagic[8] = { 'G', 'C', 'T', 'R', 'R', 'E', 'C', 0 };
+static const quint16 TrainRecordSync = 0x4347;
+static const int TrainRecordChunk = 4096; // records preallocated at a time
+
+// trainer status bits
+#define TR_STATUS_AVAILABLE  0x01
+#define TR_STATUS_READY      0x02
+#define TR_STATUS_RUNNING    0x04
+#define TR_STATUS_CALIB      0x08
+#define TR_STATUS_CONFIG     0x10
+#define TR_STATUS_BRAKEFAULT 0x20
+
+// floats and doubles go via their bits, qToLittleEndian only does integers
+static void putFloat(float value, uchar *dest)
+{
+    quint32 bits;
+    memcpy(&bits, &value, sizeof(bits));
+    qToLittleEndian<quint32>(bits, dest);
+}
+
+static float getFloat(const uchar *src)
+{
+    quint32 bits = qFromLittleEndian<quint32>(src);
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static void putDouble(double value, uchar *dest)
+{
+    quint64 bits;
+    memcpy(&bits, &value, sizeof(bits));
+    qToLittleEndian<quint64>(bits, dest);
+}
+
+static double getDouble(const uchar *src)
+{
+    quint64 bits = qFromLittleEndian<quint64>(src);
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static quint16 checksum(const uchar *data, int len)
+{
+    return qChecksum(reinterpret_cast<const char*>(data), len);
+}
+
+// is this record intact and the one we expected next?
+static bool validRecord(const uchar *rec, quint32 sequence)
+{
+    return qFromLittleEndian<quint16>(rec) == TrainRecordSync &&
+           qFromLittleEndian<quint32>(rec + 4) == sequence &&
+           qFromLittleEndian<quint16>(rec + TrainRecordSize - 2) == checksum(rec, TrainRecordSize - 2);
+}
+
+static bool validHeader(const uchar *hdr)
+{
+    return !memcmp(hdr, TrainRecordMagic, 8) &&
+           qFromLittleEndian<quint16>(hdr + 8) <= TrainRecordVersion &&
+           qFromLittleEndian<quint16>(hdr + 10) == TrainRecordSize &&
+           qFromLittleEndian<quint16>(hdr + 62) == checksum(hdr, 62);
+}
+
+//----------------------------------------------------------------------
+// RECORDING
+//----------------------------------------------------------------------
+
+TrainRecorder::TrainRecorder() : interval(0), sequence(0), allocated(0)
+{
+}
+
+TrainRecorder::~TrainRecorder()
+{
+    close();
+}
+
+bool
+TrainRecorder::open(QString filename, QDateTime start, int interval, QList<int> devices)
+{
+    close();
+
+    // unbuffered so every record is handed to the OS as it is written
+    file.setFileName(filename);
+    if (!file.open(QIODevice::ReadWrite | QIODevice::Truncate | QIODevice::Unbuffered)) return false;
+
+    this->start = start;
+    this->interval = interval;
+    this->devices = devices;
+    sequence = 0;
+
+    allocated = TrainRecordHeaderSize + qint64(TrainRecordChunk) * TrainRecordSize;
+    if (!file.resize(allocated) || !writeHeader(false)) {
+        file.close();
+        file.remove();
+        return false;
+    }
+    return true;
+}
+
+bool
+TrainRecorder::writeHeader(bool finished)
+{
+    uchar hdr[TrainRecordHeaderSize];
+    memset(hdr, 0, sizeof(hdr));
+
+    memcpy(hdr, TrainRecordMagic, 8);
+    qToLittleEndian<quint16>(TrainRecordVersion, hdr + 8);
+    qToLittleEndian<quint16>(TrainRecordSize, hdr + 10);
+    qToLittleEndian<quint16>(interval, hdr + 12);
+    hdr[14] = finished ? 1 : 0;
+    hdr[15] = qMin(devices.count(), TrainRecordDevices);
+    qToLittleEndian<qint64>(start.toMSecsSinceEpoch(), hdr + 16);
+    for (int i=0; i < hdr[15]; i++) qToLittleEndian<quint32>(devices.at(i), hdr + 24 + (i*4));
+    qToLittleEndian<quint16>(checksum(hdr, 62), hdr + 62);
+
+    return file.seek(0) && file.write(reinterpret_cast<const char*>(hdr), sizeof(hdr)) == sizeof(hdr);
+}
+
+void
+TrainRecorder::write(const RealtimeData &rtData, qint64 msecs, int device)
+{
+    if (!file.isOpen()) return;
+
+    // only room in the header for so many
+    if (device >= TrainRecordDevices) return;
+
+    qint64 pos = TrainRecordHeaderSize + qint64(sequence) * TrainRecordSize;
+
+    // grow another chunk
+    if (pos + TrainRecordSize > allocated) {
+        allocated += qint64(TrainRecordChunk) * TrainRecordSize;
+        file.resize(allocated);
+    }
+
+    uchar rec[TrainRecordSize];
+    memset(rec, 0, sizeof(rec));
+
+    qToLittleEndian<quint16>(TrainRecordSync, rec);
+    rec[2] = device < 0 ? 0 : 1;
+    rec[3] = device < 0 ? 0 : device;
+    qToLittleEndian<quint32>(sequence, rec + 4);
+    qToLittleEndian<qint64>(msecs, rec + 8);
+    putDouble(rtData.getDistance(), rec + 16);
+
+    float values[18] = { float(rtData.getWatts()), float(rtData.getAltWatts()), float(rtData.getHr()),
+                         float(rtData.getCadence()), float(rtData.getSpeed()), float(rtData.getWheelRpm()),
+                         float(rtData.getLoad()), float(rtData.getSlope()), float(rtData.getLRBalance()),
+                         float(rtData.getLTE()), float(rtData.getRTE()), float(rtData.getLPS()),
+                         float(rtData.getRPS()), float(rtData.getSmO2()), float(rtData.gettHb()),
+                         float(rtData.getVirtualSpeed()), float(rtData.getWbal()), float(rtData.getAltDistance()) };
+    for (int i=0; i<18; i++) putFloat(values[i], rec + 24 + (i*4));
+
+    qToLittleEndian<qint32>(rtData.getLap(), rec + 96);
+    qToLittleEndian<qint32>(rtData.getLapMsecs(), rec + 100);
+    qToLittleEndian<qint32>(rtData.value(RealtimeData::LapTimeRemaining), rec + 104);
+
+    uchar status = 0;
+    if (rtData.getTrainerStatusAvailable()) status |= TR_STATUS_AVAILABLE;
+    if (rtData.getTrainerReady()) status |= TR_STATUS_READY;
+    if (rtData.getTrainerRunning()) status |= TR_STATUS_RUNNING;
+    if (rtData.getTrainerCalibRequired()) status |= TR_STATUS_CALIB;
+    if (rtData.getTrainerConfigRequired()) status |= TR_STATUS_CONFIG;
+    if (rtData.getTrainerBrakeFault()) status |= TR_STATUS_BRAKEFAULT;
+    rec[108] = status;
+    rec[109] = rtData.mode;
+
+    memcpy(rec + 112, rtData.spinScan, 24);
+    qToLittleEndian<quint16>(checksum(rec, TrainRecordSize - 2), rec + TrainRecordSize - 2);
+
+    if (file.seek(pos) && file.write(reinterpret_cast<const char*>(rec), sizeof(rec)) == sizeof(rec))
+        sequence++;
+}
+
+void
+TrainRecorder::close()
+{
+    if (!file.isOpen()) return;
+
+    file.resize(TrainRecordHeaderSize + qint64(sequence) * TrainRecordSize);
+    writeHeader(true);
+    file.close();
+}
+
+bool
+TrainRecorder::recover(QString filename)
+{
+    QFile file(filename);
+    if (!file.open(QIODevice::ReadWrite)) return false;
+
+    uchar hdr[TrainRecordHeaderSize];
+    if (file.read(reinterpret_cast<char*>(hdr), sizeof(hdr)) != sizeof(hdr) ||
+        !validHeader(hdr) || hdr[14]) return false;
+
+    // count what made it to disk
+    uchar rec[TrainRecordSize];
+    quint32 sequence = 0;
+    while (file.read(reinterpret_cast<char*>(rec), sizeof(rec)) == sizeof(rec) && validRecord(rec, sequence))
+        sequence++;
+
+    file.resize(TrainRecordHeaderSize + qint64(sequence) * TrainRecordSize);
+
+    // finished now
+    hdr[14] = 1;
+    qToLittleEndian<quint16>(checksum(hdr, 62), hdr + 62);
+    file.seek(0);
+    file.write(reinterpret_cast<const char*>(hdr), sizeof(hdr));
+    file.close();
+
+    return true;
+}
+
+//----------------------------------------------------------------------
+// CONVERT TO A RIDE
+//----------------------------------------------------------------------
+
+RideFile *
+TrainRecordFileReader::openRideFile(QFile &file, QStringList &errors, QList<RideFile*>*) const
+{
+    if (!file.open(QFile::ReadOnly)) {
+        errors << ("Could not open ride file: \"" + file.fileName() + "\"");
+        return NULL;
+    }
+    QByteArray data = file.readAll();
+    file.close();
+
+    const uchar *buf = reinterpret_cast<const uchar*>(data.constData());
+    if (data.size() < TrainRecordHeaderSize || !validHeader(buf)) {
+        errors << ("Not a train recording: \"" + file.fileName() + "\"");
+        return NULL;
+    }
+
+    RideFile *rideFile = new RideFile;
+    rideFile->setDeviceType("GoldenCheetah");
+    rideFile->setFileFormat("GoldenCheetah Train Recording (gcrec)");
+    rideFile->setStartTime(QDateTime::fromMSecsSinceEpoch(qFromLittleEndian<qint64>(buf + 16)));
+    rideFile->setRecIntSecs(qFromLittleEndian<quint16>(buf + 12) / 1000.0);
+    rideFile->setTag("Sport", "Bike");
+
+    // the merged samples make the ride, the per device values
+    // are only there for when we need to see what each one said
+    int records = (data.size() - TrainRecordHeaderSize) / TrainRecordSize;
+    for (int i=0; i<records; i++) {
+
+        const uchar *rec = buf + TrainRecordHeaderSize + (i * TrainRecordSize);
+
+        // interrupted and not recovered, stop at the first that didn't make it
+        if (!validRecord(rec, i)) break;
+        if (rec[2] != 0) continue;
+
+        double secs = qFromLittleEndian<qint64>(rec + 8) / 1000.0;
+        double km = getDouble(rec + 16);
+        double watts = getFloat(rec + 24);
+        double hr = getFloat(rec + 32);
+        double cad = getFloat(rec + 36);
+        double kph = getFloat(rec + 40);
+        double slope = getFloat(rec + 52);
+        double lrbalance = getFloat(rec + 56);
+        double lte = getFloat(rec + 60);
+        double rte = getFloat(rec + 64);
+        double lps = getFloat(rec + 68);
+        double rps = getFloat(rec + 72);
+        double smo2 = getFloat(rec + 76);
+        double thb = getFloat(rec + 80);
+        int interval = qFromLittleEndian<qint32>(rec + 96);
+
+        // slope from the workout when riding a course, the load isn't one
+        if (rec[109] != CRS) slope = 0;
+
+        rideFile->appendPoint(secs, cad, hr, km,
+                              kph, 0.0, watts, 0.0, 0.0, 0.0,
+                              0.0, slope, RideFile::NoTemp, lrbalance,
+                              lte, rte, lps, rps,
+                              0.0, 0.0,
+                              0.0, 0.0, 0.0, 0.0,
+                              0.0, 0.0, 0.0, 0.0,
+                              smo2, thb, 0.0, 0.0, 0.0, 0.0, interval);
+    }
+
+    if (rideFile->dataPoints().count() == 0) {
+        errors << ("No samples in train recording: \"" + file.fileName() + "\"");
+        delete rideFile;
+        return NULL;
+    }
+    return rideFile;
+}
@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2015 Mark Liversedge (liversedge@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _GC_TrainRecorder_h
+#define _GC_TrainRecorder_h 1
+#include "GoldenCheetah.h"
+#include "RideFile.h"
+#include "RealtimeData.h"
+
+#include <QFile>
+#include <QString>
+#include <QDateTime>
+#include <QList>
+
+// The train recorder writes every sample the train engine takes, and
+// the raw values from each device that went into it, as fixed size
+// binary records appended to a .gcrec file in the athlete's records
+// folder. The file is grown in preallocated chunks and written without
+// any buffering so a session survives the app dying part way through.
+//
+// Each record carries a sync word, a sequence number and a checksum so
+// a reader stops cleanly at the first record that didn't make it to
+// disk (or the zeroes of the preallocated tail). The header is marked
+// as finished when the session stops; a file that isn't marked was
+// interrupted and is recovered the next time we record.
+//
+// The .gcrec reader is registered with the ride file factory, so the
+// import wizard converts a recording into a ride just like any other.
+//
+static const unsigned int TrainRecordVersion = 1;
+// revision history:
+// version  date         description
+// 1        20-Jun-15    Initial - header, merged and per device records
+
+// The header is TrainRecordHeaderSize bytes, little endian throughout:
+//  0 char[8]  magic "GCTRREC\0"
+//  8 quint16  version
+// 10 quint16  record size
+// 12 quint16  engine tick in msecs
+// 14 quint8   finished (1 when the session stopped cleanly)
+// 15 quint8   device count
+// 16 qint64   start time, msecs since the epoch (UTC)
+// 24 quint32  device types[8]
+// 56 reserved
+// 62 quint16  checksum of bytes 0-61
+//
+// Followed by records of TrainRecordSize bytes:
+//  0 quint16  sync 0x4347
+//  2 quint8   type; 0 the merged sample, 1 a device's raw values
+//  3 quint8   device index (type 1 only)
+//  4 quint32  sequence, from 0
+//  8 qint64   session msecs
+// 16 double   distance (km)
+// 24 float    watts, altwatts, hr, cadence, speed, wheelrpm, load, slope,
+//             lrbalance, lte, rte, lps, rps, smo2, thb, virtual speed,
+//             wbal, altdistance
+// 96 qint32   lap, lap msecs, lap msecs remaining
+//108 quint8   trainer status bits
+//109 quint8   mode
+//110 reserved
+//112 quint8   spinscan[24]
+//136 reserved
+//142 quint16  checksum of bytes 0-141
+//
+static const int TrainRecordHeaderSize = 64;
+static const int TrainRecordSize = 144;
+static const int TrainRecordDevices = 8;
+
+class TrainRecorder
+{
+    public:
+        TrainRecorder();
+        ~TrainRecorder();
+
+        // start a new recording, the device types go in the header
+        bool open(QString filename, QDateTime start, int interval, QList<int> devices);
+        bool isOpen() const { return file.isOpen(); }
+        QString fileName() const { return file.fileName(); }
+
+        // device -1 is the merged sample, otherwise its index
+        void write(const RealtimeData &rtData, qint64 msecs, int device = -1);
+
+        // drop the unused preallocation and mark it finished
+        void close();
+
+        // finish off a recording that was interrupted, true if
+        // it was and has been so it can now be imported
+        static bool recover(QString filename);
+
+    private:
+        bool writeHeader(bool finished);
+
+        QFile file;
+        QDateTime start;
+        int interval;
+        QList<int> devices;
+
+        quint32 sequence;
+        qint64 allocated;       // bytes preallocated
+};
+
+struct TrainRecordFileReader : public RideFileReader {
+    virtual RideFile *openRideFile(QFile &file, QStringList &errors, QList<RideFile*>* = 0) const;
+};
+
+#endif // _GC_TrainRecorder_h
@@ -41,6 +41,7 @@
 #endif
 #include "ANTlocalController.h"
 #include "NullController.h"
+#include "SimulatorController.h"
 #ifdef GC_HAVE_WFAPI
 #include "KickrController.h"
 #endif
@@ -436,16 +437,8 @@ intensity->hide(); //XXX!!! temporary
     calibrating = false;
 
     // now the GUI is setup lets sort our control variables
-    gui_timer = new QTimer(this);
-    disk_timer = new QTimer(this);
-    load_timer = new QTimer(this);
+    engine = new TrainEngine(this);
 
-    session_time = QTime();
-    session_elapsed_msec = 0;
-    lap_time = QTime();
-    lap_elapsed_msec = 0;
-
-    recordFile = NULL;
     status = 0;
     status |= RT_MODE_ERGO;         // ergo mode by default
     mode = ERG;
@@ -456,15 +449,14 @@ intensity->hide(); //XXX!!! temporary
     hrcount = 0;
     spdcount = 0;
     lodcount = 0;
-    wbalr = wbal = 0;
+    wbal = 0;
     load_msecs = total_msecs = lap_msecs = 0;
     displayWorkoutDistance = displayDistance = displayPower = displayHeartRate =
     displaySpeed = displayCadence = slope = load = 0;
     displayLRBalance = displayLTE = displayRTE = displayLPS = displayRPS = 0;
 
-    connect(gui_timer, SIGNAL(timeout()), this, SLOT(guiUpdate()));
-    connect(disk_timer, SIGNAL(timeout()), this, SLOT(diskUpdate()));
-    connect(load_timer, SIGNAL(timeout()), this, SLOT(loadUpdate()));
+    // samples arrive from the engine thread
+    connect(engine, SIGNAL(sampled()), this, SLOT(guiUpdate()), Qt::QueuedConnection);
 
     configChanged(CONFIG_APPEARANCE | CONFIG_DEVICES | CONFIG_ZONES); // will reset the workout tree
     setLabels();
@@ -473,6 +465,9 @@ intensity->hide(); //XXX!!! temporary
     toolbarButtons->hide();
 #endif
 
+    // import anything left behind when we died mid session, once
+    // the athlete has finished opening
+    QTimer::singleShot(0, this, SLOT(recoverRecordings()));
 }
 
 void
@@ -657,6 +652,8 @@ TrainSidebar::configChanged(qint32)
 #endif
         } else if (Devices.at(i).type == DEV_NULL) {
             Devices[i].controller = new NullController(this, &Devices[i]);
+        } else if (Devices.at(i).type == DEV_SIMULATOR) {
+            Devices[i].controller = new SimulatorController(this, &Devices[i]);
         } else if (Devices.at(i).type == DEV_ANTLOCAL) {
             Devices[i].controller = new ANTlocalController(this, &Devices[i]);
 #ifdef GC_HAVE_WFAPI
@@ -1005,6 +1002,26 @@ TrainSidebar::videosyncTreeWidgetSelectionChanged()
  * Was realtime window, now local and manages controller and chart updates etc
  *------------------------------------------------------------------------------*/
 
+// recordings that weren't finished are from a session that died, so
+// finish them off and import them when the athlete is opened
+void TrainSidebar::recoverRecordings()
+{
+    QDir records = context->athlete->home->records();
+    if (!records.exists()) return;
+
+    QList<QString> list;
+
+    foreach(QString name, records.entryList(QStringList() << "*.gcrec", QDir::Files)) {
+        QString path = records.canonicalPath() + "/" + name;
+        if (TrainRecorder::recover(path)) list.append(path);
+    }
+
+    if (list.count()) {
+        RideImportWizard *dialog = new RideImportWizard (list, context);
+        dialog->process(); // do it!
+    }
+}
+
 void TrainSidebar::Start()       // when start button is pressed
 {
     static QIcon playIcon(":images/oxygen/play.png");
@@ -1015,14 +1032,9 @@ void TrainSidebar::Start()       // when start button is pressed
         // UN PAUSE!
         play->setIcon(pauseIcon);
 
-        session_time.start();
-        lap_time.start();
         status &=~RT_PAUSED;
         foreach(int dev, devices()) Devices[dev].controller->restart();
-        gui_timer->start(REFRESHRATE);
-        if (status & RT_RECORDING) disk_timer->start(SAMPLERATE);
-        load_period.restart();
-        if (status & RT_WORKOUT) load_timer->start(LOADRATE);
+        engine->setPaused(false);
 
 #if !defined GC_VIDEO_NONE
         mediaTree->setEnabled(false);
@@ -1037,14 +1049,9 @@ void TrainSidebar::Start()       // when start button is pressed
         // Pause!
         play->setIcon(playIcon);
 
-        session_elapsed_msec += session_time.elapsed();
-        lap_elapsed_msec += lap_time.elapsed();
+        engine->setPaused(true);
         foreach(int dev, devices()) Devices[dev].controller->pause();
         status |=RT_PAUSED;
-        gui_timer->stop();
-        if (status & RT_RECORDING) disk_timer->stop();
-        if (status & RT_WORKOUT) load_timer->stop();
-        load_msecs += load_period.restart();
 
 #if !defined GC_VIDEO_NONE
         // enable media tree so we can change movie - mid workout
@@ -1105,50 +1112,40 @@ void TrainSidebar::Start()       // when start button is pressed
         // we're away!
         status |=RT_RUNNING;
 
-        load_period.restart();
-        session_time.start();
-        session_elapsed_msec = 0;
-        lap_time.start();
-        lap_elapsed_msec = 0;
-        wbalr = 0;
+        load_msecs = 0;
         wbal = WPRIME;
         calibrating = false;
 
-        if (status & RT_WORKOUT) {
-            load_timer->start(LOADRATE);      // start recording
-        }
-
         if (recordSelector->isChecked()) {
             status |= RT_RECORDING;
         }
 
+        // hand the devices and workout over to the engine
+        engine->clearDevices();
+        foreach(int dev, devices())
+            engine->addDevice(Devices[dev].controller, Devices[dev].type,
+                              dev == bpmTelemetry, dev == rpmTelemetry,
+                              dev == kphTelemetry, dev == wattsTelemetry);
+        engine->setWorkout((status & RT_WORKOUT) ? ergFile : NULL, mode);
+        engine->setAthlete(FTP, WPRIME,
+                           context->athlete->settings()->wbalTau,
+                           context->athlete->settings()->weight);
+
         if (status & RT_RECORDING) {
             QDateTime now = QDateTime::currentDateTime();
 
-            // setup file
-            QString filename = now.toString(QString("yyyy_MM_dd_hh_mm_ss")) + QString(".csv");
-
             if (!context->athlete->home->records().exists())
                 context->athlete->home->createAllSubdirs();
 
-            QString fulltarget = context->athlete->home->records().canonicalPath() + "/" + filename;
-
-            if (recordFile) delete recordFile;
-            recordFile = new QFile(fulltarget);
-            if (!recordFile->open(QFile::WriteOnly | QFile::Truncate)) {
-                status &= ~RT_RECORDING;
-            } else {
-
-                // CSV File header
-
-                QTextStream recordFileStream(recordFile);
-                recordFileStream << "secs, cad, hr, km, kph, nm, watts, alt, lon, lat, headwind, slope, temp, interval, lrbalance, lte, rte, lps, rps, smo2, thb, o2hb, hhb\n";
+            // setup file
+            QString filename = now.toString(QString("yyyy_MM_dd_hh_mm_ss")) + QString(".gcrec");
+            recordFileName = context->athlete->home->records().canonicalPath() + "/" + filename;
 
-                disk_timer->start(SAMPLERATE);  // start screen
-            }
+            // the engine writes it as it goes
+            if (!engine->record(recordFileName, now)) status &= ~RT_RECORDING;
         }
-        gui_timer->start(REFRESHRATE);      // start recording
 
+        engine->startSession(load, slope);
     }
 }
 
@@ -1159,14 +1156,9 @@ void TrainSidebar::Pause()        // pause capture to recalibrate
 
     if (status&RT_PAUSED) {
 
-        session_time.start();
-        lap_time.start();
         status &=~RT_PAUSED;
         foreach(int dev, devices()) Devices[dev].controller->restart();
-        gui_timer->start(REFRESHRATE);
-        if (status & RT_RECORDING) disk_timer->start(SAMPLERATE);
-        load_period.restart();
-        if (status & RT_WORKOUT) load_timer->start(LOADRATE);
+        engine->setPaused(false);
 
 #if !defined GC_VIDEO_NONE
         mediaTree->setEnabled(false);
@@ -1178,14 +1170,9 @@ void TrainSidebar::Pause()        // pause capture to recalibrate
 
     } else {
 
-        session_elapsed_msec += session_time.elapsed();
-        lap_elapsed_msec += lap_time.elapsed();
+        engine->setPaused(true);
         foreach(int dev, devices()) Devices[dev].controller->pause();
         status |=RT_PAUSED;
-        gui_timer->stop();
-        if (status & RT_RECORDING) disk_timer->stop();
-        if (status & RT_WORKOUT) load_timer->stop();
-        load_msecs += load_period.restart();
 
         // enable media tree so we can change movie
 #if !defined GC_VIDEO_NONE
@@ -1213,10 +1200,10 @@ void TrainSidebar::Stop(int deviceStatus)        // when stop button is pressed
     workoutTree->setEnabled(true);
     deviceTree->setEnabled(true);
 
-    // wipe connection
+    // stop polling before we wipe the connection
+    engine->stopSession();
     foreach(int dev, devices()) Devices[dev].controller->stop();
 
-    gui_timer->stop();
     calibrating = false;
 
     load = 0;
@@ -1224,23 +1211,17 @@ void TrainSidebar::Stop(int deviceStatus)        // when stop button is pressed
 
     QDateTime now = QDateTime::currentDateTime();
 
+    // the engine closed the recording when it stopped
     if (status & RT_RECORDING) {
-        disk_timer->stop();
-
-        // close and reset File
-        recordFile->close();
 
         if(deviceStatus == DEVICE_ERROR)
         {
-            recordFile->remove();
+            QFile::remove(recordFileName);
         }
         else {
             // add to the view - using basename ONLY
-            QString name;
-            name = recordFile->fileName();
-
             QList<QString> list;
-            list.append(name);
+            list.append(recordFileName);
 
             RideImportWizard *dialog = new RideImportWizard (list, context);
             dialog->process(); // do it!
@@ -1248,7 +1229,6 @@ void TrainSidebar::Stop(int deviceStatus)        // when stop button is pressed
     }
 
     if (status & RT_WORKOUT) {
-        load_timer->stop();
         load_msecs = 0;
     }
 
@@ -1273,12 +1253,8 @@ void TrainSidebar::Stop(int deviceStatus)        // when stop button is pressed
     spdcount = 0;
     lodcount = 0;
     displayWorkoutLap = displayLap =0;
-    wbalr = 0;
     wbal = WPRIME;
-    session_elapsed_msec = 0;
-    session_time.restart();
-    lap_elapsed_msec = 0;
-    lap_time.restart();
+    total_msecs = lap_msecs = 0;
     displayWorkoutDistance = displayDistance = 0;
     guiUpdate();
 
@@ -1309,10 +1285,6 @@ void TrainSidebar::updateData(RealtimeData &rtData)
 
 void TrainSidebar::guiUpdate()           // refreshes the telemetry
 {
-    RealtimeData rtData;
-    rtData.setLap(displayLap + displayWorkoutLap); // user laps + predefined workout lap
-    rtData.mode = mode;
-
     // On a Mac prevent the screensaver from kicking in
     // this is apparently the 'supported' mechanism for
     // disabling the screen saver on a Mac instead of
@@ -1322,173 +1294,80 @@ void TrainSidebar::guiUpdate()           // refreshes the telemetry
     UpdateSystemActivity(OverallAct);
 #endif
 
-    // get latest telemetry from devices
-    if (status&RT_RUNNING) {
-        if(calibrating) {
-            foreach(int dev, devices()) { // Do for Computrainers only.  Need to check with other devices
-                RealtimeData local = rtData;
-                if (Devices[dev].type == DEV_CT)
-                  Devices[dev].controller->getRealtimeData(local); // See if the F3 button has been pressed
-            }
-            // and exit.  Nothing else to do until we finish calibrating
-            return;
-        } else {
-            rtData.setLoad(load); // always set load..
-            rtData.setSlope(slope); // always set load..
-
-            // fetch the right data from each device...
-            foreach(int dev, devices()) {
-
-                RealtimeData local = rtData;
-                Devices[dev].controller->getRealtimeData(local);
-
-                // get spinscan data from a computrainer?
-                if (Devices[dev].type == DEV_CT) {
-                    memcpy((uint8_t*)rtData.spinScan, (uint8_t*)local.spinScan, 24);
-                    rtData.setLoad(local.getLoad()); // and get load in case it was adjusted
-                    rtData.setSlope(local.getSlope()); // and get slope in case it was adjusted
-                    // to within defined limits
-                }
+    // take everything the engine has published since we last
+    // looked, in order, so a slow repaint doesn't lose samples
+    TrainSample sample;
+    bool got = false, second = false, finished = false;
+    while (engine->nextSample(sample)) {
+
+        // left over from a session that has stopped
+        if ((status&RT_RUNNING) == 0) continue;
+        got = true;
+
+        RealtimeData &rtData = sample.rtData;
+
+        // local stuff ...
+        displayPower = rtData.getWatts();
+        displayCadence = rtData.getCadence();
+        displayHeartRate = rtData.getHr();
+        displaySpeed = rtData.getSpeed();
+        load = rtData.getLoad();
+        slope = rtData.getSlope();
+        displayLRBalance = rtData.getLRBalance();
+        displayLTE = rtData.getLTE();
+        displayRTE = rtData.getRTE();
+        displayLPS = rtData.getLPS();
+        displayRPS = rtData.getRPS();
+        displayDistance = rtData.getDistance();
+        displayWorkoutDistance = sample.workoutDistance;
+        total_msecs = rtData.getMsecs();
+        lap_msecs = rtData.getLapMsecs();
+        load_msecs = sample.workoutMsecs;
+        wbal = rtData.getWbal();
+
+        if (displayWorkoutLap != sample.workoutLap) {
+            displayWorkoutLap = sample.workoutLap;
+            context->notifyNewLap();
+        }
 
-				if (Devices[dev].type == DEV_FORTIUS) {
-	                rtData.setLoad(local.getLoad()); // and get load in case it was adjusted
-                    rtData.setSlope(local.getSlope()); // and get slope in case it was adjusted
-					// to within defined limits
-				}
+        // we got to the end!
+        if (sample.finished) {
+            finished = true;
+            break;
+        }
 
-                if (Devices[dev].type == DEV_ANTLOCAL || Devices[dev].type == DEV_NULL) {
-                    rtData.setHb(local.getSmO2(), local.gettHb()); //only moxy data from ant and robot devices right now
-                }
+        if (sample.second) second = true;
 
-                // what are we getting from this one?
-                if (dev == bpmTelemetry) rtData.setHr(local.getHr());
-                if (dev == rpmTelemetry) rtData.setCadence(local.getCadence());
-                if (dev == kphTelemetry) {
-                    rtData.setSpeed(local.getSpeed());
-                    rtData.setDistance(local.getDistance());
-                }
-                if (dev == wattsTelemetry) {
-                    rtData.setWatts(local.getWatts());
-                    rtData.setAltWatts(local.getAltWatts());
-                    rtData.setLRBalance(local.getLRBalance());
-                    rtData.setLTE(local.getLTE());
-                    rtData.setRTE(local.getRTE());
-                    rtData.setLPS(local.getLPS());
-                    rtData.setRPS(local.getRPS());
-                }
-                if (local.getTrainerStatusAvailable())
-                {
-                    rtData.setTrainerStatusAvailable(true);
-                    rtData.setTrainerReady(local.getTrainerReady());
-                    rtData.setTrainerRunning(local.getTrainerRunning());
-                    rtData.setTrainerCalibRequired(local.getTrainerCalibRequired());
-                    rtData.setTrainerConfigRequired(local.getTrainerConfigRequired());
-                    rtData.setTrainerBrakeFault(local.getTrainerBrakeFault());
-                }
-            }
-
-            // Distance assumes current speed for the last second. from km/h to km/sec
-            displayDistance += displaySpeed / (5 * 3600); // assumes 200ms refreshrate
+        if (sample.control) {
+            if (status&RT_MODE_ERGO) context->notifySetNow(load_msecs);
+            else context->notifySetNow(displayWorkoutDistance * 1000);
+        }
+    }
 
-            if (!(status&RT_MODE_ERGO) && (context->currentVideoSyncFile()))
-            {
-                displayWorkoutDistance = context->currentVideoSyncFile()->km + context->currentVideoSyncFile()->manualOffset;
-                // TODO : graphs to be shown at seek position
-            }
-            else
-                displayWorkoutDistance += displaySpeed / (5 * 3600); // assumes 200ms refreshrate
-            rtData.setDistance(displayDistance);
+    if (finished) {
+        Stop(DEVICE_OK);
+        return;
+    }
+    if (!got) return;
 
-            // time
-            total_msecs = session_elapsed_msec + session_time.elapsed();
-            lap_msecs = lap_elapsed_msec + lap_time.elapsed();
+    // following the video rather than our own distance
+    if (!(status&RT_MODE_ERGO) && (context->currentVideoSyncFile()))
+    {
+        displayWorkoutDistance = context->currentVideoSyncFile()->km + context->currentVideoSyncFile()->manualOffset;
+        engine->setWorkoutDistance(displayWorkoutDistance);
+        // TODO : graphs to be shown at seek position
+    }
 
-            rtData.setMsecs(total_msecs);
-            rtData.setLapMsecs(lap_msecs);
+    // the latest sample is what we show
+    RealtimeData &rtData = sample.rtData;
 
-            long lapTimeRemaining;
-            if (ergFile) lapTimeRemaining = ergFile->nextLap(load_msecs) - load_msecs;
-            else lapTimeRemaining = 0;
+    // go update the displays...
+    context->notifyTelemetryUpdate(rtData); // signal everyone to update telemetry
 
-            if(lapTimeRemaining < 0) {
-                    if (ergFile) lapTimeRemaining =  ergFile->Duration - load_msecs;
-                    if(lapTimeRemaining < 0)
-                        lapTimeRemaining = 0;
-            }
-            rtData.setLapMsecsRemaining(lapTimeRemaining);
-
-            // local stuff ...
-            displayPower = rtData.getWatts();
-            displayCadence = rtData.getCadence();
-            displayHeartRate = rtData.getHr();
-            displaySpeed = rtData.getSpeed();
-            load = rtData.getLoad();
-            slope = rtData.getSlope();
-            displayLRBalance = rtData.getLRBalance();
-            displayLTE = rtData.getLTE();
-            displayRTE = rtData.getRTE();
-            displayLPS = rtData.getLPS();
-            displayRPS = rtData.getRPS();
-
-            // virtual speed
-            double crr = 0.004f; // typical for asphalt surfaces
-            double g = 9.81;     // g constant 9.81 m/s
-            double weight = appsettings->cvalue(context->athlete->cyclist, GC_WEIGHT, 0.0).toDouble();
-            double m = weight ? weight + 8 : 83; // default to 75kg weight, plus 8kg bike
-            double sl = slope / 100; // 10% = 0.1
-            double ad = 1.226f; // default air density at sea level
-            double cdA = 0.5f; // typical
-            double pw = rtData.getWatts();
-
-            // algorithm supplied by Tom Compton
-            // from www.AnalyticCycling.com
-            // 3.6 * ... converts from meters per second to kph
-            double vs = 3.6f * (
-            (-2*pow(2,0.3333333333333333)*(crr*m + g*m*sl)) /
-                pow(54*pow(ad,2)*pow(cdA,2)*pw +
-                sqrt(2916*pow(ad,4)*pow(cdA,4)*pow(pw,2) +
-                864*pow(ad,3)*pow(cdA,3)*pow(crr*m +
-                g*m*sl,3)),0.3333333333333333) +
-                pow(54*pow(ad,2)*pow(cdA,2)*pw +
-                sqrt(2916*pow(ad,4)*pow(cdA,4)*pow(pw,2) +
-                864*pow(ad,3)*pow(cdA,3)*pow(crr*m +
-                g*m*sl,3)),0.3333333333333333)/
-                (3.*pow(2,0.3333333333333333)*ad*cdA));
-
-            // just in case...
-            if (std::isnan(vs) || std::isinf(vs)) vs = 0.00f;
-            rtData.setVirtualSpeed(vs);
-
-            // W'bal on the fly
-            // using Dave Waterworth's reformulation
-            double TAU = appsettings->cvalue(context->athlete->cyclist, GC_WBALTAU, 300).toInt();
-
-            // any watts expended in last 200msec?
-            double JOULES = double(rtData.getWatts() - FTP) / 5.00f;
-            if (JOULES < 0) JOULES = 0;
-
-            // running total of replenishment
-            wbalr += JOULES * exp((total_msecs/1000.00f) / TAU);
-            wbal = WPRIME - (wbalr * exp((-total_msecs/1000.00f) / TAU));
-
-            rtData.setWbal(wbal);
-
-            // go update the displays...
-            context->notifyTelemetryUpdate(rtData); // signal everyone to update telemetry
-
-            // set now to current time when not using a workout
-            // but limit to almost every second (account for
-            // slight timing errors of 100ms or so)
-
-            // Do some rounding to the hundreds because as time goes by, rtData.getMsecs() drifts just below and then it does not pass the mod 1000 < 100 test
-            // For example:  msecs = 42199.  Mod 1000 = 199 versus msecs = 42000.  Mod 1000 = 0
-            // With this, it will now call tick just about every second
-            long rmsecs = round((rtData.getMsecs() + 99) / 100) * 100;
-            // Test for <= 100ms
-            if (!(status&RT_WORKOUT) && ((rmsecs % 1000) <= 100)) {
-                context->notifySetNow(rtData.getMsecs());
-            }
-        }
+    // set now to current time when not using a workout
+    // the engine flags the first sample in each second
+    if (!(status&RT_WORKOUT) && second) {
+        context->notifySetNow(rtData.getMsecs());
     }
 }
 
@@ -1497,6 +1376,7 @@ void TrainSidebar::newLap()
 {
     if ((status&RT_RUNNING) == RT_RUNNING) {
         displayLap++;
+        engine->newLap();
 
         pwrcount  = 0;
         cadcount  = 0;
@@ -1509,8 +1389,7 @@ void TrainSidebar::newLap()
 
 void TrainSidebar::resetLapTimer()
 {
-    lap_time.restart();
-    lap_elapsed_msec = 0;
+    engine->resetLap();
 }
 
 // can be called from the controller
@@ -1518,107 +1397,29 @@ void TrainSidebar::nextDisplayMode()
 {
 }
 
-void TrainSidebar::warnnoConfig()
+// can be called from the controller when it can't talk to the device
+void TrainSidebar::deviceError(QString message)
 {
-    QMessageBox::warning(this, tr("No Devices Configured"), "Please configure a device in Preferences.");
+    // it keeps telling us until the engine stops
+    if ((status&RT_RUNNING) == 0) return;
+
+    Stop(DEVICE_ERROR);
+
+    QMessageBox msgBox;
+    msgBox.setText(message);
+    msgBox.setIcon(QMessageBox::Critical);
+    msgBox.exec();
 }
 
-//----------------------------------------------------------------------
-// DISK UPDATE FUNCTIONS
-//----------------------------------------------------------------------
-void TrainSidebar::diskUpdate()
+void TrainSidebar::warnnoConfig()
 {
-    int  secs;
-
-    long torq = 0, altitude = 0;
-    QTextStream recordFileStream(recordFile);
-
-    if (calibrating) return;
-
-    // convert from milliseconds to secondes
-    total_msecs = session_elapsed_msec + session_time.elapsed();
-    secs = total_msecs;
-    secs /= 1000.0;
-
-    // GoldenCheetah CVS Format "secs, cad, hr, km, kph, nm, watts, alt, lon, lat, headwind, slope, temp, interval, lrbalance, lte, rte, lps, rps, smo2, thb, o2hb, hhb\n";
-
-    recordFileStream    << secs
-                        << "," << displayCadence
-                        << "," << displayHeartRate
-                        << "," << displayDistance
-                        << "," << displaySpeed
-                        << "," << torq
-                        << "," << displayPower
-                        << "," << altitude
-                        << "," // lon
-                        << "," // lat
-                        << "," // headwind
-                        << "," // slope
-                        << "," // temp
-                        << "," << (displayLap + displayWorkoutLap)
-                        << "," << displayLRBalance
-                        << "," << displayLTE
-                        << "," << displayRTE
-                        << "," << displayLPS
-                        << "," << displayRPS
-                        << "," // smo2
-                        << "," // thb
-                        << "," // o2hb
-                        << "," // hhb\n
-
-                        << "," << "\n";
+    QMessageBox::warning(this, tr("No Devices Configured"), "Please configure a device in Preferences.");
 }
 
 //----------------------------------------------------------------------
 // WORKOUT MODE
 //----------------------------------------------------------------------
 
-void TrainSidebar::loadUpdate()
-{
-    int curLap;
-
-    // we hold our horses whilst calibration is taking place...
-    if (calibrating) return;
-
-    // the period between loadUpdate calls is not constant, and not exactly LOADRATE,
-    // therefore, use a QTime timer to measure the load period
-    load_msecs += load_period.restart();
-
-    if (status&RT_MODE_ERGO) {
-        load = ergFile->wattsAt(load_msecs, curLap);
-
-        if(displayWorkoutLap != curLap)
-        {
-            context->notifyNewLap();
-        }
-        displayWorkoutLap = curLap;
-
-        // we got to the end!
-        if (load == -100) {
-            Stop(DEVICE_OK);
-        } else {
-            foreach(int dev, devices()) Devices[dev].controller->setLoad(load);
-            context->notifySetNow(load_msecs);
-        }
-    } else {
-        slope = ergFile->gradientAt(displayWorkoutDistance*1000, curLap);
-
-        if(displayWorkoutLap != curLap)
-        {
-            context->notifyNewLap();
-        }
-        displayWorkoutLap = curLap;
-
-        // we got to the end!
-        if (slope == -100) {
-            Stop(DEVICE_OK);
-        } else {
-            foreach(int dev, devices()) Devices[dev].controller->setGradient(slope);
-            context->notifySetNow(displayWorkoutDistance * 1000);
-        }
-    }
-}
-
 void TrainSidebar::Calibrate()
 {
     static QProgressDialog *bar=NULL;
@@ -1627,29 +1428,21 @@ void TrainSidebar::Calibrate()
     if (calibrating) {
         bar->reset(); // will hide...
 
-        // restart gui etc
-        session_time.start();
-        lap_time.start();
-        load_period.restart();
-        if (status & RT_WORKOUT) load_timer->start(LOADRATE);
-        if (status & RT_RECORDING) disk_timer->start(SAMPLERATE);
-        context->notifyUnPause(); // get video started again, amongst other things
-
         // back to ergo/slope mode and restore load/gradient
         if (status&RT_MODE_ERGO) {
 
-            foreach(int dev, devices()) {
-                Devices[dev].controller->setMode(RT_MODE_ERGO);
-                Devices[dev].controller->setLoad(load);
-            }
+            foreach(int dev, devices()) Devices[dev].controller->setMode(RT_MODE_ERGO);
+            engine->setLoad(load);
         } else {
 
-            foreach(int dev, devices()) {
-                Devices[dev].controller->setMode(RT_MODE_SPIN);
-                Devices[dev].controller->setGradient(slope);
-            }
+            foreach(int dev, devices()) Devices[dev].controller->setMode(RT_MODE_SPIN);
+            engine->setSlope(slope);
         }
 
+        // restart the clock, workout and recording
+        engine->setCalibrating(false);
+        context->notifyUnPause(); // get video started again, amongst other things
+
     } else {
 
         if (bar == NULL) {
@@ -1662,14 +1455,9 @@ void TrainSidebar::Calibrate()
         }
         bar->show();
 
-        // pause gui/load, streaming and recording
-        // but keep the gui ticking so we get realtime telemetry to detect the F3 keypad =button press
-        session_elapsed_msec += session_time.elapsed();
-        lap_elapsed_msec += lap_time.elapsed();
-
-        if (status & RT_RECORDING) disk_timer->stop();
-        if (status & RT_WORKOUT) load_timer->stop();
-        load_msecs += load_period.restart();
+        // pause the clock, workout, streaming and recording but keep the
+        // engine polling so we get realtime telemetry to detect the F3 keypad button press
+        engine->setCalibrating(true);
 
         context->notifyPause(); // get video started again, amongst other things
 
@@ -1686,14 +1474,18 @@ void TrainSidebar::FFwd()
     if ((status&RT_RUNNING) == 0) return;
 
     if (status&RT_MODE_ERGO) {
-        load_msecs += 10000; // jump forward 10 seconds
+        load_msecs = engine->workoutMsecs() + 10000; // jump forward 10 seconds
+        engine->setWorkoutMsecs(load_msecs);
         context->notifySeek(load_msecs);
     }
     else if (context->currentVideoSyncFile())
     {
         context->notifySeek(+1); // in case of video with RLV file synchronisation just ask to go forward
     }
-    else displayWorkoutDistance += 1; // jump forward a kilometer in the workout
+    else {
+        displayWorkoutDistance = engine->workoutDistance() + 1; // jump forward a kilometer in the workout
+        engine->setWorkoutDistance(displayWorkoutDistance);
+    }
 }
 
 void TrainSidebar::Rewind()
@@ -1701,8 +1493,9 @@ void TrainSidebar::Rewind()
     if ((status&RT_RUNNING) == 0) return;
 
     if (status&RT_MODE_ERGO) {
-        load_msecs -=10000; // jump back 10 seconds
+        load_msecs = engine->workoutMsecs() - 10000; // jump back 10 seconds
         if (load_msecs < 0) load_msecs = 0;
+        engine->setWorkoutMsecs(load_msecs);
         context->notifySeek(load_msecs);
     }
     else if (context->currentVideoSyncFile())
@@ -1710,8 +1503,9 @@ void TrainSidebar::Rewind()
         context->notifySeek(-1); // in case of video with RLV file synchronisation just ask to go backward
     }
     else {
-        displayWorkoutDistance -=1; // jump back a kilometer
+        displayWorkoutDistance = engine->workoutDistance() - 1; // jump back a kilometer
         if (displayWorkoutDistance < 0) displayWorkoutDistance = 0;
+        engine->setWorkoutDistance(displayWorkoutDistance);
     }
 }
 
@@ -1724,12 +1518,16 @@ void TrainSidebar::FFwdLap()
     double lapmarker;
 
     if (status&RT_MODE_ERGO) {
+        load_msecs = engine->workoutMsecs();
         lapmarker = ergFile->nextLap(load_msecs);
         if (lapmarker != -1) load_msecs = lapmarker; // jump forward to lapmarker
+        engine->setWorkoutMsecs(load_msecs);
         context->notifySeek(load_msecs);
     } else {
+        displayWorkoutDistance = engine->workoutDistance();
         lapmarker = ergFile->nextLap(displayWorkoutDistance*1000);
         if (lapmarker != -1) displayWorkoutDistance = lapmarker/1000; // jump forward to lapmarker
+        engine->setWorkoutDistance(displayWorkoutDistance);
     }
 }
 
@@ -1743,16 +1541,17 @@ void TrainSidebar::Higher()
         intensitySlider->setValue(intensitySlider->value()+5);
 
     } else {
+        load = engine->load();
+        slope = engine->slope();
+
         if (status&RT_MODE_ERGO) load += 5;
         else slope += 0.1;
 
         if (load >1500) load = 1500;
         if (slope >15) slope = 15;
 
-        if (status&RT_MODE_ERGO)
-            foreach(int dev, devices()) Devices[dev].controller->setLoad(load);
-        else
-            foreach(int dev, devices()) Devices[dev].controller->setGradient(slope);
+        if (status&RT_MODE_ERGO) engine->setLoad(load);
+        else engine->setSlope(slope);
     }
 }
 
@@ -1766,6 +1565,8 @@ void TrainSidebar::Lower()
         intensitySlider->setValue(intensitySlider->value()-5);
 
     } else {
+        load = engine->load();
+        slope = engine->slope();
 
         if (status&RT_MODE_ERGO) load -= 5;
         else slope -= 0.1;
@@ -1773,10 +1574,8 @@ void TrainSidebar::Lower()
         if (load <0) load = 0;
         if (slope <-10) slope = -10;
 
-        if (status&RT_MODE_ERGO)
-            foreach(int dev, devices()) Devices[dev].controller->setLoad(load);
-        else
-            foreach(int dev, devices()) Devices[dev].controller->setGradient(slope);
+        if (status&RT_MODE_ERGO) engine->setLoad(load);
+        else engine->setSlope(slope);
     }
 }
 
@@ -1824,6 +1623,9 @@ void TrainSidebar::adjustIntensity()
 
     bool insertedNow = context->getNow() ? false : true; // don't add if at start
 
+    // the engine may be looking up the load right now
+    QMutexLocker locker(engine->workoutLock());
+
     // what about gradient courses?
     ErgFilePoint last;
     for(int i = 0; i < context->currentErgFile()->Points.count(); i++) {
@@ -1867,6 +1669,7 @@ void TrainSidebar::adjustIntensity()
 
     // recalculate metrics
     context->currentErgFile()->calculateMetrics();
+    locker.unlock();
     setLabels();
 
     // unblock signals now we are done
@@ -29,6 +29,7 @@
 #include "VideoSyncFile.h"
 #include "ErgFilePlot.h"
 #include "GcSideBarItem.h"
+#include "TrainEngine.h"
 
 // standard stuff
 #include <QDir>
@@ -57,10 +58,10 @@
 #define RT_WORKOUT      0x0800        // is running a workout
 #define RT_STREAMING    0x1000        // is streaming to a remote peer
 
-// msecs constants for timers
-#define REFRESHRATE    200 // screen refresh in milliseconds
+// msecs constants for the train engine
+#define REFRESHRATE    200 // device polling and screen refresh in milliseconds
 #define STREAMRATE     200 // rate at which we stream updates to remote peer
-#define SAMPLERATE     1000 // disk update in milliseconds
+#define SAMPLERATE     1000 // once a second updates in milliseconds
 #define LOADRATE       1000 // rate at which load is adjusted
 
 // device treeview node types
@@ -102,7 +103,6 @@ class TrainSidebar : public GcWindow
         // was realtimewindow,merged into tool
         // update charts/dials and manage controller
         void updateData(RealtimeData &);      // to update telemetry by push devices
-        void nextDisplayMode();     // show next display mode
         void setStreamController();     // based upon selected device
 
         // this
@@ -147,6 +147,7 @@ class TrainSidebar : public GcWindow
         void removeInvalidVideoSync();
         void removeInvalidWorkout();
 
+        void recoverRecordings();   // import any that were interrupted
 
     public slots:
         void configChanged(qint32);
@@ -166,11 +167,11 @@ class TrainSidebar : public GcWindow
         void Lower();       // set load/gradient higher
         void newLap();      // start new Lap!
         void resetLapTimer(); //reset the lap timer
+        void nextDisplayMode();     // show next display mode
+        void deviceError(QString);  // controller lost its device
 
-        // Timed actions
-        void guiUpdate();           // refreshes the telemetry
-        void diskUpdate();          // writes to CSV file
-        void loadUpdate();          // sets Load on CT like devices
+        // Engine actions
+        void guiUpdate();           // refreshes the telemetry from the engine
 
         // When no config has been setup
         void warnnoConfig();
@@ -234,21 +235,17 @@ class TrainSidebar : public GcWindow
         int status;
         int displaymode;
 
-        QFile *recordFile;      // where we record!
+        QString recordFileName;     // where we record!
         ErgFile *ergFile;       // workout file
         VideoSyncFile *videosyncFile;       // videosync file
 
         long total_msecs,
              lap_msecs,
              load_msecs;
-        QTime load_period;
-
-        uint session_elapsed_msec, lap_elapsed_msec;
-        QTime session_time, lap_time;
 
-        QTimer      *gui_timer,     // refresh the gui
-                    *load_timer,    // change the load on the device
-                    *disk_timer;    // write to .CSV file
+        // polls the devices, runs the workout and
+        // integrates distance off the gui thread
+        TrainEngine *engine;
 
     public:
         int mode;
@@ -256,7 +253,7 @@ class TrainSidebar : public GcWindow
         QCheckBox   *recordSelector;
         QSharedPointer<QFileSystemWatcher> watcher;
         bool calibrating;
-        double wbalr, wbal;
+        double wbal;
 };
 
 class MultiDeviceDialog : public QDialog
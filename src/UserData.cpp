@@ -379,11 +379,8 @@ UserData::setRideItem(RideItem*m)
 
         if (vector.count() == 0 && rideItem->ride()) {
 
-            // run through each sample and create an equivalent
-            foreach(RideFilePoint *p, rideItem->ride()->dataPoints()) {
-                Result res = parser.evaluate(rideItem, p);
-                vector << res.number;
-            }
+            // evaluate for all the samples in one go
+            vector = parser.evaluateSamples(rideItem);
 
             // cache for next time !
             rideItem->userCache.insert(parser.signature(), vector);
@@ -51,7 +51,6 @@
 #include "WPrime.h"
 #include "RideItem.h"
 #include "Units.h" // for MILES_PER_KM
-#include "Settings.h" // for GC_WBALFORM
 
 const double WprimeMultConst = 1.0;
 const int WPrimeDecayPeriod = 1800; // 1 hour, tried infinite but costly and limited value
@@ -84,15 +83,17 @@ WPrime::WPrime()
 {
     // XXX will need to reset metrics when they are added
     minY = maxY = 0;
-    wasIntegral = (appsettings->value(NULL, GC_WBALFORM, "int").toString() == "int");
+    wasIntegral = true; // setRide() uses the athlete's setting
 }
 
 void
 WPrime::check()
 {
-    bool integral = (appsettings->value(NULL, GC_WBALFORM, "int").toString() == "int");
+    if (!rideFile || !rideFile->context) return;
+
+    bool integral = rideFile->context->athlete->settings()->wbalIntegral;
     if (integral == wasIntegral) return;
-    else if (rideFile) {
+    else {
         wasIntegral = integral;
         setRide(rideFile); // reset coz calc mode changed
     }
@@ -101,8 +102,6 @@ WPrime::check()
 void
 WPrime::setRide(RideFile *input)
 {
-    bool integral = (appsettings->value(NULL, GC_WBALFORM, "int").toString() == "int");
-
     QTime time; // for profiling performance of the code
     time.start();
 
@@ -121,6 +120,10 @@ WPrime::setRide(RideFile *input)
         return;
     }
 
+    // the formula is in the athlete's settings snapshot
+    bool integral = input->context ? input->context->athlete->settings()->wbalIntegral : true;
+    wasIntegral = integral;
+
     // STEP 1: CONVERT POWER DATA TO A 1 SECOND TIME SERIES
     // create a raw time series in the format QwtSpline wants
     QVector<QPointF> points;
@@ -363,7 +366,7 @@ WPrime::setRide(RideFile *input)
 void
 WPrime::setErg(ErgFile *input)
 {
-    bool integral = (appsettings->value(NULL, GC_WBALFORM, "int").toString() == "int");
+    bool integral = input->context->athlete->settings()->wbalIntegral;
 
     QTime time; // for profiling performance of the code
     time.start();
@@ -416,7 +419,7 @@ WPrime::setErg(ErgFile *input)
             } else EXP += value; // total expenditure above CP
         }
 
-        TAU = appsettings->cvalue(input->context->athlete->cyclist, GC_WBALTAU, 300).toInt();
+        TAU = input->context->athlete->settings()->wbalTau;
 
         // lets run forward from 0s to end of ride
         values.resize(last+1);
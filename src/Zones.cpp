@@ -21,6 +21,7 @@
 #include "Colors.h"
 #include "Settings.h"
 #include "TimeUtils.h"
+#include "DateIndex.h"
 #include <QtGui>
 #include <QtAlgorithms>
 #include <qcolor.h>
@@ -511,15 +512,7 @@ next_line: {}
 // end of range
 int Zones::whichRange(const QDate &date) const
 {
-    for (int rnum = 0; rnum < ranges.size(); ++rnum) {
-
-        const ZoneRange &range = ranges[rnum];
-        if (((date >= range.begin) || (range.begin.isNull())) &&
-            ((date < range.end) || (range.end.isNull())))
-            return rnum;
-
-    }
-    return -1;
+    return whichDateRange(ranges, date);
 }
 
 int Zones::numZones(int rnum) const
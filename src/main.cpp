@@ -23,6 +23,8 @@
 #include "TrainDB.h"
 #include "Colors.h"
 #include "GcUpgrade.h"
+#include "TrainBenchmark.h"
+#include "ANTReplay.h"
 
 #include <QApplication>
 #include <QtGui>
@@ -132,6 +134,11 @@ main(int argc, char *argv[])
     bool server = false;
     nogui = false;
     bool help = false;
+    QString trainbench, trace;
+    double rate = 4;
+    int duration = 0, stall = 0;
+    QString antreplay;
+    int chunk = 40, gap = 5;
 
     // honour command line switches
     foreach (QString arg, sargs) {
@@ -149,6 +156,16 @@ main(int argc, char *argv[])
             fprintf(stderr, "--debug             to turn on redirection of messages to goldencheetah.log [debug build]\n");
 #else
             fprintf(stderr, "--debug             to direct diagnostic messages to the terminal instead of goldencheetah.log\n");
+#endif
+            fprintf(stderr, "--trainbench=file   to run a workout on a simulated trainer and report the train engine timings\n");
+            fprintf(stderr, "  --trace=file      replay sensor readings from a ride instead of making them up\n");
+            fprintf(stderr, "  --rate=n          sensor readings a second, default 4\n");
+            fprintf(stderr, "  --duration=secs   how long to run for, default the whole workout\n");
+            fprintf(stderr, "  --stall=msecs     hold off taking samples for this long every second\n");
+#ifndef WIN32
+            fprintf(stderr, "--antreplay=file    to replay an antlog.bin through the ANT reader on a pseudo terminal\n");
+            fprintf(stderr, "  --chunk=bytes     largest write, they go from 1 byte up to this, default 40\n");
+            fprintf(stderr, "  --gap=msecs       pause between writes, default 5\n");
 #endif
             fprintf (stderr, "\nSpecify the folder and/or athlete to open on startup\n");
             fprintf(stderr, "If no parameters are passed it will reopen the last athlete.\n\n");
@@ -170,6 +187,23 @@ main(int argc, char *argv[])
             debug = true;
 #endif
 
+        } else if (arg.startsWith("--trainbench=")) {
+            trainbench = arg.mid(13);
+        } else if (arg.startsWith("--trace=")) {
+            trace = arg.mid(8);
+        } else if (arg.startsWith("--rate=")) {
+            rate = arg.mid(7).toDouble();
+        } else if (arg.startsWith("--duration=")) {
+            duration = arg.mid(11).toInt();
+        } else if (arg.startsWith("--stall=")) {
+            stall = arg.mid(8).toInt();
+        } else if (arg.startsWith("--antreplay=")) {
+            antreplay = arg.mid(12);
+        } else if (arg.startsWith("--chunk=")) {
+            chunk = arg.mid(8).toInt();
+        } else if (arg.startsWith("--gap=")) {
+            gap = arg.mid(6).toInt();
+
         } else {
 
             // not switches !
@@ -182,6 +216,32 @@ main(int argc, char *argv[])
         exit(0);
     }
 
+    // benchmark the train engine, no gui needed
+    if (trainbench != "") {
+        {
+            QCoreApplication bench(argc, argv);
+            TrainBenchmark benchmark(trainbench);
+            benchmark.setTrace(trace);
+            benchmark.setRate(rate);
+            benchmark.setDuration(duration);
+            benchmark.setStall(stall);
+            ret = benchmark.run();
+        }
+        exit(ret);
+    }
+
+    // replay an ANT log through the reader, no gui needed
+    if (antreplay != "") {
+        {
+            QCoreApplication replay(argc, argv);
+            ANTReplay replayer(antreplay);
+            replayer.setChunk(chunk);
+            replayer.setGap(gap);
+            ret = replayer.run();
+        }
+        exit(ret);
+    }
+
     //
     // INITIALISE ONE TIME OBJECTS
     //
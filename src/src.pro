@@ -350,6 +350,7 @@ HEADERS += \
         ANTLogger.h \
         ANTMessage.h \
         ANTMessages.h \
+        ANTReplay.h \
         ANTlocalController.h \
         Athlete.h \
         AthleteBackup.h \
@@ -377,7 +378,9 @@ HEADERS += \
         CPPlot.h \
         CriticalPowerWindow.h \
         CsvRideFile.h \
+        DateIndex.h \
         DataProcessor.h \
+        DecimatedSeriesData.h \
         DaysScaleDraw.h \
         Device.h \
         DeviceTypes.h \
@@ -442,6 +445,7 @@ HEADERS += \
         LTMWindow.h \
         MacroDevice.h \
         MainWindow.h \
+        MeanMaxIndex.h \
         ManualRideDialog.h \
         ManualRideFile.h \
         MergeActivityWizard.h \
@@ -477,6 +481,7 @@ HEADERS += \
         RideAutoImportConfig.h \
         RideCache.h \
         RideCacheModel.h \
+        RideDBStore.h \
         RideEditor.h \
         RideFile.h \
         RideFileCache.h \
@@ -502,6 +507,7 @@ HEADERS += \
         Serial.h \
         Settings.h \
         ShareDialog.h \
+        SimulatorController.h \
         SpecialFields.h \
         Specification.h \
         SpinScanPlot.h \
@@ -529,7 +535,10 @@ HEADERS += \
         ToolsDialog.h \
         ToolsRhoEstimator.h \
         VDOTCalculator.h \
+        TrainBenchmark.h \
         TrainDB.h \
+        TrainEngine.h \
+        TrainRecorder.h \
         TrainSidebar.h \
         TreeMapWindow.h \
         TreeMapPlot.h \
@@ -578,6 +587,7 @@ SOURCES += \
         ANTChannel.cpp \
         ANTLogger.cpp \
         ANTMessage.cpp \
+        ANTReplay.cpp \
         ANTlocalController.cpp \
         Athlete.cpp \
         AthleteBackup.cpp \
@@ -612,6 +622,7 @@ SOURCES += \
         CsvRideFile.cpp \
         DanielsPoints.cpp \
         DataProcessor.cpp \
+        DecimatedSeriesData.cpp \
         Device.cpp \
         DeviceTypes.cpp \
         DeviceConfiguration.cpp \
@@ -689,6 +700,7 @@ SOURCES += \
         LTMWindow.cpp \
         MacroDevice.cpp \
         MainWindow.cpp \
+        MeanMaxIndex.cpp \
         ManualRideDialog.cpp \
         ManualRideFile.cpp \
         MergeActivityWizard.cpp \
@@ -726,6 +738,7 @@ SOURCES += \
         RideAutoImportConfig.cpp \
         RideCache.cpp \
         RideCacheModel.cpp \
+        RideDBStore.cpp \
         RideEditor.cpp \
         RideFile.cpp \
         RideFileCache.cpp \
@@ -748,6 +761,7 @@ SOURCES += \
         Serial.cpp \
         Settings.cpp \
         ShareDialog.cpp \
+        SimulatorController.cpp \
         SmallPlot.cpp \
         SpecialFields.cpp \
         Specification.cpp \
@@ -781,7 +795,10 @@ SOURCES += \
         ToolsRhoEstimator.cpp \
         VDOT.cpp \
         VDOTCalculator.cpp \
+        TrainBenchmark.cpp \
         TrainDB.cpp \
+        TrainEngine.cpp \
+        TrainRecorder.cpp \
         TrainSidebar.cpp \
         TreeMapWindow.cpp \
         TreeMapPlot.cpp \